@@ -0,0 +1,331 @@
+/*
+ *  bench_draw.c - Benchmark of the shape drawing kernels
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../bitmap.h"
+#include "../draw.h"
+
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define BENCH_REPEAT 5
+#define BENCH_SHAPES 2000
+#define BENCH_SIZE_MIN 4
+#define BENCH_SIZE_MAX 200
+#define BENCH_FAR_SIZE_MAX 1000000
+
+/* shapes are in one array for each shape, the union keeps them apart */
+typedef union _BenchShape_ {
+	Rectangle rectangle;
+	Circle circle;
+	Triangle triangle;
+	Line line;
+	Ellipse ellipse;
+	Ring ring;
+	RoundRect roundrect;
+} BenchShape;
+
+static const char *shape_names[SH_COUNT] = {
+	"rectangle",
+	"circle",
+	"triangle",
+	"line",
+	"polyline",
+	"polygon",
+	"ellipse",
+	"ring",
+	"roundrect",
+	"define",
+	"use",
+	"points",
+	"grid",
+	"image",
+	"gradient",
+	"text"
+};
+
+//-----------------------------------------------------------------------------
+///
+/// Get monotonic time in seconds
+//
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Random number between min and max (both inclusive)
+//
+static int random_between(int min, int max)
+{
+	return min + rand() % (max - min + 1);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Creates a random shape around a point
+///
+/// @param shape   shape type
+/// @param obj     receives the shape
+/// @param x       center column
+/// @param y       center row
+/// @param size    width of the shape
+//
+static void shape_around(Shape shape, BenchShape *obj, int x, int y, int size)
+{
+	int color = rand() & 0xffffff;
+	int half = size / 2;
+	if (shape == SH_RECTANGLE)
+	{
+		Rectangle rect = {0, color, x - half, y - half, size, size};
+		obj->rectangle = rect;
+	}
+	else if (shape == SH_CIRCLE)
+	{
+		Circle circle = {0, color, x, y, half};
+		obj->circle = circle;
+	}
+	else if (shape == SH_LINE)
+	{
+		Line line = {0, color,
+					 x + random_between(-half, half), y - half,
+					 x + random_between(-half, half), y + half,
+					 random_between(1, 4)};
+		obj->line = line;
+	}
+	else if (shape == SH_ELLIPSE)
+	{
+		Ellipse ellipse = {0, color, x, y, half, random_between(1, half)};
+		obj->ellipse = ellipse;
+	}
+	else if (shape == SH_RING)
+	{
+		Ring ring = {0, color, x, y, random_between(0, half), half};
+		obj->ring = ring;
+	}
+	else if (shape == SH_ROUNDRECT)
+	{
+		RoundRect rect = {0, color, x - half, y - half, size, size,
+						  random_between(1, half)};
+		obj->roundrect = rect;
+	}
+	else
+	{
+		Triangle tri = {0, color,
+						x + random_between(-half, half), y - half,
+						x - half, y + random_between(0, half),
+						x + half, y + random_between(-half, half)};
+		obj->triangle = tri;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Creates commands with random shapes. Inside shapes have their bounding
+/// box in the picture (so draw_command takes the kernel without clipping),
+/// edge shapes have their center on the border of the picture, outside
+/// shapes are up to BENCH_FAR_SIZE_MAX big and next to the picture (so
+/// draw_command skips them).
+///
+/// @param shape     shape type
+/// @param set       0 for inside, 1 for edge, 2 for outside shapes
+/// @param commands  receives BENCH_SHAPES commands
+/// @param objs      receives the BENCH_SHAPES shapes of the commands
+//
+static void shapes_new(Shape shape, int set, Command *commands,
+					   BenchShape *objs)
+{
+	for (int i = 0; i < BENCH_SHAPES; i++)
+	{
+		int size = random_between(BENCH_SIZE_MIN, BENCH_SIZE_MAX);
+		int margin = size / 2 + 2;
+		int x, y;
+		if (set == 2)
+		{
+			size = random_between(BENCH_SIZE_MAX, BENCH_FAR_SIZE_MAX);
+			margin = size / 2 + 2;
+			x = random_between(0, BENCH_WIDTH - 1);
+			y = random_between(0, BENCH_HEIGHT - 1);
+			/* move the center out of the picture by more than half the size */
+			switch (i % 4)
+			{
+			case 0:
+				x = -margin - random_between(0, size);
+				break;
+			case 1:
+				x = BENCH_WIDTH - 1 + margin + random_between(0, size);
+				break;
+			case 2:
+				y = -margin - random_between(0, size);
+				break;
+			default:
+				y = BENCH_HEIGHT - 1 + margin + random_between(0, size);
+				break;
+			}
+		}
+		else if (set == 1)
+		{
+			x = random_between(0, BENCH_WIDTH - 1);
+			y = random_between(0, BENCH_HEIGHT - 1);
+			/* move the center on one of the four borders */
+			switch (i % 4)
+			{
+			case 0:
+				x = 0;
+				break;
+			case 1:
+				x = BENCH_WIDTH - 1;
+				break;
+			case 2:
+				y = 0;
+				break;
+			default:
+				y = BENCH_HEIGHT - 1;
+				break;
+			}
+		}
+		else
+		{
+			x = random_between(margin, BENCH_WIDTH - 1 - margin);
+			y = random_between(margin, BENCH_HEIGHT - 1 - margin);
+		}
+		shape_around(shape, &objs[i], x, y, size);
+		commands[i].shape = shape;
+		commands[i].id = i;
+		commands[i].obj = &objs[i];
+		commands[i].fill = NULL;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws all commands with one variant and prints the speed of the best run
+///
+/// @param pix_buffer  pixel buffer to draw into
+/// @param commands    BENCH_SHAPES commands
+/// @param set         name of the shape set
+/// @param variant     0 clipping kernel, 1 kernel without clipping,
+///                    2 draw_command (chooses the kernel)
+//
+static void bench_variant(PixelBuffer *pix_buffer, Command *commands,
+						  const char *set, int variant)
+{
+	const char *variant_names[] = {"clip", "noclip", "dispatch"};
+	double best = 1e30;
+	uint64_t pixels = 0;
+	for (int run = 0; run < BENCH_REPEAT; run++)
+	{
+		pixels = 0;
+		double start = now();
+		for (int i = 0; i < BENCH_SHAPES; i++)
+		{
+			if (variant == 2)
+			{
+				draw_command(pix_buffer, &commands[i]);
+			}
+			else
+			{
+				pixels += draw_command_kernel(pix_buffer, &commands[i],
+											  variant == 0);
+			}
+		}
+		double t = now() - start;
+		if (t < best)
+		{
+			best = t;
+		}
+	}
+
+	if (variant == 2)
+	{
+		printf("%-10s %-7s %-9s %10.3f %9.1f ns/shape\n",
+			   shape_names[commands[0].shape], set, variant_names[variant],
+			   best * 1e3, best * 1e9 / BENCH_SHAPES);
+		return;
+	}
+	printf("%-10s %-7s %-9s %10.3f %9.1f ns/shape %9.1f Mpixel/s\n",
+		   shape_names[commands[0].shape], set, variant_names[variant],
+		   best * 1e3, best * 1e9 / BENCH_SHAPES, pixels / best / 1e6);
+}
+
+int main(void)
+{
+	PixelBuffer *pix_buffer = bitmap_pixel_buffer_new(BENCH_WIDTH,
+													  BENCH_HEIGHT);
+	Command *commands = malloc(sizeof(Command) * BENCH_SHAPES);
+	BenchShape *objs = malloc(sizeof(BenchShape) * BENCH_SHAPES);
+	if (pix_buffer == NULL || commands == NULL || objs == NULL)
+	{
+		printf("Error: out of memory.\n");
+		bitmap_pixel_buffer_delete(pix_buffer);
+		free(commands);
+		free(objs);
+		return 1;
+	}
+
+	/* touch all pages before timing */
+	bitmap_pixel_buffer_fill(pix_buffer, 0xffffff);
+	srand(1);
+	printf("%dx%d, %d shapes of size %d to %d, best of %d runs, time in ms\n",
+		   BENCH_WIDTH, BENCH_HEIGHT, BENCH_SHAPES, BENCH_SIZE_MIN,
+		   BENCH_SIZE_MAX, BENCH_REPEAT);
+	/*
+	 * polylines are lines between points, the line kernel covers them,
+	 * polygons are measured with their point lists by make bench-regions,
+	 * uses of symbols by make bench-symbols, points by make bench-points,
+	 * grids by make bench-grid, images by make bench-image, gradient fills
+	 * by make bench-gradient, texts by make bench-text
+	 */
+	for (Shape shape = 0; shape < SH_COUNT; shape++)
+	{
+		if (shape == SH_POLYLINE || shape == SH_POLYGON ||
+			shape == SH_SYMBOL || shape == SH_USE || shape == SH_POINTS ||
+			shape == SH_GRID || shape == SH_IMAGE || shape == SH_GRADIENT ||
+			shape == SH_TEXT)
+		{
+			continue;
+		}
+		/* the kernel without clipping only gets inside shapes */
+		shapes_new(shape, 0, commands, objs);
+		bench_variant(pix_buffer, commands, "inside", 0);
+		bench_variant(pix_buffer, commands, "inside", 1);
+		bench_variant(pix_buffer, commands, "inside", 2);
+		shapes_new(shape, 1, commands, objs);
+		bench_variant(pix_buffer, commands, "edge", 0);
+		bench_variant(pix_buffer, commands, "edge", 2);
+		shapes_new(shape, 2, commands, objs);
+		bench_variant(pix_buffer, commands, "outside", 0);
+		bench_variant(pix_buffer, commands, "outside", 2);
+	}
+
+	bitmap_pixel_buffer_delete(pix_buffer);
+	free(commands);
+	free(objs);
+	return 0;
+}
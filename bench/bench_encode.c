@@ -0,0 +1,246 @@
+/*
+ *  bench_encode.c - Benchmark of the encoders (speed and size)
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../bitmap.h"
+#include "../draw.h"
+#include "../stream.h"
+#include "../png.h"
+#include "../qoi.h"
+
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define BENCH_REPEAT 5
+
+typedef struct _Sink_ {
+	char *data;
+	size_t size;
+	size_t capacity;
+} Sink;
+
+//-----------------------------------------------------------------------------
+///
+/// Write function of a stream copying into preallocated memory, so the
+/// benchmark measures the encoders and not the disk
+///
+/// @param handle  pointer to Sink
+/// @param data    data to write
+/// @param size    size of data in bytes
+///
+/// @return STREAM_SUCCESS on success, STREAM_ERR_WRITE if sink is full
+//
+static int sink_write(void *handle, const void *data, size_t size)
+{
+	Sink *sink = handle;
+	if (sink->size + size > sink->capacity)
+	{
+		return STREAM_ERR_WRITE;
+	}
+	memcpy(sink->data + sink->size, data, size);
+	sink->size += size;
+	return STREAM_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Get monotonic time in seconds
+//
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Fill the pixel buffer with a scene of flat colored shapes
+///
+/// @param pix_buffer  pixel buffer to draw into
+/// @param shapes      number of shapes
+//
+static void scene_flat(PixelBuffer *pix_buffer, int shapes)
+{
+	Command comm;
+	Rectangle rect = {0, 0xffffff, 0, 0, BENCH_WIDTH, BENCH_HEIGHT};
+	comm.shape = SH_RECTANGLE;
+	comm.obj = &rect;
+	comm.fill = NULL;
+	draw_command(pix_buffer, &comm);
+
+	int i;
+	for (i = 0; i < shapes; i++)
+	{
+		Circle circle;
+		circle.color = (rand() % 16) * 0x0f0f0f ^ 0x3060a0;
+		circle.x = rand() % BENCH_WIDTH;
+		circle.y = rand() % BENCH_HEIGHT;
+		circle.radius = 10 + rand() % 150;
+		comm.shape = SH_CIRCLE;
+		comm.obj = &circle;
+		draw_command(pix_buffer, &comm);
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Fill the pixel buffer with a smooth gradient plus some noise (photo like)
+///
+/// @param pix_buffer  pixel buffer to draw into
+//
+static void scene_noise(PixelBuffer *pix_buffer)
+{
+	uint32_t x, y;
+	for (y = 0; y < pix_buffer->height; y++)
+	{
+		for (x = 0; x < pix_buffer->width; x++)
+		{
+			int r = (x * 255 / pix_buffer->width + rand() % 8) & 0xff;
+			int g = (y * 255 / pix_buffer->height + rand() % 8) & 0xff;
+			int b = ((x + y) / 8 + rand() % 8) & 0xff;
+			bitmap_write_pixel(pix_buffer, x, y, (r << 16) | (g << 8) | b);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Encode the pixel buffer with all formats and print size and speed
+///
+/// @param name        name of the scene
+/// @param pix_buffer  pixel buffer containing the scene
+//
+static void bench_scene(const char *name, PixelBuffer *pix_buffer)
+{
+	const char *formats[] = {"bmp", "png", "png-fast", "qoi", "bmp-rle8"};
+	double raw = (double)pix_buffer->width * pix_buffer->height *
+		BITMAP_RGB_COLOR_SIZE;
+	Sink sink;
+	sink.capacity = 2 * raw + 65536;
+	sink.data = malloc(sink.capacity);
+	if (sink.data == NULL)
+	{
+		return;
+	}
+	memset(sink.data, 0, sink.capacity);
+	int f;
+
+	for (f = 0; f < 5; f++)
+	{
+		double best = 1e30;
+		size_t size = 0;
+		int i;
+		for (i = 0; i < BENCH_REPEAT; i++)
+		{
+			Stream stream = {sink_write, &sink};
+			sink.size = 0;
+			double start = now();
+			if (f == 0)
+			{
+				int header_size;
+				size_t array_size;
+				char *header = bitmap_file_header_new(pix_buffer->width,
+													  pix_buffer->height,
+													  &header_size);
+				char *array = bitmap_get_pixel_array(pix_buffer, &array_size);
+				stream_write(&stream, header, header_size);
+				stream_write(&stream, array, array_size);
+				bitmap_file_header_delete(header);
+				size = sink.size;
+			}
+			else if (f == 1 || f == 2)
+			{
+				png_write(&stream, pix_buffer, f == 2);
+				size = sink.size;
+			}
+			else if (f == 3)
+			{
+				qoi_write(&stream, pix_buffer);
+				size = sink.size;
+			}
+			else
+			{
+				BitmapPalette palette;
+				uint32_t compression;
+				size_t array_size;
+				if (bitmap_palette_from_pixel_buffer(pix_buffer, &palette)
+					!= BITMAP_SUCCESS)
+				{
+					break;
+				}
+				char *array = bitmap_indexed_pixel_array_new(pix_buffer,
+															 &palette,
+															 &compression,
+															 &array_size);
+				int header_size;
+				char *header = bitmap_indexed_file_header_new(
+					pix_buffer->width, pix_buffer->height, &palette,
+					compression, array_size, &header_size);
+				stream_write(&stream, header, header_size);
+				stream_write(&stream, array, array_size);
+				bitmap_file_header_delete(header);
+				bitmap_pixel_array_delete(array);
+				size = sink.size;
+			}
+			double t = now() - start;
+			if (t < best)
+			{
+				best = t;
+			}
+		}
+		if (size == 0)
+		{
+			printf("%-8s %-9s %12s\n", name, formats[f], "n/a");
+			continue;
+		}
+		printf("%-8s %-9s %12zu bytes %7.2f%% %9.1f MB/s\n", name, formats[f],
+			   size, 100.0 * size / raw, raw / best / 1e6);
+	}
+
+	free(sink.data);
+}
+
+int main(void)
+{
+	PixelBuffer *pix_buffer = bitmap_pixel_buffer_new(BENCH_WIDTH,
+													  BENCH_HEIGHT);
+	if (pix_buffer == NULL)
+	{
+		printf("Error: out of memory.\n");
+		return 1;
+	}
+
+	srand(1);
+	printf("%dx%d, best of %d runs, speed relative to 24 bit input\n",
+		   BENCH_WIDTH, BENCH_HEIGHT, BENCH_REPEAT);
+	scene_flat(pix_buffer, 200);
+	bench_scene("flat", pix_buffer);
+	scene_noise(pix_buffer);
+	bench_scene("noise", pix_buffer);
+
+	bitmap_pixel_buffer_delete(pix_buffer);
+	return 0;
+}
@@ -0,0 +1,290 @@
+/*
+ *  bench_render.c - Benchmark of the parse, render and write stages
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../bitmap.h"
+#include "../render.h"
+#include "../span.h"
+
+#define BENCH_DEFAULT_RUNS 11
+#define BENCH_STAGES 4
+
+static const char *usage =
+	"Usage: ./bench_render [--runs=N] [--lazy] [--scanline] "
+	"[--kernel=auto|scalar|sse2|avx2|avx512] <width> <height> <scene>...\n";
+
+static const char *stage_names[BENCH_STAGES] = {
+	"parse",
+	"render",
+	"write",
+	"total"
+};
+
+//-----------------------------------------------------------------------------
+///
+/// Get monotonic time in seconds
+//
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Compare function for qsort, orders doubles ascending
+//
+static int compare_double(const void *a, const void *b)
+{
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Percentile of sorted samples (nearest rank)
+///
+/// @param samples  sorted samples
+/// @param n        number of samples
+/// @param p        percentile between 0 and 100
+///
+/// @return the sample at the percentile
+//
+static double percentile(double *samples, int n, double p)
+{
+	int rank = (int)(p / 100.0 * n + 0.999999);
+	if (rank < 1)
+	{
+		rank = 1;
+	}
+	if (rank > n)
+	{
+		rank = n;
+	}
+	return samples[rank - 1];
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Run all stages for a scene once
+///
+/// @param context     render context
+/// @param scene_path  path of the input file
+/// @param width       canvas width
+/// @param height      canvas height
+/// @param file        file the bitmap is written to
+/// @param times       array receiving the time of each stage in seconds
+///
+/// @return RENDER_SUCCESS on success, a RENDER_ERR_* code otherwise
+//
+static int run_once(RenderContext *context, char *scene_path, uint32_t width,
+					uint32_t height, FILE *file, double *times)
+{
+	int ret;
+
+	/* parse (including sorting by id) */
+	double start = now();
+	ret = render_load_file(context, scene_path);
+	if (ret != RENDER_SUCCESS)
+	{
+		return ret;
+	}
+	double parsed = now();
+
+	/* render */
+	PixelBuffer *pix_buffer = render_pixel_buffer_get(context, width, height);
+	if (pix_buffer == NULL)
+	{
+		return RENDER_ERR_OUT_OF_MEM;
+	}
+	ret = render_draw(context, pix_buffer);
+	if (ret != RENDER_SUCCESS)
+	{
+		goto run_once_cleanup;
+	}
+	double rendered = now();
+
+	/* write */
+	ret = RENDER_ERR_WRITE;
+	if (fseek(file, 0, SEEK_SET) != 0 || ftruncate(fileno(file), 0) != 0)
+	{
+		goto run_once_cleanup;
+	}
+	ret = render_write_file(context, pix_buffer, RENDER_FORMAT_BMP, 0, file);
+	if (ret != RENDER_SUCCESS)
+	{
+		goto run_once_cleanup;
+	}
+	double written = now();
+
+	times[0] = parsed - start;
+	times[1] = rendered - parsed;
+	times[2] = written - rendered;
+	times[3] = written - start;
+
+run_once_cleanup:
+	render_pixel_buffer_release(context, pix_buffer);
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Benchmark a scene and print the statistics of each stage
+///
+/// @param scene_path  path of the input file
+/// @param width       canvas width
+/// @param height      canvas height
+/// @param runs        number of runs
+/// @param lazy        1 to clear the background lazily per tile
+/// @param scanline    1 to use the scanline renderer
+/// @param file        file the bitmap is written to
+///
+/// @return RENDER_SUCCESS on success, a RENDER_ERR_* code otherwise
+//
+static int bench_scene(char *scene_path, uint32_t width, uint32_t height,
+					   int runs, int lazy, int scanline, FILE *file)
+{
+	double *samples = malloc(sizeof(double) * BENCH_STAGES * runs);
+	RenderContext *context = render_context_new();
+	if (samples == NULL || context == NULL)
+	{
+		free(samples);
+		render_context_delete(context);
+		return RENDER_ERR_OUT_OF_MEM;
+	}
+	context->lazy_clear = lazy;
+	context->scanline = scanline;
+
+	/* samples of a stage are stored next to each other */
+	double times[BENCH_STAGES];
+	for (int run = 0; run < runs; run++)
+	{
+		int ret = run_once(context, scene_path, width, height, file, times);
+		if (ret != RENDER_SUCCESS)
+		{
+			printf("Error: %s failed with error %d.\n", scene_path, ret);
+			free(samples);
+			render_context_delete(context);
+			return ret;
+		}
+		for (int stage = 0; stage < BENCH_STAGES; stage++)
+		{
+			samples[stage * runs + run] = times[stage];
+		}
+	}
+
+	const char *name = strrchr(scene_path, '/');
+	name = (name == NULL) ? scene_path : name + 1;
+	for (int stage = 0; stage < BENCH_STAGES; stage++)
+	{
+		double *s = samples + stage * runs;
+		qsort(s, runs, sizeof(double), compare_double);
+		printf("%-24s %-8s %5d %10.3f %10.3f %10.3f %10.3f %10.3f\n", name,
+			   stage_names[stage], runs, s[0] * 1e3,
+			   percentile(s, runs, 50) * 1e3, percentile(s, runs, 90) * 1e3,
+			   percentile(s, runs, 99) * 1e3, s[runs - 1] * 1e3);
+	}
+
+	free(samples);
+	render_context_delete(context);
+	return RENDER_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+	int runs = BENCH_DEFAULT_RUNS;
+	int lazy = 0;
+	int scanline = 0;
+	int arg_index = 1;
+	while (arg_index < argc && strncmp(argv[arg_index], "--", 2) == 0)
+	{
+		if (strncmp(argv[arg_index], "--runs=", 7) == 0)
+		{
+			runs = atoi(argv[arg_index] + 7);
+		}
+		else if (strcmp(argv[arg_index], "--lazy") == 0)
+		{
+			lazy = 1;
+		}
+		else if (strcmp(argv[arg_index], "--scanline") == 0)
+		{
+			scanline = 1;
+		}
+		else if (strncmp(argv[arg_index], "--kernel=", 9) == 0)
+		{
+			if (span_select(argv[arg_index] + 9) != SPAN_SUCCESS)
+			{
+				printf("Error: kernel \"%s\" is not supported.\n",
+					   argv[arg_index] + 9);
+				return 1;
+			}
+		}
+		else
+		{
+			printf("%s", usage);
+			return 1;
+		}
+		arg_index++;
+	}
+	if (runs < 1 || argc - arg_index < 3)
+	{
+		printf("%s", usage);
+		return 1;
+	}
+	long width = atol(argv[arg_index]);
+	long height = atol(argv[arg_index + 1]);
+	if (width < 1 || height < 1 || width > INT32_MAX || height > INT32_MAX)
+	{
+		printf("%s", usage);
+		return 1;
+	}
+
+	/* the bitmap goes to an anonymous temporary file */
+	FILE *tmp = tmpfile();
+	if (tmp == NULL)
+	{
+		printf("Error: could not create temporary file.\n");
+		return 1;
+	}
+
+	printf("%ldx%ld, %d runs%s%s, %s kernels, times in ms\n", width, height,
+		   runs, lazy ? ", lazy clear" : "", scanline ? ", scanline" : "",
+		   span_kernel_name(span_selected()));
+	printf("%-24s %-8s %5s %10s %10s %10s %10s %10s\n", "scene", "stage",
+		   "runs", "min", "p50", "p90", "p99", "max");
+	int ret = RENDER_SUCCESS;
+	for (int i = arg_index + 2; i < argc && ret == RENDER_SUCCESS; i++)
+	{
+		ret = bench_scene(argv[i], width, height, runs, lazy, scanline,
+						  tmp);
+	}
+
+	fclose(tmp);
+	return (ret == RENDER_SUCCESS) ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+/*
+ *  bench_span.c - Self-test and benchmark of the span kernels
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../span.h"
+
+#define BENCH_REPEAT 5
+#define BENCH_PASSES 64
+#define BENCH_PIXELS (1 << 16) /* 192 kB, the kernels and not the memory */
+
+static const char *usage =
+	"Usage: ./bench_span [--kernel=scalar|sse2|avx2|avx512]\n";
+
+/* span lengths in pixels: triangle tips, small shapes, 1920 wide rows */
+static const size_t lengths[] = {8, 64, 1920};
+
+//-----------------------------------------------------------------------------
+///
+/// Get monotonic time in seconds
+//
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Times fill, pack and gradient (lerp) of a kernel with spans of all lengths and prints the
+/// speed of the best run
+///
+/// @param kernel  kernel to time
+/// @param dst     BENCH_PIXELS pixels
+/// @param src     BENCH_PIXELS pixels
+//
+static void bench_kernel(SpanKernel kernel, uint8_t *dst, const uint8_t *src)
+{
+	span_use(kernel);
+	for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+	{
+		size_t length = lengths[l];
+		size_t spans = BENCH_PIXELS / length;
+		double best_fill = 1e30;
+		double best_pack = 1e30;
+		double best_lerp = 1e30;
+		for (int run = 0; run < BENCH_REPEAT; run++)
+		{
+			double start = now();
+			for (int pass = 0; pass < BENCH_PASSES; pass++)
+			{
+				for (size_t i = 0; i < spans; i++)
+				{
+					span_fill(dst + i * length * 3, (int)i + pass, length);
+				}
+			}
+			double filled = now();
+			for (int pass = 0; pass < BENCH_PASSES; pass++)
+			{
+				for (size_t i = 0; i < spans; i++)
+				{
+					span_pack_rgb(dst + i * length * 3, src + i * length * 3,
+								  length);
+				}
+			}
+			double packed = now();
+			for (int pass = 0; pass < BENCH_PASSES; pass++)
+			{
+				for (size_t i = 0; i < spans; i++)
+				{
+					int32_t start[3] = {(int)i << 16, pass << 16, 128 << 16};
+					int32_t step[3] = {1 << 12, -(1 << 10), 1 << 8};
+					span_lerp(dst + i * length * 3, start, step, length);
+				}
+			}
+			double lerped = now();
+			if (filled - start < best_fill)
+			{
+				best_fill = filled - start;
+			}
+			if (packed - filled < best_pack)
+			{
+				best_pack = packed - filled;
+			}
+			if (lerped - packed < best_lerp)
+			{
+				best_lerp = lerped - packed;
+			}
+		}
+		double pixels = (double)spans * length * BENCH_PASSES;
+		printf("%-8s %6zu %12.1f %12.1f %12.1f\n", span_kernel_name(kernel),
+			   length, pixels / best_fill / 1e6, pixels / best_pack / 1e6,
+			   pixels / best_lerp / 1e6);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int only = -1;
+	if (argc > 2 || (argc == 2 && strncmp(argv[1], "--kernel=", 9) != 0))
+	{
+		printf("%s", usage);
+		return 1;
+	}
+	if (argc == 2)
+	{
+		for (int kernel = 0; kernel < SPAN_KERNEL_COUNT; kernel++)
+		{
+			if (strcmp(argv[1] + 9, span_kernel_name(kernel)) == 0)
+			{
+				only = kernel;
+			}
+		}
+		if (only < 0)
+		{
+			printf("%s", usage);
+			return 1;
+		}
+		if (!span_kernel_supported(only))
+		{
+			printf("Error: kernel \"%s\" is not supported on this CPU.\n",
+				   argv[1] + 9);
+			return 1;
+		}
+	}
+
+	/* every kernel must give the output of the scalar kernel */
+	int failed = 0;
+	for (int kernel = 0; kernel < SPAN_KERNEL_COUNT; kernel++)
+	{
+		int ret = span_self_test(kernel);
+		printf("self-test %-8s %s\n", span_kernel_name(kernel),
+			   ret == SPAN_SUCCESS ? "ok" :
+			   ret == SPAN_ERR_UNSUPPORTED ? "not supported" : "FAILED");
+		failed |= ret != SPAN_SUCCESS && ret != SPAN_ERR_UNSUPPORTED;
+	}
+	if (failed)
+	{
+		return 1;
+	}
+
+	uint8_t *dst = malloc(BENCH_PIXELS * 3);
+	uint8_t *src = malloc(BENCH_PIXELS * 3);
+	if (dst == NULL || src == NULL)
+	{
+		printf("Error: out of memory.\n");
+		free(dst);
+		free(src);
+		return 1;
+	}
+	for (size_t i = 0; i < BENCH_PIXELS * 3; i++)
+	{
+		src[i] = (uint8_t)(i * 7);
+	}
+	memset(dst, 0, BENCH_PIXELS * 3);
+
+	printf("\n%d passes over %d pixels, best of %d runs, speed in Mpixel/s\n",
+		   BENCH_PASSES, BENCH_PIXELS, BENCH_REPEAT);
+	printf("%-8s %6s %12s %12s %12s\n", "kernel", "span", "fill", "pack rgb",
+		   "gradient");
+	for (int kernel = 0; kernel < SPAN_KERNEL_COUNT; kernel++)
+	{
+		if ((only < 0 || only == kernel) && span_kernel_supported(kernel))
+		{
+			bench_kernel(kernel, dst, src);
+		}
+	}
+
+	free(dst);
+	free(src);
+	return 0;
+}
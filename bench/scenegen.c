@@ -0,0 +1,1641 @@
+/*
+ *  scenegen.c - Generator for synthetic benchmark scenes
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Writes an input file for the bitmap program to stdout. All parameters
+ * have defaults, the same parameters and seed always give the same file.
+ *
+ *   --shapes=N        number of shapes
+ *   --size=MIN:MAX    shape size in pixels (rectangle side, circle diameter,
+ *                     triangle bounding box side)
+ *   --dist=uniform    sizes uniformly distributed between MIN and MAX
+ *   --dist=log        sizes log-uniformly distributed (many small shapes,
+ *                     few large ones)
+ *   --mix=R:C:T       relative weights of rectangles, circles and triangles
+ *   --overlap=D       place the shapes in a centered region so that on
+ *                     average D shapes cover each pixel of it, 0 spreads the
+ *                     shapes over the whole canvas
+ *   --canvas=WxH      canvas size the coordinates are generated for
+ *   --seed=S          seed of the random generator
+ *   --chart=S:P       instead of shapes write S chart series of P points
+ *                     each (random walks from the left to the right border)
+ *   --chart-as=polyline|line|triangle
+ *                     a series as one polyline, as a line per segment or as
+ *                     two triangles per segment (how lines had to be drawn
+ *                     before there were line commands)
+ *   --line-width=W    width of the chart lines
+ *   --regions=N:V     instead of shapes write N map regions of V points
+ *                     each, their size is taken from --size
+ *   --regions-as=polygon|triangle
+ *                     a region as one polygon or as a fan of triangles
+ *                     from its center (how regions had to be drawn before
+ *                     there were polygon commands)
+ *   --rounded=N       instead of shapes write N ellipses, rings and rounded
+ *                     rectangles, their size is taken from --size
+ *   --rounded-as=shapes|stacks
+ *                     each as its own command or as a stack of the older
+ *                     shapes: an ellipse as a rectangle per row, a ring as
+ *                     a circle with a white circle inside, a rounded
+ *                     rectangle as two rectangles and four circles
+ *   --symbols=S:U     instead of shapes write S icons of five shapes each,
+ *                     their size is taken from --size, and U copies of them
+ *   --symbols-as=use|shapes
+ *                     an icon as a symbol (define) drawn by use commands or
+ *                     each copy as its shapes (how icons had to be drawn
+ *                     before there were symbols)
+ *   --points=N        instead of shapes write N points of random colors,
+ *                     discs with the radius MIN / 2 of --size
+ *   --points-as=file|circles
+ *                     the points as a points command whose binary file
+ *                     (columns x, y and color) is written to --points-file
+ *                     or as a circle per point (how points had to be drawn
+ *                     before there were points commands)
+ *   --points-file=P   path of the binary file of the points
+ *   --grid=C:R        instead of shapes write a heatmap of C x R cells,
+ *                     squares with the side MIN of --size, colored by 16
+ *                     levels of a smooth random field
+ *   --grid-as=file|rectangles
+ *                     the heatmap as a grid command whose binary file is
+ *                     written to --grid-file or as a rectangle per cell (how
+ *                     heatmaps had to be drawn before there were grids)
+ *   --grid-file=P     path of the binary file of the cell colors
+ *   --image=W:H       instead of shapes write a picture of W x H pixels of
+ *                     smoothly changing colors, drawn scaled by MIN of
+ *                     --size
+ *   --image-as=bmp|grid
+ *                     the picture as an image command whose bitmap file is
+ *                     written to --image-file or as a grid of a cell per
+ *                     pixel with its binary file written there (how
+ *                     pictures had to be drawn before there were images)
+ *   --image-file=P    path of the bitmap or binary file of the picture
+ *   --image-bits=B    bits per pixel of the bitmap file, 24 or 32
+ *   --fill=solid|linear|radial
+ *                     the shapes (not the ones of the other scenes) in
+ *                     their color or filled with one of a few linear or
+ *                     radial gradients across the canvas, the shapes are
+ *                     the same for all three
+ *   --labels=N        instead of shapes write N labels of data points (a
+ *                     random value like "417.25" each) at random places,
+ *                     in the embedded font scaled by MIN of --size
+ *   --labels-as=text|rectangles
+ *                     a label as a text command or as a rectangle per run
+ *                     of pixels of its glyph rows (how labels had to be
+ *                     drawn before there were text commands)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "../font.h"
+
+#define SCENEGEN_SUCCESS 0
+#define SCENEGEN_ERR_USAGE 1
+#define SCENEGEN_ERR_OUT_OF_MEM 2
+#define SCENEGEN_ERR_WRITE 3
+
+#define DIST_UNIFORM 0
+#define DIST_LOG 1
+
+#define CHART_POLYLINE 0
+#define CHART_LINE 1
+#define CHART_TRIANGLE 2
+
+#define REGIONS_POLYGON 0
+#define REGIONS_TRIANGLE 1
+
+#define ROUNDED_SHAPES 0
+#define ROUNDED_STACKS 1
+
+#define SYMBOLS_USE 0
+#define SYMBOLS_SHAPES 1
+
+#define POINTS_FILE 0
+#define POINTS_CIRCLES 1
+
+#define GRID_FILE 0
+#define GRID_RECTANGLES 1
+
+#define IMAGE_BMP 0
+#define IMAGE_GRID 1
+
+#define LABELS_TEXT 0
+#define LABELS_RECTANGLES 1
+
+#define FILL_SOLID 0
+#define FILL_LINEAR 1
+#define FILL_RADIAL 2
+
+/* gradients of --fill and their stops */
+#define FILL_GRADIENTS 16
+#define FILL_STOPS 3
+
+/* levels of the heatmap of --grid and the waves its field is made of */
+#define GRID_LEVELS 16
+#define GRID_WAVES 4
+
+/* shapes of an icon and the numbers describing one (shape, color, values) */
+#define ICON_SHAPES 5
+#define ICON_VALUES 7
+
+#define SCENEGEN_PI 3.14159265358979323846
+
+typedef struct _SceneParams_ {
+	long shapes;
+	long size_min;
+	long size_max;
+	int dist;
+	long mix[3];
+	double overlap;
+	long width;
+	long height;
+	uint64_t seed;
+	long chart_series;
+	long chart_points;
+	int chart_as;
+	long line_width;
+	long regions;
+	long region_points;
+	int regions_as;
+	long rounded;
+	int rounded_as;
+	long symbols;
+	long uses;
+	int symbols_as;
+	long points;
+	int points_as;
+	const char *points_file;
+	long grid_columns;
+	long grid_rows;
+	int grid_as;
+	const char *grid_file;
+	long image_width;
+	long image_height;
+	int image_as;
+	const char *image_file;
+	long image_bits;
+	int fill;
+	long labels;
+	int labels_as;
+} SceneParams;
+
+static const char *usage =
+	"Usage: ./scenegen [--shapes=N] [--size=MIN:MAX] [--dist=uniform|log] "
+	"[--mix=R:C:T] [--overlap=D] [--canvas=WxH] [--seed=S] [--chart=S:P] "
+	"[--chart-as=polyline|line|triangle] [--line-width=W] [--regions=N:V] "
+	"[--regions-as=polygon|triangle] [--rounded=N] "
+	"[--rounded-as=shapes|stacks] [--symbols=S:U] "
+	"[--symbols-as=use|shapes] [--points=N] [--points-as=file|circles] "
+	"[--points-file=P] [--grid=C:R] [--grid-as=file|rectangles] "
+	"[--grid-file=P] [--image=W:H] [--image-as=bmp|grid] [--image-file=P] "
+	"[--image-bits=24|32] [--fill=solid|linear|radial] [--labels=N] "
+	"[--labels-as=text|rectangles]\n";
+
+//-----------------------------------------------------------------------------
+///
+/// Random generator (xorshift64*), used instead of rand() so the scenes are
+/// the same with every C library
+///
+/// @param state  state of the generator, must not be zero
+///
+/// @return next random number
+//
+static uint64_t next_random(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Random number in a range
+///
+/// @param state  state of the generator
+/// @param min    smallest possible number
+/// @param max    biggest possible number
+///
+/// @return random number between min and max (both inclusive)
+//
+static long random_range(uint64_t *state, long min, long max)
+{
+	return min + (long)(next_random(state) % (uint64_t)(max - min + 1));
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Random shape size following the requested distribution
+///
+/// @param state   state of the generator
+/// @param params  scene parameters
+///
+/// @return shape size in pixels
+//
+static long random_size(uint64_t *state, SceneParams *params)
+{
+	if (params->dist == DIST_LOG)
+	{
+		double u = (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+		double size = params->size_min *
+			pow((double)params->size_max / params->size_min, u);
+		return (long)(size + 0.5);
+	}
+	return random_range(state, params->size_min, params->size_max);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Parse the command line options
+///
+/// @param argc    number of arguments
+/// @param argv    arguments
+/// @param params  parameters, initialised with defaults before
+///
+/// @return SCENEGEN_SUCCESS on success, SCENEGEN_ERR_USAGE otherwise
+//
+static int parse_options(int argc, char *argv[], SceneParams *params)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		char *arg = argv[i];
+		char *value = strchr(arg, '=');
+		if (value == NULL)
+		{
+			return SCENEGEN_ERR_USAGE;
+		}
+		value++;
+
+		int n;
+		if (strncmp(arg, "--shapes=", 9) == 0)
+		{
+			n = sscanf(value, "%ld", &params->shapes) == 1;
+		}
+		else if (strncmp(arg, "--size=", 7) == 0)
+		{
+			n = sscanf(value, "%ld:%ld", &params->size_min,
+					   &params->size_max) == 2;
+		}
+		else if (strncmp(arg, "--dist=", 7) == 0)
+		{
+			n = 1;
+			if (strcmp(value, "uniform") == 0)
+			{
+				params->dist = DIST_UNIFORM;
+			}
+			else if (strcmp(value, "log") == 0)
+			{
+				params->dist = DIST_LOG;
+			}
+			else
+			{
+				n = 0;
+			}
+		}
+		else if (strncmp(arg, "--mix=", 6) == 0)
+		{
+			n = sscanf(value, "%ld:%ld:%ld", &params->mix[0], &params->mix[1],
+					   &params->mix[2]) == 3;
+		}
+		else if (strncmp(arg, "--overlap=", 10) == 0)
+		{
+			n = sscanf(value, "%lf", &params->overlap) == 1;
+		}
+		else if (strncmp(arg, "--canvas=", 9) == 0)
+		{
+			n = sscanf(value, "%ldx%ld", &params->width, &params->height) == 2;
+		}
+		else if (strncmp(arg, "--chart=", 8) == 0)
+		{
+			n = sscanf(value, "%ld:%ld", &params->chart_series,
+					   &params->chart_points) == 2;
+		}
+		else if (strncmp(arg, "--chart-as=", 11) == 0)
+		{
+			n = 1;
+			if (strcmp(value, "polyline") == 0)
+			{
+				params->chart_as = CHART_POLYLINE;
+			}
+			else if (strcmp(value, "line") == 0)
+			{
+				params->chart_as = CHART_LINE;
+			}
+			else if (strcmp(value, "triangle") == 0)
+			{
+				params->chart_as = CHART_TRIANGLE;
+			}
+			else
+			{
+				n = 0;
+			}
+		}
+		else if (strncmp(arg, "--regions=", 10) == 0)
+		{
+			n = sscanf(value, "%ld:%ld", &params->regions,
+					   &params->region_points) == 2;
+		}
+		else if (strncmp(arg, "--regions-as=", 13) == 0)
+		{
+			n = 1;
+			if (strcmp(value, "polygon") == 0)
+			{
+				params->regions_as = REGIONS_POLYGON;
+			}
+			else if (strcmp(value, "triangle") == 0)
+			{
+				params->regions_as = REGIONS_TRIANGLE;
+			}
+			else
+			{
+				n = 0;
+			}
+		}
+		else if (strncmp(arg, "--rounded=", 10) == 0)
+		{
+			n = sscanf(value, "%ld", &params->rounded) == 1;
+		}
+		else if (strncmp(arg, "--rounded-as=", 13) == 0)
+		{
+			n = 1;
+			if (strcmp(value, "shapes") == 0)
+			{
+				params->rounded_as = ROUNDED_SHAPES;
+			}
+			else if (strcmp(value, "stacks") == 0)
+			{
+				params->rounded_as = ROUNDED_STACKS;
+			}
+			else
+			{
+				n = 0;
+			}
+		}
+		else if (strncmp(arg, "--symbols=", 10) == 0)
+		{
+			n = sscanf(value, "%ld:%ld", &params->symbols,
+					   &params->uses) == 2;
+		}
+		else if (strncmp(arg, "--symbols-as=", 13) == 0)
+		{
+			n = 1;
+			if (strcmp(value, "use") == 0)
+			{
+				params->symbols_as = SYMBOLS_USE;
+			}
+			else if (strcmp(value, "shapes") == 0)
+			{
+				params->symbols_as = SYMBOLS_SHAPES;
+			}
+			else
+			{
+				n = 0;
+			}
+		}
+		else if (strncmp(arg, "--points=", 9) == 0)
+		{
+			n = sscanf(value, "%ld", &params->points) == 1;
+		}
+		else if (strncmp(arg, "--points-as=", 12) == 0)
+		{
+			n = 1;
+			if (strcmp(value, "file") == 0)
+			{
+				params->points_as = POINTS_FILE;
+			}
+			else if (strcmp(value, "circles") == 0)
+			{
+				params->points_as = POINTS_CIRCLES;
+			}
+			else
+			{
+				n = 0;
+			}
+		}
+		else if (strncmp(arg, "--points-file=", 14) == 0)
+		{
+			params->points_file = value;
+			n = *value != 0;
+		}
+		else if (strncmp(arg, "--grid=", 7) == 0)
+		{
+			n = sscanf(value, "%ld:%ld", &params->grid_columns,
+					   &params->grid_rows) == 2;
+		}
+		else if (strncmp(arg, "--grid-as=", 10) == 0)
+		{
+			n = 1;
+			if (strcmp(value, "file") == 0)
+			{
+				params->grid_as = GRID_FILE;
+			}
+			else if (strcmp(value, "rectangles") == 0)
+			{
+				params->grid_as = GRID_RECTANGLES;
+			}
+			else
+			{
+				n = 0;
+			}
+		}
+		else if (strncmp(arg, "--grid-file=", 12) == 0)
+		{
+			params->grid_file = value;
+			n = *value != 0;
+		}
+		else if (strncmp(arg, "--image=", 8) == 0)
+		{
+			n = sscanf(value, "%ld:%ld", &params->image_width,
+					   &params->image_height) == 2;
+		}
+		else if (strncmp(arg, "--image-as=", 11) == 0)
+		{
+			n = 1;
+			if (strcmp(value, "bmp") == 0)
+			{
+				params->image_as = IMAGE_BMP;
+			}
+			else if (strcmp(value, "grid") == 0)
+			{
+				params->image_as = IMAGE_GRID;
+			}
+			else
+			{
+				n = 0;
+			}
+		}
+		else if (strncmp(arg, "--image-file=", 13) == 0)
+		{
+			params->image_file = value;
+			n = *value != 0;
+		}
+		else if (strncmp(arg, "--image-bits=", 13) == 0)
+		{
+			n = sscanf(value, "%ld", &params->image_bits) == 1;
+		}
+		else if (strncmp(arg, "--labels=", 9) == 0)
+		{
+			n = sscanf(value, "%ld", &params->labels) == 1;
+		}
+		else if (strncmp(arg, "--labels-as=", 12) == 0)
+		{
+			n = 1;
+			if (strcmp(value, "text") == 0)
+			{
+				params->labels_as = LABELS_TEXT;
+			}
+			else if (strcmp(value, "rectangles") == 0)
+			{
+				params->labels_as = LABELS_RECTANGLES;
+			}
+			else
+			{
+				n = 0;
+			}
+		}
+		else if (strncmp(arg, "--fill=", 7) == 0)
+		{
+			if (strcmp(value, "solid") == 0)
+			{
+				params->fill = FILL_SOLID;
+			}
+			else if (strcmp(value, "linear") == 0)
+			{
+				params->fill = FILL_LINEAR;
+			}
+			else if (strcmp(value, "radial") == 0)
+			{
+				params->fill = FILL_RADIAL;
+			}
+			else
+			{
+				n = 0;
+			}
+		}
+		else if (strncmp(arg, "--line-width=", 13) == 0)
+		{
+			n = sscanf(value, "%ld", &params->line_width) == 1;
+		}
+		else if (strncmp(arg, "--seed=", 7) == 0)
+		{
+			unsigned long long seed;
+			n = sscanf(value, "%llu", &seed) == 1;
+			params->seed = seed;
+		}
+		else
+		{
+			n = 0;
+		}
+		if (!n)
+		{
+			return SCENEGEN_ERR_USAGE;
+		}
+	}
+
+	/* check ranges */
+	if (params->shapes < 0 || params->size_min < 1 ||
+		params->size_max < params->size_min || params->mix[0] < 0 ||
+		params->mix[1] < 0 || params->mix[2] < 0 ||
+		params->mix[0] + params->mix[1] + params->mix[2] <= 0 ||
+		params->overlap < 0 || params->width < 1 || params->height < 1 ||
+		params->chart_series < 0 || (params->chart_series > 0 &&
+									 params->chart_points < 2) ||
+		params->line_width < 1 || params->regions < 0 ||
+		(params->regions > 0 && params->region_points < 3) ||
+		params->rounded < 0 || params->symbols < 0 || params->uses < 0 ||
+		(params->uses > 0 && params->symbols < 1) || params->points < 0 ||
+		params->points > INT32_MAX || (params->points > 0 &&
+		params->points_as == POINTS_FILE && params->points_file == NULL) ||
+		params->grid_columns < 0 || params->grid_rows < 0 ||
+		params->grid_columns > INT32_MAX || params->grid_rows > INT32_MAX ||
+		(params->grid_columns * params->grid_rows > 0 &&
+		 params->grid_as == GRID_FILE && params->grid_file == NULL) ||
+		params->image_width < 0 || params->image_height < 0 ||
+		params->image_width > 0xffff || params->image_height > 0xffff ||
+		(params->image_width * params->image_height > 0 &&
+		 params->image_file == NULL) ||
+		(params->image_bits != 24 && params->image_bits != 32) ||
+		params->labels < 0)
+	{
+		return SCENEGEN_ERR_USAGE;
+	}
+	return SCENEGEN_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes a segment of a chart line as two triangles covering the quad of
+/// the segment moved by half the width to both sides
+///
+/// @param id      pointer to the next id, counted up for each triangle
+/// @param color   color of the line
+/// @param x1      column of the first point
+/// @param y1      row of the first point
+/// @param x2      column of the second point
+/// @param y2      row of the second point
+/// @param width   width of the line
+//
+static void write_segment_triangles(long *id, long color, long x1, long y1,
+									long x2, long y2, long width)
+{
+	double dx = x2 - x1;
+	double dy = y2 - y1;
+	double length = sqrt(dx * dx + dy * dy);
+	if (length == 0)
+	{
+		return;
+	}
+	long nx = lround(-dy / length * width / 2);
+	long ny = lround(dx / length * width / 2);
+	printf("triangle id=\"%ld\" color=\"%06lx\" ax=\"%ld\" ay=\"%ld\" "
+		   "bx=\"%ld\" by=\"%ld\" cx=\"%ld\" cy=\"%ld\"\n", (*id)++, color,
+		   x1 + nx, y1 + ny, x2 + nx, y2 + ny, x2 - nx, y2 - ny);
+	printf("triangle id=\"%ld\" color=\"%06lx\" ax=\"%ld\" ay=\"%ld\" "
+		   "bx=\"%ld\" by=\"%ld\" cx=\"%ld\" cy=\"%ld\"\n", (*id)++, color,
+		   x1 + nx, y1 + ny, x2 - nx, y2 - ny, x1 - nx, y1 - ny);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Generate a chart (random walks from the left to the right border) and
+/// write it to stdout
+///
+/// @param params  scene parameters
+//
+static void generate_chart(SceneParams *params)
+{
+	uint64_t state = params->seed * 0x9e3779b97f4a7c15ULL + 1;
+	if (state == 0)
+	{
+		state = 1;
+	}
+
+	long id = 1;
+	long points = params->chart_points;
+	long max_step = params->height / 20 + 1;
+	for (long s = 0; s < params->chart_series; s++)
+	{
+		long color = random_range(&state, 0, 0xffffff);
+		long y = random_range(&state, 0, params->height - 1);
+		long prev_x = 0;
+		long prev_y = y;
+		if (params->chart_as == CHART_POLYLINE)
+		{
+			printf("polyline id=\"%ld\" color=\"%06lx\" width=\"%ld\" "
+				   "points=\"", id++, color, params->line_width);
+		}
+		for (long i = 0; i < points; i++)
+		{
+			long x = i * (params->width - 1) / (points - 1);
+			if (i > 0)
+			{
+				y += random_range(&state, -max_step, max_step);
+				y = (y < 0) ? 0 : (y >= params->height) ? params->height - 1 : y;
+			}
+
+			if (params->chart_as == CHART_POLYLINE)
+			{
+				printf((i > 0) ? " %ld,%ld" : "%ld,%ld", x, y);
+			}
+			else if (i > 0 && params->chart_as == CHART_LINE)
+			{
+				printf("line id=\"%ld\" color=\"%06lx\" x1=\"%ld\" "
+					   "y1=\"%ld\" x2=\"%ld\" y2=\"%ld\" width=\"%ld\"\n",
+					   id++, color, prev_x, prev_y, x, y, params->line_width);
+			}
+			else if (i > 0)
+			{
+				write_segment_triangles(&id, color, prev_x, prev_y, x, y,
+										params->line_width);
+			}
+			prev_x = x;
+			prev_y = y;
+		}
+		if (params->chart_as == CHART_POLYLINE)
+		{
+			printf("\"\n");
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Generate map regions (shapes around a center with a wavy border) and
+/// write them to stdout. The border is star-shaped from the center, so a
+/// fan of triangles from the center covers the same area.
+///
+/// @param params  scene parameters
+///
+/// @return SCENEGEN_SUCCESS on success, SCENEGEN_ERR_OUT_OF_MEM otherwise
+//
+static int generate_regions(SceneParams *params)
+{
+	uint64_t state = params->seed * 0x9e3779b97f4a7c15ULL + 1;
+	if (state == 0)
+	{
+		state = 1;
+	}
+
+	long points = params->region_points;
+	long *xy = malloc(2 * points * sizeof(long));
+	if (xy == NULL)
+	{
+		return SCENEGEN_ERR_OUT_OF_MEM;
+	}
+
+	long id = 1;
+	for (long r = 0; r < params->regions; r++)
+	{
+		long color = random_range(&state, 0, 0xffffff);
+		long cx = random_range(&state, 0, params->width - 1);
+		long cy = random_range(&state, 0, params->height - 1);
+		double radius = random_size(&state, params) / 2.0;
+
+		/* three waves of random phase and a little noise on the radius */
+		double phase[3];
+		for (int k = 0; k < 3; k++)
+		{
+			phase[k] = random_range(&state, 0, 359) * SCENEGEN_PI / 180;
+		}
+		for (long i = 0; i < points; i++)
+		{
+			double angle = 2 * SCENEGEN_PI * i / points;
+			double noise = random_range(&state, -100, 100) / 100.0;
+			double scale = 1 + 0.2 * sin(3 * angle + phase[0]) +
+				0.1 * sin(7 * angle + phase[1]) +
+				0.05 * sin(17 * angle + phase[2]) + 0.02 * noise;
+			xy[2 * i] = cx + lround(radius * scale * cos(angle));
+			xy[2 * i + 1] = cy + lround(radius * scale * sin(angle));
+		}
+
+		if (params->regions_as == REGIONS_POLYGON)
+		{
+			printf("polygon id=\"%ld\" color=\"%06lx\" rule=\"nonzero\" "
+				   "points=\"", id++, color);
+			for (long i = 0; i < points; i++)
+			{
+				printf((i > 0) ? " %ld,%ld" : "%ld,%ld", xy[2 * i],
+					   xy[2 * i + 1]);
+			}
+			printf("\"\n");
+			continue;
+		}
+		for (long i = 0; i < points; i++)
+		{
+			long j = (i + 1 < points) ? i + 1 : 0;
+			printf("triangle id=\"%ld\" color=\"%06lx\" ax=\"%ld\" "
+				   "ay=\"%ld\" bx=\"%ld\" by=\"%ld\" cx=\"%ld\" "
+				   "cy=\"%ld\"\n", id++, color, cx, cy, xy[2 * i],
+				   xy[2 * i + 1], xy[2 * j], xy[2 * j + 1]);
+		}
+	}
+	free(xy);
+	return SCENEGEN_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Generate labels of data points and write them to stdout, as rectangles
+/// the runs of set bits of each glyph row of the font (see font.h), scaled
+/// like the text command draws them
+///
+/// @param params  scene parameters
+//
+static void generate_labels(SceneParams *params)
+{
+	uint64_t state = params->seed * 0x9e3779b97f4a7c15ULL + 1;
+	if (state == 0)
+	{
+		state = 1;
+	}
+	long scale = params->size_min;
+	long id = 1;
+	for (long i = 0; i < params->labels; i++)
+	{
+		char label[32];
+		snprintf(label, sizeof(label), "%ld.%02ld",
+				 random_range(&state, 0, 999), random_range(&state, 0, 99));
+		long x = random_range(&state, 0, params->width - 1);
+		long y = random_range(&state, 0, params->height - 1);
+		long color = random_range(&state, 0, 0xffffff);
+		if (params->labels_as == LABELS_TEXT)
+		{
+			printf("text id=\"%ld\" color=\"%06lx\" x=\"%ld\" y=\"%ld\" "
+				   "scale=\"%ld\" text=\"%s\"\n", id++, color, x, y, scale,
+				   label);
+			continue;
+		}
+		for (long c = 0; label[c] != 0; c++)
+		{
+			const uint8_t *rows = font_glyphs[font_glyph(label[c])];
+			long left = x + c * FONT_ADVANCE * scale;
+			for (long r = 0; r < FONT_HEIGHT; r++)
+			{
+				for (long b = 0; b < FONT_WIDTH;)
+				{
+					long start = b;
+					while (b < FONT_WIDTH &&
+						   ((rows[r] >> (FONT_WIDTH - 1 - b)) & 1))
+					{
+						b++;
+					}
+					if (b == start)
+					{
+						b++;
+						continue;
+					}
+					printf("rectangle id=\"%ld\" color=\"%06lx\" x=\"%ld\" "
+						   "y=\"%ld\" width=\"%ld\" height=\"%ld\"\n", id++,
+						   color, left + start * scale, y + r * scale,
+						   (b - start) * scale, scale);
+				}
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Generate ellipses, rings and rounded rectangles (in turn) and write them
+/// to stdout, as stacks the older shapes cover the same pixels (the ring
+/// with a white hole)
+///
+/// @param params  scene parameters
+//
+static void generate_rounded(SceneParams *params)
+{
+	uint64_t state = params->seed * 0x9e3779b97f4a7c15ULL + 1;
+	if (state == 0)
+	{
+		state = 1;
+	}
+
+	long id = 1;
+	for (long r = 0; r < params->rounded; r++)
+	{
+		long color = random_range(&state, 0, 0xffffff);
+		long x = random_range(&state, 0, params->width - 1);
+		long y = random_range(&state, 0, params->height - 1);
+		long half = random_size(&state, params) / 2;
+		half = (half > 0) ? half : 1;
+		long other = random_range(&state, 1, half);
+		int stacks = params->rounded_as == ROUNDED_STACKS;
+
+		if (r % 3 == 0 && !stacks)
+		{
+			printf("ellipse id=\"%ld\" color=\"%06lx\" x=\"%ld\" y=\"%ld\" "
+				   "rx=\"%ld\" ry=\"%ld\"\n", id++, color, x, y, half, other);
+		}
+		else if (r % 3 == 0)
+		{
+			/* the columns inside (k ry)^2 + (d rx)^2 < (rx ry)^2 */
+			long columns = 0;
+			for (long d = other - 1; d > -other; d--)
+			{
+				long limit = half * other * half * other -
+					d * half * d * half;
+				while (columns > 0 && (columns - 1) * other *
+					   (columns - 1) * other >= limit)
+				{
+					columns--;
+				}
+				while (columns < half && columns * other * columns * other <
+					   limit)
+				{
+					columns++;
+				}
+				printf("rectangle id=\"%ld\" color=\"%06lx\" x=\"%ld\" "
+					   "y=\"%ld\" width=\"%ld\" height=\"1\"\n", id++,
+					   color, x - columns + 1, y + d, 2 * columns - 1);
+			}
+		}
+		else if (r % 3 == 1 && !stacks)
+		{
+			printf("ring id=\"%ld\" color=\"%06lx\" x=\"%ld\" y=\"%ld\" "
+				   "inner=\"%ld\" outer=\"%ld\"\n", id++, color, x, y,
+				   other - 1, half);
+		}
+		else if (r % 3 == 1)
+		{
+			printf("circle id=\"%ld\" color=\"%06lx\" x=\"%ld\" y=\"%ld\" "
+				   "radius=\"%ld\"\n", id++, color, x, y, half);
+			printf("circle id=\"%ld\" color=\"ffffff\" x=\"%ld\" y=\"%ld\" "
+				   "radius=\"%ld\"\n", id++, x, y, other - 1);
+		}
+		else
+		{
+			/* width 2 half, height 2 other, corner radius up to other */
+			long width = 2 * half;
+			long height = 2 * other;
+			long radius = random_range(&state, 1, other);
+			long left = x - half;
+			long top = y - other;
+			if (!stacks)
+			{
+				printf("roundrect id=\"%ld\" color=\"%06lx\" x=\"%ld\" "
+					   "y=\"%ld\" width=\"%ld\" height=\"%ld\" "
+					   "radius=\"%ld\"\n", id++, color, left, top, width,
+					   height, radius);
+				continue;
+			}
+			printf("rectangle id=\"%ld\" color=\"%06lx\" x=\"%ld\" "
+				   "y=\"%ld\" width=\"%ld\" height=\"%ld\"\n", id++, color,
+				   left + radius - 1, top, width - 2 * radius + 2, height);
+			printf("rectangle id=\"%ld\" color=\"%06lx\" x=\"%ld\" "
+				   "y=\"%ld\" width=\"%ld\" height=\"%ld\"\n", id++, color,
+				   left, top + radius - 1, width, height - 2 * radius + 2);
+			for (int corner = 0; corner < 4; corner++)
+			{
+				long cx = (corner & 1) ? left + width - radius :
+					left + radius - 1;
+				long cy = (corner & 2) ? top + height - radius :
+					top + radius - 1;
+				printf("circle id=\"%ld\" color=\"%06lx\" x=\"%ld\" "
+					   "y=\"%ld\" radius=\"%ld\"\n", id++, color, cx, cy,
+					   radius);
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes a shape of an icon moved by x, y
+///
+/// @param id     id of the shape
+/// @param shape  shape, color and values of the shape (ICON_VALUES)
+/// @param x      column the icon starts in
+/// @param y      row the icon starts in
+//
+static void write_icon_shape(long id, const long *shape, long x, long y)
+{
+	if (shape[0] == 0)
+	{
+		printf("roundrect id=\"%ld\" color=\"%06lx\" x=\"%ld\" y=\"%ld\" "
+			   "width=\"%ld\" height=\"%ld\" radius=\"%ld\"\n", id, shape[1],
+			   shape[2] + x, shape[3] + y, shape[4], shape[5], shape[6]);
+	}
+	else if (shape[0] == 1)
+	{
+		printf("ring id=\"%ld\" color=\"%06lx\" x=\"%ld\" y=\"%ld\" "
+			   "inner=\"%ld\" outer=\"%ld\"\n", id, shape[1], shape[2] + x,
+			   shape[3] + y, shape[4], shape[5]);
+	}
+	else if (shape[0] == 2)
+	{
+		printf("circle id=\"%ld\" color=\"%06lx\" x=\"%ld\" y=\"%ld\" "
+			   "radius=\"%ld\"\n", id, shape[1], shape[2] + x, shape[3] + y,
+			   shape[4]);
+	}
+	else if (shape[0] == 3)
+	{
+		printf("ellipse id=\"%ld\" color=\"%06lx\" x=\"%ld\" y=\"%ld\" "
+			   "rx=\"%ld\" ry=\"%ld\"\n", id, shape[1], shape[2] + x,
+			   shape[3] + y, shape[4], shape[5]);
+	}
+	else
+	{
+		printf("rectangle id=\"%ld\" color=\"%06lx\" x=\"%ld\" y=\"%ld\" "
+			   "width=\"%ld\" height=\"%ld\"\n", id, shape[1], shape[2] + x,
+			   shape[3] + y, shape[4], shape[5]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Generate icons (a rounded rectangle with a ring, a circle, an ellipse and
+/// a bar on it, all inside a square of the icon size) and copies of them at
+/// random places, and write them to stdout as symbols and uses or as the
+/// shapes of each copy
+///
+/// @param params  scene parameters
+///
+/// @return SCENEGEN_SUCCESS on success, SCENEGEN_ERR_OUT_OF_MEM otherwise
+//
+static int generate_symbols(SceneParams *params)
+{
+	uint64_t state = params->seed * 0x9e3779b97f4a7c15ULL + 1;
+	if (state == 0)
+	{
+		state = 1;
+	}
+
+	long *icons = malloc(sizeof(long) * params->symbols * ICON_SHAPES *
+						 ICON_VALUES + 1);
+	long *sizes = malloc(sizeof(long) * params->symbols + 1);
+	if (icons == NULL || sizes == NULL)
+	{
+		free(icons);
+		free(sizes);
+		return SCENEGEN_ERR_OUT_OF_MEM;
+	}
+
+	long id = 1;
+	for (long i = 0; i < params->symbols; i++)
+	{
+		long s = random_size(&state, params);
+		s = (s < 12) ? 12 : s;
+		long c = s / 2;
+		long icon[ICON_SHAPES][ICON_VALUES] = {
+			{0, 0, 0, 0, s, s, s / 4},
+			{1, 0, c, c, s / 4, c - 1, 0},
+			{2, 0, c, c, s / 6, 0, 0},
+			{3, 0, c, s - s / 6, s / 3, s / 10 + 1, 0},
+			{4, 0, s / 4, c - 1, c, 2, 0}
+		};
+		for (int k = 0; k < ICON_SHAPES; k++)
+		{
+			icon[k][1] = random_range(&state, 0, 0xffffff);
+		}
+		memcpy(icons + i * ICON_SHAPES * ICON_VALUES, icon, sizeof(icon));
+		sizes[i] = s;
+
+		if (params->symbols_as == SYMBOLS_USE)
+		{
+			printf("define id=\"%ld\" width=\"%ld\" height=\"%ld\"\n",
+				   id++, s, s);
+			for (int k = 0; k < ICON_SHAPES; k++)
+			{
+				write_icon_shape(k + 1, icon[k], 0, 0);
+			}
+			printf("end\n");
+		}
+	}
+
+	for (long u = 0; u < params->uses; u++)
+	{
+		long i = random_range(&state, 0, params->symbols - 1);
+		long x = random_range(&state, -sizes[i] / 2, params->width - 1);
+		long y = random_range(&state, -sizes[i] / 2, params->height - 1);
+		if (params->symbols_as == SYMBOLS_USE)
+		{
+			printf("use id=\"%ld\" symbol=\"%ld\" x=\"%ld\" y=\"%ld\"\n",
+				   id++, i + 1, x, y);
+			continue;
+		}
+		for (int k = 0; k < ICON_SHAPES; k++)
+		{
+			write_icon_shape(id++, icons + (i * ICON_SHAPES + k) * ICON_VALUES,
+							 x, y);
+		}
+	}
+
+	free(icons);
+	free(sizes);
+	return SCENEGEN_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Generate points at random places with random colors and write them to
+/// stdout as one points command with its binary file or as a circle per
+/// point
+///
+/// @param params  scene parameters
+///
+/// @return SCENEGEN_SUCCESS on success, SCENEGEN_ERR_OUT_OF_MEM if out of
+///         memory, SCENEGEN_ERR_WRITE if the file can't be written
+//
+static int generate_points(SceneParams *params)
+{
+	uint64_t state = params->seed * 0x9e3779b97f4a7c15ULL + 1;
+	if (state == 0)
+	{
+		state = 1;
+	}
+	long n = params->points;
+	long radius = params->size_min / 2 > 0 ? params->size_min / 2 : 1;
+
+	/* columns x, y and color like the points command reads them */
+	int32_t *columns = malloc(sizeof(int32_t) * 3 * n + 1);
+	if (columns == NULL)
+	{
+		return SCENEGEN_ERR_OUT_OF_MEM;
+	}
+	for (long i = 0; i < n; i++)
+	{
+		columns[i] = random_range(&state, 0, params->width - 1);
+		columns[n + i] = random_range(&state, 0, params->height - 1);
+		columns[2 * n + i] = random_range(&state, 0, 0xffffff);
+	}
+
+	if (params->points_as == POINTS_CIRCLES)
+	{
+		for (long i = 0; i < n; i++)
+		{
+			printf("circle id=\"%ld\" color=\"%06lx\" x=\"%ld\" y=\"%ld\" "
+				   "radius=\"%ld\"\n", i + 1, (long)columns[2 * n + i],
+				   (long)columns[i], (long)columns[n + i], radius);
+		}
+		free(columns);
+		return SCENEGEN_SUCCESS;
+	}
+
+	FILE *file = fopen(params->points_file, "wb");
+	if (file == NULL)
+	{
+		free(columns);
+		return SCENEGEN_ERR_WRITE;
+	}
+	size_t written = fwrite(columns, sizeof(int32_t), 3 * n, file);
+	int closed = fclose(file);
+	free(columns);
+	if (written != (size_t)(3 * n) || closed != 0)
+	{
+		return SCENEGEN_ERR_WRITE;
+	}
+	printf("points id=\"1\" color=\"000000\" radius=\"%ld\" file=\"%s\" "
+		   "layout=\"xyc\"\n", radius, params->points_file);
+	return SCENEGEN_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Generate a heatmap: a field of random waves sampled at the cells and
+/// cut into GRID_LEVELS levels from blue to red, so neighbouring cells
+/// often have the same color. Write it to stdout as one grid command with
+/// its binary file or as a rectangle per cell.
+///
+/// @param params  scene parameters
+///
+/// @return SCENEGEN_SUCCESS on success, SCENEGEN_ERR_OUT_OF_MEM if out of
+///         memory, SCENEGEN_ERR_WRITE if the file can't be written
+//
+static int generate_grid(SceneParams *params)
+{
+	uint64_t state = params->seed * 0x9e3779b97f4a7c15ULL + 1;
+	if (state == 0)
+	{
+		state = 1;
+	}
+	long columns = params->grid_columns;
+	long rows = params->grid_rows;
+	long cell = params->size_min;
+
+	double waves[GRID_WAVES][3];
+	for (int k = 0; k < GRID_WAVES; k++)
+	{
+		waves[k][0] = random_range(&state, 1, 8) * 2 * SCENEGEN_PI / columns;
+		waves[k][1] = random_range(&state, 1, 8) * 2 * SCENEGEN_PI / rows;
+		waves[k][2] = random_range(&state, 0, 628) / 100.0;
+	}
+	uint32_t *cells = malloc(sizeof(uint32_t) * columns * rows + 1);
+	if (cells == NULL)
+	{
+		return SCENEGEN_ERR_OUT_OF_MEM;
+	}
+	for (long r = 0; r < rows; r++)
+	{
+		for (long c = 0; c < columns; c++)
+		{
+			double value = 0;
+			for (int k = 0; k < GRID_WAVES; k++)
+			{
+				value += sin(waves[k][0] * c + waves[k][1] * r + waves[k][2]);
+			}
+			long level = (long)((value / GRID_WAVES + 1) / 2 * GRID_LEVELS);
+			level = (level >= GRID_LEVELS) ? GRID_LEVELS - 1 : level;
+			level = (level < 0) ? 0 : level;
+			long red = level * 255 / (GRID_LEVELS - 1);
+			cells[r * columns + c] = red << 16 | 0x20 << 8 | (255 - red);
+		}
+	}
+
+	if (params->grid_as == GRID_RECTANGLES)
+	{
+		for (long i = 0; i < columns * rows; i++)
+		{
+			printf("rectangle id=\"%ld\" color=\"%06lx\" x=\"%ld\" "
+				   "y=\"%ld\" width=\"%ld\" height=\"%ld\"\n", i + 1,
+				   (long)cells[i], i % columns * cell, i / columns * cell, cell,
+				   cell);
+		}
+		free(cells);
+		return SCENEGEN_SUCCESS;
+	}
+
+	FILE *file = fopen(params->grid_file, "wb");
+	if (file == NULL)
+	{
+		free(cells);
+		return SCENEGEN_ERR_WRITE;
+	}
+	size_t written = fwrite(cells, sizeof(uint32_t), columns * rows, file);
+	int closed = fclose(file);
+	free(cells);
+	if (written != (size_t)(columns * rows) || closed != 0)
+	{
+		return SCENEGEN_ERR_WRITE;
+	}
+	printf("grid id=\"1\" x=\"0\" y=\"0\" cell_width=\"%ld\" "
+		   "cell_height=\"%ld\" columns=\"%ld\" rows=\"%ld\" file=\"%s\"\n",
+		   cell, cell, columns, rows, params->grid_file);
+	return SCENEGEN_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes a 32 bit value little endian, like in the headers of bitmap files
+///
+/// @param bytes  first byte to write
+/// @param value  value
+//
+static void put_u32(unsigned char *bytes, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		bytes[i] = (value >> (8 * i)) & 0xff;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Generate a picture: red, green and blue each a field of random waves, so
+/// the color changes from pixel to pixel like in a photo. Write it to stdout
+/// as an image command with its bitmap file or as a grid with a cell per
+/// pixel and its binary file.
+///
+/// @param params  scene parameters
+///
+/// @return SCENEGEN_SUCCESS on success, SCENEGEN_ERR_OUT_OF_MEM if out of
+///         memory, SCENEGEN_ERR_WRITE if the file can't be written
+//
+static int generate_image(SceneParams *params)
+{
+	uint64_t state = params->seed * 0x9e3779b97f4a7c15ULL + 1;
+	if (state == 0)
+	{
+		state = 1;
+	}
+	long width = params->image_width;
+	long height = params->image_height;
+	long scale = params->size_min;
+
+	double waves[3][GRID_WAVES][3];
+	for (int channel = 0; channel < 3; channel++)
+	{
+		for (int k = 0; k < GRID_WAVES; k++)
+		{
+			double *wave = waves[channel][k];
+			wave[0] = random_range(&state, 1, 8) * 2 * SCENEGEN_PI / width;
+			wave[1] = random_range(&state, 1, 8) * 2 * SCENEGEN_PI / height;
+			wave[2] = random_range(&state, 0, 628) / 100.0;
+		}
+	}
+	uint32_t *pixels = malloc(sizeof(uint32_t) * width * height + 1);
+	if (pixels == NULL)
+	{
+		return SCENEGEN_ERR_OUT_OF_MEM;
+	}
+	for (long r = 0; r < height; r++)
+	{
+		for (long c = 0; c < width; c++)
+		{
+			uint32_t color = 0;
+			for (int channel = 0; channel < 3; channel++)
+			{
+				double value = 0;
+				for (int k = 0; k < GRID_WAVES; k++)
+				{
+					double *wave = waves[channel][k];
+					value += sin(wave[0] * c + wave[1] * r + wave[2]);
+				}
+				long level = (long)((value / GRID_WAVES + 1) / 2 * 256);
+				level = (level > 255) ? 255 : (level < 0) ? 0 : level;
+				color |= (uint32_t)level << (8 * channel);
+			}
+			pixels[r * width + c] = color;
+		}
+	}
+
+	FILE *file = fopen(params->image_file, "wb");
+	if (file == NULL)
+	{
+		free(pixels);
+		return SCENEGEN_ERR_WRITE;
+	}
+	int failed = 0;
+	if (params->image_as == IMAGE_GRID)
+	{
+		failed = fwrite(pixels, sizeof(uint32_t), width * height, file) !=
+			(size_t)(width * height);
+		printf("grid id=\"1\" x=\"0\" y=\"0\" cell_width=\"%ld\" "
+			   "cell_height=\"%ld\" columns=\"%ld\" rows=\"%ld\" "
+			   "file=\"%s\"\n", scale, scale, width, height,
+			   params->image_file);
+	}
+	else
+	{
+		/* bottom up rows, aligned to four bytes, the fourth byte is 255 */
+		long bytes = params->image_bits / 8;
+		long row_size = (width * bytes + 3) & ~3L;
+		unsigned char header[54];
+		memset(header, 0, sizeof(header));
+		header[0] = 'B';
+		header[1] = 'M';
+		put_u32(header + 2, sizeof(header) + row_size * height);
+		put_u32(header + 10, sizeof(header));
+		put_u32(header + 14, 40);
+		put_u32(header + 18, width);
+		put_u32(header + 22, height);
+		header[26] = 1;
+		header[28] = bytes * 8;
+		failed = fwrite(header, sizeof(header), 1, file) != 1;
+		unsigned char *row = calloc(row_size + 1, 1);
+		failed |= row == NULL;
+		for (long r = height - 1; !failed && r >= 0; r--)
+		{
+			for (long c = 0; c < width; c++)
+			{
+				put_u32(row + c * bytes, pixels[r * width + c] | 0xff000000u);
+			}
+			failed = fwrite(row, row_size, 1, file) != 1;
+		}
+		free(row);
+		printf("image id=\"1\" x=\"0\" y=\"0\" width=\"%ld\" "
+			   "height=\"%ld\" file=\"%s\"\n", width * scale,
+			   height * scale, params->image_file);
+	}
+	failed |= fclose(file) != 0;
+	free(pixels);
+	return failed ? SCENEGEN_ERR_WRITE : SCENEGEN_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write the gradients of --fill, ids first_id to first_id + FILL_GRADIENTS
+/// - 1: linear ones across the canvas in random directions or radial ones
+/// around random centers, each with FILL_STOPS random colors
+///
+/// @param params    scene parameters
+/// @param state     random state, not the one of the shapes
+/// @param first_id  id of the first gradient
+//
+static void generate_fill_gradients(SceneParams *params, uint64_t *state,
+									long first_id)
+{
+	long w = params->width;
+	long h = params->height;
+	for (long g = 0; g < FILL_GRADIENTS; g++)
+	{
+		long x1 = random_range(state, 0, w - 1);
+		long y1 = random_range(state, 0, h - 1);
+		long x2 = w - 1 - x1;
+		long y2 = h - 1 - y1;
+		if (params->fill == FILL_RADIAL)
+		{
+			x2 = x1 + random_range(state, w / 8, w / 2);
+			y2 = y1;
+		}
+		printf("gradient id=\"%ld\" kind=\"%s\" x1=\"%ld\" y1=\"%ld\" "
+			   "x2=\"%ld\" y2=\"%ld\" stops=\"", first_id + g,
+			   params->fill == FILL_RADIAL ? "radial" : "linear", x1, y1, x2,
+			   y2);
+		for (long i = 0; i < FILL_STOPS; i++)
+		{
+			printf("%s%ld:%06lx", i > 0 ? " " : "",
+				   i * 100 / (FILL_STOPS - 1),
+				   random_range(state, 0, 0xffffff));
+		}
+		printf("\"\n");
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Generate the scene and write it to stdout
+///
+/// @param params  scene parameters
+///
+/// @return SCENEGEN_SUCCESS on success, SCENEGEN_ERR_OUT_OF_MEM otherwise
+//
+static int generate(SceneParams *params)
+{
+	long n = params->shapes;
+	uint64_t state = params->seed * 0x9e3779b97f4a7c15ULL + 1;
+	if (state == 0)
+	{
+		state = 1;
+	}
+
+	/* choose shape and size first, they determine the area for the overlap */
+	int *shapes = malloc(n * sizeof(int) + 1);
+	long *sizes = malloc(n * sizeof(long) + 1);
+	uint32_t *ids = malloc(n * sizeof(uint32_t) + 1);
+	if (shapes == NULL || sizes == NULL || ids == NULL)
+	{
+		free(shapes);
+		free(sizes);
+		free(ids);
+		return SCENEGEN_ERR_OUT_OF_MEM;
+	}
+
+	long mix_total = params->mix[0] + params->mix[1] + params->mix[2];
+	double area = 0;
+	for (long i = 0; i < n; i++)
+	{
+		long pick = random_range(&state, 0, mix_total - 1);
+		shapes[i] = pick < params->mix[0] ? 0 :
+			pick < params->mix[0] + params->mix[1] ? 1 : 2;
+		sizes[i] = random_size(&state, params);
+		double s = sizes[i];
+		area += shapes[i] == 0 ? s * s :
+			shapes[i] == 1 ? SCENEGEN_PI * s * s / 4 : s * s / 4;
+	}
+
+	/*
+	 * ids are a shuffled permutation, so the program has to sort the
+	 * commands before drawing
+	 */
+	for (long i = 0; i < n; i++)
+	{
+		ids[i] = i + 1;
+	}
+	for (long i = n - 1; i > 0; i--)
+	{
+		long j = random_range(&state, 0, i);
+		uint32_t tmp = ids[i];
+		ids[i] = ids[j];
+		ids[j] = tmp;
+	}
+
+	/* region for the shape centers, same aspect ratio as the canvas */
+	double region_w = params->width;
+	double region_h = params->height;
+	if (params->overlap > 0)
+	{
+		double scale = sqrt(area / params->overlap /
+							((double)params->width * params->height));
+		if (scale < 1)
+		{
+			region_w *= scale;
+			region_h *= scale;
+		}
+	}
+	long x0 = (params->width - (long)region_w) / 2;
+	long y0 = (params->height - (long)region_h) / 2;
+	long x1 = x0 + (long)region_w;
+	long y1 = y0 + (long)region_h;
+	if (x1 <= x0)
+	{
+		x1 = x0 + 1;
+	}
+	if (y1 <= y0)
+	{
+		y1 = y0 + 1;
+	}
+
+	/* fills come from their own random state, the shapes stay the same */
+	uint64_t fill_state = state ^ 0xd1b54a32d192ed03ULL;
+	if (fill_state == 0)
+	{
+		fill_state = 1;
+	}
+	if (params->fill != FILL_SOLID)
+	{
+		generate_fill_gradients(params, &fill_state, n + 1);
+	}
+
+	for (long i = 0; i < n; i++)
+	{
+		long x = random_range(&state, x0, x1 - 1);
+		long y = random_range(&state, y0, y1 - 1);
+		long s = sizes[i];
+		long color = random_range(&state, 0, 0xffffff);
+		char fill[32] = "";
+		if (params->fill != FILL_SOLID)
+		{
+			snprintf(fill, sizeof(fill), " fill=\"%ld\"", n + 1 +
+					 random_range(&fill_state, 0, FILL_GRADIENTS - 1));
+		}
+
+		if (shapes[i] == 0)
+		{
+			printf("rectangle id=\"%u\" color=\"%06lx\" x=\"%ld\" y=\"%ld\" "
+				   "width=\"%ld\" height=\"%ld\"%s\n", ids[i], color,
+				   x - s / 2, y - s / 2, s, s, fill);
+		}
+		else if (shapes[i] == 1)
+		{
+			long radius = s / 2 > 0 ? s / 2 : 1;
+			printf("circle id=\"%u\" color=\"%06lx\" x=\"%ld\" y=\"%ld\" "
+				   "radius=\"%ld\"%s\n", ids[i], color, x, y, radius, fill);
+		}
+		else
+		{
+			long h = s / 2;
+			printf("triangle id=\"%u\" color=\"%06lx\" ax=\"%ld\" ay=\"%ld\" "
+				   "bx=\"%ld\" by=\"%ld\" cx=\"%ld\" cy=\"%ld\"%s\n", ids[i],
+				   color,
+				   x + random_range(&state, -h, h), y - h,
+				   x - h, y + random_range(&state, -h, h),
+				   x + h, y + random_range(&state, 0, h), fill);
+		}
+	}
+
+	free(shapes);
+	free(sizes);
+	free(ids);
+	return SCENEGEN_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret;
+	SceneParams params;
+	params.shapes = 1000;
+	params.size_min = 4;
+	params.size_max = 64;
+	params.dist = DIST_UNIFORM;
+	params.mix[0] = 1;
+	params.mix[1] = 1;
+	params.mix[2] = 1;
+	params.overlap = 0;
+	params.width = 1920;
+	params.height = 1080;
+	params.seed = 1;
+	params.chart_series = 0;
+	params.chart_points = 0;
+	params.chart_as = CHART_POLYLINE;
+	params.line_width = 2;
+	params.regions = 0;
+	params.region_points = 0;
+	params.regions_as = REGIONS_POLYGON;
+	params.fill = FILL_SOLID;
+	params.labels = 0;
+	params.labels_as = LABELS_TEXT;
+	params.rounded = 0;
+	params.rounded_as = ROUNDED_SHAPES;
+	params.symbols = 0;
+	params.uses = 0;
+	params.symbols_as = SYMBOLS_USE;
+	params.points = 0;
+	params.points_as = POINTS_FILE;
+	params.points_file = NULL;
+	params.grid_columns = 0;
+	params.grid_rows = 0;
+	params.grid_as = GRID_FILE;
+	params.grid_file = NULL;
+	params.image_width = 0;
+	params.image_height = 0;
+	params.image_as = IMAGE_BMP;
+	params.image_file = NULL;
+	params.image_bits = 24;
+
+	if (parse_options(argc, argv, &params) != SCENEGEN_SUCCESS)
+	{
+		fprintf(stderr, "%s", usage);
+		return SCENEGEN_ERR_USAGE;
+	}
+
+	if (params.chart_series > 0)
+	{
+		generate_chart(&params);
+		return SCENEGEN_SUCCESS;
+	}
+
+	if (params.regions > 0)
+	{
+		if (generate_regions(&params) != SCENEGEN_SUCCESS)
+		{
+			fprintf(stderr, "Error: out of memory.\n");
+			return SCENEGEN_ERR_OUT_OF_MEM;
+		}
+		return SCENEGEN_SUCCESS;
+	}
+
+	if (params.symbols > 0)
+	{
+		if (generate_symbols(&params) != SCENEGEN_SUCCESS)
+		{
+			fprintf(stderr, "Error: out of memory.\n");
+			return SCENEGEN_ERR_OUT_OF_MEM;
+		}
+		return SCENEGEN_SUCCESS;
+	}
+
+	if (params.points > 0)
+	{
+		ret = generate_points(&params);
+		if (ret == SCENEGEN_ERR_WRITE)
+		{
+			fprintf(stderr, "Error: could not write \"%s\".\n",
+					params.points_file);
+		}
+		else if (ret != SCENEGEN_SUCCESS)
+		{
+			fprintf(stderr, "Error: out of memory.\n");
+		}
+		return ret;
+	}
+
+	if (params.grid_columns > 0 && params.grid_rows > 0)
+	{
+		ret = generate_grid(&params);
+		if (ret == SCENEGEN_ERR_WRITE)
+		{
+			fprintf(stderr, "Error: could not write \"%s\".\n",
+					params.grid_file);
+		}
+		else if (ret != SCENEGEN_SUCCESS)
+		{
+			fprintf(stderr, "Error: out of memory.\n");
+		}
+		return ret;
+	}
+
+	if (params.image_width > 0 && params.image_height > 0)
+	{
+		ret = generate_image(&params);
+		if (ret == SCENEGEN_ERR_WRITE)
+		{
+			fprintf(stderr, "Error: could not write \"%s\".\n",
+					params.image_file);
+		}
+		else if (ret != SCENEGEN_SUCCESS)
+		{
+			fprintf(stderr, "Error: out of memory.\n");
+		}
+		return ret;
+	}
+
+	if (params.rounded > 0)
+	{
+		generate_rounded(&params);
+		return SCENEGEN_SUCCESS;
+	}
+
+	if (params.labels > 0)
+	{
+		generate_labels(&params);
+		return SCENEGEN_SUCCESS;
+	}
+
+	if (generate(&params) != SCENEGEN_SUCCESS)
+	{
+		fprintf(stderr, "Error: out of memory.\n");
+		return SCENEGEN_ERR_OUT_OF_MEM;
+	}
+	return SCENEGEN_SUCCESS;
+}
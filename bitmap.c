@@ -18,10 +18,19 @@
  *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS, madvise */
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "bitmap.h"
 
@@ -36,10 +45,10 @@
 ///
 /// @return size of row (in pixel buffer) in bytes (aligned to four bytes)
 //
-static uint32_t bitmap_pixel_array_row_size(uint32_t width)
+size_t bitmap_pixel_array_row_size(uint32_t width)
 {
-	uint32_t line_width, line_width_align;
-	line_width = width * BITMAP_RGB_COLOR_SIZE;
+	size_t line_width, line_width_align;
+	line_width = (size_t)width * BITMAP_RGB_COLOR_SIZE;
 	line_width_align = line_width;
 	if (line_width % BITMAP_ALIGNMENT != 0)
 	{
@@ -60,10 +69,10 @@ static uint32_t bitmap_pixel_array_row_size(uint32_t width)
 ///
 /// @return size of pixel area in bitmap in bytes (aligned to four bytes)
 //
-static uint32_t bitmap_pixel_array_size(uint32_t width, uint32_t height)
+uint64_t bitmap_pixel_array_size(uint32_t width, uint32_t height)
 {
 	/* align to BITMAP_BYTES_ALIGNMENT */
-	uint32_t line_width_align;
+	uint64_t line_width_align;
 	line_width_align = bitmap_pixel_array_row_size(width);
 
 	return (line_width_align * height);
@@ -71,179 +80,80 @@ static uint32_t bitmap_pixel_array_size(uint32_t width, uint32_t height)
 
 //-----------------------------------------------------------------------------
 ///
-/// Write into pixel buffer
-///
-/// @param column     column of the pixel to write (between 0 which is leftmost
-///                   column and (width - 1) which is the rightmost column)
-/// @param row        row of the pixel to write (between 0 which is the top row
-///                   and (height - 1) which is the bottom column)
-/// @param color      24 bit color data (Byte 0: not used, Byte 1: red,
-///                   Byte 2: green, Byte 3: blue with Byte 0 being the most
-///                   significant byte)
-///
-/// @return BITMAP_SUCCESS on success or BITMAP_ERR_NULL_POINTER_PASSED or
-///         BITMAP_ERR_WIDTH_HEIGHT_OUT_OF_BOUND otherwise
-//
-int bitmap_write_pixel(PixelBuffer *pix_buffer,
-								uint32_t column, uint32_t row, uint32_t color)
-{
-	if (pix_buffer == NULL)
-	{
-		return BITMAP_ERR_NULL_POINTER_PASSED;
-	}
-
-	if (pix_buffer->data == NULL)
-	{
-		return BITMAP_ERR_NULL_POINTER_PASSED;
-	}
-
-	if (row >= pix_buffer->height || column >= pix_buffer->width)
-	{
-		return BITMAP_ERR_WIDTH_HEIGHT_OUT_OF_BOUND;
-	}
-
-	/* bitmap is upside down, therefore swap row */
-	row = pix_buffer->height - row;
-
-	uint32_t line_width = bitmap_pixel_array_row_size(pix_buffer->width);
-	char *data = pix_buffer->data;
-	char *pixel = data + row * line_width + column * BITMAP_RGB_COLOR_SIZE;
-
-	if ((pixel + 2) < (data + pix_buffer->data_size)) {
-		pixel[0] = color & 0xff; /* red */
-		pixel[1] = (color & 0xff00) >> 8; /* green */
-		pixel[2] = (color & 0xff0000) >> 16; /* blue */
-	}
-
-	return BITMAP_SUCCESS;
-}
-
-//-----------------------------------------------------------------------------
-///
-/// Create a pixel buffer to write the color data in
+/// Calculate size of a 24 bit bitmap file, the file format stores this size
+/// in 32 bits, so it must not exceed BITMAP_MAX_FILE_SIZE
 ///
 /// @param width     width of the picture in pixel
 /// @param height    height of the picture in pixel
 ///
-/// @return pointer to pixel buffer or NULL if memory allocation failed
-//
-PixelBuffer *bitmap_pixel_buffer_new(uint32_t width, uint32_t height)
-{
-	/* allocate memory for pixel buffer */
-	PixelBuffer *pix_buffer = malloc(sizeof(PixelBuffer));
-	if (pix_buffer == NULL)
-	{
-		return NULL;
-	}
-
-	/* set the pixel buffer fields */
-	pix_buffer->width = width;
-	pix_buffer->height = height;
-	pix_buffer->data_size = bitmap_pixel_array_size(width, height);
-	pix_buffer->data = malloc(pix_buffer->data_size);
-	if (pix_buffer->data == NULL)
-	{
-		free(pix_buffer);
-		return NULL;
-	}
-	memset(pix_buffer->data, 0, pix_buffer->data_size);
-
-	return pix_buffer;
-}
-
-//-----------------------------------------------------------------------------
-///
-/// Delete a pixel buffer element
-///
-/// @param pix_buffer  pixel buffer to delete
-///
-//
-void bitmap_pixel_buffer_delete(PixelBuffer *pix_buffer)
-{
-	/* check wether pix_buffer is NULL */
-	if (pix_buffer == NULL)
-	{
-		return;
-	}
-
-	/* free buffer */
-	if (pix_buffer->data != NULL)
-	{
-		free(pix_buffer->data);
-	}
-	free(pix_buffer);
-}
-
-//-----------------------------------------------------------------------------
-///
-/// Get data array of pixel buffer
-///
-/// @param pix_buffer    pointer to pixel buffer data structure
-/// @param data_size     pointer to integer in which size of the data array will
-///                      be stored
-///
-/// @return address of data array or NULL if pix_buffer does not contain any
-///         data
+/// @return size of the bitmap file in bytes
 //
-char *bitmap_get_pixel_array(PixelBuffer *pix_buffer, int *data_size)
+uint64_t bitmap_file_size(uint32_t width, uint32_t height)
 {
-	if (pix_buffer == NULL)
-	{
-		return NULL;
-	}
-
-	*data_size = pix_buffer->data_size;
-	return pix_buffer->data;
+	return BITMAP_HEADER_SIZE + bitmap_pixel_array_size(width, height);
 }
 
 //-----------------------------------------------------------------------------
 ///
-/// Create file header for bitmap with inital values
-///
-/// @param list      pointer to an integer where size of file header will be
-///                  stored
+/// Fill the bitmap header structure with the values shared by all bitmaps
+/// this program writes
 ///
-/// @return address of memory area containing file header or NULL if memory
-///         could not be allocated
+/// @param bh           header structure to fill
+/// @param width        width of the picture in pixel
+/// @param height       height of the picture in pixel
+/// @param bit_count    bits per pixel (24 for true color, 8 for palette)
+/// @param compression  BITMAP_BI_RGB or BITMAP_BI_RLE8
+/// @param clr_used     number of entries in the color table following the
+///                     header
+/// @param array_size   size of the pixel array following the color table in
+///                     bytes, the caller has to make sure the file size does
+///                     not exceed BITMAP_MAX_FILE_SIZE
 //
-char *bitmap_file_header_new(uint32_t width, uint32_t height, int *data_size)
+static void bitmap_header_init(BitmapHeader *bh, uint32_t width,
+							   uint32_t height, uint16_t bit_count,
+							   uint32_t compression, uint32_t clr_used,
+							   uint64_t array_size)
 {
-	/* allocate memory for file header */
-	BitmapHeader bh;
-	memset(&bh, 0, sizeof(BitmapHeader));
+	memset(bh, 0, sizeof(BitmapHeader));
+	uint32_t off_bits = BITMAP_HEADER_SIZE + clr_used * BITMAP_PALETTE_ENTRY_SIZE;
 
 	/* set default values for BitmapFileHeader */
-	BitmapFileHeader *bmfh = &(bh.bmfh);
+	BitmapFileHeader *bmfh = &(bh->bmfh);
 	bmfh->bf_type = 0x4d42; /* "BM" for bitmap */
-	bmfh->bf_size = BITMAP_HEADER_SIZE + bitmap_pixel_array_size(width, height);
+	bmfh->bf_size = off_bits + array_size;
 	bmfh->bf_reserved1 = 0;
 	bmfh->bf_reserved2 = 0;
-	bmfh->bf_off_bits = BITMAP_HEADER_SIZE;
+	bmfh->bf_off_bits = off_bits;
 
 	/* set default values for BitmapInfoHeader */
-	BitmapInfoHeader *bmih = &(bh.bmih);
+	BitmapInfoHeader *bmih = &(bh->bmih);
 	bmih->bi_size = BITMAP_INFO_HEADER_SIZE;
 	bmih->bi_width = width;
 	bmih->bi_height = height;
 	bmih->bi_planes = 1;
-	bmih->bi_bit_count = 24;
-	bmih->bi_compression = 0; /* BI_RGB -> not compressed */
-	bmih->bi_size_image = 0;
+	bmih->bi_bit_count = bit_count;
+	bmih->bi_compression = compression;
+	/* size of image may only be left out for uncompressed bitmaps */
+	bmih->bi_size_image = (compression == BITMAP_BI_RGB) ? 0 : array_size;
 	bmih->bi_x_pels_per_meter = 0;
 	bmih->bi_y_pels_per_meter = 0;
-	bmih->bi_clr_used = 0;
+	bmih->bi_clr_used = clr_used;
 	bmih->bi_clr_important = 0;
+}
 
-	/* allocate memory for data stream buffer */
-	*data_size = BITMAP_HEADER_SIZE;
-	char *header = malloc(*data_size);
-	if (header == NULL)
-	{
-		*data_size = 0;
-		return NULL;
-	}
+//-----------------------------------------------------------------------------
+///
+/// Write the bitmap header structure byte by byte (little endian) into a
+/// data stream buffer
+///
+/// @param bh      header structure to serialise
+/// @param header  buffer of at least BITMAP_HEADER_SIZE bytes
+//
+static void bitmap_header_serialise(BitmapHeader *bh, char *header)
+{
+	BitmapFileHeader *bmfh = &(bh->bmfh);
+	BitmapInfoHeader *bmih = &(bh->bmih);
 
-	/* copy data to data stream buffer */
 	/* file header */
 	header[0] = (bmfh->bf_type & 0x00ff) >> 0;
 	header[1] = (bmfh->bf_type & 0xff00) >> 8;
@@ -300,18 +210,1461 @@ char *bitmap_file_header_new(uint32_t width, uint32_t height, int *data_size)
 	header[51] = (bmih->bi_clr_important & 0x0000ff00) >> 8;
 	header[52] = (bmih->bi_clr_important & 0x00ff0000) >> 16;
 	header[53] = (bmih->bi_clr_important & 0xff000000) >> 24;
+}
 
-	return header;
+//-----------------------------------------------------------------------------
+///
+/// Fill a row of the pixel array with one color, the padding at the end of
+/// the row is set to zero. The filled part is doubled with memcpy, so the
+/// row is written with the fast block operations of the C library.
+///
+/// @param row         first byte of the row
+/// @param line_width  bytes of the pixels in the row
+/// @param row_size    bytes of the row including padding
+/// @param color       24 bit color data like for bitmap_write_pixel
+//
+static void bitmap_fill_row(char *row, size_t line_width, size_t row_size,
+							uint32_t color)
+{
+	char blue = color & 0xff;
+	char green = (color & 0xff00) >> 8;
+	char red = (color & 0xff0000) >> 16;
+
+	if (blue == green && green == red)
+	{
+		memset(row, blue, line_width);
+	}
+	else if (line_width > 0)
+	{
+		row[0] = blue;
+		row[1] = green;
+		row[2] = red;
+		size_t filled = BITMAP_RGB_COLOR_SIZE;
+		while (filled < line_width)
+		{
+			size_t n = (filled < line_width - filled) ? filled :
+				line_width - filled;
+			memcpy(row + filled, row, n);
+			filled += n;
+		}
+	}
+	memset(row + line_width, 0, row_size - line_width);
 }
 
 //-----------------------------------------------------------------------------
 ///
-/// Deletes a file header array created by bitmap_file_header_new
+/// Copy the background row of a lazily cleared pixel buffer into a part of
+/// a row, the last tile column includes the row padding
 ///
-/// @param file_header  pointer to file header array
+/// @param pix_buffer  pixel buffer with tiles
+/// @param row         row in memory (counted from bottom)
+/// @param column      first tile column
+/// @param end_column  tile column after the last one
+//
+static void bitmap_clear_tile_columns(PixelBuffer *pix_buffer, uint32_t row,
+									  uint32_t column, uint32_t end_column)
+{
+	size_t row_size = bitmap_pixel_array_row_size(pix_buffer->width);
+	size_t tile_count = (size_t)pix_buffer->tile_columns *
+		((pix_buffer->height + BITMAP_TILE_SIZE - 1) >> BITMAP_TILE_SHIFT);
+	const char *background = (const char *)pix_buffer->tiles + tile_count;
+
+	size_t start = ((size_t)column << BITMAP_TILE_SHIFT) *
+		BITMAP_RGB_COLOR_SIZE;
+	size_t end = row_size;
+	if (end_column < pix_buffer->tile_columns)
+	{
+		end = ((size_t)end_column << BITMAP_TILE_SHIFT) * BITMAP_RGB_COLOR_SIZE;
+	}
+	char *dest = pix_buffer->data + (size_t)row * row_size;
+
+	/* a gray (like the white background) is set without reading the row */
+	if (background[0] == background[1] && background[1] == background[2])
+	{
+		size_t line_width = (size_t)pix_buffer->width * BITMAP_RGB_COLOR_SIZE;
+		size_t end_pixels = (end < line_width) ? end : line_width;
+		memset(dest + start, background[0], end_pixels - start);
+		memset(dest + end_pixels, 0, end - end_pixels);
+		return;
+	}
+	memcpy(dest + start, background + start, end - start);
+}
+
+//-----------------------------------------------------------------------------
 ///
+/// Fill a tile of a lazily cleared pixel buffer with the background
+///
+/// @param pix_buffer  pixel buffer with tiles
+/// @param tile        index of the tile (row of tiles in memory times
+///                    tile_columns plus column of the tile)
 //
-void bitmap_file_header_delete(char *file_header)
+static void bitmap_clear_tile(PixelBuffer *pix_buffer, size_t tile)
 {
- free(file_header);
+	uint32_t column = tile % pix_buffer->tile_columns;
+	uint32_t row = (tile / pix_buffer->tile_columns) << BITMAP_TILE_SHIFT;
+	uint32_t end_row = row + BITMAP_TILE_SIZE;
+	if (end_row > pix_buffer->height)
+	{
+		end_row = pix_buffer->height;
+	}
+
+	for (; row < end_row; row++)
+	{
+		bitmap_clear_tile_columns(pix_buffer, row, column, column + 1);
+	}
+	pix_buffer->tiles[tile] = 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write into pixel buffer, in a lazily cleared pixel buffer the area has
+/// to be touched (bitmap_pixel_buffer_touch) first
+///
+/// @param column     column of the pixel to write (between 0 which is leftmost
+///                   column and (width - 1) which is the rightmost column)
+/// @param row        row of the pixel to write (between 0 which is the top row
+///                   and (height - 1) which is the bottom column)
+/// @param color      24 bit color data (Byte 0: not used, Byte 1: red,
+///                   Byte 2: green, Byte 3: blue with Byte 0 being the most
+///                   significant byte)
+///
+/// @return BITMAP_SUCCESS on success or BITMAP_ERR_NULL_POINTER_PASSED or
+///         BITMAP_ERR_WIDTH_HEIGHT_OUT_OF_BOUND otherwise
+//
+int bitmap_write_pixel(PixelBuffer *pix_buffer,
+								uint32_t column, uint32_t row, uint32_t color)
+{
+	if (pix_buffer == NULL)
+	{
+		return BITMAP_ERR_NULL_POINTER_PASSED;
+	}
+
+	if (pix_buffer->data == NULL)
+	{
+		return BITMAP_ERR_NULL_POINTER_PASSED;
+	}
+
+	if (row >= pix_buffer->height || column >= pix_buffer->width)
+	{
+		return BITMAP_ERR_WIDTH_HEIGHT_OUT_OF_BOUND;
+	}
+
+	/* bitmap is upside down, therefore swap row */
+	row = pix_buffer->height - 1 - row;
+
+	size_t line_width = bitmap_pixel_array_row_size(pix_buffer->width);
+	char *pixel = pix_buffer->data + (size_t)row * line_width +
+		(size_t)column * BITMAP_RGB_COLOR_SIZE;
+
+	pixel[0] = color & 0xff; /* blue */
+	pixel[1] = (color & 0xff00) >> 8; /* green */
+	pixel[2] = (color & 0xff0000) >> 16; /* red */
+
+	return BITMAP_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Fill the whole pixel buffer with one color, the padding at the end of the
+/// rows is set to zero. The first row is filled by bitmap_fill_row, all
+/// other rows are copies of it (or a single memset if the color is a gray
+/// and the rows have no padding), so every byte is written once.
+///
+/// @param pix_buffer  pixel buffer to fill
+/// @param color       24 bit color data like for bitmap_write_pixel
+///
+/// @return BITMAP_SUCCESS on success, BITMAP_ERR_NULL_POINTER_PASSED
+///         otherwise
+//
+int bitmap_pixel_buffer_fill(PixelBuffer *pix_buffer, uint32_t color)
+{
+	if (pix_buffer == NULL || (pix_buffer->data == NULL &&
+							   pix_buffer->data_size > 0))
+	{
+		return BITMAP_ERR_NULL_POINTER_PASSED;
+	}
+	pix_buffer->lazy = 0;
+	if (pix_buffer->width == 0 || pix_buffer->height == 0)
+	{
+		return BITMAP_SUCCESS;
+	}
+
+	size_t line_width = (size_t)pix_buffer->width * BITMAP_RGB_COLOR_SIZE;
+	size_t row_size = bitmap_pixel_array_row_size(pix_buffer->width);
+	char blue = color & 0xff;
+	if (line_width == row_size && blue == (char)((color & 0xff00) >> 8) &&
+		blue == (char)((color & 0xff0000) >> 16))
+	{
+		memset(pix_buffer->data, blue, pix_buffer->data_size);
+		return BITMAP_SUCCESS;
+	}
+
+	char *first = pix_buffer->data;
+	bitmap_fill_row(first, line_width, row_size, color);
+	for (uint32_t row = 1; row < pix_buffer->height; row++)
+	{
+		memcpy(first + (size_t)row * row_size, first, row_size);
+	}
+
+	return BITMAP_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Clear the pixel buffer to one color lazily: the buffer is split into tiles
+/// of BITMAP_TILE_SIZE x BITMAP_TILE_SIZE pixels, bitmap_pixel_buffer_touch
+/// fills the tiles of an area with the color before it is drawn and the tiles
+/// never drawn to are filled by bitmap_pixel_buffer_resolve, which every
+/// function reading the pixels calls. So a tile is filled while it is in the
+/// cache anyway and untouched areas cost one streaming write.
+/// Buffers on memory of the caller (bitmap_pixel_buffer_init) are never
+/// deleted, they are filled right away (like if the tile flags can't be
+/// allocated). The tile flags are kept for the next clear.
+///
+/// @param pix_buffer  pixel buffer to clear
+/// @param color       24 bit color data like for bitmap_write_pixel
+///
+/// @return BITMAP_SUCCESS on success, BITMAP_ERR_NULL_POINTER_PASSED
+///         otherwise
+//
+int bitmap_pixel_buffer_clear_lazy(PixelBuffer *pix_buffer, uint32_t color)
+{
+	if (pix_buffer == NULL)
+	{
+		return BITMAP_ERR_NULL_POINTER_PASSED;
+	}
+	if ((pix_buffer->map == NULL && pix_buffer->header == NULL) ||
+		pix_buffer->width == 0 || pix_buffer->height == 0)
+	{
+		return bitmap_pixel_buffer_fill(pix_buffer, color);
+	}
+
+	uint32_t tile_columns = (pix_buffer->width + BITMAP_TILE_SIZE - 1) >>
+		BITMAP_TILE_SHIFT;
+	uint32_t tile_rows = (pix_buffer->height + BITMAP_TILE_SIZE - 1) >>
+		BITMAP_TILE_SHIFT;
+	size_t tile_count = (size_t)tile_columns * tile_rows;
+	size_t line_width = (size_t)pix_buffer->width * BITMAP_RGB_COLOR_SIZE;
+	size_t row_size = bitmap_pixel_array_row_size(pix_buffer->width);
+
+	/* tile flags followed by one row of the background */
+	if (pix_buffer->tiles_size < tile_count + row_size)
+	{
+		uint8_t *tiles = realloc(pix_buffer->tiles, tile_count + row_size);
+		if (tiles == NULL)
+		{
+			return bitmap_pixel_buffer_fill(pix_buffer, color);
+		}
+		pix_buffer->tiles = tiles;
+		pix_buffer->tiles_size = tile_count + row_size;
+	}
+
+	memset(pix_buffer->tiles, 0, tile_count);
+	bitmap_fill_row((char *)pix_buffer->tiles + tile_count, line_width,
+					row_size, color);
+	pix_buffer->tile_columns = tile_columns;
+	pix_buffer->lazy = 1;
+	return BITMAP_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Announce drawing into an area of a lazily cleared pixel buffer, the tiles
+/// of the area that were not drawn to before are filled with the
+/// background. The area is clipped to the picture. Does nothing for buffers
+/// that are not lazily cleared.
+///
+/// @param pix_buffer  pixel buffer
+/// @param left        leftmost column of the area
+/// @param top         top row of the area (rows like for bitmap_write_pixel)
+/// @param right       rightmost column of the area
+/// @param bottom      bottom row of the area
+//
+void bitmap_pixel_buffer_touch(PixelBuffer *pix_buffer, int64_t left,
+							   int64_t top, int64_t right, int64_t bottom)
+{
+	if (pix_buffer == NULL || !pix_buffer->lazy)
+	{
+		return;
+	}
+
+	/* clip */
+	if (left < 0)
+	{
+		left = 0;
+	}
+	if (top < 0)
+	{
+		top = 0;
+	}
+	if (right >= pix_buffer->width)
+	{
+		right = (int64_t)pix_buffer->width - 1;
+	}
+	if (bottom >= pix_buffer->height)
+	{
+		bottom = (int64_t)pix_buffer->height - 1;
+	}
+	if (left > right || top > bottom)
+	{
+		return;
+	}
+
+	/* bitmap is upside down, the tiles are counted in memory order */
+	uint32_t first_row = (pix_buffer->height - 1 - bottom) >> BITMAP_TILE_SHIFT;
+	uint32_t last_row = (pix_buffer->height - 1 - top) >> BITMAP_TILE_SHIFT;
+	uint32_t first_column = left >> BITMAP_TILE_SHIFT;
+	uint32_t last_column = right >> BITMAP_TILE_SHIFT;
+	for (uint32_t row = first_row; row <= last_row; row++)
+	{
+		size_t tile = (size_t)row * pix_buffer->tile_columns + first_column;
+		for (uint32_t column = first_column; column <= last_column;
+			 column++, tile++)
+		{
+			if (!pix_buffer->tiles[tile])
+			{
+				bitmap_clear_tile(pix_buffer, tile);
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Fill the tiles of a lazily cleared pixel buffer that were not drawn to,
+/// afterwards the pixel array is complete. Neighbouring tiles are filled
+/// with one copy per row. Does nothing for buffers that are not lazily
+/// cleared.
+///
+/// @param pix_buffer  pixel buffer
+//
+void bitmap_pixel_buffer_resolve(PixelBuffer *pix_buffer)
+{
+	if (pix_buffer == NULL || !pix_buffer->lazy)
+	{
+		return;
+	}
+
+	uint32_t tile_columns = pix_buffer->tile_columns;
+	uint32_t tile_rows = (pix_buffer->height + BITMAP_TILE_SIZE - 1) >>
+		BITMAP_TILE_SHIFT;
+	size_t row_size = bitmap_pixel_array_row_size(pix_buffer->width);
+	const char *background = (const char *)pix_buffer->tiles +
+		(size_t)tile_columns * tile_rows;
+	int gray = background[0] == background[1] &&
+		background[1] == background[2];
+	int padding = row_size != (size_t)pix_buffer->width * BITMAP_RGB_COLOR_SIZE;
+
+	uint32_t tile_row = 0;
+	while (tile_row < tile_rows)
+	{
+		const uint8_t *cleared = pix_buffer->tiles +
+			(size_t)tile_row * tile_columns;
+
+		/*
+		 * Rows of tiles not drawn to at all are one contiguous block, a large
+		 * memset is done with streaming stores by the C library
+		 */
+		if (gray && !padding && memchr(cleared, 1, tile_columns) == NULL)
+		{
+			uint32_t end_row = tile_row + 1;
+			while (end_row < tile_rows &&
+				   memchr(pix_buffer->tiles + (size_t)end_row * tile_columns, 1,
+						  tile_columns) == NULL)
+			{
+				end_row++;
+			}
+			size_t first = ((size_t)tile_row << BITMAP_TILE_SHIFT) * row_size;
+			size_t last = ((size_t)end_row << BITMAP_TILE_SHIFT) * row_size;
+			if (last > pix_buffer->data_size)
+			{
+				last = pix_buffer->data_size;
+			}
+			memset(pix_buffer->data + first, background[0], last - first);
+			tile_row = end_row;
+			continue;
+		}
+
+		/* the other rows only where tiles were not drawn to */
+		uint32_t row = tile_row << BITMAP_TILE_SHIFT;
+		uint32_t end = row + BITMAP_TILE_SIZE;
+		if (end > pix_buffer->height)
+		{
+			end = pix_buffer->height;
+		}
+		for (; row < end; row++)
+		{
+			uint32_t column = 0;
+			while (column < tile_columns)
+			{
+				if (cleared[column])
+				{
+					column++;
+					continue;
+				}
+				uint32_t end_column = column + 1;
+				while (end_column < tile_columns && !cleared[end_column])
+				{
+					end_column++;
+				}
+				bitmap_clear_tile_columns(pix_buffer, row, column, end_column);
+				column = end_column;
+			}
+		}
+		tile_row++;
+	}
+	pix_buffer->lazy = 0;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Create a pixel buffer to write the color data in
+///
+/// @param width     width of the picture in pixel
+/// @param height    height of the picture in pixel
+///
+/// @return pointer to pixel buffer or NULL if memory allocation failed (or the
+///         size of the buffer does not fit into the address space)
+//
+PixelBuffer *bitmap_pixel_buffer_new(uint32_t width, uint32_t height)
+{
+	/* allocate memory for pixel buffer */
+	PixelBuffer *pix_buffer = malloc(sizeof(PixelBuffer));
+	if (pix_buffer == NULL)
+	{
+		return NULL;
+	}
+
+	/* set the pixel buffer fields */
+	uint64_t data_size = bitmap_pixel_array_size(width, height);
+	if (data_size > SIZE_MAX - BITMAP_MAP_HEADROOM)
+	{
+		free(pix_buffer);
+		return NULL;
+	}
+	pix_buffer->width = width;
+	pix_buffer->height = height;
+	pix_buffer->map = NULL;
+	pix_buffer->map_size = 0;
+	pix_buffer->map_is_file = 0;
+	pix_buffer->data_size = data_size;
+	pix_buffer->lazy = 0;
+	pix_buffer->tiles = NULL;
+	pix_buffer->tiles_size = 0;
+	pix_buffer->tile_columns = 0;
+
+	if (pix_buffer->data_size >= BITMAP_HUGE_PAGE_THRESHOLD)
+	{
+		/*
+		 * Large buffers are mapped directly (they are zeroed by the kernel)
+		 * and backed by huge pages if possible, which saves page faults and
+		 * TLB misses when drawing
+		 */
+		pix_buffer->map_size = BITMAP_MAP_HEADROOM + pix_buffer->data_size;
+		pix_buffer->map = mmap(NULL, pix_buffer->map_size,
+							   PROT_READ | PROT_WRITE,
+							   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (pix_buffer->map == MAP_FAILED)
+		{
+			free(pix_buffer);
+			return NULL;
+		}
+#ifdef MADV_HUGEPAGE
+		madvise(pix_buffer->map, pix_buffer->map_size, MADV_HUGEPAGE);
+#endif
+		pix_buffer->data = pix_buffer->map + BITMAP_MAP_HEADROOM;
+		pix_buffer->header = pix_buffer->data - BITMAP_HEADER_SIZE;
+		return pix_buffer;
+	}
+
+	/*
+	 * calloc gets large blocks zeroed from the kernel, without touching them,
+	 * so the pages are first written when the picture is filled
+	 */
+	char *block = calloc(1, BITMAP_HEADROOM + pix_buffer->data_size);
+	if (block == NULL)
+	{
+		free(pix_buffer);
+		return NULL;
+	}
+	pix_buffer->data = block + BITMAP_HEADROOM;
+	pix_buffer->header = pix_buffer->data - BITMAP_HEADER_SIZE;
+
+	return pix_buffer;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Create a pixel buffer which is the pixel array of a bitmap file. The file
+/// is created with its final size, the header is written and the pixel array
+/// is mapped into memory, so everything drawn goes directly into the file and
+/// nothing has to be written when drawing is done.
+///
+/// @param path      path of the bitmap file to create
+/// @param width     width of the picture in pixel
+/// @param height    height of the picture in pixel
+///
+/// @return pointer to pixel buffer or NULL if the file could not be created
+///         or mapped, is larger than BITMAP_MAX_FILE_SIZE or memory
+///         allocation failed
+//
+PixelBuffer *bitmap_pixel_buffer_map_file(const char *path, uint32_t width,
+										  uint32_t height)
+{
+	PixelBuffer *pix_buffer = malloc(sizeof(PixelBuffer));
+	if (pix_buffer == NULL)
+	{
+		return NULL;
+	}
+	if (bitmap_file_size(width, height) > BITMAP_MAX_FILE_SIZE ||
+		bitmap_file_size(width, height) > SIZE_MAX)
+	{
+		/* the bitmap format can not describe this file */
+		free(pix_buffer);
+		return NULL;
+	}
+	pix_buffer->width = width;
+	pix_buffer->height = height;
+	pix_buffer->data_size = bitmap_pixel_array_size(width, height);
+	pix_buffer->map_size = bitmap_file_size(width, height);
+	pix_buffer->map_is_file = 1;
+	pix_buffer->lazy = 0;
+	pix_buffer->tiles = NULL;
+	pix_buffer->tiles_size = 0;
+	pix_buffer->tile_columns = 0;
+
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0)
+	{
+		goto bitmap_pixel_buffer_map_file_cleanup1;
+	}
+
+	/*
+	 * Reserve the blocks now, writing to a mapping of a sparse file on a full
+	 * disk would end with SIGBUS instead of an error
+	 */
+	if (posix_fallocate(fd, 0, pix_buffer->map_size) != 0)
+	{
+		goto bitmap_pixel_buffer_map_file_cleanup2;
+	}
+
+	pix_buffer->map = mmap(NULL, pix_buffer->map_size, PROT_READ | PROT_WRITE,
+						   MAP_SHARED, fd, 0);
+	if (pix_buffer->map == MAP_FAILED)
+	{
+		goto bitmap_pixel_buffer_map_file_cleanup2;
+	}
+	close(fd); /* the mapping keeps the file open */
+
+	/* write header, pixel array follows directly (fallocate zeroed it) */
+	BitmapHeader bh;
+	bitmap_header_init(&bh, width, height, 24, BITMAP_BI_RGB, 0,
+					   pix_buffer->data_size);
+	bitmap_header_serialise(&bh, pix_buffer->map);
+	pix_buffer->data = pix_buffer->map + BITMAP_HEADER_SIZE;
+	pix_buffer->header = pix_buffer->map;
+
+	return pix_buffer;
+
+bitmap_pixel_buffer_map_file_cleanup2:
+	close(fd);
+	unlink(path);
+bitmap_pixel_buffer_map_file_cleanup1:
+	free(pix_buffer);
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Initialise a pixel buffer structure for memory provided by the caller, the
+/// memory is used as it is (rows bottom up, each row aligned to four bytes
+/// like the bitmap pixel array), it is not cleared
+/// A pixel buffer initialised this way must not be passed to
+/// bitmap_pixel_buffer_delete, the caller owns structure and memory
+///
+/// @param pix_buffer  pixel buffer structure to initialise
+/// @param data        memory for the pixels
+/// @param data_size   size of the memory in bytes, at least
+///                    bitmap_pixel_array_size(width, height)
+/// @param width       width of the picture in pixel
+/// @param height      height of the picture in pixel
+///
+/// @return BITMAP_SUCCESS on success, BITMAP_ERR_NULL_POINTER_PASSED or
+///         BITMAP_ERR_WIDTH_HEIGHT_OUT_OF_BOUND (memory too small) otherwise
+//
+int bitmap_pixel_buffer_init(PixelBuffer *pix_buffer, char *data,
+							 size_t data_size, uint32_t width, uint32_t height)
+{
+	if (pix_buffer == NULL || (data == NULL && data_size > 0))
+	{
+		return BITMAP_ERR_NULL_POINTER_PASSED;
+	}
+
+	uint64_t array_size = bitmap_pixel_array_size(width, height);
+	if (array_size > data_size)
+	{
+		return BITMAP_ERR_WIDTH_HEIGHT_OUT_OF_BOUND;
+	}
+
+	pix_buffer->data = data;
+	pix_buffer->data_size = array_size;
+	pix_buffer->width = width;
+	pix_buffer->height = height;
+	pix_buffer->map = NULL;
+	pix_buffer->map_size = 0;
+	pix_buffer->map_is_file = 0;
+	pix_buffer->header = NULL;
+	pix_buffer->lazy = 0;
+	pix_buffer->tiles = NULL;
+	pix_buffer->tiles_size = 0;
+	pix_buffer->tile_columns = 0;
+	return BITMAP_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Delete a pixel buffer element
+///
+/// @param pix_buffer  pixel buffer to delete
+///
+//
+void bitmap_pixel_buffer_delete(PixelBuffer *pix_buffer)
+{
+	/* check wether pix_buffer is NULL */
+	if (pix_buffer == NULL)
+	{
+		return;
+	}
+
+	/* a mapped file has to be complete */
+	if (pix_buffer->map_is_file)
+	{
+		bitmap_pixel_buffer_resolve(pix_buffer);
+	}
+	free(pix_buffer->tiles);
+
+	/* free buffer (it starts with the headroom) or unmap the mapping */
+	if (pix_buffer->map != NULL)
+	{
+		munmap(pix_buffer->map, pix_buffer->map_size);
+	}
+	else if (pix_buffer->data != NULL)
+	{
+		free(pix_buffer->data - BITMAP_HEADROOM);
+	}
+	free(pix_buffer);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Get data array of pixel buffer
+///
+/// @param pix_buffer    pointer to pixel buffer data structure
+/// @param data_size     pointer to integer in which size of the data array will
+///                      be stored
+///
+/// @return address of data array or NULL if pix_buffer does not contain any
+///         data
+//
+char *bitmap_get_pixel_array(PixelBuffer *pix_buffer, size_t *data_size)
+{
+	if (pix_buffer == NULL)
+	{
+		return NULL;
+	}
+
+	bitmap_pixel_buffer_resolve(pix_buffer);
+	*data_size = pix_buffer->data_size;
+	return pix_buffer->data;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Get a row of the pixel buffer, rows are counted from top to bottom like
+/// the rows passed to bitmap_write_pixel
+///
+/// @param pix_buffer  pointer to pixel buffer data structure
+/// @param row         row between 0 (top row) and (height - 1)
+///
+/// @return address of the first pixel of the row (pixels are stored as blue,
+///         green, red) or NULL if row is out of bound
+//
+char *bitmap_get_row(PixelBuffer *pix_buffer, uint32_t row)
+{
+	if (pix_buffer == NULL || pix_buffer->data == NULL ||
+		row >= pix_buffer->height)
+	{
+		return NULL;
+	}
+
+	bitmap_pixel_buffer_resolve(pix_buffer);
+
+	/* bitmap is upside down, therefore swap row */
+	row = pix_buffer->height - 1 - row;
+	return pix_buffer->data +
+		(size_t)row * bitmap_pixel_array_row_size(pix_buffer->width);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Get the complete 24 bit bitmap file of the pixel buffer, the file header
+/// is written into the headroom in front of the pixel array, so no memory is
+/// allocated or copied. The file stays valid until the pixel buffer is
+/// drawn to or deleted.
+///
+/// @param pix_buffer  pixel buffer
+/// @param file_size   pointer to a variable receiving the size of the file
+///
+/// @return pointer to the file, NULL if the pixel buffer has no headroom
+///         (bitmap_pixel_buffer_init) or the file would be larger than
+///         BITMAP_MAX_FILE_SIZE
+//
+char *bitmap_get_file(PixelBuffer *pix_buffer, size_t *file_size)
+{
+	if (pix_buffer == NULL || pix_buffer->header == NULL)
+	{
+		return NULL;
+	}
+	bitmap_pixel_buffer_resolve(pix_buffer);
+	if (bitmap_file_header_init(pix_buffer->header, pix_buffer->width,
+								pix_buffer->height) != BITMAP_SUCCESS)
+	{
+		return NULL;
+	}
+	*file_size = BITMAP_HEADER_SIZE + pix_buffer->data_size;
+	return pix_buffer->header;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write the file header of a 24 bit bitmap into memory of the caller
+///
+/// @param header    memory of at least BITMAP_HEADER_SIZE bytes
+/// @param width     width of the picture in pixel
+/// @param height    height of the picture in pixel
+///
+/// @return BITMAP_SUCCESS on success, BITMAP_ERR_NULL_POINTER_PASSED or
+///         BITMAP_ERR_TOO_LARGE (file larger than BITMAP_MAX_FILE_SIZE)
+///         otherwise
+//
+int bitmap_file_header_init(char *header, uint32_t width, uint32_t height)
+{
+	if (header == NULL)
+	{
+		return BITMAP_ERR_NULL_POINTER_PASSED;
+	}
+	if (bitmap_file_size(width, height) > BITMAP_MAX_FILE_SIZE)
+	{
+		return BITMAP_ERR_TOO_LARGE;
+	}
+
+	BitmapHeader bh;
+	bitmap_header_init(&bh, width, height, 24, BITMAP_BI_RGB, 0,
+					   bitmap_pixel_array_size(width, height));
+	bitmap_header_serialise(&bh, header);
+	return BITMAP_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Create file header for bitmap with inital values
+///
+/// @param list      pointer to an integer where size of file header will be
+///                  stored
+///
+/// @return address of memory area containing file header or NULL if memory
+///         could not be allocated or the file would be larger than
+///         BITMAP_MAX_FILE_SIZE
+//
+char *bitmap_file_header_new(uint32_t width, uint32_t height, int *data_size)
+{
+	*data_size = 0;
+	if (bitmap_file_size(width, height) > BITMAP_MAX_FILE_SIZE)
+	{
+		return NULL;
+	}
+
+	/* allocate memory for data stream buffer */
+	char *header = malloc(BITMAP_HEADER_SIZE);
+	if (header == NULL)
+	{
+		return NULL;
+	}
+
+	/* copy data to data stream buffer */
+	bitmap_file_header_init(header, width, height);
+	*data_size = BITMAP_HEADER_SIZE;
+
+	return header;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Deletes a file header array created by bitmap_file_header_new
+///
+/// @param file_header  pointer to file header array
+///
+//
+void bitmap_file_header_delete(char *file_header)
+{
+ free(file_header);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Read the 24 bit color of a pixel in the pixel buffer data
+///
+/// @param pixel  pointer to the first byte (blue) of the pixel
+///
+/// @return color in the same format as passed to bitmap_write_pixel
+//
+static inline uint32_t bitmap_read_color(const unsigned char *pixel)
+{
+	return pixel[0] | (pixel[1] << 8) | ((uint32_t)pixel[2] << 16);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Calculate the slot of a color in the palette hash table
+///
+/// @param color  24 bit color
+///
+/// @return index into palette->hash_keys
+//
+static inline uint32_t bitmap_palette_hash(uint32_t color)
+{
+	return ((color * 2654435761u) >> 16) & (BITMAP_PALETTE_HASH_SIZE - 1);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Find index of a color in the palette, adding it if it is not contained yet
+///
+/// @param palette  palette to search
+/// @param color    24 bit color
+///
+/// @return index of the color in the palette or -1 if palette is full
+//
+static int bitmap_palette_lookup(BitmapPalette *palette, uint32_t color)
+{
+	uint32_t key = color | BITMAP_PALETTE_HASH_USED;
+	uint32_t slot = bitmap_palette_hash(color);
+
+	while (palette->hash_keys[slot] != 0)
+	{
+		if (palette->hash_keys[slot] == key)
+		{
+			return palette->hash_index[slot];
+		}
+		slot = (slot + 1) & (BITMAP_PALETTE_HASH_SIZE - 1);
+	}
+
+	if (palette->size >= BITMAP_PALETTE_MAX_COLORS)
+	{
+		return -1;
+	}
+
+	palette->hash_keys[slot] = key;
+	palette->hash_index[slot] = palette->size;
+	palette->colors[palette->size] = color;
+	return palette->size++;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Collect the colors used in a pixel buffer into a palette
+///
+/// @param pix_buffer  pixel buffer to scan
+/// @param palette     palette which will be filled
+///
+/// @return BITMAP_SUCCESS if the picture uses BITMAP_PALETTE_MAX_COLORS colors
+///         or less, BITMAP_ERR_NULL_POINTER_PASSED or
+///         BITMAP_ERR_TOO_MANY_COLORS otherwise
+//
+int bitmap_palette_from_pixel_buffer(PixelBuffer *pix_buffer,
+									 BitmapPalette *palette)
+{
+	if (pix_buffer == NULL || pix_buffer->data == NULL || palette == NULL)
+	{
+		return BITMAP_ERR_NULL_POINTER_PASSED;
+	}
+	bitmap_pixel_buffer_resolve(pix_buffer);
+	memset(palette, 0, sizeof(BitmapPalette));
+
+	size_t row_size = bitmap_pixel_array_row_size(pix_buffer->width);
+	uint32_t row, column;
+	for (row = 0; row < pix_buffer->height; row++)
+	{
+		const unsigned char *pixel =
+			(unsigned char *)pix_buffer->data + (size_t)row * row_size;
+		uint32_t last = 0xffffffff; /* no valid 24 bit color */
+
+		for (column = 0; column < pix_buffer->width; column++)
+		{
+			/* flat scenes consist mostly of runs, skip the lookup for them */
+			uint32_t color = bitmap_read_color(pixel);
+			if (color != last)
+			{
+				if (bitmap_palette_lookup(palette, color) < 0)
+				{
+					return BITMAP_ERR_TOO_MANY_COLORS;
+				}
+				last = color;
+			}
+			pixel += BITMAP_RGB_COLOR_SIZE;
+		}
+	}
+
+	return BITMAP_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Translate a row of the pixel buffer to palette indices
+///
+/// @param pix_buffer  pixel buffer to read from
+/// @param palette     palette containing all colors of the pixel buffer
+/// @param row         row in the pixel buffer (bottom row is 0)
+/// @param indices     array of at least pix_buffer->width bytes
+//
+static void bitmap_row_to_indices(PixelBuffer *pix_buffer,
+								  BitmapPalette *palette, uint32_t row,
+								  unsigned char *indices)
+{
+	size_t row_size = bitmap_pixel_array_row_size(pix_buffer->width);
+	const unsigned char *pixel =
+		(unsigned char *)pix_buffer->data + (size_t)row * row_size;
+	uint32_t last = 0xffffffff; /* no valid 24 bit color */
+	int index = 0;
+	uint32_t column;
+
+	for (column = 0; column < pix_buffer->width; column++)
+	{
+		uint32_t color = bitmap_read_color(pixel);
+		if (color != last)
+		{
+			index = bitmap_palette_lookup(palette, color);
+			last = color;
+		}
+		indices[column] = index;
+		pixel += BITMAP_RGB_COLOR_SIZE;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Encode a row of palette indices with run length encoding (BI_RLE8)
+///
+/// @param indices   palette indices of the row
+/// @param width     number of pixels in the row
+/// @param out       output buffer
+/// @param capacity  bytes available in output buffer
+///
+/// @return number of bytes written or -1 if capacity was not sufficient
+//
+static int64_t bitmap_rle8_encode_row(const unsigned char *indices,
+									  uint32_t width, unsigned char *out,
+									  size_t capacity)
+{
+	size_t size = 0;
+	uint32_t pos = 0;
+
+	while (pos < width)
+	{
+		/* measure run of equal indices starting at pos */
+		uint32_t run = 1;
+		while (pos + run < width && run < 255 &&
+			   indices[pos + run] == indices[pos])
+		{
+			run++;
+		}
+
+		if (run >= 2)
+		{
+			/* encoded mode: count followed by index */
+			if (size + 2 > capacity)
+			{
+				return -1;
+			}
+			out[size++] = run;
+			out[size++] = indices[pos];
+			pos += run;
+			continue;
+		}
+
+		/* collect literals until the next run of at least two pixels */
+		uint32_t literal = 1;
+		while (pos + literal < width && literal < 255 &&
+			   !(pos + literal + 1 < width &&
+				 indices[pos + literal] == indices[pos + literal + 1]))
+		{
+			literal++;
+		}
+
+		if (literal < 3)
+		{
+			/* absolute mode needs at least three pixels, encode singles */
+			uint32_t i;
+			for (i = 0; i < literal; i++)
+			{
+				if (size + 2 > capacity)
+				{
+					return -1;
+				}
+				out[size++] = 1;
+				out[size++] = indices[pos + i];
+			}
+		}
+		else
+		{
+			/* absolute mode: escape, count, indices padded to 16 bit */
+			size_t padded = literal + (literal & 1);
+			if (size + 2 + padded > capacity)
+			{
+				return -1;
+			}
+			out[size++] = 0;
+			out[size++] = literal;
+			memcpy(out + size, indices + pos, literal);
+			size += literal;
+			if (literal & 1)
+			{
+				out[size++] = 0;
+			}
+		}
+		pos += literal;
+	}
+
+	/* end of line */
+	if (size + 2 > capacity)
+	{
+		return -1;
+	}
+	out[size++] = 0;
+	out[size++] = 0;
+
+	return size;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Create the pixel array of an 8 bit palette bitmap. The pixel array is run
+/// length encoded (BI_RLE8) unless the encoding would be larger than the plain
+/// 8 bit pixel array (BI_RGB), e.g. for noisy pictures.
+///
+/// @param pix_buffer   pixel buffer to convert
+/// @param palette      palette created by bitmap_palette_from_pixel_buffer
+/// @param compression  pointer to integer where BITMAP_BI_RLE8 or
+///                     BITMAP_BI_RGB will be stored
+/// @param data_size    pointer to integer where size of pixel array will be
+///                     stored
+///
+/// @return address of pixel array (has to be freed with
+///         bitmap_pixel_array_delete) or NULL if memory could not be allocated
+//
+char *bitmap_indexed_pixel_array_new(PixelBuffer *pix_buffer,
+									 BitmapPalette *palette,
+									 uint32_t *compression, size_t *data_size)
+{
+	if (pix_buffer == NULL || pix_buffer->data == NULL || palette == NULL)
+	{
+		return NULL;
+	}
+	bitmap_pixel_buffer_resolve(pix_buffer);
+
+	uint32_t width = pix_buffer->width;
+	uint32_t height = pix_buffer->height;
+	size_t index_row_size = width;
+	if (index_row_size % BITMAP_ALIGNMENT != 0)
+	{
+		index_row_size += BITMAP_ALIGNMENT - index_row_size % BITMAP_ALIGNMENT;
+	}
+
+	/*
+	 * The plain 8 bit array is the upper bound for the encoded data, if the
+	 * encoder exceeds it the plain array is written instead
+	 */
+	size_t capacity = index_row_size * height;
+	unsigned char *array = malloc(capacity > 2 ? capacity : 2);
+	unsigned char *indices = malloc(index_row_size);
+	if (array == NULL || indices == NULL)
+	{
+		free(array);
+		free(indices);
+		return NULL;
+	}
+
+	/* first try run length encoding */
+	size_t size = 0;
+	int rle = 1;
+	uint32_t row;
+	for (row = 0; row < height; row++)
+	{
+		bitmap_row_to_indices(pix_buffer, palette, row, indices);
+		int64_t ret = bitmap_rle8_encode_row(indices, width, array + size,
+											 capacity - size);
+		if (ret < 0)
+		{
+			rle = 0;
+			break;
+		}
+		size += ret;
+	}
+
+	if (!rle)
+	{
+		/* encoded data grew too large, write plain 8 bit array instead */
+		size = 0;
+		for (row = 0; row < height; row++)
+		{
+			bitmap_row_to_indices(pix_buffer, palette, row, indices);
+			memset(indices + width, 0, index_row_size - width);
+			memcpy(array + size, indices, index_row_size);
+			size += index_row_size;
+		}
+	}
+
+	if (rle)
+	{
+		/* end of bitmap, replaces the end of line of the last row */
+		if (size >= 2)
+		{
+			array[size - 1] = 1;
+		}
+		else
+		{
+			array[size++] = 0;
+			array[size++] = 1;
+		}
+	}
+
+	free(indices);
+	*compression = rle ? BITMAP_BI_RLE8 : BITMAP_BI_RGB;
+	*data_size = size;
+	return (char *)array;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Deletes a pixel array created by bitmap_indexed_pixel_array_new
+///
+/// @param pixel_array  pointer to pixel array
+///
+//
+void bitmap_pixel_array_delete(char *pixel_array)
+{
+	free(pixel_array);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Create file header including color table for an 8 bit palette bitmap
+///
+/// @param width            width of the picture in pixel
+/// @param height           height of the picture in pixel
+/// @param palette          palette created by bitmap_palette_from_pixel_buffer
+/// @param compression      compression as returned by
+///                         bitmap_indexed_pixel_array_new
+/// @param pixel_array_size size of the pixel array in bytes
+/// @param data_size        pointer to an integer where size of file header will
+///                         be stored
+///
+/// @return address of memory area containing file header (to be freed with
+///         bitmap_file_header_delete) or NULL if memory could not be allocated
+///         or the file would be larger than BITMAP_MAX_FILE_SIZE
+//
+char *bitmap_indexed_file_header_new(uint32_t width, uint32_t height,
+									 BitmapPalette *palette,
+									 uint32_t compression,
+									 size_t pixel_array_size, int *data_size)
+{
+	uint64_t file_size = BITMAP_HEADER_SIZE + (uint64_t)pixel_array_size +
+		palette->size * BITMAP_PALETTE_ENTRY_SIZE;
+	if (file_size > BITMAP_MAX_FILE_SIZE)
+	{
+		*data_size = 0;
+		return NULL;
+	}
+
+	BitmapHeader bh;
+	bitmap_header_init(&bh, width, height, 8, compression, palette->size,
+					   pixel_array_size);
+
+	/* allocate memory for header and color table */
+	*data_size = bh.bmfh.bf_off_bits;
+	char *header = malloc(*data_size);
+	if (header == NULL)
+	{
+		*data_size = 0;
+		return NULL;
+	}
+	bitmap_header_serialise(&bh, header);
+
+	/* color table entries are stored as blue, green, red, reserved */
+	char *table = header + BITMAP_HEADER_SIZE;
+	int i;
+	for (i = 0; i < palette->size; i++)
+	{
+		table[i * BITMAP_PALETTE_ENTRY_SIZE + 0] = palette->colors[i] & 0xff;
+		table[i * BITMAP_PALETTE_ENTRY_SIZE + 1] =
+			(palette->colors[i] & 0xff00) >> 8;
+		table[i * BITMAP_PALETTE_ENTRY_SIZE + 2] =
+			(palette->colors[i] & 0xff0000) >> 16;
+		table[i * BITMAP_PALETTE_ENTRY_SIZE + 3] = 0;
+	}
+
+	return header;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write the pixel buffer as 24 bit bitmap file. Header and pixel array are
+/// passed to the kernel with a single writev call, without copying them into
+/// a stdio buffer first.
+///
+/// @param fd          file descriptor opened for writing
+/// @param pix_buffer  pixel buffer to write
+///
+/// @return BITMAP_SUCCESS on success, BITMAP_ERR_NULL_POINTER_PASSED,
+///         BITMAP_ERR_TOO_LARGE or BITMAP_ERR_WRITE otherwise
+//
+int bitmap_write_file(int fd, PixelBuffer *pix_buffer)
+{
+	if (pix_buffer == NULL || pix_buffer->data == NULL)
+	{
+		return BITMAP_ERR_NULL_POINTER_PASSED;
+	}
+	bitmap_pixel_buffer_resolve(pix_buffer);
+	if (bitmap_file_size(pix_buffer->width, pix_buffer->height) >
+		BITMAP_MAX_FILE_SIZE)
+	{
+		return BITMAP_ERR_TOO_LARGE;
+	}
+
+	/*
+	 * With headroom header and pixel array are one piece of memory, otherwise
+	 * they are gathered by writev
+	 */
+	char header[BITMAP_HEADER_SIZE];
+	struct iovec iov[2];
+	int count;
+	size_t file_size;
+	char *file = bitmap_get_file(pix_buffer, &file_size);
+	if (file != NULL)
+	{
+		iov[0].iov_base = file;
+		iov[0].iov_len = file_size;
+		count = 1;
+	}
+	else
+	{
+		bitmap_file_header_init(header, pix_buffer->width, pix_buffer->height);
+		iov[0].iov_base = header;
+		iov[0].iov_len = BITMAP_HEADER_SIZE;
+		iov[1].iov_base = pix_buffer->data;
+		iov[1].iov_len = pix_buffer->data_size;
+		count = 2;
+	}
+
+	/* writev may write less than requested, continue with the rest */
+	int index = 0;
+	while (index < count)
+	{
+		ssize_t written = writev(fd, iov + index, count - index);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return BITMAP_ERR_WRITE;
+		}
+		while (index < count && (size_t)written >= iov[index].iov_len)
+		{
+			written -= iov[index].iov_len;
+			index++;
+		}
+		if (index < count)
+		{
+			iov[index].iov_base = (char *)iov[index].iov_base + written;
+			iov[index].iov_len -= written;
+		}
+	}
+
+	return BITMAP_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Read a 16 bit little endian value of a file header
+///
+/// @param bytes  first byte of the value
+///
+/// @return value
+//
+static inline uint16_t bitmap_read_u16(const unsigned char *bytes)
+{
+	return bytes[0] | (bytes[1] << 8);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Read a 32 bit little endian value of a file header
+///
+/// @param bytes  first byte of the value
+///
+/// @return value
+//
+static inline uint32_t bitmap_read_u32(const unsigned char *bytes)
+{
+	return bytes[0] | (bytes[1] << 8) | ((uint32_t)bytes[2] << 16) |
+		((uint32_t)bytes[3] << 24);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Check the headers of a bitmap file in memory and find its pixels. Only
+/// uncompressed files of 24 or 32 bits per pixel are read, 32 bit files
+/// also with bit fields if these are the ones of BI_RGB.
+///
+/// @param image  receives size and pixels, map is not changed
+/// @param data   first byte of the file
+/// @param size   size of the file in bytes
+///
+/// @return BITMAP_SUCCESS on success, BITMAP_ERR_FORMAT if the file is no
+///         bitmap of this kind or is too short for its pixels
+//
+static int bitmap_image_parse(BitmapImage *image, const unsigned char *data,
+							  size_t size)
+{
+	if (size < BITMAP_HEADER_SIZE || data[0] != 'B' || data[1] != 'M')
+	{
+		return BITMAP_ERR_FORMAT;
+	}
+	uint32_t off_bits = bitmap_read_u32(data + 10);
+	uint32_t info_size = bitmap_read_u32(data + 14);
+	int32_t width = (int32_t)bitmap_read_u32(data + 18);
+	int32_t height = (int32_t)bitmap_read_u32(data + 22);
+	uint16_t planes = bitmap_read_u16(data + 26);
+	uint16_t bit_count = bitmap_read_u16(data + 28);
+	uint32_t compression = bitmap_read_u32(data + 30);
+	if (info_size < BITMAP_INFO_HEADER_SIZE || planes != 1 || width <= 0 ||
+		height == 0 || height == INT32_MIN ||
+		(bit_count != 24 && bit_count != 32))
+	{
+		return BITMAP_ERR_FORMAT;
+	}
+	if (compression == BITMAP_BI_BITFIELDS && bit_count == 32)
+	{
+		/* the masks follow the info header (or are part of a larger one) */
+		if (size < BITMAP_HEADER_SIZE + 12 ||
+			bitmap_read_u32(data + BITMAP_HEADER_SIZE) != 0xff0000 ||
+			bitmap_read_u32(data + BITMAP_HEADER_SIZE + 4) != 0xff00 ||
+			bitmap_read_u32(data + BITMAP_HEADER_SIZE + 8) != 0xff)
+		{
+			return BITMAP_ERR_FORMAT;
+		}
+	}
+	else if (compression != BITMAP_BI_RGB)
+	{
+		return BITMAP_ERR_FORMAT;
+	}
+
+	/* rows are aligned to four bytes, positive heights are bottom up */
+	uint64_t rows = (height < 0) ? -(int64_t)height : height;
+	uint64_t row_size = ((uint64_t)width * (bit_count / 8) + 3) & ~(uint64_t)3;
+	if (off_bits > size || (size - off_bits) / row_size < rows)
+	{
+		return BITMAP_ERR_FORMAT;
+	}
+	image->width = width;
+	image->height = rows;
+	image->bytes_per_pixel = bit_count / 8;
+	if (height < 0)
+	{
+		image->top = data + off_bits;
+		image->stride = row_size;
+	}
+	else
+	{
+		image->top = data + off_bits + (rows - 1) * row_size;
+		image->stride = -(ptrdiff_t)row_size;
+	}
+	return BITMAP_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Map a bitmap file read only and find its pixels (see BitmapImage), they
+/// are not copied: the pages are shared with the page cache and only the
+/// rows that are drawn are read from disk
+///
+/// @param path   path of the bitmap file
+/// @param image  receives the mapped image, has to be unmapped with
+///               bitmap_image_unmap, on error its map is NULL
+///
+/// @return BITMAP_SUCCESS on success, BITMAP_ERR_NULL_POINTER_PASSED,
+///         BITMAP_ERR_READ if the file is no regular file or can't be mapped
+///         or BITMAP_ERR_FORMAT (see bitmap_image_parse) otherwise
+//
+int bitmap_image_map(const char *path, BitmapImage *image)
+{
+	if (path == NULL || image == NULL)
+	{
+		return BITMAP_ERR_NULL_POINTER_PASSED;
+	}
+	memset(image, 0, sizeof(BitmapImage));
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return BITMAP_ERR_READ;
+	}
+	int ret = BITMAP_ERR_READ;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		goto bitmap_image_map_cleanup1;
+	}
+	if ((uint64_t)st.st_size < BITMAP_HEADER_SIZE ||
+		(uint64_t)st.st_size > SIZE_MAX)
+	{
+		ret = BITMAP_ERR_FORMAT;
+		goto bitmap_image_map_cleanup1;
+	}
+	size_t size = st.st_size;
+	void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+	{
+		goto bitmap_image_map_cleanup1;
+	}
+	ret = bitmap_image_parse(image, map, size);
+	if (ret != BITMAP_SUCCESS)
+	{
+		munmap(map, size);
+		goto bitmap_image_map_cleanup1;
+	}
+	image->map = map;
+	image->map_size = size;
+
+bitmap_image_map_cleanup1:
+	close(fd);
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Unmap an image mapped by bitmap_image_map, an image that is not mapped
+/// (map is NULL) is left as it is
+///
+/// @param image  image
+//
+void bitmap_image_unmap(BitmapImage *image)
+{
+	if (image != NULL && image->map != NULL)
+	{
+		munmap(image->map, image->map_size);
+		image->map = NULL;
+		image->top = NULL;
+	}
 }
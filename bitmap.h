@@ -22,25 +22,87 @@
 #define BITMAP_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define BITMAP_SUCCESS 0
 #define BITMAP_ERR_NULL_POINTER_PASSED 1
 #define BITMAP_ERR_WIDTH_HEIGHT_OUT_OF_BOUND 2
+#define BITMAP_ERR_TOO_MANY_COLORS 3
+#define BITMAP_ERR_WRITE 4
+#define BITMAP_ERR_TOO_LARGE 5
+#define BITMAP_ERR_READ 6
+#define BITMAP_ERR_FORMAT 7
 
 #define BITMAP_HEADER_SIZE (BITMAP_FILE_HEADER_SIZE + BITMAP_INFO_HEADER_SIZE)
 #define BITMAP_FILE_HEADER_SIZE 14
 #define BITMAP_INFO_HEADER_SIZE 40
+#define BITMAP_MAX_FILE_SIZE 0xffffffffULL /* bf_size is 32 bit */
+
+/* pixel buffers of this size and larger are allocated with huge pages */
+#define BITMAP_HUGE_PAGE_THRESHOLD (32 * 1024 * 1024)
+
+/*
+ * Room in front of the pixel array of allocated pixel buffers, the file
+ * header is written there so header and pixels are one contiguous file.
+ * It is larger than the header to keep the pixel array aligned (16 bytes
+ * for malloc'd, a page for mapped buffers).
+ */
+#define BITMAP_HEADROOM 64
+#define BITMAP_MAP_HEADROOM 4096
+
+/*
+ * Pixel buffers cleared lazily are split into tiles of 64 x 64 pixels, a
+ * tile is filled with the background when it is first drawn to (touched)
+ */
+#define BITMAP_TILE_SHIFT 6
+#define BITMAP_TILE_SIZE (1 << BITMAP_TILE_SHIFT)
 
 #define BITMAP_RGB_COLOR_SIZE 3
 #define BITMAP_ALIGNMENT 4
 
+#define BITMAP_BI_RGB 0
+#define BITMAP_BI_RLE8 1
+#define BITMAP_BI_BITFIELDS 3
+
+#define BITMAP_PALETTE_MAX_COLORS 256
+#define BITMAP_PALETTE_ENTRY_SIZE 4
+#define BITMAP_PALETTE_HASH_SIZE 1024 /* power of two, > 2 * max colors */
+#define BITMAP_PALETTE_HASH_USED 0x1000000 /* marks used hash table slots */
+
 typedef struct _PixelBuffer_ {
 	char *data;
-	int data_size;
+	size_t data_size;
 	uint32_t width;
 	uint32_t height;
+	char *map;       /* mapping containing data (bitmap file or huge pages),
+	                  * NULL if malloc'd */
+	size_t map_size;
+	int map_is_file; /* 1 if map is a bitmap file, no need to write it */
+	char *header;    /* BITMAP_HEADER_SIZE bytes directly in front of data
+	                  * for the file header, NULL if there is no room */
+	int lazy;        /* 1 while tiles not drawn to are not cleared yet */
+	uint8_t *tiles;  /* per tile 1 if cleared, followed by a row of the
+	                  * background, kept for the next lazy clear */
+	size_t tiles_size;
+	uint32_t tile_columns;
 } PixelBuffer;
 
+/*
+ * a 24 or 32 bit bitmap file mapped by bitmap_image_map, the pixels (blue,
+ * green, red, with 32 bits followed by a byte that is ignored) are read
+ * from the mapping, a row is found from the top row on with stride, which
+ * is negative for files stored bottom up
+ */
+typedef struct _BitmapImage_ {
+	uint32_t width;
+	uint32_t height;
+	int bytes_per_pixel;    /* 3 or 4 */
+	const uint8_t *top;     /* first pixel of the top row */
+	ptrdiff_t stride;       /* bytes from a row to the row below it */
+	void *map;              /* mapping of the file, NULL if not mapped */
+	size_t map_size;
+} BitmapImage;
+
 typedef struct _BitmapFileHeader_ {
 	uint16_t bf_type;
 	uint32_t bf_size;
@@ -68,14 +130,52 @@ typedef struct _BitmapHeader_ {
 	BitmapInfoHeader bmih;
 } BitmapHeader;
 
+typedef struct _BitmapPalette_ {
+	uint32_t colors[BITMAP_PALETTE_MAX_COLORS];
+	int size;
+	/* open addressing hash table mapping colors to palette indices */
+	uint32_t hash_keys[BITMAP_PALETTE_HASH_SIZE];
+	uint8_t hash_index[BITMAP_PALETTE_HASH_SIZE];
+} BitmapPalette;
+
+size_t bitmap_pixel_array_row_size(uint32_t width);
+uint64_t bitmap_pixel_array_size(uint32_t width, uint32_t height);
+uint64_t bitmap_file_size(uint32_t width, uint32_t height);
+int bitmap_file_header_init(char *header, uint32_t width, uint32_t height);
 char *bitmap_file_header_new(uint32_t width, uint32_t height, int *data_size);
 void bitmap_file_header_delete(char *file_header);
 
 PixelBuffer *bitmap_pixel_buffer_new(uint32_t width, uint32_t height);
+PixelBuffer *bitmap_pixel_buffer_map_file(const char *path, uint32_t width,
+										  uint32_t height);
+int bitmap_pixel_buffer_init(PixelBuffer *pix_buffer, char *data,
+							 size_t data_size, uint32_t width, uint32_t height);
 void bitmap_pixel_buffer_delete(PixelBuffer *pix_buffer);
+int bitmap_pixel_buffer_fill(PixelBuffer *pix_buffer, uint32_t color);
+int bitmap_pixel_buffer_clear_lazy(PixelBuffer *pix_buffer, uint32_t color);
+void bitmap_pixel_buffer_touch(PixelBuffer *pix_buffer, int64_t left,
+							   int64_t top, int64_t right, int64_t bottom);
+void bitmap_pixel_buffer_resolve(PixelBuffer *pix_buffer);
 int bitmap_write_pixel(PixelBuffer *pix_buffer,
 							  uint32_t column, uint32_t row, uint32_t color);
 
-char *bitmap_get_pixel_array(PixelBuffer *pix_buffer, int *data_size);
+char *bitmap_get_pixel_array(PixelBuffer *pix_buffer, size_t *data_size);
+char *bitmap_get_row(PixelBuffer *pix_buffer, uint32_t row);
+char *bitmap_get_file(PixelBuffer *pix_buffer, size_t *file_size);
+int bitmap_write_file(int fd, PixelBuffer *pix_buffer);
+
+int bitmap_palette_from_pixel_buffer(PixelBuffer *pix_buffer,
+									 BitmapPalette *palette);
+char *bitmap_indexed_pixel_array_new(PixelBuffer *pix_buffer,
+									 BitmapPalette *palette,
+									 uint32_t *compression, size_t *data_size);
+void bitmap_pixel_array_delete(char *pixel_array);
+char *bitmap_indexed_file_header_new(uint32_t width, uint32_t height,
+									 BitmapPalette *palette,
+									 uint32_t compression,
+									 size_t pixel_array_size, int *data_size);
+
+int bitmap_image_map(const char *path, BitmapImage *image);
+void bitmap_image_unmap(BitmapImage *image);
 
 #endif
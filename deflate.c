@@ -0,0 +1,584 @@
+/*
+ *  deflate.c - Code for the deflate (zlib) compressor
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "deflate.h"
+
+#define ADLER_MOD 65521
+#define ADLER_NMAX 5552 /* bytes which can be summed before b overflows */
+
+static const uint16_t length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+	16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* lookup tables, filled by deflate_init_tables */
+static int tables_initialised = 0;
+static uint16_t literal_code[288];   /* fixed huffman codes, bit reversed */
+static uint8_t literal_bits[288];
+static uint8_t dist_code_reversed[30];
+static uint8_t length_to_code[DEFLATE_MAX_MATCH + 1];
+static uint8_t dist_to_code[512];
+
+//-----------------------------------------------------------------------------
+///
+/// Reverse the lowest bits of a code, deflate stores huffman codes starting
+/// with the most significant bit
+///
+/// @param code   code to reverse
+/// @param bits   length of the code in bits
+///
+/// @return reversed code
+//
+static uint16_t deflate_reverse(uint16_t code, int bits)
+{
+	uint16_t reversed = 0;
+	int i;
+	for (i = 0; i < bits; i++)
+	{
+		reversed = (reversed << 1) | (code & 1);
+		code >>= 1;
+	}
+	return reversed;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Fill the lookup tables for the fixed huffman codes and the length and
+/// distance codes
+//
+static void deflate_init_tables(void)
+{
+	if (tables_initialised)
+	{
+		return;
+	}
+
+	/* fixed literal/length codes (RFC 1951, 3.2.6) */
+	int i;
+	for (i = 0; i < 288; i++)
+	{
+		if (i < 144)
+		{
+			literal_code[i] = deflate_reverse(0x30 + i, 8);
+			literal_bits[i] = 8;
+		}
+		else if (i < 256)
+		{
+			literal_code[i] = deflate_reverse(0x190 + i - 144, 9);
+			literal_bits[i] = 9;
+		}
+		else if (i < 280)
+		{
+			literal_code[i] = deflate_reverse(i - 256, 7);
+			literal_bits[i] = 7;
+		}
+		else
+		{
+			literal_code[i] = deflate_reverse(0xc0 + i - 280, 8);
+			literal_bits[i] = 8;
+		}
+	}
+	for (i = 0; i < 30; i++)
+	{
+		dist_code_reversed[i] = deflate_reverse(i, 5);
+	}
+
+	/* map lengths and distances to their codes */
+	int code;
+	for (code = 0; code < 29; code++)
+	{
+		int length;
+		for (length = length_base[code];
+			 length < length_base[code] + (1 << length_extra[code]) &&
+			 length <= DEFLATE_MAX_MATCH; length++)
+		{
+			length_to_code[length] = code;
+		}
+	}
+	length_to_code[DEFLATE_MAX_MATCH] = 28;
+	for (code = 0; code < 30; code++)
+	{
+		int dist;
+		for (dist = dist_base[code];
+			 dist < dist_base[code] + (1 << dist_extra[code]); dist++)
+		{
+			/* distances above 256 are looked up by (dist - 1) >> 7 */
+			if (dist <= 256)
+			{
+				dist_to_code[dist - 1] = code;
+			}
+			else
+			{
+				dist_to_code[256 + ((dist - 1) >> 7)] = code;
+			}
+		}
+	}
+
+	tables_initialised = 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write the byte output buffer to the stream
+///
+/// @param deflate  compressor
+//
+static void deflate_flush_output(Deflate *deflate)
+{
+	if (stream_write(deflate->stream, deflate->out, deflate->out_length)
+		!= STREAM_SUCCESS)
+	{
+		deflate->error = DEFLATE_ERR_WRITE;
+	}
+	deflate->out_length = 0;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Append bits to the output, deflate fills bytes starting with the least
+/// significant bit
+///
+/// @param deflate  compressor
+/// @param value    bits to write
+/// @param count    number of bits (at most 32)
+//
+static inline void deflate_put_bits(Deflate *deflate, uint32_t value, int count)
+{
+	deflate->bits |= (uint64_t)value << deflate->bit_count;
+	deflate->bit_count += count;
+
+	/* move whole 32 bit words to the byte output */
+	if (deflate->bit_count >= 32)
+	{
+		if (deflate->out_length > DEFLATE_OUTPUT_SIZE - 4)
+		{
+			deflate_flush_output(deflate);
+		}
+		unsigned char *out = deflate->out + deflate->out_length;
+		out[0] = deflate->bits & 0xff;
+		out[1] = (deflate->bits >> 8) & 0xff;
+		out[2] = (deflate->bits >> 16) & 0xff;
+		out[3] = (deflate->bits >> 24) & 0xff;
+		deflate->out_length += 4;
+		deflate->bits >>= 32;
+		deflate->bit_count -= 32;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Move the remaining whole bytes of the bit buffer to the byte output, pad
+/// the last byte with zero bits
+///
+/// @param deflate  compressor
+//
+static void deflate_align_bits(Deflate *deflate)
+{
+	while (deflate->bit_count > 0)
+	{
+		if (deflate->out_length == DEFLATE_OUTPUT_SIZE)
+		{
+			deflate_flush_output(deflate);
+		}
+		deflate->out[deflate->out_length++] = deflate->bits & 0xff;
+		deflate->bits >>= 8;
+		deflate->bit_count -= (deflate->bit_count < 8) ? deflate->bit_count : 8;
+	}
+	deflate->bits = 0;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Emit a literal byte
+///
+/// @param deflate  compressor
+/// @param literal  byte value
+//
+static inline void deflate_literal(Deflate *deflate, int literal)
+{
+	deflate_put_bits(deflate, literal_code[literal], literal_bits[literal]);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Emit a match (length/distance pair)
+///
+/// @param deflate  compressor
+/// @param length   length of the match (DEFLATE_MIN_MATCH to DEFLATE_MAX_MATCH)
+/// @param dist     distance back to the start of the match (1 to 32768)
+//
+static inline void deflate_match(Deflate *deflate, int length, int dist)
+{
+	int code = length_to_code[length];
+	int symbol = 257 + code;
+	deflate_put_bits(deflate, literal_code[symbol], literal_bits[symbol]);
+	if (length_extra[code] > 0)
+	{
+		deflate_put_bits(deflate, length - length_base[code],
+						 length_extra[code]);
+	}
+
+	code = (dist <= 256) ? dist_to_code[dist - 1]
+		: dist_to_code[256 + ((dist - 1) >> 7)];
+	deflate_put_bits(deflate, dist_code_reversed[code], 5);
+	if (dist_extra[code] > 0)
+	{
+		deflate_put_bits(deflate, dist - dist_base[code], dist_extra[code]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Calculate hash of the three bytes at a window position
+///
+/// @param data  pointer into window
+///
+/// @return hash value between 0 and (DEFLATE_HASH_SIZE - 1)
+//
+static inline uint32_t deflate_hash(const unsigned char *data)
+{
+	uint32_t v = data[0] | (data[1] << 8) | (data[2] << 16);
+	return (v * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Insert a window position into the hash chains
+///
+/// @param deflate  compressor
+/// @param pos      window position with at least three bytes following
+///
+/// @return previous head of the hash chain (-1 if empty)
+//
+static inline int32_t deflate_insert(Deflate *deflate, int pos)
+{
+	uint32_t hash = deflate_hash(deflate->window + pos);
+	int32_t candidate = deflate->head[hash];
+	deflate->prev[pos & DEFLATE_WINDOW_MASK] = candidate;
+	deflate->head[hash] = pos;
+	return candidate;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Count the equal bytes at two positions, comparing eight bytes at a time
+///
+/// @param a           first position
+/// @param b           second position
+/// @param max_length  maximum number of bytes to compare
+///
+/// @return number of equal bytes
+//
+static inline int deflate_match_length(const unsigned char *a,
+									   const unsigned char *b, int max_length)
+{
+	int length = 0;
+
+	while (length + 8 <= max_length)
+	{
+		uint64_t va, vb;
+		memcpy(&va, a + length, 8);
+		memcpy(&vb, b + length, 8);
+		if (va != vb)
+		{
+			break;
+		}
+		length += 8;
+	}
+	while (length < max_length && a[length] == b[length])
+	{
+		length++;
+	}
+
+	return length;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Compress the data in the window
+///
+/// @param deflate  compressor
+/// @param flush    if not 0, all data is compressed, otherwise enough
+///                 lookahead is left for the longest match
+//
+static void deflate_compress(Deflate *deflate, int flush)
+{
+	const unsigned char *window = deflate->window;
+	int limit = deflate->window_length;
+	if (!flush)
+	{
+		limit -= DEFLATE_MIN_LOOKAHEAD;
+	}
+	int max_chain = deflate->fast ? 1 : DEFLATE_MAX_CHAIN;
+
+	while (deflate->pos < limit)
+	{
+		int pos = deflate->pos;
+		int available = deflate->window_length - pos;
+		int best_length = 0;
+		int best_dist = 0;
+
+		if (available >= DEFLATE_MIN_MATCH)
+		{
+			int max_length = available < DEFLATE_MAX_MATCH ?
+				available : DEFLATE_MAX_MATCH;
+			int32_t candidate = deflate_insert(deflate, pos);
+			int chain = max_chain;
+
+			while (candidate >= 0 && candidate < pos &&
+				   pos - candidate < DEFLATE_WINDOW_SIZE && chain-- > 0)
+			{
+				const unsigned char *a = window + candidate;
+				const unsigned char *b = window + pos;
+				/* quick check of the byte which would improve the match */
+				if (a[best_length] == b[best_length])
+				{
+					int length = deflate_match_length(a, b, max_length);
+					if (length > best_length)
+					{
+						best_length = length;
+						best_dist = pos - candidate;
+						if (length == max_length)
+						{
+							break;
+						}
+					}
+				}
+				candidate = deflate->prev[candidate & DEFLATE_WINDOW_MASK];
+			}
+		}
+
+		if (best_length >= DEFLATE_MIN_MATCH)
+		{
+			deflate_match(deflate, best_length, best_dist);
+
+			/* hash the positions covered by the match */
+			if (!deflate->fast || best_length <= DEFLATE_FAST_MAX_INSERT)
+			{
+				int i;
+				for (i = 1; i < best_length; i++)
+				{
+					if (pos + i + DEFLATE_MIN_MATCH <= deflate->window_length)
+					{
+						deflate_insert(deflate, pos + i);
+					}
+				}
+			}
+			deflate->pos += best_length;
+		}
+		else
+		{
+			deflate_literal(deflate, window[pos]);
+			deflate->pos++;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Move the second half of the window to the first half to make room for
+/// new data
+///
+/// @param deflate  compressor
+//
+static void deflate_slide(Deflate *deflate)
+{
+	memmove(deflate->window, deflate->window + DEFLATE_WINDOW_SIZE,
+			DEFLATE_WINDOW_SIZE);
+	deflate->window_length -= DEFLATE_WINDOW_SIZE;
+	deflate->pos -= DEFLATE_WINDOW_SIZE;
+
+	int i;
+	for (i = 0; i < DEFLATE_HASH_SIZE; i++)
+	{
+		int32_t p = deflate->head[i];
+		deflate->head[i] = (p >= DEFLATE_WINDOW_SIZE) ?
+			p - DEFLATE_WINDOW_SIZE : -1;
+	}
+	for (i = 0; i < DEFLATE_WINDOW_SIZE; i++)
+	{
+		int32_t p = deflate->prev[i];
+		deflate->prev[i] = (p >= DEFLATE_WINDOW_SIZE) ?
+			p - DEFLATE_WINDOW_SIZE : -1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Update the adler32 checksum of the uncompressed data
+///
+/// @param deflate  compressor
+/// @param data     uncompressed data
+/// @param size     size of data in bytes
+//
+static void deflate_adler32(Deflate *deflate, const unsigned char *data,
+							size_t size)
+{
+	uint32_t a = deflate->adler_a;
+	uint32_t b = deflate->adler_b;
+
+	while (size > 0)
+	{
+		size_t n = size < ADLER_NMAX ? size : ADLER_NMAX;
+		size -= n;
+		while (n-- > 0)
+		{
+			a += *data++;
+			b += a;
+		}
+		a %= ADLER_MOD;
+		b %= ADLER_MOD;
+	}
+
+	deflate->adler_a = a;
+	deflate->adler_b = b;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Create a compressor writing a zlib stream to the given stream
+///
+/// @param stream  stream receiving the compressed data
+/// @param fast    if not 0, only the most recent match candidate is checked
+///
+/// @return pointer to compressor or NULL if memory could not be allocated
+//
+Deflate *deflate_new(Stream *stream, int fast)
+{
+	deflate_init_tables();
+
+	Deflate *deflate = malloc(sizeof(Deflate));
+	if (deflate == NULL)
+	{
+		return NULL;
+	}
+
+	deflate->stream = stream;
+	deflate->fast = fast;
+	deflate->error = DEFLATE_SUCCESS;
+	deflate->window_length = 0;
+	deflate->pos = 0;
+	memset(deflate->head, 0xff, sizeof(deflate->head)); /* all -1 */
+	memset(deflate->prev, 0xff, sizeof(deflate->prev));
+	deflate->bits = 0;
+	deflate->bit_count = 0;
+	deflate->out_length = 0;
+	deflate->adler_a = 1;
+	deflate->adler_b = 0;
+
+	/* zlib header: deflate with 32K window, compression level hint */
+	deflate->out[deflate->out_length++] = 0x78;
+	deflate->out[deflate->out_length++] = fast ? 0x01 : 0x9c;
+
+	/* everything goes into one final block with fixed huffman codes */
+	deflate_put_bits(deflate, 1, 1); /* BFINAL */
+	deflate_put_bits(deflate, 1, 2); /* BTYPE = 01 */
+
+	return deflate;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Delete a compressor
+///
+/// @param deflate  compressor created by deflate_new
+//
+void deflate_delete(Deflate *deflate)
+{
+	free(deflate);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Compress data, the data does not have to be kept after the call
+///
+/// @param deflate  compressor
+/// @param data     uncompressed data
+/// @param size     size of data in bytes
+///
+/// @return DEFLATE_SUCCESS on success, DEFLATE_ERR_WRITE otherwise
+//
+int deflate_write(Deflate *deflate, const unsigned char *data, size_t size)
+{
+	deflate_adler32(deflate, data, size);
+
+	while (size > 0 && deflate->error == DEFLATE_SUCCESS)
+	{
+		size_t space = 2 * DEFLATE_WINDOW_SIZE - deflate->window_length;
+		if (space == 0)
+		{
+			deflate_compress(deflate, 0);
+			deflate_slide(deflate);
+			continue;
+		}
+
+		size_t n = size < space ? size : space;
+		memcpy(deflate->window + deflate->window_length, data, n);
+		deflate->window_length += n;
+		data += n;
+		size -= n;
+	}
+
+	return deflate->error;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Compress the remaining data and finish the zlib stream
+///
+/// @param deflate  compressor
+///
+/// @return DEFLATE_SUCCESS on success, DEFLATE_ERR_WRITE otherwise
+//
+int deflate_finish(Deflate *deflate)
+{
+	deflate_compress(deflate, 1);
+
+	/* end of block, then pad to byte boundary */
+	deflate_literal(deflate, 256);
+	deflate_align_bits(deflate);
+
+	/* adler32 checksum in big endian byte order */
+	uint32_t adler = (deflate->adler_b << 16) | deflate->adler_a;
+	deflate_put_bits(deflate, (adler >> 24) & 0xff, 8);
+	deflate_put_bits(deflate, (adler >> 16) & 0xff, 8);
+	deflate_put_bits(deflate, (adler >> 8) & 0xff, 8);
+	deflate_put_bits(deflate, adler & 0xff, 8);
+
+	deflate_flush_output(deflate);
+	return deflate->error;
+}
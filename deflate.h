@@ -0,0 +1,72 @@
+/*
+ *  deflate.h - Definitions for the deflate (zlib) compressor
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "stream.h"
+
+#define DEFLATE_SUCCESS 0
+#define DEFLATE_ERR_OUT_OF_MEM 1
+#define DEFLATE_ERR_WRITE 2
+
+#define DEFLATE_WINDOW_SIZE 32768
+#define DEFLATE_WINDOW_MASK (DEFLATE_WINDOW_SIZE - 1)
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_HASH_SIZE (1 << DEFLATE_HASH_BITS)
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_MIN_LOOKAHEAD (DEFLATE_MAX_MATCH + DEFLATE_MIN_MATCH + 1)
+#define DEFLATE_MAX_CHAIN 32       /* match candidates checked in normal mode */
+#define DEFLATE_FAST_MAX_INSERT 16 /* longer matches are not hashed in fast mode */
+#define DEFLATE_OUTPUT_SIZE 65536
+
+typedef struct _Deflate_ {
+	Stream *stream;
+	int fast;
+	int error;
+
+	/* sliding window: DEFLATE_WINDOW_SIZE bytes history plus lookahead */
+	unsigned char window[2 * DEFLATE_WINDOW_SIZE];
+	int window_length;
+	int pos;
+	int32_t head[DEFLATE_HASH_SIZE];
+	int32_t prev[DEFLATE_WINDOW_SIZE];
+
+	/* bit and byte output */
+	uint64_t bits;
+	int bit_count;
+	unsigned char out[DEFLATE_OUTPUT_SIZE];
+	int out_length;
+
+	/* checksum of the uncompressed data */
+	uint32_t adler_a;
+	uint32_t adler_b;
+} Deflate;
+
+Deflate *deflate_new(Stream *stream, int fast);
+void deflate_delete(Deflate *deflate);
+int deflate_write(Deflate *deflate, const unsigned char *data, size_t size);
+int deflate_finish(Deflate *deflate);
+
+#endif
@@ -18,60 +18,330 @@
  *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "draw.h"
+#include "font.h"
+#include "span.h"
+#include "stats.h"
+
+/*
+ * The kernels are written once with a clip parameter and instantiated for
+ * clip = 0 and clip = 1, inlining them makes the parameter a constant, so the
+ * variant for shapes inside the picture has no clipping code at all
+ */
+#ifdef __GNUC__
+#define DRAW_KERNEL static inline __attribute__((always_inline)) uint64_t
+#else
+#define DRAW_KERNEL static inline uint64_t
+#endif
+
+/* pixels written at once by draw_span, 12 bytes are whole 32 bit words */
+#define DRAW_SPAN_BLOCK 4
+
+/* longer spans are filled by the vector kernels of span_fill */
+#define DRAW_SPAN_SHORT 16
+
+/* 1.0 in the 16.16 fixed point of lines of width 1 */
+#define DRAW_FIXED_ONE 65536
+
+/* polylines at least this wide get round joins between their lines */
+#define DRAW_JOIN_WIDTH 3
+
+/*
+ * polygon edges reaching a row are sorted into the others one by one, if
+ * there are not more than this, otherwise the row is sorted again
+ */
+#define DRAW_POLYGON_INSERT 8
+
+/* colors of the ramp of a radial gradient, from its center to its radius */
+#define DRAW_GRADIENT_RAMP 1024
+
+/*
+ * pixels of a linear gradient interpolated from one start, so that the
+ * rounded step of the 16.16 fixed point adds up to less than 1/32
+ */
+#define DRAW_GRADIENT_RUN 1024
+
+/* returned by a kernel instead of the pixels if it ran out of memory */
+#define DRAW_KERNEL_OUT_OF_MEM UINT64_MAX
+
+/* marks the columns of a symbol row a shape wrote, colors have 24 bits */
+#define DRAW_SYMBOL_COVERED 0x1000000u
+
+/* first number of runs of a symbol mask, doubled when they are used up */
+#define DRAW_SYMBOL_RUNS 256
+
+/*
+ * ellipses the span cache keeps the spans of (the least recently used goes
+ * first), the buckets of their radii and the biggest radius cached
+ */
+#define DRAW_CACHE_ENTRIES 256
+#define DRAW_CACHE_BUCKETS 512
+#define DRAW_CACHE_MAX_RADIUS 4096
+
+/*
+ * most threads drawing points at once, the points of a command are only
+ * drawn by threads if there are at least DRAW_POINTS_PARALLEL, and each
+ * thread gets at least DRAW_POINTS_BAND_ROWS rows of the picture
+ */
+#define DRAW_MAX_THREADS 64
+#define DRAW_POINTS_PARALLEL 16384
+#define DRAW_POINTS_BAND_ROWS 64
+
+typedef uint64_t (*DrawKernel)(PixelBuffer *pix_buffer, const void *obj);
+
+/*
+ * spans of the ellipse radii drawn last, see draw_ellipse_spans. Chains and
+ * buckets hold entry indexes + 1, 0 ends a chain. All render contexts share
+ * the cache, draw_span_cache_lock guards it and the references of its tables.
+ * Circles are not cached: their column test is one multiplication and the
+ * search from the previous row finds a row in a step or two, so the locked
+ * lookup made the circle kernel slower in make bench-draw.
+ * Triangles are not either: their rows are stepped in doubles from the
+ * absolute vertices, so the same relative vertices do not give the same
+ * pixels at another position.
+ */
+typedef struct _DrawSpanCache_ {
+	DrawEllipseSpans *entries[DRAW_CACHE_ENTRIES];
+	uint64_t last_use[DRAW_CACHE_ENTRIES];
+	int chain[DRAW_CACHE_ENTRIES];    /* next entry of the same bucket */
+	int buckets[DRAW_CACHE_BUCKETS];  /* first entry of each bucket */
+	int length;
+	uint64_t clock;                   /* counts the lookups */
+} DrawSpanCache;
+
+static DrawSpanCache draw_span_cache;
+static pthread_mutex_t draw_span_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* columns x1 to x2 (exclusive) of a row of a glyph, in pixels of the font */
+typedef struct _DrawGlyphRun_ {
+	uint8_t x1;
+	uint8_t x2;
+} DrawGlyphRun;
+
+/* bytes of a glyph row of scale 1 in the picture, covered by two words */
+#define DRAW_GLYPH_BYTES (FONT_WIDTH * BITMAP_RGB_COLOR_SIZE)
+
+/*
+ * the glyphs of the font as runs, see draw_glyph_atlas: the runs of row r of
+ * glyph g are runs[first[g * FONT_HEIGHT + r]] to
+ * runs[first[g * FONT_HEIGHT + r + 1] - 1], a row has at most
+ * (FONT_WIDTH + 1) / 2 runs. For scale 1 the same row as masks of the bytes
+ * of its pixels: bytes 0 to 7 and 7 to 14 of the row, and the number of its
+ * pixels. glyphs has the glyph of every character.
+ */
+typedef struct _DrawGlyphAtlas_ {
+	uint8_t glyphs[256];
+	uint16_t first[FONT_GLYPHS * FONT_HEIGHT + 1];
+	DrawGlyphRun runs[FONT_GLYPHS * FONT_HEIGHT * ((FONT_WIDTH + 1) / 2)];
+	uint64_t masks[FONT_GLYPHS * FONT_HEIGHT][2];
+	uint8_t pixels[FONT_GLYPHS * FONT_HEIGHT];
+} DrawGlyphAtlas;
+
+static DrawGlyphAtlas draw_atlas;
+static pthread_once_t draw_atlas_once = PTHREAD_ONCE_INIT;
+
+/* threads drawing points, 0 for one per processor, see draw_set_threads */
+static int draw_threads = 0;
+
+/* what a kernel needs to know about the picture and the color */
+typedef struct _DrawTarget_ {
+	char *data;
+	size_t row_size;
+	int64_t width;
+	int64_t height;
+	int color;
+	char pattern[DRAW_SPAN_BLOCK * BITMAP_RGB_COLOR_SIZE]; /* color 4 times */
+} DrawTarget;
+
+/* rows top to bottom (exclusive) a thread draws the points in */
+typedef struct _DrawPointsBand_ {
+	PixelBuffer *pix_buffer;
+	const Points *points;
+	const int32_t *columns;  /* of the disc rows by distance from the center */
+	int64_t distances;       /* in columns, farther rows are calculated */
+	int64_t top;
+	int64_t bottom;
+	int clip;                /* 1 if discs can reach out of the picture */
+	uint64_t pixels;         /* written by the thread */
+} DrawPointsBand;
 
 //-----------------------------------------------------------------------------
 ///
-/// Draws a horizontal line
-/// Be careful, a correct pix_buffer must be passed, no checks
-/// are performed!
+/// Changes the color of a target, the color is repeated to a block of
+/// DRAW_SPAN_BLOCK pixels (blue, green, red like in the pixel buffer)
 ///
-/// @param pix_buffer pixel buffer struct where the rectangle will be drawn into
-/// @param x1         first x coordinate for horizontal line
-/// @param x2         second x coordinate for horizontal line
-/// @param y          y coordinate for horizontal line
-//  @param color      color of the line
+/// @param target  target
+/// @param color   24 bit color
 //
-static void horizline(PixelBuffer *pix_buffer, int x1, int x2, int y, int color)
+static inline void draw_target_color(DrawTarget *target, int color)
 {
-	/* if x1 greater than x2 -> swap variables */
-	if (x1 > x2)
+	target->color = color;
+	for (int i = 0; i < DRAW_SPAN_BLOCK; i++)
+	{
+		target->pattern[i * 3] = color & 0xff; /* blue */
+		target->pattern[i * 3 + 1] = (color & 0xff00) >> 8; /* green */
+		target->pattern[i * 3 + 2] = (color & 0xff0000) >> 16; /* red */
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Prepares the target of a kernel
+///
+/// @param target      target to prepare
+/// @param pix_buffer  pixel buffer that will be drawn into
+/// @param color       24 bit color
+//
+static inline void draw_target_init(DrawTarget *target,
+									PixelBuffer *pix_buffer, int color)
+{
+	target->data = pix_buffer->data;
+	target->row_size = bitmap_pixel_array_row_size(pix_buffer->width);
+	target->width = pix_buffer->width;
+	target->height = pix_buffer->height;
+	draw_target_color(target, color);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Fills a horizontal run of pixels, the run must be inside the picture.
+/// Short runs are filled here, the call of span_fill costs more.
+///
+/// @param target  target with the color
+/// @param y       row (counted from top)
+/// @param x1      first column
+/// @param x2      column after the last one (x2 > x1)
+///
+/// @return number of pixels written
+//
+static inline uint64_t draw_span(DrawTarget *target, int64_t y, int64_t x1,
+								 int64_t x2)
+{
+	/* bitmap is upside down, therefore swap row */
+	char *pixel = target->data + (size_t)(target->height - 1 - y) *
+		target->row_size + (size_t)x1 * BITMAP_RGB_COLOR_SIZE;
+	int64_t n = x2 - x1;
+	if (n >= DRAW_SPAN_SHORT)
+	{
+		span_fill((uint8_t *)pixel, target->color, n);
+		return n;
+	}
+	for (; n >= DRAW_SPAN_BLOCK; n -= DRAW_SPAN_BLOCK)
+	{
+		memcpy(pixel, target->pattern, sizeof(target->pattern));
+		pixel += sizeof(target->pattern);
+	}
+	for (; n > 0; n--)
+	{
+		memcpy(pixel, target->pattern, BITMAP_RGB_COLOR_SIZE);
+		pixel += BITMAP_RGB_COLOR_SIZE;
+	}
+	return x2 - x1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Fills n pixels from pixel on with a color, without a target: for spans
+/// whose color changes from one to the next
+///
+/// @param pixel  first pixel
+/// @param color  24 bit color
+/// @param n      number of pixels
+//
+static inline void draw_fill(uint8_t *pixel, int color, int64_t n)
+{
+	if (n >= DRAW_SPAN_SHORT)
 	{
-		int tmp = x2;
-		x2 = x1;
-		x1 = tmp;
+		span_fill(pixel, color, n);
+		return;
 	}
+	for (; n > 0; n--)
+	{
+		pixel[0] = color & 0xff; /* blue */
+		pixel[1] = (color & 0xff00) >> 8; /* green */
+		pixel[2] = (color & 0xff0000) >> 16; /* red */
+		pixel += BITMAP_RGB_COLOR_SIZE;
+	}
+}
 
-	/* draw line */
-	int x;
-	if (y >= 0 && y < pix_buffer->height)
+//-----------------------------------------------------------------------------
+///
+/// Draws the pixels x1 (inclusive) to x2 (exclusive) of a row. With clip the
+/// run is clipped to the picture, otherwise it must be inside.
+///
+/// @param target  target with the color
+/// @param y       row (counted from top)
+/// @param x1      first column
+/// @param x2      column after the last one, nothing is drawn if x2 <= x1
+/// @param clip    1 to clip, 0 if the run is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_run(DrawTarget *target, int64_t y, int64_t x1, int64_t x2,
+					 const int clip)
+{
+	if (clip)
 	{
-		for (x = x1; x < x2; x++)
+		if (y < 0 || y >= target->height)
 		{
-			if (x >= 0 && x < pix_buffer->width)
-			{
-				bitmap_write_pixel(pix_buffer, x, y, color);
-			}
+			return 0;
 		}
+		x1 = (x1 < 0) ? 0 : x1;
+		x2 = (x2 > target->width) ? target->width : x2;
+	}
+	if (x1 >= x2)
+	{
+		return 0;
 	}
+	return draw_span(target, y, x1, x2);
 }
 
 //-----------------------------------------------------------------------------
 ///
-/// Draws the given triangle to the pixel buffer
-/// Be careful, a correct pix_buffer and triangle must be passed, no checks
-/// are performed!
+/// Draws a horizontal line from x1 (inclusive) to x2 (exclusive), x1 and x2
+/// may be swapped
 ///
-/// @param pix_buffer pixel buffer struct where the rectangle will be drawn into
-/// @param triangle   Triangle struct that shall be drawn
+/// @param target  target with the color
+/// @param y       row (counted from top)
+/// @param x1      first x coordinate
+/// @param x2      second x coordinate
+/// @param clip    1 to clip, 0 if the line is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_horizline(DrawTarget *target, int64_t y, int64_t x1,
+						   int64_t x2, const int clip)
+{
+	/* if x1 greater than x2 -> swap variables */
+	if (x1 > x2)
+	{
+		return draw_run(target, y, x2, x1, clip);
+	}
+	return draw_run(target, y, x1, x2, clip);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Sorts the vertices of a triangle from top to bottom and calculates the
+/// steps of its edges. Everything that draws triangles walks the edges with
+/// these values, so all get exactly the same pixels.
+///
+/// @param triangle  triangle
+/// @param edges     receives the edges
 //
-static void draw_triangle(PixelBuffer *pix_buffer, Triangle *triangle)
+static void draw_triangle_edges(const Triangle *triangle,
+								DrawTriangleEdges *edges)
 {
-	int color = triangle->color;
 	int ax = triangle->ax;
 	int ay = triangle->ay;
 	int bx = triangle->bx;
@@ -80,11 +350,9 @@ static void draw_triangle(PixelBuffer *pix_buffer, Triangle *triangle)
 	int cy = triangle->cy;
 
 	double dx1, dx2, dx3;
-	double sx, sy, ex, ey;
-
 	int tmp_x, tmp_y;
 
-	/* sort points so that ay >= by >= cy */
+	/* sort points so that ay <= by <= cy */
 	if (ay > by)
 	{
 		tmp_x = ax;
@@ -113,255 +381,3935 @@ static void draw_triangle(PixelBuffer *pix_buffer, Triangle *triangle)
 		by = tmp_y;
 	}
 
-	/* calculate slopes */
-	if (by - ay > 0)
+	/*
+	 * calculate slopes, differences of int coordinates need 64 bits (and are
+	 * exact as double)
+	 */
+	int64_t dy1 = (int64_t)by - ay;
+	int64_t dy2 = (int64_t)cy - ay;
+	int64_t dy3 = (int64_t)cy - by;
+	if (dy1 > 0)
 	{
-		dx1 = ((double)bx - ax) / ((double)by - ay);
+		dx1 = (double)((int64_t)bx - ax) / dy1;
 	}
 	else
 	{
 		dx1 = 0;
 	}
 
-	if (cy - ay > 0)
+	if (dy2 > 0)
 	{
-		dx2 = ((double)cx - ax) / ((double)cy - ay);
+		dx2 = (double)((int64_t)cx - ax) / dy2;
 	}
 	else
 	{
 		dx2 = 0;
 	}
 
-	if (cy - by > 0)
+	if (dy3 > 0)
 	{
-		dx3 = ((double)cx - bx) / ((double)cy - by);
+		dx3 = (double)((int64_t)cx - bx) / dy3;
 	}
 	else
 	{
 		dx3 = 0;
 	}
 
-	/* triangle filler */
-	sx = ax;
-	sy = ay;
-	ex = ax;
-	ey = ay;
-
+	edges->sx = ax;
+	edges->ex = ax;
+	edges->sy = ay;
+	edges->bx = bx;
+	edges->by = by;
+	edges->cy = cy;
 	if (dx1 > dx2)
 	{
-		while (sy <= by)
+		edges->step_sx[0] = dx2;
+		edges->step_ex[0] = dx1;
+		edges->step_sx[1] = dx2;
+		edges->step_ex[1] = dx3;
+		edges->restart = 0;
+	}
+	else
+	{
+		edges->step_sx[0] = dx1;
+		edges->step_ex[0] = dx2;
+		edges->step_sx[1] = dx3;
+		edges->step_ex[1] = dx2;
+		edges->restart = 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Skips the rows of a part of a triangle above the picture in one step
+/// instead of a row at a time, so triangles far above the picture cost no
+/// more than their visible rows
+///
+/// @param edges  edges of the triangle
+/// @param part   0 for the rows down to b, 1 for the rows below
+/// @param sx     start column of the current row, moved along
+/// @param sy     current row, moved to row 0 or after the last row of the part
+/// @param ex     end column of the current row, moved along
+//
+static inline void draw_triangle_skip(const DrawTriangleEdges *edges,
+									  int part, double *sx, double *sy,
+									  double *ex)
+{
+	if (*sy >= 0)
+	{
+		return;
+	}
+	double end = (part == 0) ? edges->by : edges->cy;
+	double rows = (end + 1 < 0) ? end + 1 - *sy : -*sy;
+	if (rows <= 0)
+	{
+		return;
+	}
+	*sx += rows * edges->step_sx[part];
+	*ex += rows * edges->step_ex[part];
+	*sy += rows;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws the given triangle to the pixel buffer, a row at a time along the
+/// edges
+/// Be careful, a correct pix_buffer and triangle must be passed, no checks
+/// are performed!
+///
+/// @param pix_buffer pixel buffer struct where the triangle will be drawn into
+/// @param triangle   Triangle struct that shall be drawn
+/// @param clip       1 to clip, 0 if the triangle is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_triangle(PixelBuffer *pix_buffer, const Triangle *triangle,
+						  const int clip)
+{
+	DrawTarget target;
+	draw_target_init(&target, pix_buffer, triangle->color);
+	DrawTriangleEdges edges;
+	draw_triangle_edges(triangle, &edges);
+	uint64_t pixels = 0;
+
+	/*
+	 * triangle filler, the coordinates of a row are truncated to integers
+	 * (like int conversions do), rows above and below the picture are
+	 * skipped when clipping
+	 */
+	double sx = edges.sx;
+	double sy = edges.sy;
+	double ex = edges.ex;
+	if (clip)
+	{
+		draw_triangle_skip(&edges, 0, &sx, &sy, &ex);
+	}
+	while (sy <= edges.by && (!clip || sy < target.height))
+	{
+		pixels += draw_horizline(&target, (int64_t)sy, (int64_t)sx,
+								 (int64_t)ex, clip);
+		sy++;
+		sx += edges.step_sx[0];
+		ex += edges.step_ex[0];
+	}
+	if (edges.restart)
+	{
+		sx = edges.bx;
+		sy = edges.by;
+	}
+	else
+	{
+		ex = edges.bx;
+	}
+	if (clip)
+	{
+		draw_triangle_skip(&edges, 1, &sx, &sy, &ex);
+	}
+	while (sy <= edges.cy && (!clip || sy < target.height))
+	{
+		pixels += draw_horizline(&target, (int64_t)sy, (int64_t)sx,
+								 (int64_t)ex, clip);
+		sy++;
+		sx += edges.step_sx[1];
+		ex += edges.step_ex[1];
+	}
+	return pixels;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Half height of the vertical bar of a circle at a distance from the
+/// center column, the bar covers the rows center - h + 1 to center + h - 1
+///
+/// @param radius    radius of the circle
+/// @param distance  distance of the column from the center column
+///
+/// @return the half height h
+//
+static inline int64_t draw_circle_bar(int64_t radius, int64_t distance)
+{
+	return (int64_t)sqrt((double)(radius * radius - distance * distance));
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Checks a * a + b * b < c * c exactly, the squares of numbers below 2^63
+/// need up to 126 bits and are calculated as two 64 bit halves
+///
+/// @param a  first number, below 2^63
+/// @param b  second number, below 2^63
+/// @param c  third number, below 2^63
+///
+/// @return 1 if the sum of the squares of a and b is less than c squared
+//
+static inline int draw_squares_less(uint64_t a, uint64_t b, uint64_t c)
+{
+	uint64_t values[3] = {a, b, c};
+	uint64_t high[3], low[3];
+	for (int i = 0; i < 3; i++)
+	{
+		/* (h * 2^32 + l)^2 = h^2 * 2^64 + 2 h l * 2^32 + l^2 */
+		uint64_t l = values[i] & 0xffffffff;
+		uint64_t h = values[i] >> 32;
+		uint64_t cross = l * h;
+		low[i] = l * l + (cross << 33);
+		high[i] = h * h + (cross >> 31) + (low[i] < l * l);
+	}
+	uint64_t sum_low = low[0] + low[1];
+	uint64_t sum_high = high[0] + high[1] + (sum_low < low[0]);
+	return sum_high < high[2] || (sum_high == high[2] && sum_low < low[2]);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Checks whether a column of a round shape reaches a row. For a circle the
+/// column has to have a bar higher than the distance of the row, for an
+/// ellipse the pixel has to be inside: column^2 / rx^2 + distance^2 / ry^2
+/// < 1, tested exactly with integers as
+/// (column ry)^2 + (distance rx)^2 < (rx ry)^2.
+///
+/// @param rx        radius of the circle, horizontal radius of the ellipse
+/// @param ry        vertical radius of the ellipse
+/// @param column    column counted from the center column (below rx)
+/// @param distance  distance of the row from the center row (below ry)
+/// @param ellipse   1 for an ellipse, 0 for a circle
+///
+/// @return 1 if the column reaches the row, 0 otherwise
+//
+static inline int draw_round_reaches(int64_t rx, int64_t ry, int64_t column,
+									 int64_t distance, const int ellipse)
+{
+	if (ellipse)
+	{
+		return draw_squares_less(column * ry, distance * rx, rx * ry);
+	}
+	return draw_circle_bar(rx, column) > distance;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Number of columns (counted from the center) of a row of a circle or an
+/// ellipse, that is the columns reaching the row (see draw_round_reaches).
+/// The search starts at the columns of the previous row and gallops, so it
+/// is cheap for neighbouring rows and still logarithmic for a jump.
+///
+/// @param rx        radius of the circle, horizontal radius of the ellipse
+/// @param ry        vertical radius of the ellipse
+/// @param distance  distance of the row from the center row
+/// @param columns   columns of the previous row (0 for the first)
+/// @param ellipse   1 for an ellipse, 0 for a circle
+///
+/// @return columns of the row
+//
+static inline int64_t draw_round_columns(int64_t rx, int64_t ry,
+										 int64_t distance, int64_t columns,
+										 const int ellipse)
+{
+	/* the columns reach less far from the center column on */
+	int64_t lo = columns;
+	int64_t hi = columns;
+	int64_t step = 1;
+	if (columns < rx && draw_round_reaches(rx, ry, columns, distance, ellipse))
+	{
+		lo = columns + 1;
+		hi = lo;
+		while (hi < rx && draw_round_reaches(rx, ry, hi, distance, ellipse))
 		{
-			horizline(pix_buffer, sx, ex, sy, color);
-			sy++;
-			ey++;
-			sx += dx2;
-			ex += dx1;
+			lo = hi + 1;
+			hi = (rx - hi > step) ? hi + step : rx;
+			step *= 2;
 		}
-		ex = bx;
-		ey = by;
-		while (sy <= cy)
+	}
+	else
+	{
+		while (lo > 0 &&
+			   !draw_round_reaches(rx, ry, lo - 1, distance, ellipse))
 		{
-			horizline(pix_buffer, sx, ex, sy, color);
-			sy++;
-			ey++;
-			sx += dx2;
-			ex += dx3;
+			hi = lo - 1;
+			lo = (hi > step) ? hi - step : 0;
+			step *= 2;
 		}
 	}
-	else
+
+	/* the first column from lo not reaching the row, hi at the latest */
+	while (lo < hi)
 	{
-		while (sy <= by)
+		int64_t mid = lo + (hi - lo) / 2;
+		if (draw_round_reaches(rx, ry, mid, distance, ellipse))
 		{
-			horizline(pix_buffer, sx, ex, sy, color);
-			sy++;
-			ey++;
-			sx += dx1;
-			ex += dx2;
+			lo = mid + 1;
 		}
-		sx = bx;
-		sy = by;
-		while (sy <= cy)
+		else
 		{
-			horizline(pix_buffer, sx, ex, sy, color);
-			sy++;
-			ey++;
-			sx += dx3;
-			ex += dx2;
+			hi = mid;
 		}
 	}
+	return lo;
 }
 
 //-----------------------------------------------------------------------------
 ///
-/// Draws the given circle to the pixel buffer
-/// Be careful, a correct pix_buffer and circle must be passed, no checks
-/// are performed!
+/// Number of columns (counted from the center) of a circle row, that is the
+/// columns whose bar is higher than the distance of the row
 ///
-/// @param pix_buffer pixel buffer struct where the rectangle will be drawn into
-/// @param circle     Circle struct that shall be drawn
+/// @param radius    radius of the circle
+/// @param distance  distance of the row from the center row
+/// @param columns   columns of the previous row (0 for the first)
+///
+/// @return columns of the row
 //
-static void draw_circle(PixelBuffer *pix_buffer, Circle *circle)
+static inline int64_t draw_circle_columns(int64_t radius, int64_t distance,
+										  int64_t columns)
 {
-	/* prepare variables and get information from circle struct */
-	int color = circle->color;
-	int index_x, index_y;
-	int x = circle->x;
-	int y = circle->y;
-	int y_offset;
-	int radius = circle->radius;
-	int upper_x, lower_x;
-	int upper_y, lower_y;
-	int ret;
+	return draw_round_columns(radius, radius, distance, columns, 0);
+}
 
-	/* draw circle */
-	for (index_x = 0; index_x < radius; index_x++)
+//-----------------------------------------------------------------------------
+///
+/// Releases an ellipse span table, the last user frees it
+///
+/// @param spans  table from draw_ellipse_spans, may be NULL
+//
+static void draw_ellipse_spans_release(DrawEllipseSpans *spans)
+{
+	if (spans == NULL)
 	{
-		/*
-		 * Each iteration corresponds to one vertical  bar left and right
-		 * from circle center, index_x is the distance between circle center
-		 * and the vertical bar that will be drawn
-		 */
-		upper_x = x + index_x;
-		lower_x = x - index_x;
-		y_offset = sqrt(radius * radius - index_x * index_x);
-
-		if (upper_x >= 0 && upper_x < pix_buffer->width)
-		{
-			/*
-			 * Only draw the vertical bar right from center if it is inside
-			 * the image
-			 */
-			for (index_y = 0; index_y < y_offset; index_y++)
-			{
-				/* draw the parts of the vertical bar that lie inside image */
-				upper_y = y + index_y;
-				lower_y = y - index_y;
-				if (upper_y >= 0 && upper_y < pix_buffer->height)
-				{
-					bitmap_write_pixel(pix_buffer, upper_x, upper_y, color);
-				}
-				if (lower_y >= 0 && lower_y < pix_buffer->height)
-				{
-					bitmap_write_pixel(pix_buffer, upper_x, lower_y, color);
-				}
-			}
-		}
-
-		if (lower_x > 0 && lower_x < pix_buffer->width)
-		{
-			/*
-			 * Only draw the vertical bar left from center if it is inside
-			 * the image
-			 */
-			for (index_y = 0; index_y < y_offset; index_y++)
-			{
-				/* draw the parts of the vertical bar that lie inside image */
-				upper_y = y + index_y;
-				lower_y = y - index_y;
-				if (upper_y >= 0 && upper_y < pix_buffer->height)
-				{
-					ret = bitmap_write_pixel(pix_buffer, lower_x, upper_y, color);
-					if (ret != BITMAP_SUCCESS)
-					{
-						printf("Err bitmap\n");
-					}
-				}
-				if (lower_y >= 0 && lower_y < pix_buffer->height)
-				{
-					ret = bitmap_write_pixel(pix_buffer, lower_x, lower_y, color);
-					if (ret != BITMAP_SUCCESS)
-					{
-						printf("Err bitmap\n");
-					}
-				}
-			}
-		}
+		return;
+	}
+	pthread_mutex_lock(&draw_span_cache_lock);
+	int refs = --spans->refs;
+	pthread_mutex_unlock(&draw_span_cache_lock);
+	if (refs == 0)
+	{
+		free(spans);
 	}
 }
 
 //-----------------------------------------------------------------------------
 ///
-/// Draws the given rectangle to the pixel buffer
-/// Be careful, a correct pix_buffer and rectangle must be passed, no checks
-/// are performed!
+/// Bucket of the span cache for the radii of an ellipse
 ///
-/// @param pix_buffer pixel buffer struct where the rectangle will be drawn into
-/// @param rectangle  Rectangle struct that shall be drawn
+/// @param rx  horizontal radius
+/// @param ry  vertical radius
+///
+/// @return index of the bucket
 //
-static void draw_rectangle(PixelBuffer *pix_buffer, Rectangle *rectangle)
+static inline int draw_span_cache_bucket(int64_t rx, int64_t ry)
 {
-	int index_x, index_y;
-	int x_orig = rectangle->x;
-	int y_orig = rectangle->y;
-	int width = rectangle->width;
-	int height = rectangle->height;
-	int color = rectangle->color;
-	int x, y;
+	return (int)((rx * 31 + ry) % DRAW_CACHE_BUCKETS);
+}
 
-	for (index_x = 0; index_x < width; index_x++)
+//-----------------------------------------------------------------------------
+///
+/// Finds the table of an ellipse in the span cache and marks it used, the
+/// lock has to be held
+///
+/// @param cache  span cache
+/// @param rx     horizontal radius
+/// @param ry     vertical radius
+///
+/// @return table with a reference for the caller, NULL if it is not cached
+//
+static DrawEllipseSpans *draw_span_cache_find(DrawSpanCache *cache,
+											  int64_t rx, int64_t ry)
+{
+	int bucket = draw_span_cache_bucket(rx, ry);
+	for (int e = cache->buckets[bucket]; e != 0; e = cache->chain[e - 1])
 	{
-		/* each iteration corresponds to one vertical bar */
-		x = x_orig + index_x;
-		if (x >= 0 && x < width)
+		DrawEllipseSpans *spans = cache->entries[e - 1];
+		if (spans->rx == rx && spans->ry == ry)
 		{
-			/* only continue if this vertical bar is inside image */
-
-			/* draw the vertical bar */
-			for (index_y = 0; index_y < height; index_y++)
-			{
-				y = y_orig + index_y;
-				if (y >= 0 && y < height)
-				{
-					/* draw only if inside image */
-					bitmap_write_pixel(pix_buffer, x, y, color);
-				}
-			}
+			cache->last_use[e - 1] = cache->clock;
+			spans->refs++;
+			return spans;
 		}
 	}
+	return NULL;
 }
 
 //-----------------------------------------------------------------------------
 ///
-/// Executes the drawing command and writes the shape to the pixel buffer
+/// Removes an entry from its bucket of the span cache and drops the
+/// reference of the cache to its table, the entry can then take another
+/// table; the lock has to be held
 ///
-/// @param pix_buffer  pixel buffer struct where the command will be drawn into
-/// @param comm        command which will be executed
+/// @param cache  span cache
+/// @param entry  index of the entry
 ///
-/// @return DRAW_SUCCESS on success, DRAW_ERR_NULL_POINTER_PASSED or
-///         DRAW_ERR_COMMAND_INVALID otherwise
+/// @return the table if the cache was its last user (to be freed after
+///         unlocking), else NULL
 //
-int draw_command(PixelBuffer *pix_buffer, Command *comm)
+static DrawEllipseSpans *draw_span_cache_evict(DrawSpanCache *cache,
+											   int entry)
 {
-	if (pix_buffer == NULL)
+	DrawEllipseSpans *spans = cache->entries[entry];
+	int *link = &cache->buckets[draw_span_cache_bucket(spans->rx, spans->ry)];
+	while (*link != entry + 1)
 	{
-		return DRAW_ERR_NULL_POINTER_PASSED;
+		link = &cache->chain[*link - 1];
 	}
-	if (comm == NULL)
+	*link = cache->chain[entry];
+	return (--spans->refs == 0) ? spans : NULL;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Columns of every row of an ellipse from the span cache, so ellipses of
+/// the same radii calculate them only once: the exact test of a column (see
+/// draw_round_reaches) costs more than the span of a small ellipse. A
+/// missing table is calculated with draw_round_columns and replaces the
+/// least recently used one if the cache is full. Radii above
+/// DRAW_CACHE_MAX_RADIUS are not cached, their rows cost less than their
+/// pixels anyway.
+/// The cache is shared by all threads and render contexts, it is locked
+/// and a missing table is calculated without holding the lock.
+///
+/// @param rx  horizontal radius
+/// @param ry  vertical radius
+///
+/// @return table of the columns by distance from the center row, has to be
+///         released with draw_ellipse_spans_release; NULL if the radii are
+///         not cached or out of memory, the columns have to be calculated
+//
+static DrawEllipseSpans *draw_ellipse_spans(int64_t rx, int64_t ry)
+{
+	if (rx < 1 || ry < 1 || rx > DRAW_CACHE_MAX_RADIUS ||
+		ry > DRAW_CACHE_MAX_RADIUS)
 	{
-		return DRAW_ERR_NULL_POINTER_PASSED;
+		return NULL;
 	}
-	if (comm->obj == NULL)
+	DrawSpanCache *cache = &draw_span_cache;
+	pthread_mutex_lock(&draw_span_cache_lock);
+	cache->clock++;
+	DrawEllipseSpans *spans = draw_span_cache_find(cache, rx, ry);
+	pthread_mutex_unlock(&draw_span_cache_lock);
+	if (spans != NULL)
 	{
-		return DRAW_ERR_COMMAND_INVALID;
+		STATS_ADD(span_cache_hits, 1);
+		return spans;
 	}
 
-	if (comm->shape == SH_TRIANGLE)
+	STATS_ADD(span_cache_misses, 1);
+	DrawEllipseSpans *made = malloc(sizeof(DrawEllipseSpans) +
+									sizeof(int32_t) * ry);
+	if (made == NULL)
 	{
-		draw_triangle(pix_buffer, (Triangle *)comm->obj);
+		return NULL;
 	}
-	else if (comm->shape == SH_CIRCLE)
+	made->refs = 2; /* the cache and the caller */
+	made->rx = rx;
+	made->ry = ry;
+	int64_t columns = 0;
+	for (int64_t distance = ry - 1; distance >= 0; distance--)
 	{
-		draw_circle(pix_buffer, (Circle *)comm->obj);
+		columns = draw_round_columns(rx, ry, distance, columns, 1);
+		made->columns[distance] = columns;
 	}
-	else if (comm->shape == SH_RECTANGLE)
+
+	/* another thread may have cached the radii meanwhile */
+	DrawEllipseSpans *evicted = NULL;
+	pthread_mutex_lock(&draw_span_cache_lock);
+	spans = draw_span_cache_find(cache, rx, ry);
+	if (spans == NULL)
 	{
-		draw_rectangle(pix_buffer, (Rectangle *)comm->obj);
-	}
+		/* a free entry or the least recently used one */
+		int e = cache->length;
+		if (e < DRAW_CACHE_ENTRIES)
+		{
+			cache->length++;
+		}
+		else
+		{
+			e = 0;
+			for (int i = 1; i < cache->length; i++)
+			{
+				e = (cache->last_use[i] < cache->last_use[e]) ? i : e;
+			}
+			evicted = draw_span_cache_evict(cache, e);
+		}
+		int bucket = draw_span_cache_bucket(rx, ry);
+		cache->entries[e] = made;
+		cache->last_use[e] = cache->clock;
+		cache->chain[e] = cache->buckets[bucket];
+		cache->buckets[bucket] = e + 1;
+		spans = made;
+		made = NULL;
+	}
+	pthread_mutex_unlock(&draw_span_cache_lock);
+	free(made);
+	free(evicted);
+	return spans;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Empties the span cache, which all render contexts share. Tables still
+/// used by kernels or row iterators are freed by their last user.
+//
+void draw_cache_clear(void)
+{
+	DrawSpanCache *cache = &draw_span_cache;
+	DrawEllipseSpans *unused[DRAW_CACHE_ENTRIES];
+	int count = 0;
+	pthread_mutex_lock(&draw_span_cache_lock);
+	for (int e = 0; e < cache->length; e++)
+	{
+		if (--cache->entries[e]->refs == 0)
+		{
+			unused[count++] = cache->entries[e];
+		}
+	}
+	memset(cache, 0, sizeof(DrawSpanCache));
+	pthread_mutex_unlock(&draw_span_cache_lock);
+	for (int i = 0; i < count; i++)
+	{
+		free(unused[i]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Sets the number of threads drawing points (see draw_points)
+///
+/// @param threads  number of threads, 0 for one per online processor
+//
+void draw_set_threads(int threads)
+{
+	draw_threads = (threads < 0) ? 0 : threads;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Cuts the rows of every glyph of the font into runs of set bits and masks
+/// of their bytes, see DrawGlyphAtlas
+//
+static void draw_glyph_atlas_build(void)
+{
+	DrawGlyphAtlas *atlas = &draw_atlas;
+	for (int c = 0; c < 256; c++)
+	{
+		atlas->glyphs[c] = font_glyph(c);
+	}
+	int count = 0;
+	for (int g = 0; g < FONT_GLYPHS; g++)
+	{
+		for (int r = 0; r < FONT_HEIGHT; r++)
+		{
+			int bits = font_glyphs[g][r];
+			atlas->first[g * FONT_HEIGHT + r] = count;
+			for (int x = 0; x < FONT_WIDTH;)
+			{
+				if (!(bits & (1 << (FONT_WIDTH - 1 - x))))
+				{
+					x++;
+					continue;
+				}
+				atlas->runs[count].x1 = x;
+				while (x < FONT_WIDTH && (bits & (1 << (FONT_WIDTH - 1 - x))))
+				{
+					x++;
+				}
+				atlas->runs[count].x2 = x;
+				count++;
+			}
+
+			uint8_t mask[DRAW_GLYPH_BYTES];
+			int pixels = 0;
+			for (int x = 0; x < FONT_WIDTH; x++)
+			{
+				int set = (bits >> (FONT_WIDTH - 1 - x)) & 1;
+				memset(mask + x * BITMAP_RGB_COLOR_SIZE, set ? 0xff : 0,
+					   BITMAP_RGB_COLOR_SIZE);
+				pixels += set;
+			}
+			memcpy(&atlas->masks[g * FONT_HEIGHT + r][0], mask, 8);
+			memcpy(&atlas->masks[g * FONT_HEIGHT + r][1],
+				   mask + DRAW_GLYPH_BYTES - 8, 8);
+			atlas->pixels[g * FONT_HEIGHT + r] = pixels;
+		}
+	}
+	atlas->first[FONT_GLYPHS * FONT_HEIGHT] = count;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// The glyph atlas, made by the first text drawn (also by threads at once),
+/// so a glyph costs its runs and not a test of every bit of the font
+///
+/// @return the atlas
+//
+static const DrawGlyphAtlas *draw_glyph_atlas(void)
+{
+	pthread_once(&draw_atlas_once, draw_glyph_atlas_build);
+	return &draw_atlas;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Glyphs of a text with pixels in the columns 0 to width - 1 of the picture
+///
+/// @param text    text with a scale of at least 1
+/// @param length  number of characters of the text
+/// @param width   width of the picture
+/// @param first   receives the first visible glyph
+/// @param last    receives the last one, below first if there is none
+//
+static inline void draw_text_visible(const Text *text, int64_t length,
+									 int64_t width, int64_t *first,
+									 int64_t *last)
+{
+	/* glyph i covers advance * i to advance * i + reach - 1 from x on */
+	int64_t advance = (int64_t)FONT_ADVANCE * text->scale;
+	int64_t reach = (int64_t)FONT_WIDTH * text->scale;
+	int64_t x = text->x;
+	*first = (x + reach > 0) ? 0 : (-x - reach) / advance + 1;
+	*last = (width - x > 0) ? (width - 1 - x) / advance : -1;
+	*last = (*last >= length) ? length - 1 : *last;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Distances from the center row of a shape symmetric to it that have a row
+/// in the picture: row y + distance or y - distance in 0 to height - 1, when
+/// the center is above (below) the picture only the rows below (above)
+///
+/// @param y       center row
+/// @param height  height of the picture
+/// @param first   biggest distance of the shape, lowered to the picture
+/// @param last    receives the smallest distance with a row in the picture
+//
+static inline void draw_visible_distances(int64_t y, int64_t height,
+										  int64_t *first, int64_t *last)
+{
+	int64_t low = 0;
+	int64_t high = y;
+	if (y < 0)
+	{
+		low = -y;
+	}
+	else if (y >= height)
+	{
+		low = y - height + 1;
+	}
+	high = (height - 1 - y > high) ? height - 1 - y : high;
+	*first = (high < *first) ? high : *first;
+	*last = low;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Cells of a grid from first to last with pixels in 0 to size - 1, along
+/// one axis
+///
+/// @param origin  first pixel of the first cell
+/// @param cell    size of a cell (> 0)
+/// @param count   number of cells (> 0)
+/// @param size    size of the picture
+/// @param first   receives the first cell with pixels in the picture
+/// @param last    receives the last one, below first if there is none
+//
+static inline void draw_grid_visible(int64_t origin, int64_t cell,
+									 int64_t count, int64_t size,
+									 int64_t *first, int64_t *last)
+{
+	*first = (origin < 0) ? -origin / cell : 0;
+	*last = (size - origin > 0) ? (size - origin - 1) / cell : -1;
+	*last = (*last >= count) ? count - 1 : *last;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Columns of the file of an image that the columns left to right - 1 of the
+/// picture show (nearest neighbour), so scaled rows are copied by a table
+/// calculated once instead of a division per pixel
+///
+/// @param image    image with its file mapped
+/// @param left     first column of the picture, inside the image
+/// @param right    column after the last one
+/// @param columns  receives right - left columns of the file
+//
+static void draw_image_columns(const Image *image, int64_t left,
+							   int64_t right, uint32_t *columns)
+{
+	int64_t width = image->bitmap.width;
+	for (int64_t c = left; c < right; c++)
+	{
+		columns[c - left] = (c - image->x) * width / image->width;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Copies the pixels of a row of the file of an image at the columns of a
+/// table (see draw_image_columns) to a row of the picture, dropping the
+/// fourth byte of 32 bit files
+///
+/// @param pixel            first pixel to write
+/// @param source           first pixel of the row of the file
+/// @param columns          columns of the file
+/// @param n                number of pixels (> 0)
+/// @param bytes_per_pixel  3 or 4, see BitmapImage
+//
+static inline void draw_image_gather(uint8_t *pixel, const uint8_t *source,
+									 const uint32_t *columns, int64_t n,
+									 int bytes_per_pixel)
+{
+	if (bytes_per_pixel == 4)
+	{
+		/* a pixel as one word, its fourth byte is overwritten by the next */
+		for (int64_t i = 0; i < n - 1; i++)
+		{
+			memcpy(pixel, source + (size_t)columns[i] * 4, 4);
+			pixel += BITMAP_RGB_COLOR_SIZE;
+		}
+		memcpy(pixel, source + (size_t)columns[n - 1] * 4,
+			   BITMAP_RGB_COLOR_SIZE);
+		return;
+	}
+	for (int64_t i = 0; i < n; i++)
+	{
+		memcpy(pixel, source + (size_t)columns[i] * BITMAP_RGB_COLOR_SIZE,
+			   BITMAP_RGB_COLOR_SIZE);
+		pixel += BITMAP_RGB_COLOR_SIZE;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Checks whether the rows of the file of an image can be copied to the
+/// picture as they are: 24 bit pixels, not scaled horizontally
+///
+/// @param image  image with its file mapped
+///
+/// @return 1 if the rows are copied, 0 if they are gathered
+//
+static inline int draw_image_direct(const Image *image)
+{
+	return image->bitmap.bytes_per_pixel == BITMAP_RGB_COLOR_SIZE &&
+		image->bitmap.width == (uint32_t)image->width;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// First column of a circle row that reaches left to x1. Columns left of the
+/// center are only drawn from column 1 on, column 0 only as center or right
+/// column.
+///
+/// @param x   center column
+/// @param x1  leftmost column of the row
+///
+/// @return first column to draw (may be right of the row if it is empty)
+//
+static inline int64_t draw_circle_first_column(int64_t x, int64_t x1)
+{
+	/* left columns start at 1, right ones (from the center) at 0 */
+	if (x >= 1)
+	{
+		return (x1 < 1) ? 1 : x1;
+	}
+	x1 = (x1 < 0) ? 0 : x1;
+	return (x1 < x) ? x : x1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws the given circle to the pixel buffer. The circle is made of vertical
+/// bars left and right of the center (the bars get shorter with the distance
+/// from the center), it is drawn as rows: a row at distance d from the center
+/// spans all columns whose bar is higher than d.
+/// Be careful, a correct pix_buffer and circle must be passed, no checks
+/// are performed!
+///
+/// @param pix_buffer pixel buffer struct where the circle will be drawn into
+/// @param circle     Circle struct that shall be drawn
+/// @param clip       1 to clip, 0 if the circle is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_circle(PixelBuffer *pix_buffer, const Circle *circle,
+						const int clip)
+{
+	DrawTarget target;
+	draw_target_init(&target, pix_buffer, circle->color);
+	int64_t x = circle->x;
+	int64_t y = circle->y;
+	int64_t radius = circle->radius;
+	uint64_t pixels = 0;
+
+	/*
+	 * From the outermost row to the center, the number of columns (counted
+	 * from the center) with a bar higher than the row distance grows. When
+	 * clipping only the distances with a row in the picture are walked.
+	 */
+	int64_t first = radius - 1;
+	int64_t last = 0;
+	if (clip)
+	{
+		draw_visible_distances(y, target.height, &first, &last);
+	}
+	int64_t columns = 0;
+	for (int64_t distance = first; distance >= last; distance--)
+	{
+		columns = draw_circle_columns(radius, distance, columns);
+
+		int64_t x1 = x - columns + 1;
+		int64_t x2 = x + columns;
+		if (clip)
+		{
+			x1 = draw_circle_first_column(x, x1);
+		}
+		pixels += draw_run(&target, y + distance, x1, x2, clip);
+		if (distance > 0)
+		{
+			pixels += draw_run(&target, y - distance, x1, x2, clip);
+		}
+	}
+	return pixels;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws the given ellipse to the pixel buffer, as rows from the outermost
+/// to the center (mirrored to both sides), the columns of a row are those
+/// inside the ellipse (see draw_round_reaches), so an ellipse covers the
+/// columns x - rx + 1 to x + rx - 1 and the rows y - ry + 1 to y + ry - 1
+/// like a circle.
+/// Be careful, a correct pix_buffer and ellipse must be passed, no checks
+/// are performed!
+///
+/// @param pix_buffer pixel buffer struct where the ellipse will be drawn into
+/// @param ellipse    Ellipse struct that shall be drawn
+/// @param clip       1 to clip, 0 if the ellipse is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_ellipse(PixelBuffer *pix_buffer, const Ellipse *ellipse,
+						 const int clip)
+{
+	DrawTarget target;
+	draw_target_init(&target, pix_buffer, ellipse->color);
+	int64_t x = ellipse->x;
+	int64_t y = ellipse->y;
+	int64_t rx = ellipse->rx;
+	int64_t ry = ellipse->ry;
+	uint64_t pixels = 0;
+	if (rx < 1 || ry < 1)
+	{
+		return 0;
+	}
+
+	int64_t first = ry - 1;
+	int64_t last = 0;
+	if (clip)
+	{
+		draw_visible_distances(y, target.height, &first, &last);
+	}
+	DrawEllipseSpans *spans = draw_ellipse_spans(rx, ry);
+	int64_t columns = 0;
+	for (int64_t distance = first; distance >= last; distance--)
+	{
+		columns = (spans != NULL) ? spans->columns[distance] :
+			draw_round_columns(rx, ry, distance, columns, 1);
+		int64_t x1 = x - columns + 1;
+		int64_t x2 = x + columns;
+		pixels += draw_run(&target, y + distance, x1, x2, clip);
+		if (distance > 0)
+		{
+			pixels += draw_run(&target, y - distance, x1, x2, clip);
+		}
+	}
+	draw_ellipse_spans_release(spans);
+	return pixels;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws the given ring to the pixel buffer: the pixels of the circle with
+/// the outer radius that are not in the circle with the inner radius (as
+/// draw_circle draws them), a row is one span or the spans left and right
+/// of the inner circle.
+/// Be careful, a correct pix_buffer and ring must be passed, no checks
+/// are performed!
+///
+/// @param pix_buffer pixel buffer struct where the ring will be drawn into
+/// @param ring       Ring struct that shall be drawn
+/// @param clip       1 to clip, 0 if the ring is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_ring(PixelBuffer *pix_buffer, const Ring *ring,
+					  const int clip)
+{
+	DrawTarget target;
+	draw_target_init(&target, pix_buffer, ring->color);
+	int64_t x = ring->x;
+	int64_t y = ring->y;
+	int64_t outer = ring->outer;
+	int64_t inner = ring->inner;
+	uint64_t pixels = 0;
+
+	int64_t first = outer - 1;
+	int64_t last = 0;
+	if (clip)
+	{
+		draw_visible_distances(y, target.height, &first, &last);
+	}
+	int64_t columns = 0;
+	int64_t inner_columns = 0;
+	for (int64_t distance = first; distance >= last; distance--)
+	{
+		columns = draw_circle_columns(outer, distance, columns);
+		if (distance < inner)
+		{
+			inner_columns = draw_circle_columns(inner, distance,
+												inner_columns);
+		}
+
+		/* the left span ends where the inner circle starts */
+		int64_t x1 = x - columns + 1;
+		int64_t x2 = (inner_columns > 0) ? x - inner_columns + 1 : x + columns;
+		if (clip)
+		{
+			x1 = draw_circle_first_column(x, x1);
+		}
+		for (int64_t side = -1; side <= 1; side += 2)
+		{
+			if (distance > 0 || side > 0)
+			{
+				pixels += draw_run(&target, y + side * distance, x1, x2,
+								   clip);
+				if (inner_columns > 0)
+				{
+					pixels += draw_run(&target, y + side * distance,
+									   x + inner_columns, x + columns, clip);
+				}
+			}
+		}
+	}
+	return pixels;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Radius of the corners of a rounded rectangle, not more than half the
+/// width and height (a corner of radius r is 2 r - 1 pixels wide together
+/// with the opposite one) and at least 1 (a corner of radius 1 is square)
+///
+/// @param rect  rounded rectangle
+///
+/// @return corner radius to draw with
+//
+static inline int64_t draw_roundrect_radius(const RoundRect *rect)
+{
+	int64_t radius = rect->radius;
+	int64_t max = ((int64_t)rect->width + 1) / 2;
+	max = (((int64_t)rect->height + 1) / 2 < max) ?
+		((int64_t)rect->height + 1) / 2 : max;
+	radius = (radius > max) ? max : radius;
+	return (radius < 1) ? 1 : radius;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws the given rounded rectangle to the pixel buffer. The corners are
+/// the quarters of circles (as draw_circle draws them) with their centers
+/// radius - 1 pixels inside the rectangle, so a rounded rectangle of
+/// 2 radius - 1 pixels is the circle. A row between the corners spans the
+/// whole width, a row of the corners the columns of the circle row.
+/// Be careful, a correct pix_buffer and rectangle must be passed, no checks
+/// are performed!
+///
+/// @param pix_buffer pixel buffer struct where the rectangle will be drawn into
+/// @param rect       RoundRect struct that shall be drawn
+/// @param clip       1 to clip, 0 if the rectangle is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_roundrect(PixelBuffer *pix_buffer, const RoundRect *rect,
+						   const int clip)
+{
+	DrawTarget target;
+	draw_target_init(&target, pix_buffer, rect->color);
+	if (rect->width < 1 || rect->height < 1)
+	{
+		return 0;
+	}
+	int64_t radius = draw_roundrect_radius(rect);
+	int64_t x = rect->x;
+	int64_t right = x + rect->width;
+	int64_t y1 = rect->y;
+	int64_t y2 = y1 + rect->height;
+	int64_t top = y1 + radius - 1;     /* rows of the corner centers */
+	int64_t bottom = y2 - radius;
+	uint64_t pixels = 0;
+
+	if (clip)
+	{
+		y1 = (y1 < 0) ? 0 : y1;
+		y2 = (y2 > target.height) ? target.height : y2;
+	}
+	int64_t columns = 0;
+	for (int64_t y = y1; y < y2; y++)
+	{
+		int64_t distance = (y < top) ? top - y :
+			(y > bottom) ? y - bottom : 0;
+		columns = draw_circle_columns(radius, distance, columns);
+		pixels += draw_run(&target, y, x + radius - columns,
+						   right - radius + columns, clip);
+	}
+	return pixels;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws the given rectangle to the pixel buffer
+/// Be careful, a correct pix_buffer and rectangle must be passed, no checks
+/// are performed!
+///
+/// @param pix_buffer pixel buffer struct where the rectangle will be drawn into
+/// @param rectangle  Rectangle struct that shall be drawn
+/// @param clip       1 to clip, 0 if the rectangle is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_rectangle(PixelBuffer *pix_buffer, const Rectangle *rectangle,
+						   const int clip)
+{
+	DrawTarget target;
+	draw_target_init(&target, pix_buffer, rectangle->color);
+	int64_t x1 = rectangle->x;
+	int64_t y1 = rectangle->y;
+	int64_t x2 = (int64_t)rectangle->x + rectangle->width;
+	int64_t y2 = (int64_t)rectangle->y + rectangle->height;
+	uint64_t pixels = 0;
+
+	if (clip)
+	{
+		x1 = (x1 < 0) ? 0 : x1;
+		y1 = (y1 < 0) ? 0 : y1;
+		x2 = (x2 > target.width) ? target.width : x2;
+		y2 = (y2 > target.height) ? target.height : y2;
+	}
+	if (x1 >= x2)
+	{
+		return 0;
+	}
+
+	for (int64_t y = y1; y < y2; y++)
+	{
+		pixels += draw_span(&target, y, x1, x2);
+	}
+	return pixels;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Rounds a 16.16 fixed point number to the nearest integer, halves up
+///
+/// @param value  fixed point number
+///
+/// @return rounded value
+//
+static inline int64_t draw_fixed_round(int64_t value)
+{
+	value += DRAW_FIXED_ONE / 2;
+	/* division rounding down, also for negative values */
+	if (value >= 0)
+	{
+		return value / DRAW_FIXED_ONE;
+	}
+	return -((-value + DRAW_FIXED_ONE - 1) / DRAW_FIXED_ONE);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Radius of the round joins of a polyline
+///
+/// @param width  width of the polyline
+///
+/// @return radius of the circles at the inner points
+//
+static inline int64_t draw_join_radius(int64_t width)
+{
+	return (width + 1) / 2;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Sets up the spans of a line from (x1, y1) to (x2, y2). A line of width 1
+/// is walked like Bresenham's algorithm, in 16.16 fixed point: a row gets the
+/// run of columns whose nearest row it is, a steep line one pixel per row.
+/// The column of a row is exact (see draw_line_x), so a long line ends at
+/// its end point.
+/// A wider line is the quad of the line moved by half the width to both
+/// sides (the ends are cut straight), a row gets the columns whose pixel
+/// center is inside.
+///
+/// @param line   receives the spans
+/// @param x1     column of the first point
+/// @param y1     row of the first point
+/// @param x2     column of the second point
+/// @param y2     row of the second point
+/// @param width  width of the line
+///
+/// @return 1 if the line has pixels, 0 if not (width below 1 or a wider line
+///         of length 0)
+//
+static int draw_line_setup(DrawLine *line, int64_t x1, int64_t y1,
+						   int64_t x2, int64_t y2, int64_t width)
+{
+	if (width < 1)
+	{
+		return 0;
+	}
+
+	if (width == 1)
+	{
+		/* from top to bottom */
+		if (y1 > y2)
+		{
+			int64_t tmp = x1;
+			x1 = x2;
+			x2 = tmp;
+			tmp = y1;
+			y1 = y2;
+			y2 = tmp;
+		}
+		line->thick = 0;
+		line->left = (x1 < x2) ? x1 : x2;
+		line->right = (x1 < x2) ? x2 : x1;
+		line->top = y1;
+		line->bottom = y2;
+		if (y1 == y2)
+		{
+			/* one run from the middle of the row */
+			line->x = (x1 + x2) * (DRAW_FIXED_ONE / 2);
+			line->step = 0;
+			line->rest = 0;
+			line->rows = 1;
+			line->half = (line->right - line->left) * (DRAW_FIXED_ONE / 2);
+			return 1;
+		}
+		/* the step rounded down and its remainder, 0 <= rest < rows */
+		int64_t dx = (x2 - x1) * DRAW_FIXED_ONE;
+		int64_t dy = y2 - y1;
+		line->x = x1 * DRAW_FIXED_ONE;
+		line->step = dx / dy - (dx % dy < 0);
+		line->rest = dx - line->step * dy;
+		line->rows = dy;
+		int64_t run = ((dx < 0) ? -dx : dx) / dy;
+		line->half = (run > DRAW_FIXED_ONE) ? (run - DRAW_FIXED_ONE) / 2 : 0;
+		return 1;
+	}
+
+	double dx = (double)x2 - x1;
+	double dy = (double)y2 - y1;
+	double length = sqrt(dx * dx + dy * dy);
+	if (length == 0)
+	{
+		return 0;
+	}
+	line->thick = 1;
+
+	/*
+	 * across: |dy (x - x1) - dx (y - y1)| <= length * width / 2,
+	 * along: 0 <= dx (x - x1) + dy (y - y1) <= length^2. A slab parallel to
+	 * the rows only limits the rows, that is done by top and bottom.
+	 */
+	line->center[0] = 0;
+	line->slope[0] = 0;
+	line->reach[0] = HUGE_VAL;
+	if (dy != 0)
+	{
+		line->slope[0] = dx / dy;
+		line->center[0] = x1 - line->slope[0] * y1;
+		line->reach[0] = fabs(length * width / 2 / dy);
+	}
+	line->center[1] = 0;
+	line->slope[1] = 0;
+	line->reach[1] = HUGE_VAL;
+	if (dx != 0)
+	{
+		line->slope[1] = -dy / dx;
+		line->center[1] = x1 + length * length / 2 / dx -
+			line->slope[1] * y1;
+		line->reach[1] = fabs(length * length / 2 / dx);
+	}
+
+	/* corners of the quad */
+	double nx = -dy / length * width / 2;
+	double ny = dx / length * width / 2;
+	double px[4] = {x1 + nx, x2 + nx, x2 - nx, x1 - nx};
+	double py[4] = {y1 + ny, y2 + ny, y2 - ny, y1 - ny};
+	double left = px[0];
+	double right = left;
+	double top = py[0];
+	double bottom = top;
+	for (int i = 1; i < 4; i++)
+	{
+		left = (px[i] < left) ? px[i] : left;
+		right = (px[i] > right) ? px[i] : right;
+		top = (py[i] < top) ? py[i] : top;
+		bottom = (py[i] > bottom) ? py[i] : bottom;
+	}
+	line->left = (int64_t)floor(left);
+	line->right = (int64_t)ceil(right);
+	line->top = (int64_t)ceil(top);
+	line->bottom = (int64_t)floor(bottom);
+	return 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Column of a line of width 1 in a row, x1 + (x2 - x1) * k / (y2 - y1) in
+/// 16.16 fixed point rounded down: the whole steps plus the remainders of
+/// k rows, both exact in 64 bits (k and the remainder are below 2^32)
+///
+/// @param line  spans from draw_line_setup
+/// @param k     row counted from line->top, up to one row after the bottom
+///
+/// @return fixed point column of the row
+//
+static inline int64_t draw_line_x(const DrawLine *line, int64_t k)
+{
+	return line->x + k * line->step + (int64_t)(k * line->rest / line->rows);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Span of a line in a row
+///
+/// @param line  spans from draw_line_setup
+/// @param row   row between line->top and line->bottom
+/// @param x1    receives the first column
+/// @param x2    receives the column after the last one (the span is empty
+///              if x2 <= x1)
+//
+static inline void draw_line_span(const DrawLine *line, int64_t row,
+								  int64_t *x1, int64_t *x2)
+{
+	if (!line->thick)
+	{
+		int64_t x = draw_line_x(line, row - line->top);
+		int64_t first, last;
+		/* the step rounded to zero, a run is more than a column */
+		if (line->step > DRAW_FIXED_ONE)
+		{
+			/* runs of flat lines end where the run of the next row starts */
+			int64_t next = draw_line_x(line, row - line->top + 1);
+			first = draw_fixed_round(x - line->half);
+			last = draw_fixed_round(next - line->half) - 1;
+		}
+		else if (line->step + (line->rest != 0) < -DRAW_FIXED_ONE)
+		{
+			int64_t next = draw_line_x(line, row - line->top + 1);
+			last = draw_fixed_round(x + line->half);
+			first = draw_fixed_round(next + line->half) + 1;
+		}
+		else
+		{
+			first = draw_fixed_round(x - line->half);
+			last = draw_fixed_round(x + line->half);
+		}
+		*x1 = (first < line->left) ? line->left : first;
+		*x2 = ((last > line->right) ? line->right : last) + 1;
+		return;
+	}
+
+	/* columns in both slabs */
+	double y = row;
+	double a = line->center[0] + line->slope[0] * y;
+	double b = line->center[1] + line->slope[1] * y;
+	double left = (a - line->reach[0] > b - line->reach[1]) ?
+		a - line->reach[0] : b - line->reach[1];
+	double right = (a + line->reach[0] < b + line->reach[1]) ?
+		a + line->reach[0] : b + line->reach[1];
+	if (right < left)
+	{
+		*x1 = 0;
+		*x2 = 0;
+		return;
+	}
+	/* ceil and floor without a libm call (not inlined without SSE4.1) */
+	int64_t first = (int64_t)left;
+	int64_t last = (int64_t)right;
+	*x1 = first + (first < left);
+	*x2 = last - (last > right) + 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws the spans of a line
+///
+/// @param target  target with the color
+/// @param line    spans from draw_line_setup
+/// @param clip    1 to clip, 0 if the line is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_line_spans(DrawTarget *target, const DrawLine *line,
+							const int clip)
+{
+	int64_t top = line->top;
+	int64_t bottom = line->bottom;
+	if (clip)
+	{
+		top = (top < 0) ? 0 : top;
+		bottom = (bottom >= target->height) ? target->height - 1 : bottom;
+	}
+	uint64_t pixels = 0;
+	for (int64_t y = top; y <= bottom; y++)
+	{
+		int64_t x1, x2;
+		draw_line_span(line, y, &x1, &x2);
+		pixels += draw_run(target, y, x1, x2, clip);
+	}
+	return pixels;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws the given line to the pixel buffer
+/// Be careful, a correct pix_buffer and line must be passed, no checks
+/// are performed!
+///
+/// @param pix_buffer pixel buffer struct where the line will be drawn into
+/// @param line       Line struct that shall be drawn
+/// @param clip       1 to clip, 0 if the line is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_line(PixelBuffer *pix_buffer, const Line *line,
+					  const int clip)
+{
+	DrawTarget target;
+	draw_target_init(&target, pix_buffer, line->color);
+	DrawLine spans;
+	if (!draw_line_setup(&spans, line->x1, line->y1, line->x2, line->y2,
+						 line->width))
+	{
+		return 0;
+	}
+	return draw_line_spans(&target, &spans, clip);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws the given polyline to the pixel buffer: a line between each two
+/// points and, if the polyline is at least DRAW_JOIN_WIDTH wide, a circle at
+/// each inner point so that the lines are joined round
+/// Be careful, a correct pix_buffer and polyline must be passed, no checks
+/// are performed!
+///
+/// @param pix_buffer pixel buffer struct where the polyline will be drawn into
+/// @param polyline   Polyline struct that shall be drawn
+/// @param clip       1 to clip, 0 if the polyline is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_polyline(PixelBuffer *pix_buffer, const Polyline *polyline,
+						  const int clip)
+{
+	DrawTarget target;
+	draw_target_init(&target, pix_buffer, polyline->color);
+	const int *xy = polyline->points.xy;
+	int count = polyline->points.count;
+	uint64_t pixels = 0;
+
+	for (int i = 0; i + 1 < count; i++)
+	{
+		DrawLine spans;
+		if (draw_line_setup(&spans, xy[2 * i], xy[2 * i + 1], xy[2 * i + 2],
+							xy[2 * i + 3], polyline->width))
+		{
+			pixels += draw_line_spans(&target, &spans, clip);
+		}
+	}
+
+	if (polyline->width >= DRAW_JOIN_WIDTH)
+	{
+		Circle join = {polyline->id, polyline->color, 0, 0,
+					   draw_join_radius(polyline->width)};
+		for (int i = 1; i + 1 < count; i++)
+		{
+			join.x = xy[2 * i];
+			join.y = xy[2 * i + 1];
+			pixels += draw_circle(pix_buffer, &join, clip);
+		}
+	}
+	return pixels;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Compares two polygon edges by their top row (for qsort)
+///
+/// @param a  first edge
+/// @param b  second edge
+///
+/// @return negative, zero or positive like for qsort
+//
+static int draw_polygon_compare_top(const void *a, const void *b)
+{
+	int64_t top_a = ((const DrawPolygonEdge *)a)->top;
+	int64_t top_b = ((const DrawPolygonEdge *)b)->top;
+	return (top_a > top_b) - (top_a < top_b);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Compares two polygon edges by the column of their crossing (for qsort)
+///
+/// @param a  first edge
+/// @param b  second edge
+///
+/// @return negative, zero or positive like for qsort
+//
+static int draw_polygon_compare_column(const void *a, const void *b)
+{
+	int64_t column_a = ((const DrawPolygonEdge *)a)->column;
+	int64_t column_b = ((const DrawPolygonEdge *)b)->column;
+	return (column_a > column_b) - (column_a < column_b);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Sets up the edge table of a polygon. A row y gets the columns whose pixel
+/// center (x, y) is inside: each edge crosses the rows from its upper point
+/// to the row before its lower point (horizontal edges cross none) and the
+/// columns from the first column at or right of a crossing to the column
+/// before the next crossing are filled, if the fill rule says the pixels
+/// between are inside. Like this polygons sharing an edge don't share
+/// pixels, and a polygon of the corners of a rectangle gets the pixels of
+/// the rectangle.
+///
+/// @param poly     receives the edge table, free it with draw_polygon_free
+/// @param polygon  polygon
+///
+/// @return 1 on success, 0 if out of memory
+//
+static int draw_polygon_setup(DrawPolygon *poly, const Polygon *polygon)
+{
+	const int *xy = polygon->points.xy;
+	int count = polygon->points.count;
+
+	/* the edges, the active ones and at most count / 2 spans of a row */
+	char *mem = malloc(sizeof(DrawPolygonEdge) * 2 * (size_t)count +
+					   sizeof(int64_t) * ((size_t)count + 2));
+	if (mem == NULL)
+	{
+		return 0;
+	}
+	poly->edges = (DrawPolygonEdge *)mem;
+	poly->active = poly->edges + count;
+	poly->spans = (int64_t *)(poly->active + count);
+	poly->nonzero = polygon->rule == FILL_NONZERO;
+
+	poly->count = 0;
+	for (int i = 0; i < count; i++)
+	{
+		int j = (i + 1 < count) ? i + 1 : 0;
+		int64_t x1 = xy[2 * i];
+		int64_t y1 = xy[2 * i + 1];
+		int64_t x2 = xy[2 * j];
+		int64_t y2 = xy[2 * j + 1];
+		if (y1 == y2)
+		{
+			continue;
+		}
+		DrawPolygonEdge *edge = &poly->edges[poly->count++];
+		edge->winding = 1;
+		if (y1 > y2)
+		{
+			int64_t tmp = x1;
+			x1 = x2;
+			x2 = tmp;
+			tmp = y1;
+			y1 = y2;
+			y2 = tmp;
+			edge->winding = -1;
+		}
+		int64_t dy = y2 - y1;
+
+		/* step rounded down, also for edges going left */
+		int64_t step = (x2 - x1) / dy;
+		int64_t step_fraction = (x2 - x1) % dy;
+		if (step_fraction < 0)
+		{
+			step--;
+			step_fraction += dy;
+		}
+		edge->step = step;
+		edge->step_fraction = (uint32_t)step_fraction;
+		edge->dy = (uint32_t)dy;
+		edge->fraction = 0;
+		edge->x = (int32_t)x1;
+		edge->top = (int32_t)y1;
+		edge->bottom = (int32_t)y2;
+	}
+	qsort(poly->edges, poly->count, sizeof(DrawPolygonEdge),
+		  draw_polygon_compare_top);
+
+	poly->next = 0;
+	poly->active_length = 0;
+	poly->span_count = 0;
+	poly->span = 0;
+	poly->row = (poly->count > 0) ? (int64_t)poly->edges[0].top - 1 : 0;
+	return 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Frees the edge table of a polygon
+///
+/// @param poly  edge table from draw_polygon_setup
+//
+static void draw_polygon_free(DrawPolygon *poly)
+{
+	free(poly->edges);
+	poly->edges = NULL;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Moves the crossing of an edge down by a number of rows, exactly (the
+/// crossing is a fraction of integers), and updates its column
+///
+/// @param edge  polygon edge
+/// @param rows  number of rows (at least 1), the edge must still cross the
+///              row reached
+//
+static inline void draw_polygon_advance(DrawPolygonEdge *edge, int64_t rows)
+{
+	/* rows, step_fraction and fraction are below dy < 2^32, no overflow */
+	uint64_t fraction = (uint64_t)rows * edge->step_fraction + edge->fraction;
+	if (rows == 1)
+	{
+		int carry = fraction >= edge->dy;
+		edge->x = (int32_t)(edge->x + edge->step + carry);
+		edge->fraction = (uint32_t)(fraction - (carry ? edge->dy : 0));
+	}
+	else
+	{
+		edge->x = (int32_t)(edge->x + rows * edge->step +
+							(int64_t)(fraction / edge->dy));
+		edge->fraction = (uint32_t)(fraction % edge->dy);
+	}
+	edge->column = edge->x + (edge->fraction > 0);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Moves a polygon to the next row (at first_row or below) that edges cross
+/// and calculates the spans of the row, sorted from left to right. Rows no
+/// edge crosses are skipped at once, the edges crossing the row (active
+/// edges) stay sorted by their crossing from row to row, so usually
+/// sorting them again only checks the order.
+///
+/// @param poly       edge table from draw_polygon_setup
+/// @param first_row  rows above are skipped
+///
+/// @return 1 if there is such a row (it can have no spans), 0 if the polygon
+///         has no more rows
+//
+static int draw_polygon_next_row(DrawPolygon *poly, int64_t first_row)
+{
+	int64_t row = poly->row + 1;
+	row = (row < first_row) ? first_row : row;
+	if (poly->active_length == 0)
+	{
+		if (poly->next == poly->count)
+		{
+			return 0;
+		}
+		if (row < poly->edges[poly->next].top)
+		{
+			row = poly->edges[poly->next].top;
+		}
+	}
+
+	/*
+	 * move the active edges down, without those ending above the row, and
+	 * add the edges reaching it, checking whether they are still sorted
+	 */
+	DrawPolygonEdge *active = poly->active;
+	int length = 0;
+	int sorted = 1;
+	int64_t column = INT64_MIN;
+	for (int i = 0; i < poly->active_length; i++)
+	{
+		if (active[i].bottom > row)
+		{
+			draw_polygon_advance(&active[i], row - poly->row);
+			if (length < i)
+			{
+				active[length] = active[i];
+			}
+			sorted &= active[length].column >= column;
+			column = active[length++].column;
+		}
+	}
+	int added = 0;
+	for (; poly->next < poly->count && poly->edges[poly->next].top <= row;
+		 poly->next++)
+	{
+		DrawPolygonEdge *edge = &poly->edges[poly->next];
+		if (edge->bottom > row)
+		{
+			edge->column = edge->x;
+			if (row > edge->top)
+			{
+				draw_polygon_advance(edge, row - edge->top);
+			}
+			active[length] = *edge;
+			sorted &= active[length].column >= column;
+			column = active[length++].column;
+			added++;
+		}
+	}
+	poly->active_length = length;
+	poly->row = row;
+
+	/* sort by column, many new edges at once, a few by insertion */
+	if (!sorted && added > DRAW_POLYGON_INSERT)
+	{
+		qsort(active, length, sizeof(DrawPolygonEdge),
+			  draw_polygon_compare_column);
+	}
+	else if (!sorted)
+	{
+		for (int i = 1; i < length; i++)
+		{
+			if (active[i].column >= active[i - 1].column)
+			{
+				continue;
+			}
+			DrawPolygonEdge edge = active[i];
+			int j = i;
+			for (; j > 0 && active[j - 1].column > edge.column; j--)
+			{
+				active[j] = active[j - 1];
+			}
+			active[j] = edge;
+		}
+	}
+
+	/* spans between the crossings the fill rule puts inside */
+	int64_t *spans = poly->spans;
+	int count = 0;
+	int winding = 0;
+	int64_t start = 0;
+	for (int i = 0; i < length; i++)
+	{
+		int was_inside = winding != 0;
+		if (poly->nonzero)
+		{
+			winding += active[i].winding;
+		}
+		else
+		{
+			winding ^= 1;
+		}
+		if (!was_inside && winding != 0)
+		{
+			start = active[i].column;
+		}
+		else if (was_inside && winding == 0 && active[i].column > start)
+		{
+			/* spans touching each other become one */
+			if (count > 0 && spans[count - 1] == start)
+			{
+				spans[count - 1] = active[i].column;
+			}
+			else
+			{
+				spans[count++] = start;
+				spans[count++] = active[i].column;
+			}
+		}
+	}
+	poly->span_count = count / 2;
+	return 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws the given polygon to the pixel buffer, a row at a time along its
+/// edges (see draw_polygon_setup)
+/// Be careful, a correct pix_buffer and polygon must be passed, no checks
+/// are performed!
+///
+/// @param pix_buffer pixel buffer struct where the polygon will be drawn into
+/// @param polygon    Polygon struct that shall be drawn
+/// @param clip       1 to clip, 0 if the polygon is inside the picture
+///
+/// @return number of pixels written, DRAW_KERNEL_OUT_OF_MEM if there is not
+///         enough memory for the edges
+//
+DRAW_KERNEL draw_polygon(PixelBuffer *pix_buffer, const Polygon *polygon,
+						 const int clip)
+{
+	DrawTarget target;
+	draw_target_init(&target, pix_buffer, polygon->color);
+	DrawPolygon poly;
+	if (!draw_polygon_setup(&poly, polygon))
+	{
+		return DRAW_KERNEL_OUT_OF_MEM;
+	}
+
+	/* rows above the picture are skipped */
+	uint64_t pixels = 0;
+	while (draw_polygon_next_row(&poly, 0) &&
+		   (!clip || poly.row < target.height))
+	{
+		for (int i = 0; i < poly.span_count; i++)
+		{
+			pixels += draw_run(&target, poly.row, poly.spans[2 * i],
+							   poly.spans[2 * i + 1], clip);
+		}
+	}
+	draw_polygon_free(&poly);
+	return pixels;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Color at an offset of a gradient, interpolated between the stops around
+/// it, before the first and after the last stop the color of the stop
+///
+/// @param stops   stops of the gradient
+/// @param offset  offset in percent
+///
+/// @return 24 bit color
+//
+static int draw_gradient_color(const GradientStops *stops, double offset)
+{
+	const GradientStop *stop = stops->stops;
+	int i = 0;
+	while (i < stops->count && stop[i].offset <= offset)
+	{
+		i++;
+	}
+	if (i == 0 || i == stops->count)
+	{
+		return stop[(i == 0) ? 0 : i - 1].color & 0xffffff;
+	}
+	double t = (offset - stop[i - 1].offset) /
+		(stop[i].offset - stop[i - 1].offset);
+	int color = 0;
+	for (int shift = 0; shift < 24; shift += 8)
+	{
+		int a = (stop[i - 1].color >> shift) & 0xff;
+		int b = (stop[i].color >> shift) & 0xff;
+		color |= (int)floor(a + (b - a) * t + 0.5) << shift;
+	}
+	return color;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Prepares a gradient for drawing: calculates the ramp of a radial
+/// gradient, the colors at DRAW_GRADIENT_RAMP distances from its center to
+/// its radius. A gradient that has its ramp already is left as it is.
+///
+/// @param gradient  gradient
+///
+/// @return DRAW_SUCCESS on success, DRAW_ERR_OUT_OF_MEM otherwise
+//
+static int draw_gradient_prepare(Gradient *gradient)
+{
+	if (gradient->kind != GRADIENT_RADIAL || gradient->ramp != NULL)
+	{
+		return DRAW_SUCCESS;
+	}
+	uint32_t *ramp = malloc(sizeof(uint32_t) * DRAW_GRADIENT_RAMP);
+	if (ramp == NULL)
+	{
+		return DRAW_ERR_OUT_OF_MEM;
+	}
+	for (int i = 0; i < DRAW_GRADIENT_RAMP; i++)
+	{
+		ramp[i] = draw_gradient_color(&gradient->stops,
+									  100.0 * i / (DRAW_GRADIENT_RAMP - 1));
+	}
+	gradient->ramp = ramp;
+	return DRAW_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes n pixels between two stops of a linear gradient (see
+/// draw_gradient_linear): the channels change by a fixed step, the pixels
+/// are written by span_lerp in runs of DRAW_GRADIENT_RUN pixels
+///
+/// @param a       stop before the pixels
+/// @param b       stop after the pixels (b->offset > a->offset)
+/// @param p0      position at column 0
+/// @param dp      change of the position from one column to the next
+/// @param length  squared length of the gradient
+/// @param x       first column
+/// @param n       number of pixels
+/// @param pixel   first pixel
+//
+static void draw_gradient_lerp(const GradientStop *a, const GradientStop *b,
+							   double p0, double dp, double length, int64_t x,
+							   int64_t n, uint8_t *pixel)
+{
+	double scale = 1.0 / ((b->offset - a->offset) * length);
+	double dt = dp * scale;
+	while (n > 0)
+	{
+		/* t from 0 at stop a to 1 at stop b, rounding can leave the range */
+		int64_t run = (n < DRAW_GRADIENT_RUN) ? n : DRAW_GRADIENT_RUN;
+		double t = (p0 + x * dp - a->offset * length) * scale;
+		t = (t < 0) ? 0 : (t > 1) ? 1 : t;
+		int32_t start[3];
+		int32_t step[3];
+		for (int c = 0; c < 3; c++)
+		{
+			int ca = (a->color >> (8 * c)) & 0xff;
+			int cb = (b->color >> (8 * c)) & 0xff;
+			start[c] = (int32_t)floor((ca + (cb - ca) * t) * DRAW_FIXED_ONE +
+									  DRAW_FIXED_ONE / 2);
+			step[c] = (int32_t)floor((cb - ca) * dt * DRAW_FIXED_ONE + 0.5);
+		}
+		span_lerp(pixel, start, step, run);
+		pixel += run * BITMAP_RGB_COLOR_SIZE;
+		x += run;
+		n -= run;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes the pixels of a linear gradient from column x1 to x2 (exclusive)
+/// of a row. The offset of a pixel is the projection of its distance from
+/// x1, y1 of the gradient onto the way to x2, y2, along a row it changes by
+/// a fixed step, so the row is cut where it passes a stop and each piece
+/// between two stops is interpolated with a fixed step per channel. The
+/// offset is kept as the position p = 100 * (dot product of the distance
+/// and the way), at offset o p is o * the squared length of the way: both
+/// are integers, which doubles hold exactly for coordinates up to about
+/// 2^22 apart, so a pixel on a stop is cut exactly.
+///
+/// @param gradient  linear gradient
+/// @param y         row (counted from top)
+/// @param x1        first column
+/// @param x2        column after the last one
+/// @param pixel     first pixel, receives x2 - x1 pixels
+//
+static void draw_gradient_linear(const Gradient *gradient, int64_t y,
+								 int64_t x1, int64_t x2, uint8_t *pixel)
+{
+	const GradientStop *stop = gradient->stops.stops;
+	int count = gradient->stops.count;
+	double dx = (double)gradient->x2 - gradient->x1;
+	double dy = (double)gradient->y2 - gradient->y1;
+	double length = dx * dx + dy * dy;
+	if (length == 0)
+	{
+		draw_fill(pixel, stop[count - 1].color, x2 - x1);
+		return;
+	}
+
+	/* position at column x of the row: p0 + x * dp */
+	double dp = 100 * dx;
+	double p0 = 100 * (-(double)gradient->x1 * dx +
+					   (y - (double)gradient->y1) * dy);
+	for (int64_t x = x1; x < x2;)
+	{
+		/* between stop i - 1 and stop i, up to the column p passes one */
+		double p = p0 + x * dp;
+		int i = 0;
+		while (i < count && stop[i].offset * length <= p)
+		{
+			i++;
+		}
+		double leave = x2;
+		if (dp > 0 && i < count)
+		{
+			leave = ceil((stop[i].offset * length - p0) / dp);
+		}
+		else if (dp < 0 && i > 0)
+		{
+			leave = floor((stop[i - 1].offset * length - p0) / dp) + 1;
+		}
+		int64_t end = (leave >= x2) ? x2 : (leave <= x) ? x + 1 :
+			(int64_t)leave;
+
+		if (i == 0 || i == count)
+		{
+			draw_fill(pixel, stop[(i == 0) ? 0 : count - 1].color, end - x);
+		}
+		else
+		{
+			draw_gradient_lerp(&stop[i - 1], &stop[i], p0, dp, length, x,
+							   end - x, pixel);
+		}
+		pixel += (end - x) * BITMAP_RGB_COLOR_SIZE;
+		x = end;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes the pixels of a radial gradient from column x1 to x2 (exclusive)
+/// of a row. The offset of a pixel is its distance from the center, which
+/// does not change by a fixed step along the row, the color is looked up in
+/// the ramp by the distance of each pixel. Pixels outside of the radius have
+/// the color of the last stop.
+/// The square root per pixel is kept on purpose: stepping the squared
+/// distance in integers (by 2 ex + 1 per column) and moving the index across
+/// a table of the squared distance of each ramp index gave the same pixels,
+/// but the table costs more than a small gradient draws and the index moves
+/// by an unpredictable number of entries per pixel, both were slower in
+/// make bench-gradient than the square root.
+///
+/// @param gradient  radial gradient with its ramp
+/// @param y         row (counted from top)
+/// @param x1        first column
+/// @param x2        column after the last one
+/// @param pixel     first pixel, receives x2 - x1 pixels
+//
+static void draw_gradient_radial(const Gradient *gradient, int64_t y,
+								 int64_t x1, int64_t x2, uint8_t *pixel)
+{
+	const uint32_t *ramp = gradient->ramp;
+	int last = ramp[DRAW_GRADIENT_RAMP - 1];
+	double dx = (double)gradient->x2 - gradient->x1;
+	double dy = (double)gradient->y2 - gradient->y1;
+	double radius = sqrt(dx * dx + dy * dy);
+	double ey = y - (double)gradient->y1;
+	if (fabs(ey) >= radius)
+	{
+		draw_fill(pixel, last, x2 - x1);
+		return;
+	}
+
+	/* the columns inside the circle in the row */
+	double reach = sqrt(radius * radius - ey * ey);
+	double left = ceil(gradient->x1 - reach);
+	double right = floor(gradient->x1 + reach) + 1;
+	int64_t inside1 = (left <= x1) ? x1 : (left >= x2) ? x2 : (int64_t)left;
+	int64_t inside2 = (right <= inside1) ? inside1 : (right >= x2) ? x2 :
+		(int64_t)right;
+	draw_fill(pixel, last, inside1 - x1);
+	pixel += (inside1 - x1) * BITMAP_RGB_COLOR_SIZE;
+
+	double scale = (DRAW_GRADIENT_RAMP - 1) / radius;
+	double ey2 = ey * ey;
+	for (int64_t x = inside1; x < inside2; x++)
+	{
+		double ex = x - (double)gradient->x1;
+		double index = sqrt(ex * ex + ey2) * scale + 0.5;
+		uint32_t color = ramp[(index < DRAW_GRADIENT_RAMP - 1) ? (int)index :
+							  DRAW_GRADIENT_RAMP - 1];
+		pixel[0] = color & 0xff; /* blue */
+		pixel[1] = (color & 0xff00) >> 8; /* green */
+		pixel[2] = (color & 0xff0000) >> 16; /* red */
+		pixel += BITMAP_RGB_COLOR_SIZE;
+	}
+	draw_fill(pixel, last, x2 - inside2);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes the pixels of a gradient from column x1 to x2 (exclusive) of a
+/// row, the gradient has to be prepared by draw_gradient_prepare
+///
+/// @param gradient  gradient
+/// @param y         row (counted from top)
+/// @param x1        first column
+/// @param x2        column after the last one
+/// @param pixel     first pixel, receives x2 - x1 pixels
+//
+static void draw_gradient_span(const Gradient *gradient, int64_t y,
+							   int64_t x1, int64_t x2, uint8_t *pixel)
+{
+	if (gradient->kind == GRADIENT_RADIAL)
+	{
+		draw_gradient_radial(gradient, y, x1, x2, pixel);
+	}
+	else
+	{
+		draw_gradient_linear(gradient, y, x1, x2, pixel);
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Sets the current span of a row iterator, clipped to the picture
+///
+/// @param rows  row iterator
+/// @param row   row (counted from top)
+/// @param x1    first column
+/// @param x2    column after the last one
+//
+static inline void draw_rows_set(DrawRows *rows, int64_t row, int64_t x1,
+								 int64_t x2)
+{
+	rows->row = row;
+	rows->x1 = (x1 < 0) ? 0 : x1;
+	rows->x2 = (x2 > rows->width) ? rows->width : x2;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Moves a row iterator to the next span of its shape, also to spans above
+/// or below the picture
+///
+/// @param rows  row iterator
+///
+/// @return 1 if there is a next span, 0 if the shape has no more spans
+//
+static int draw_rows_step(DrawRows *rows)
+{
+	if (rows->walk == SH_USE)
+	{
+		/* the next run, rows of the mask without runs are skipped */
+		const DrawSymbolMask *mask = rows->mask;
+		rows->run++;
+		while (rows->mask_row < mask->rows &&
+			   rows->run >= mask->first[rows->mask_row + 1])
+		{
+			rows->mask_row++;
+		}
+		if (rows->mask_row >= mask->rows)
+		{
+			return 0;
+		}
+		const DrawSymbolRun *run = &mask->runs[rows->run];
+		rows->color = run->color;
+		draw_rows_set(rows, rows->y + mask->top + rows->mask_row,
+					  rows->x + run->x1, rows->x + run->x2);
+		return 1;
+	}
+
+	if (rows->walk == SH_TEXT)
+	{
+		/* the next run of a glyph, after the last glyph the next row */
+		const DrawGlyphAtlas *atlas = &draw_atlas;
+		const unsigned char *chars = (const unsigned char *)rows->text->text;
+		int64_t scale = rows->text->scale;
+		int key = atlas->glyphs[chars[rows->glyph]] * FONT_HEIGHT +
+			(rows->row - rows->y) / scale;
+		rows->run++;
+		while (rows->run >= atlas->first[key + 1])
+		{
+			if (rows->glyph < rows->last_column)
+			{
+				rows->glyph++;
+			}
+			else
+			{
+				if (rows->row + 1 >= rows->end)
+				{
+					return 0;
+				}
+				rows->row++;
+				rows->glyph = rows->first_column;
+			}
+			key = atlas->glyphs[chars[rows->glyph]] * FONT_HEIGHT +
+				(rows->row - rows->y) / scale;
+			rows->run = atlas->first[key];
+		}
+		const DrawGlyphRun *run = &atlas->runs[rows->run];
+		int64_t left = rows->x + rows->glyph * FONT_ADVANCE * scale;
+		draw_rows_set(rows, rows->row, left + run->x1 * scale,
+					  left + run->x2 * scale);
+		return 1;
+	}
+
+	if (rows->walk == SH_GRID)
+	{
+		/* the next cells of one color, after the last the next row */
+		const Grid *grid = rows->grid;
+		if (rows->column > rows->last_column)
+		{
+			if (rows->row + 1 >= rows->end)
+			{
+				return 0;
+			}
+			rows->row++;
+			rows->column = rows->first_column;
+		}
+		const uint32_t *cells = grid->cells + (size_t)((rows->row - rows->y) /
+			grid->cell_height) * grid->columns;
+		int64_t c = rows->column;
+		int color = cells[c] & 0xffffff;
+		int64_t end = c + 1;
+		while (end <= rows->last_column &&
+			   (int)(cells[end] & 0xffffff) == color)
+		{
+			end++;
+		}
+		rows->color = color;
+		rows->column = end;
+		draw_rows_set(rows, rows->row, rows->x + c * grid->cell_width,
+					  rows->x + end * grid->cell_width);
+		return 1;
+	}
+
+	if (rows->walk == SH_IMAGE)
+	{
+		/* the visible columns of the next row */
+		const Image *image = rows->image;
+		const BitmapImage *bitmap = &image->bitmap;
+		if (rows->row + 1 >= rows->end)
+		{
+			return 0;
+		}
+		rows->row++;
+		int64_t source_row = (rows->row - rows->y) * bitmap->height /
+			image->height;
+		const uint8_t *source = bitmap->top + source_row * bitmap->stride;
+		if (rows->image_row == NULL)
+		{
+			rows->pixels = source +
+				(rows->x1 - rows->x) * BITMAP_RGB_COLOR_SIZE;
+		}
+		else if (source_row != rows->source_row)
+		{
+			draw_image_gather(rows->image_row, source, rows->source_columns,
+							  rows->x2 - rows->x1, bitmap->bytes_per_pixel);
+		}
+		rows->source_row = source_row;
+		return 1;
+	}
+
+	if (rows->walk == SH_RING && rows->part == 1)
+	{
+		/* the span right of the inner circle */
+		rows->part = 0;
+		draw_rows_set(rows, rows->row, rows->next_x1, rows->next_x2);
+		return 1;
+	}
+
+	if (rows->walk == SH_ELLIPSE || rows->walk == SH_RING ||
+		rows->walk == SH_ROUNDRECT)
+	{
+		if (rows->row + 1 >= rows->end)
+		{
+			return 0;
+		}
+		rows->row++;
+		if (rows->walk == SH_ROUNDRECT)
+		{
+			int64_t distance = (rows->row < rows->y) ? rows->y - rows->row :
+				(rows->row > rows->bottom) ? rows->row - rows->bottom : 0;
+			rows->columns = draw_circle_columns(rows->radius, distance,
+												rows->columns);
+			draw_rows_set(rows, rows->row,
+						  rows->x + rows->radius - rows->columns,
+						  rows->right - rows->radius + rows->columns);
+			return 1;
+		}
+
+		int64_t distance = rows->row - rows->y;
+		distance = (distance < 0) ? -distance : distance;
+		if (rows->walk == SH_ELLIPSE)
+		{
+			rows->columns = (rows->spans != NULL) ?
+				rows->spans->columns[distance] :
+				draw_round_columns(rows->radius, rows->radius_y, distance,
+								   rows->columns, 1);
+			draw_rows_set(rows, rows->row, rows->x - rows->columns + 1,
+						  rows->x + rows->columns);
+			return 1;
+		}
+
+		/* ring, the same spans as draw_ring */
+		rows->columns = draw_circle_columns(rows->radius, distance,
+											rows->columns);
+		rows->inner_columns = (distance < rows->inner) ?
+			draw_circle_columns(rows->inner, distance, rows->inner_columns) :
+			0;
+		int64_t x1 = draw_circle_first_column(rows->x,
+											  rows->x - rows->columns + 1);
+		int64_t x2 = rows->x + rows->columns;
+		if (rows->inner_columns > 0)
+		{
+			rows->next_x1 = rows->x + rows->inner_columns;
+			rows->next_x2 = x2;
+			rows->part = 1;
+			x2 = rows->x - rows->inner_columns + 1;
+		}
+		draw_rows_set(rows, rows->row, x1, x2);
+		return 1;
+	}
+
+	if (rows->walk == SH_POLYGON)
+	{
+		/*
+		 * the next span of the row, or of the next row with spans, rows
+		 * without spans are only searched down to the bottom of the picture
+		 */
+		DrawPolygon *poly = &rows->polygon;
+		poly->span++;
+		while (poly->span >= poly->span_count)
+		{
+			if (poly->row + 1 >= rows->height ||
+				!draw_polygon_next_row(poly, 0))
+			{
+				return 0;
+			}
+			poly->span = 0;
+		}
+		draw_rows_set(rows, poly->row, poly->spans[2 * poly->span],
+					  poly->spans[2 * poly->span + 1]);
+		return 1;
+	}
+
+	if (rows->walk == SH_LINE)
+	{
+		if (rows->row + 1 > rows->line.bottom)
+		{
+			return 0;
+		}
+		rows->row++;
+		int64_t x1, x2;
+		draw_line_span(&rows->line, rows->row, &x1, &x2);
+		draw_rows_set(rows, rows->row, x1, x2);
+		return 1;
+	}
+
+	if (rows->walk == SH_RECTANGLE)
+	{
+		if (rows->row + 1 >= rows->end)
+		{
+			return 0;
+		}
+		rows->row++;
+		return 1;
+	}
+
+	if (rows->walk == SH_CIRCLE)
+	{
+		if (rows->row + 1 >= rows->end)
+		{
+			return 0;
+		}
+		rows->row++;
+
+		/* columns with a bar higher than the distance of the row */
+		int64_t distance = rows->row - rows->y;
+		distance = (distance < 0) ? -distance : distance;
+		rows->columns = draw_circle_columns(rows->radius, distance,
+											rows->columns);
+		int64_t x1 = draw_circle_first_column(rows->x,
+											  rows->x - rows->columns + 1);
+		draw_rows_set(rows, rows->row, x1, rows->x + rows->columns);
+		return 1;
+	}
+
+	/* triangle, the same steps as draw_triangle */
+	DrawTriangleEdges *edges = &rows->edges;
+	if (rows->part == 0)
+	{
+		draw_triangle_skip(edges, 0, &rows->sx, &rows->sy, &rows->ex);
+		if (rows->sy > edges->by)
+		{
+			rows->part = 1;
+			if (edges->restart)
+			{
+				rows->sx = edges->bx;
+				rows->sy = edges->by;
+			}
+			else
+			{
+				rows->ex = edges->bx;
+			}
+			draw_triangle_skip(edges, 1, &rows->sx, &rows->sy, &rows->ex);
+		}
+	}
+	if (rows->sy > (rows->part == 0 ? edges->by : edges->cy))
+	{
+		return 0;
+	}
+	int64_t x1 = (int64_t)rows->sx;
+	int64_t x2 = (int64_t)rows->ex;
+	if (x1 > x2)
+	{
+		int64_t tmp = x1;
+		x1 = x2;
+		x2 = tmp;
+	}
+	draw_rows_set(rows, (int64_t)rows->sy, x1, x2);
+	rows->sy++;
+	rows->sx += edges->step_sx[rows->part];
+	rows->ex += edges->step_ex[rows->part];
+	return 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes the pixels of the current span of a row iterator with a fill into
+/// its fill row, the span gets them instead of its color
+///
+/// @param rows  row iterator with a fill
+//
+static void draw_rows_fill(DrawRows *rows)
+{
+	if (rows->x1 < rows->x2)
+	{
+		draw_gradient_span(rows->fill, rows->row, rows->x1, rows->x2,
+						   rows->fill_row);
+	}
+	rows->pixels = rows->fill_row;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Gives a row iterator the fill of its command: prepares the gradient and
+/// allocates a row as wide as the box of the piece in the picture, which
+/// every span of the piece fits in, then fills the current span
+///
+/// @param rows   row iterator at the first span of the piece
+/// @param comm   command with a fill
+/// @param piece  piece walked
+///
+/// @return 1 on success, 0 if out of memory
+//
+static int draw_rows_fill_begin(DrawRows *rows, Command *comm, int piece)
+{
+	int64_t left, top, right, bottom;
+	draw_piece_bounding_box(comm, piece, &left, &top, &right, &bottom);
+	if (!draw_clip_box(rows->width, rows->height, &left, &top, &right,
+					   &bottom))
+	{
+		left = 0;
+		right = rows->width - 1;
+	}
+	if (draw_gradient_prepare(comm->fill) != DRAW_SUCCESS)
+	{
+		return 0;
+	}
+	rows->fill_row = malloc((right - left + 1) * BITMAP_RGB_COLOR_SIZE);
+	if (rows->fill_row == NULL)
+	{
+		return 0;
+	}
+	rows->fill = comm->fill;
+	draw_rows_fill(rows);
+	return 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Starts to walk a circle from the first row at first_row or below
+///
+/// @param rows       row iterator with picture size and color set
+/// @param x          center column
+/// @param y          center row
+/// @param radius     radius
+/// @param first_row  spans above this row are skipped
+///
+/// @return 1 if the circle has a span at first_row or below, 0 otherwise
+//
+static int draw_rows_begin_circle(DrawRows *rows, int64_t x, int64_t y,
+								  int64_t radius, int64_t first_row)
+{
+	/* rows y - radius + 1 to y + radius - 1 */
+	rows->walk = SH_CIRCLE;
+	rows->x = x;
+	rows->y = y;
+	rows->radius = radius;
+	rows->columns = 0;
+	rows->end = y + radius;
+	int64_t top = y - radius + 1;
+	rows->row = ((top < first_row) ? first_row : top) - 1;
+	return draw_rows_step(rows);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Starts to walk a line from the first row at first_row or below
+///
+/// @param rows       row iterator with picture size, color and the spans of
+///                   the line (rows->line) set
+/// @param first_row  spans above this row are skipped
+///
+/// @return 1 if the line has a span at first_row or below, 0 otherwise
+//
+static int draw_rows_begin_line(DrawRows *rows, int64_t first_row)
+{
+	rows->walk = SH_LINE;
+	int64_t top = rows->line.top;
+	rows->row = ((top < first_row) ? first_row : top) - 1;
+	return draw_rows_step(rows);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Starts to walk a piece of a shape (see draw_pieces) row by row from top to
+/// bottom. The spans are the pixels draw_command writes for the piece,
+/// clipped to the picture, the current span is from x1 to x2 (exclusive) of
+/// row and may be empty (x2 <= x1). A triangle can have two spans in the same
+/// row.
+///
+/// @param rows       receives the row iterator
+/// @param comm       command with a valid shape
+/// @param piece      piece of the shape, 0 for shapes of one piece
+/// @param width      width of the picture
+/// @param height     height of the picture
+/// @param first_row  spans above this row are skipped
+///
+/// @return 1 if the piece has a span in the picture at first_row or below,
+///         0 otherwise, -1 if out of memory
+//
+int draw_rows_begin(DrawRows *rows, Command *comm, int piece, uint32_t width,
+					uint32_t height, int64_t first_row)
+{
+	rows->shape = comm->shape;
+	rows->walk = comm->shape;
+	rows->polygon.edges = NULL;
+	rows->spans = NULL;
+	rows->source_columns = NULL;
+	rows->image_row = NULL;
+	rows->pixels = NULL;
+	rows->fill = NULL;
+	rows->fill_row = NULL;
+	rows->width = width;
+	rows->height = height;
+	int more = 1;
+
+	if (comm->shape == SH_RECTANGLE)
+	{
+		Rectangle *rect = comm->obj;
+		int64_t x2 = (int64_t)rect->x + rect->width;
+		int64_t y1 = (rect->y < 0) ? 0 : rect->y;
+		int64_t y2 = (int64_t)rect->y + rect->height;
+		rows->color = rect->color;
+		rows->end = y2;
+		y1 = (y1 < first_row) ? first_row : y1;
+		draw_rows_set(rows, y1, rect->x, x2);
+		more = rows->x1 < rows->x2 && y1 < y2;
+	}
+	else if (comm->shape == SH_CIRCLE)
+	{
+		Circle *circle = comm->obj;
+		rows->color = circle->color;
+		more = draw_rows_begin_circle(rows, circle->x, circle->y,
+									  circle->radius, first_row);
+	}
+	else if (comm->shape == SH_POINTS)
+	{
+		/* the disc of a point is a circle */
+		Points *points = comm->obj;
+		rows->color = (points->colors != NULL) ?
+			(points->colors[piece] & 0xffffff) : points->color;
+		more = draw_rows_begin_circle(rows, points->x[piece],
+									  points->y[piece], points->radius,
+									  first_row);
+	}
+	else if (comm->shape == SH_TRIANGLE)
+	{
+		Triangle *tri = comm->obj;
+		rows->color = tri->color;
+		draw_triangle_edges(tri, &rows->edges);
+		rows->sx = rows->edges.sx;
+		rows->sy = rows->edges.sy;
+		rows->ex = rows->edges.ex;
+		rows->part = 0;
+		do
+		{
+			more = draw_rows_step(rows);
+		} while (more && rows->row < first_row);
+	}
+	else if (comm->shape == SH_LINE)
+	{
+		Line *line = comm->obj;
+		rows->color = line->color;
+		more = draw_line_setup(&rows->line, line->x1, line->y1, line->x2,
+							   line->y2, line->width) &&
+			draw_rows_begin_line(rows, first_row);
+	}
+	else if (comm->shape == SH_ELLIPSE || comm->shape == SH_RING)
+	{
+		/* rows y - ry + 1 to y + ry - 1 (outer radius for rings) */
+		int64_t y, reach;
+		if (comm->shape == SH_ELLIPSE)
+		{
+			Ellipse *ellipse = comm->obj;
+			rows->color = ellipse->color;
+			rows->x = ellipse->x;
+			y = ellipse->y;
+			rows->radius = ellipse->rx;
+			rows->radius_y = ellipse->ry;
+			rows->spans = draw_ellipse_spans(ellipse->rx, ellipse->ry);
+			reach = (ellipse->rx < 1) ? 0 : ellipse->ry;
+		}
+		else
+		{
+			Ring *ring = comm->obj;
+			rows->color = ring->color;
+			rows->x = ring->x;
+			y = ring->y;
+			rows->radius = ring->outer;
+			rows->inner = ring->inner;
+			rows->inner_columns = 0;
+			rows->part = 0;
+			reach = ring->outer;
+		}
+		rows->y = y;
+		rows->columns = 0;
+		rows->end = y + reach;
+		int64_t top = y - reach + 1;
+		rows->row = ((top < first_row) ? first_row : top) - 1;
+		more = draw_rows_step(rows);
+	}
+	else if (comm->shape == SH_ROUNDRECT)
+	{
+		RoundRect *rect = comm->obj;
+		int64_t radius = draw_roundrect_radius(rect);
+		int64_t top = rect->y;
+		rows->color = rect->color;
+		rows->x = rect->x;
+		rows->right = (int64_t)rect->x + rect->width;
+		rows->radius = radius;
+		rows->y = top + radius - 1;
+		rows->bottom = (int64_t)rect->y + rect->height - radius;
+		rows->columns = 0;
+		rows->end = (rect->width < 1) ? top : top + rect->height;
+		rows->row = ((top < first_row) ? first_row : top) - 1;
+		more = draw_rows_step(rows);
+	}
+	else if (comm->shape == SH_USE)
+	{
+		/* the runs of the mask from the row at first_row on */
+		Use *use = comm->obj;
+		if (use->def == NULL)
+		{
+			return 0;
+		}
+		if (draw_symbol_prepare(use->def) != DRAW_SUCCESS)
+		{
+			return -1;
+		}
+		const DrawSymbolMask *mask = use->def->mask;
+		int64_t skip = first_row - ((int64_t)use->y + mask->top);
+		rows->mask = mask;
+		rows->x = use->x;
+		rows->y = use->y;
+		rows->mask_row = (skip < 0) ? 0 : (skip > mask->rows) ? mask->rows :
+			skip;
+		rows->run = (int64_t)mask->first[rows->mask_row] - 1;
+		more = draw_rows_step(rows);
+	}
+	else if (comm->shape == SH_GRID)
+	{
+		/* the visible cells of the rows from first_row on */
+		Grid *grid = comm->obj;
+		rows->grid = grid;
+		rows->x = grid->x;
+		rows->y = grid->y;
+		more = grid->cells != NULL && grid->cell_width > 0 &&
+			grid->cell_height > 0 && grid->columns > 0 && grid->rows > 0;
+		if (more)
+		{
+			int64_t end = grid->y + (int64_t)grid->rows * grid->cell_height;
+			int64_t top = (grid->y < 0) ? 0 : grid->y;
+			top = (top < first_row) ? first_row : top;
+			rows->end = (end > height) ? height : end;
+			draw_grid_visible(grid->x, grid->cell_width, grid->columns, width,
+							  &rows->first_column, &rows->last_column);
+			rows->row = top;
+			rows->column = rows->first_column;
+			more = top < rows->end && rows->first_column <= rows->last_column &&
+				draw_rows_step(rows);
+		}
+	}
+	else if (comm->shape == SH_IMAGE)
+	{
+		/* the visible columns of the rows from first_row on */
+		Image *image = comm->obj;
+		int64_t end = (int64_t)image->y + image->height;
+		int64_t top = (image->y < 0) ? 0 : image->y;
+		top = (top < first_row) ? first_row : top;
+		rows->image = image;
+		rows->x = image->x;
+		rows->y = image->y;
+		rows->end = (end > height) ? height : end;
+		draw_rows_set(rows, top - 1, image->x,
+					  (int64_t)image->x + image->width);
+		more = image->bitmap.map != NULL && rows->x1 < rows->x2 &&
+			top < rows->end;
+		if (more && !draw_image_direct(image))
+		{
+			/* rows of the picture are gathered from the file */
+			int64_t n = rows->x2 - rows->x1;
+			rows->source_columns = malloc((sizeof(uint32_t) +
+										   BITMAP_RGB_COLOR_SIZE) * n);
+			if (rows->source_columns == NULL)
+			{
+				return -1;
+			}
+			rows->image_row = (uint8_t *)(rows->source_columns + n);
+			rows->pixels = rows->image_row;
+			rows->source_row = -1;
+			draw_image_columns(image, rows->x1, rows->x2,
+							   rows->source_columns);
+		}
+		more = more && draw_rows_step(rows);
+	}
+	else if (comm->shape == SH_TEXT)
+	{
+		/* the runs of the visible glyphs of the rows from first_row on */
+		Text *text = comm->obj;
+		int64_t end = (int64_t)text->y + (int64_t)FONT_HEIGHT * text->scale;
+		int64_t top = (text->y < 0) ? 0 : text->y;
+		top = (top < first_row) ? first_row : top;
+		rows->color = text->color;
+		rows->text = text;
+		rows->x = text->x;
+		rows->y = text->y;
+		rows->end = (end > height) ? height : end;
+		more = text->scale > 0 && top < rows->end;
+		if (more)
+		{
+			const DrawGlyphAtlas *atlas = draw_glyph_atlas();
+			draw_text_visible(text, strlen(text->text), width,
+							  &rows->first_column, &rows->last_column);
+			more = rows->first_column <= rows->last_column;
+			if (more)
+			{
+				unsigned char c = text->text[rows->first_column];
+				rows->row = top;
+				rows->glyph = rows->first_column;
+				rows->run = (int64_t)atlas->first[atlas->glyphs[c] *
+					FONT_HEIGHT + (top - text->y) / text->scale] - 1;
+				more = draw_rows_step(rows);
+			}
+		}
+	}
+	else if (comm->shape == SH_SYMBOL || comm->shape == SH_GRADIENT)
+	{
+		/* drawn by its uses, by the shapes it fills */
+		more = 0;
+	}
+	else if (comm->shape == SH_POLYGON)
+	{
+		/* the first row at first_row or below, then its first span */
+		Polygon *polygon = comm->obj;
+		rows->color = polygon->color;
+		if (!draw_polygon_setup(&rows->polygon, polygon))
+		{
+			return -1;
+		}
+		more = draw_polygon_next_row(&rows->polygon, first_row);
+		rows->polygon.span = -1;
+		more = more && draw_rows_step(rows);
+	}
+	else
+	{
+		/* the lines first, then the joins */
+		Polyline *polyline = comm->obj;
+		const int *xy = polyline->points.xy;
+		int segments = polyline->points.count - 1;
+		rows->color = polyline->color;
+		if (piece < segments)
+		{
+			xy += 2 * piece;
+			more = draw_line_setup(&rows->line, xy[0], xy[1], xy[2], xy[3],
+								   polyline->width) &&
+				draw_rows_begin_line(rows, first_row);
+		}
+		else
+		{
+			xy += 2 * (piece - segments + 1);
+			more = draw_rows_begin_circle(rows, xy[0], xy[1],
+										  draw_join_radius(polyline->width),
+										  first_row);
+		}
+	}
+	if (!more || rows->row >= rows->height)
+	{
+		draw_rows_end(rows);
+		return 0;
+	}
+	if (comm->fill != NULL && !draw_rows_fill_begin(rows, comm, piece))
+	{
+		draw_rows_end(rows);
+		return -1;
+	}
+	return 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Moves a row iterator to the next span, the rows of the spans never
+/// decrease
+///
+/// @param rows  row iterator from draw_rows_begin
+///
+/// @return 1 if there is a next span in the picture, 0 otherwise
+//
+int draw_rows_next(DrawRows *rows)
+{
+	if (!draw_rows_step(rows) || rows->row >= rows->height)
+	{
+		return 0;
+	}
+	if (rows->fill != NULL)
+	{
+		draw_rows_fill(rows);
+	}
+	return 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Frees what a row iterator allocated (the edges of a polygon, the row of
+/// an image or a fill) and releases the spans of an ellipse, has to be
+/// called when the iterator is not used anymore, unless draw_rows_begin
+/// returned 0 or -1
+///
+/// @param rows  row iterator from draw_rows_begin
+//
+void draw_rows_end(DrawRows *rows)
+{
+	draw_polygon_free(&rows->polygon);
+	draw_ellipse_spans_release(rows->spans);
+	rows->spans = NULL;
+	free(rows->source_columns);
+	rows->source_columns = NULL;
+	rows->image_row = NULL;
+	free(rows->fill_row);
+	rows->fill_row = NULL;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Rasterizes the shapes of a symbol once into its mask (see DrawSymbolMask),
+/// the uses of the symbol then only copy the runs of the mask. The shapes are
+/// walked with their row iterators as in a picture of the size of the
+/// symbol, each row is written into a line in drawing order and cut into
+/// runs of one color, touching runs are joined to segments that a use copies
+/// with one memcpy. A symbol that has its mask already is left as it is.
+///
+/// @param symbol  symbol with its shapes
+///
+/// @return DRAW_SUCCESS on success, DRAW_ERR_OUT_OF_MEM otherwise
+//
+int draw_symbol_prepare(Symbol *symbol)
+{
+	if (symbol->mask != NULL)
+	{
+		return DRAW_SUCCESS;
+	}
+
+	/* the box of the pieces in the symbol, only it is walked */
+	List *shapes = symbol->shapes;
+	int length = (shapes != NULL) ? shapes->length : 0;
+	uint32_t width = (symbol->width > 0) ? symbol->width : 0;
+	uint32_t height = (symbol->height > 0) ? symbol->height : 0;
+	int64_t left = width;
+	int64_t top = height;
+	int64_t right = -1;
+	int64_t bottom = -1;
+	size_t count = 0;
+	for (int i = 0; i < length; i++)
+	{
+		Command *comm = list_get(shapes, i);
+		for (int piece = 0; piece < draw_pieces(comm); piece++)
+		{
+			int64_t l, t, r, b;
+			draw_piece_bounding_box(comm, piece, &l, &t, &r, &b);
+			if (draw_clip_box(width, height, &l, &t, &r, &b))
+			{
+				left = (l < left) ? l : left;
+				top = (t < top) ? t : top;
+				right = (r > right) ? r : right;
+				bottom = (b > bottom) ? b : bottom;
+			}
+		}
+		count += draw_pieces(comm);
+	}
+	int64_t rows = (bottom >= top) ? bottom - top + 1 : 0;
+	int64_t columns = (right >= left) ? right - left + 1 : 0;
+	top = (rows > 0) ? top : 0;
+
+	int ret = DRAW_ERR_OUT_OF_MEM;
+	int active = 0;
+	size_t run_count = 0;
+	size_t capacity = 0;
+	DrawSymbolRun *runs = NULL;
+	DrawRows *walks = malloc(sizeof(DrawRows) * count + 1);
+	uint32_t *line = malloc(sizeof(uint32_t) * columns + 1);
+	uint32_t *first = malloc(sizeof(uint32_t) * (rows + 1));
+	if (walks == NULL || line == NULL || first == NULL)
+	{
+		goto draw_symbol_prepare_cleanup1;
+	}
+	for (int i = 0; i < length; i++)
+	{
+		Command *comm = list_get(shapes, i);
+		for (int piece = 0; piece < draw_pieces(comm); piece++)
+		{
+			int begun = draw_rows_begin(&walks[active], comm, piece, width,
+										height, top);
+			if (begun < 0)
+			{
+				goto draw_symbol_prepare_cleanup1;
+			}
+			active += begun;
+		}
+	}
+
+	for (int64_t r = 0; r < rows; r++)
+	{
+		/* the spans of the row in drawing order, later ones on top */
+		memset(line, 0, sizeof(uint32_t) * columns);
+		for (int i = 0; i < active; i++)
+		{
+			DrawRows *walk = &walks[i];
+			int more = 1;
+			while (more && walk->row == top + r)
+			{
+				int64_t x1 = (walk->x1 < left) ? left : walk->x1;
+				int64_t x2 = (walk->x2 > right + 1) ? right + 1 : walk->x2;
+				uint32_t value = (walk->color & 0xffffff) |
+					DRAW_SYMBOL_COVERED;
+				const uint8_t *pixel = (walk->pixels == NULL) ? NULL :
+					walk->pixels + (x1 - walk->x1) * BITMAP_RGB_COLOR_SIZE;
+				for (int64_t x = x1; x < x2; x++)
+				{
+					if (pixel != NULL)
+					{
+						/* an image has a color per pixel */
+						value = pixel[0] | (pixel[1] << 8) |
+							((uint32_t)pixel[2] << 16) | DRAW_SYMBOL_COVERED;
+						pixel += BITMAP_RGB_COLOR_SIZE;
+					}
+					line[x - left] = value;
+				}
+				more = draw_rows_next(walk);
+			}
+			if (!more)
+			{
+				draw_rows_end(walk);
+				memmove(walk, walk + 1, sizeof(DrawRows) * (active - i - 1));
+				active--;
+				i--;
+			}
+		}
+
+		/* runs of the written columns of one color */
+		first[r] = run_count;
+		for (int64_t x = 0; x < columns;)
+		{
+			int64_t start = x;
+			uint32_t value = line[x];
+			while (x < columns && line[x] == value)
+			{
+				x++;
+			}
+			if (!(value & DRAW_SYMBOL_COVERED))
+			{
+				continue;
+			}
+			if (run_count == capacity)
+			{
+				capacity = (capacity == 0) ? DRAW_SYMBOL_RUNS : 2 * capacity;
+				DrawSymbolRun *tmp = (capacity <= UINT32_MAX) ?
+					realloc(runs, sizeof(DrawSymbolRun) * capacity) : NULL;
+				if (tmp == NULL)
+				{
+					goto draw_symbol_prepare_cleanup1;
+				}
+				runs = tmp;
+			}
+			runs[run_count].x1 = left + start;
+			runs[run_count].x2 = left + x;
+			runs[run_count].color = value & 0xffffff;
+			run_count++;
+		}
+	}
+	first[rows] = run_count;
+
+	/* a run starts a segment unless it touches the run before in its row */
+	size_t segment_count = 0;
+	uint64_t pixels = 0;
+	for (int64_t r = 0; r < rows; r++)
+	{
+		for (uint32_t i = first[r]; i < first[r + 1]; i++)
+		{
+			segment_count += (i == first[r] || runs[i - 1].x2 != runs[i].x1);
+			pixels += runs[i].x2 - runs[i].x1;
+		}
+	}
+	if (pixels > UINT32_MAX)
+	{
+		goto draw_symbol_prepare_cleanup1;
+	}
+
+	/* the mask in one allocation, freed with the symbol */
+	DrawSymbolMask *mask = malloc(sizeof(DrawSymbolMask) +
+								  sizeof(uint32_t) * (rows + 1) * 2 +
+								  sizeof(DrawSymbolRun) * run_count +
+								  sizeof(DrawSymbolSegment) * segment_count +
+								  BITMAP_RGB_COLOR_SIZE * pixels);
+	if (mask == NULL)
+	{
+		goto draw_symbol_prepare_cleanup1;
+	}
+	mask->top = top;
+	mask->rows = rows;
+	mask->pixels = pixels;
+	mask->first = (uint32_t *)(mask + 1);
+	mask->runs = (DrawSymbolRun *)(mask->first + rows + 1);
+	mask->first_segment = (uint32_t *)(mask->runs + run_count);
+	mask->segments = (DrawSymbolSegment *)(mask->first_segment + rows + 1);
+	mask->pixel_data = (uint8_t *)(mask->segments + segment_count);
+	memcpy(mask->first, first, sizeof(uint32_t) * (rows + 1));
+	if (run_count > 0)
+	{
+		memcpy(mask->runs, runs, sizeof(DrawSymbolRun) * run_count);
+	}
+
+	uint32_t offset = 0;
+	segment_count = 0;
+	for (int64_t r = 0; r < rows; r++)
+	{
+		mask->first_segment[r] = segment_count;
+		for (uint32_t i = first[r]; i < first[r + 1]; i++)
+		{
+			if (i == first[r] || runs[i - 1].x2 != runs[i].x1)
+			{
+				mask->segments[segment_count].x1 = runs[i].x1;
+				mask->segments[segment_count].offset = offset;
+				segment_count++;
+			}
+			mask->segments[segment_count - 1].x2 = runs[i].x2;
+			for (int32_t x = runs[i].x1; x < runs[i].x2; x++)
+			{
+				uint8_t *pixel = mask->pixel_data +
+					(size_t)offset * BITMAP_RGB_COLOR_SIZE;
+				pixel[0] = runs[i].color & 0xff; /* blue */
+				pixel[1] = (runs[i].color & 0xff00) >> 8; /* green */
+				pixel[2] = (runs[i].color & 0xff0000) >> 16; /* red */
+				offset++;
+			}
+		}
+	}
+	mask->first_segment[rows] = segment_count;
+	symbol->mask = mask;
+	ret = DRAW_SUCCESS;
+
+draw_symbol_prepare_cleanup1:
+	for (int i = 0; i < active; i++)
+	{
+		draw_rows_end(&walks[i]);
+	}
+	free(walks);
+	free(line);
+	free(first);
+	free(runs);
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws the given use of a symbol to the pixel buffer: the segments of the
+/// mask of the symbol, moved to the origin of the use, each copied from the
+/// pixel data of the mask. The mask has to be made by
+/// draw_symbol_prepare before.
+/// Be careful, a correct pix_buffer and use must be passed, no checks
+/// are performed!
+///
+/// @param pix_buffer pixel buffer struct where the symbol will be drawn into
+/// @param use        Use struct that shall be drawn
+/// @param clip       1 to clip, 0 if the symbol is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_use(PixelBuffer *pix_buffer, const Use *use, const int clip)
+{
+	const DrawSymbolMask *mask = use->def->mask;
+	DrawTarget target;
+	draw_target_init(&target, pix_buffer, 0);
+	int64_t x = use->x;
+	int64_t top = (int64_t)use->y + mask->top;
+	int64_t first = 0;
+	int64_t last = mask->rows;
+	uint64_t pixels = 0;
+
+	if (clip)
+	{
+		first = (top < 0) ? -top : 0;
+		last = (target.height - top < last) ? target.height - top : last;
+	}
+	for (int64_t r = first; r < last; r++)
+	{
+		/* bitmap is upside down, therefore swap row */
+		char *row = target.data + (size_t)(target.height - 1 - (top + r)) *
+			target.row_size;
+		for (uint32_t i = mask->first_segment[r];
+			 i < mask->first_segment[r + 1]; i++)
+		{
+			const DrawSymbolSegment *segment = &mask->segments[i];
+			int64_t x1 = x + segment->x1;
+			int64_t x2 = x + segment->x2;
+			const uint8_t *src = mask->pixel_data +
+				(size_t)segment->offset * BITMAP_RGB_COLOR_SIZE;
+			if (clip)
+			{
+				src += (x1 < 0) ? -x1 * BITMAP_RGB_COLOR_SIZE : 0;
+				x1 = (x1 < 0) ? 0 : x1;
+				x2 = (x2 > target.width) ? target.width : x2;
+				if (x1 >= x2)
+				{
+					continue;
+				}
+			}
+			memcpy(row + x1 * BITMAP_RGB_COLOR_SIZE, src,
+				   (x2 - x1) * BITMAP_RGB_COLOR_SIZE);
+			pixels += x2 - x1;
+		}
+	}
+	return pixels;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws the points of a band of rows (see draw_points): each point whose
+/// disc reaches the band is stamped with the columns of the disc rows, the
+/// same rows as a circle of the radius at the point. Rows farther from the
+/// center than the table reaches (only discs centered outside the picture
+/// have them) get their columns like the rows of a circle. Discs reaching
+/// out of the picture left or right are clipped like circles, the rows are
+/// always clipped to the band.
+///
+/// @param arg  the DrawPointsBand, its pixels receive the pixels written
+///
+/// @return NULL
+//
+static void *draw_points_band(void *arg)
+{
+	DrawPointsBand *band = arg;
+	const Points *points = band->points;
+	const int32_t *columns = band->columns;
+	DrawTarget target;
+	draw_target_init(&target, band->pix_buffer, points->color);
+	int64_t radius = points->radius;
+	uint64_t pixels = 0;
+
+	for (int i = 0; i < points->count; i++)
+	{
+		/* rows y - radius + 1 to y + radius - 1 */
+		int64_t y = points->y[i];
+		if (y + radius <= band->top || y - radius >= band->bottom)
+		{
+			continue;
+		}
+		int64_t first = y - radius + 1;
+		int64_t last = y + radius - 1;
+		first = (first < band->top) ? band->top : first;
+		last = (last >= band->bottom) ? band->bottom - 1 : last;
+
+		int color = (points->colors != NULL) ?
+			points->colors[i] & 0xffffff : points->color;
+		if (color != target.color)
+		{
+			draw_target_color(&target, color);
+		}
+		int64_t x = points->x[i];
+		int clip = band->clip &&
+			(x - radius < 0 || x + radius >= target.width);
+		int64_t c = 0;
+		for (int64_t row = first; row <= last; row++)
+		{
+			int64_t distance = (row < y) ? y - row : row - y;
+			c = (distance < band->distances) ? columns[distance] :
+				draw_circle_columns(radius, distance, c);
+			int64_t x1 = x - c + 1;
+			int64_t x2 = x + c;
+			if (clip)
+			{
+				x1 = draw_circle_first_column(x, x1);
+				x2 = (x2 > target.width) ? target.width : x2;
+			}
+			pixels += draw_run(&target, row, x1, x2, 0);
+		}
+	}
+	band->pixels = pixels;
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws points (see Points) to the pixel buffer as discs of one radius,
+/// each with the pixels of a circle at the point. The columns of the disc
+/// rows are calculated once and stamped at every point. With many points
+/// the rows of the picture are split into bands drawn by threads at the
+/// same time (see draw_set_threads), a band scans all points and only
+/// draws the discs reaching it, so the pixels of each row are written in
+/// the order of the points like drawing them one after the other.
+///
+/// @param pix_buffer  pixel buffer the points will be drawn into
+/// @param points      points with their file mapped
+/// @param clip        1 to clip, 0 if all discs are inside the picture
+///
+/// @return number of pixels written, DRAW_KERNEL_OUT_OF_MEM if out of memory
+//
+DRAW_KERNEL draw_points(PixelBuffer *pix_buffer, const Points *points,
+						const int clip)
+{
+	if (points->count == 0 || points->radius < 1)
+	{
+		return 0;
+	}
+
+	/*
+	 * rows of the discs in the picture and their distances from a center,
+	 * the table has the distances up to the height of the picture (all a
+	 * disc centered in the picture has there), a disc centered farther out
+	 * calculates its rows in the picture
+	 */
+	int64_t height = pix_buffer->height;
+	int64_t radius = points->radius;
+	int64_t top = (points->top < 0) ? 0 : points->top;
+	int64_t bottom = (points->bottom >= height) ? height : points->bottom + 1;
+	int64_t min_y = points->top + radius;
+	int64_t max_y = points->bottom - radius;
+	int64_t distances = (max_y > height - 1 - min_y) ? max_y :
+		height - 1 - min_y;
+	distances = (distances + 1 < radius) ? distances + 1 : radius;
+	distances = (distances > height) ? height : distances;
+
+	/* the disc: its columns (from the center) by distance of the row */
+	int32_t *columns = malloc(sizeof(int32_t) * distances);
+	if (columns == NULL)
+	{
+		return DRAW_KERNEL_OUT_OF_MEM;
+	}
+	int64_t c = 0;
+	for (int64_t distance = distances - 1; distance >= 0; distance--)
+	{
+		c = draw_circle_columns(radius, distance, c);
+		columns[distance] = c;
+	}
+
+	int threads = draw_threads;
+	if (threads <= 0)
+	{
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (online > 0) ? online : 1;
+	}
+	threads = (threads > DRAW_MAX_THREADS) ? DRAW_MAX_THREADS : threads;
+	if (points->count < DRAW_POINTS_PARALLEL)
+	{
+		threads = 1;
+	}
+	if ((bottom - top) / DRAW_POINTS_BAND_ROWS < threads)
+	{
+		threads = (bottom - top) / DRAW_POINTS_BAND_ROWS;
+		threads = (threads < 1) ? 1 : threads;
+	}
+
+	/* the span kernel is selected before threads use it */
+	span_selected();
+	DrawPointsBand bands[DRAW_MAX_THREADS];
+	pthread_t ids[DRAW_MAX_THREADS];
+	int started[DRAW_MAX_THREADS];
+	for (int b = 0; b < threads; b++)
+	{
+		bands[b].pix_buffer = pix_buffer;
+		bands[b].points = points;
+		bands[b].columns = columns;
+		bands[b].distances = distances;
+		bands[b].top = top + (bottom - top) * b / threads;
+		bands[b].bottom = top + (bottom - top) * (b + 1) / threads;
+		bands[b].clip = clip;
+		bands[b].pixels = 0;
+	}
+
+	/* band 0 is drawn here, a band whose thread can't start too */
+	for (int b = 1; b < threads; b++)
+	{
+		started[b] = pthread_create(&ids[b], NULL, draw_points_band,
+									&bands[b]) == 0;
+	}
+	draw_points_band(&bands[0]);
+	uint64_t pixels = bands[0].pixels;
+	for (int b = 1; b < threads; b++)
+	{
+		if (started[b])
+		{
+			pthread_join(ids[b], NULL);
+		}
+		else
+		{
+			draw_points_band(&bands[b]);
+		}
+		pixels += bands[b].pixels;
+	}
+	free(columns);
+	return pixels;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws a grid (see Grid) to the pixel buffer. The cells of a row of cells
+/// are drawn into the first pixel row they cover as spans, neighbouring
+/// cells of the same color as one span, the other pixel rows of the cells
+/// are copies of it. So a row of cells costs one pass over its colors and
+/// a copy per further pixel row, no matter how small the cells are.
+///
+/// @param pix_buffer  pixel buffer the grid will be drawn into
+/// @param grid        grid with its file mapped
+/// @param clip        1 to clip, 0 if the grid is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_grid(PixelBuffer *pix_buffer, const Grid *grid,
+					  const int clip)
+{
+	int64_t width = pix_buffer->width;
+	int64_t height = pix_buffer->height;
+	size_t row_size = bitmap_pixel_array_row_size(pix_buffer->width);
+	int64_t x = grid->x;
+	int64_t y = grid->y;
+	int64_t cell_width = grid->cell_width;
+	int64_t cell_height = grid->cell_height;
+	int64_t first_column = 0;
+	int64_t last_column = grid->columns - 1;
+	int64_t first_row = 0;
+	int64_t last_row = grid->rows - 1;
+	if (clip)
+	{
+		draw_grid_visible(x, cell_width, grid->columns, width, &first_column,
+						  &last_column);
+		draw_grid_visible(y, cell_height, grid->rows, height, &first_row,
+						  &last_row);
+	}
+	if (grid->cells == NULL || first_column > last_column)
+	{
+		return 0;
+	}
+
+	/* the columns the visible cells cover */
+	int64_t left = x + first_column * cell_width;
+	int64_t right = x + (last_column + 1) * cell_width;
+	left = (clip && left < 0) ? 0 : left;
+	right = (clip && right > width) ? width : right;
+	size_t bytes = (right - left) * BITMAP_RGB_COLOR_SIZE;
+
+	uint64_t pixels = 0;
+	for (int64_t r = first_row; r <= last_row; r++)
+	{
+		int64_t top = y + r * cell_height;
+		int64_t bottom = top + cell_height;
+		top = (clip && top < 0) ? 0 : top;
+		bottom = (clip && bottom > height) ? height : bottom;
+
+		/* bitmap is upside down, therefore swap row */
+		uint8_t *first = (uint8_t *)pix_buffer->data +
+			(size_t)(height - 1 - top) * row_size;
+		const uint32_t *cells = grid->cells + (size_t)r * grid->columns;
+		for (int64_t c = first_column; c <= last_column;)
+		{
+			int color = cells[c] & 0xffffff;
+			int64_t end = c + 1;
+			while (end <= last_column && (int)(cells[end] & 0xffffff) == color)
+			{
+				end++;
+			}
+			int64_t x1 = x + c * cell_width;
+			int64_t x2 = x + end * cell_width;
+			x1 = (x1 < left) ? left : x1;
+			x2 = (x2 > right) ? right : x2;
+			draw_fill(first + x1 * BITMAP_RGB_COLOR_SIZE, color, x2 - x1);
+			c = end;
+		}
+		for (int64_t row = top + 1; row < bottom; row++)
+		{
+			memcpy((uint8_t *)pix_buffer->data +
+				   (size_t)(height - 1 - row) * row_size +
+				   left * BITMAP_RGB_COLOR_SIZE,
+				   first + left * BITMAP_RGB_COLOR_SIZE, bytes);
+		}
+		pixels += (uint64_t)(right - left) * (bottom - top);
+	}
+	return pixels;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws an image (see Image) to the pixel buffer. Rows of 24 bit files that
+/// are not scaled horizontally are copied with memcpy straight from the
+/// mapping, other rows are gathered by a table of the columns of the file
+/// (see draw_image_columns). A row of the picture showing the same row of
+/// the file as the row above (scaled up vertically) is a copy of that row.
+///
+/// @param pix_buffer  pixel buffer the image will be drawn into
+/// @param image       image with its file mapped
+/// @param clip        1 to clip, 0 if the image is inside the picture
+///
+/// @return number of pixels written, DRAW_KERNEL_OUT_OF_MEM if out of memory
+//
+DRAW_KERNEL draw_image(PixelBuffer *pix_buffer, const Image *image,
+					   const int clip)
+{
+	const BitmapImage *bitmap = &image->bitmap;
+	int64_t height = pix_buffer->height;
+	size_t row_size = bitmap_pixel_array_row_size(pix_buffer->width);
+	int64_t left = image->x;
+	int64_t top = image->y;
+	int64_t right = left + image->width;
+	int64_t bottom = top + image->height;
+	if (clip)
+	{
+		left = (left < 0) ? 0 : left;
+		top = (top < 0) ? 0 : top;
+		right = (right > pix_buffer->width) ? pix_buffer->width : right;
+		bottom = (bottom > height) ? height : bottom;
+	}
+	if (bitmap->map == NULL || left >= right || top >= bottom)
+	{
+		return 0;
+	}
+
+	uint32_t *columns = NULL;
+	if (!draw_image_direct(image))
+	{
+		columns = malloc(sizeof(uint32_t) * (right - left));
+		if (columns == NULL)
+		{
+			return DRAW_KERNEL_OUT_OF_MEM;
+		}
+		draw_image_columns(image, left, right, columns);
+	}
+
+	size_t bytes = (right - left) * BITMAP_RGB_COLOR_SIZE;
+	int64_t previous = -1;
+	const uint8_t *previous_pixel = NULL;
+	for (int64_t row = top; row < bottom; row++)
+	{
+		/* bitmap is upside down, therefore swap row */
+		uint8_t *pixel = (uint8_t *)pix_buffer->data +
+			(size_t)(height - 1 - row) * row_size +
+			left * BITMAP_RGB_COLOR_SIZE;
+		int64_t source_row = (row - image->y) * bitmap->height /
+			image->height;
+		const uint8_t *source = bitmap->top + source_row * bitmap->stride;
+		if (source_row == previous)
+		{
+			memcpy(pixel, previous_pixel, bytes);
+		}
+		else if (columns == NULL)
+		{
+			memcpy(pixel, source + (left - image->x) * BITMAP_RGB_COLOR_SIZE,
+				   bytes);
+		}
+		else
+		{
+			draw_image_gather(pixel, source, columns, right - left,
+							  bitmap->bytes_per_pixel);
+		}
+		previous = source_row;
+		previous_pixel = pixel;
+	}
+	free(columns);
+	return (uint64_t)(right - left) * (bottom - top);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes a glyph row of scale 1 with the masks of the glyph atlas: the
+/// bytes of its pixels get the color, the others keep theirs. Two
+/// overlapping words instead of a span per run, so the tiny runs of small
+/// labels cost no branches.
+///
+/// @param pixel    first pixel of the glyph row, all FONT_WIDTH pixels are in
+///                 the picture
+/// @param mask     masks of the row, see DrawGlyphAtlas
+/// @param pattern  the color in the bytes of the masks
+//
+static inline void draw_glyph_row(uint8_t *pixel, const uint64_t mask[2],
+								  const uint64_t pattern[2])
+{
+	/* both are read first, the byte they share gets the same value */
+	uint64_t words[2];
+	memcpy(&words[0], pixel, 8);
+	memcpy(&words[1], pixel + DRAW_GLYPH_BYTES - 8, 8);
+	words[0] = (words[0] & ~mask[0]) | (pattern[0] & mask[0]);
+	words[1] = (words[1] & ~mask[1]) | (pattern[1] & mask[1]);
+	memcpy(pixel, &words[0], 8);
+	memcpy(pixel + DRAW_GLYPH_BYTES - 8, &words[1], 8);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws a text (see Text) to the pixel buffer, a picture row at a time: the
+/// runs of the glyph rows from the glyph atlas (see draw_glyph_atlas),
+/// scaled and moved to the cell of each glyph, are drawn as spans, glyph
+/// rows of scale 1 inside the picture with their masks (see draw_glyph_row).
+/// Glyphs left or right of the picture are skipped when clipping.
+///
+/// @param pix_buffer  pixel buffer the text will be drawn into
+/// @param text        text
+/// @param clip        1 to clip, 0 if the text is inside the picture
+///
+/// @return number of pixels written
+//
+DRAW_KERNEL draw_text(PixelBuffer *pix_buffer, const Text *text,
+					  const int clip)
+{
+	const DrawGlyphAtlas *atlas = draw_glyph_atlas();
+	const unsigned char *chars = (const unsigned char *)text->text;
+	int64_t length = strlen(text->text);
+	int64_t scale = text->scale;
+	int64_t advance = FONT_ADVANCE * scale;
+	int64_t top = text->y;
+	int64_t bottom = top + FONT_HEIGHT * scale;
+	int64_t first = 0;
+	int64_t last = length - 1;
+	if (scale < 1)
+	{
+		return 0;
+	}
+	DrawTarget target;
+	draw_target_init(&target, pix_buffer, text->color);
+	if (clip)
+	{
+		top = (top < 0) ? 0 : top;
+		bottom = (bottom > target.height) ? target.height : bottom;
+		draw_text_visible(text, length, target.width, &first, &last);
+	}
+	uint8_t bytes[DRAW_GLYPH_BYTES];
+	uint64_t pattern[2];
+	draw_fill(bytes, text->color, FONT_WIDTH);
+	memcpy(&pattern[0], bytes, 8);
+	memcpy(&pattern[1], bytes + DRAW_GLYPH_BYTES - 8, 8);
+
+	uint64_t pixels = 0;
+	for (int64_t row = top; row < bottom; row++)
+	{
+		/* bitmap is upside down, therefore swap row */
+		uint8_t *line = (uint8_t *)target.data +
+			(size_t)(target.height - 1 - row) * target.row_size;
+		int64_t r = (row - text->y) / scale;
+		int64_t left = text->x + first * advance;
+		for (int64_t i = first; i <= last; i++, left += advance)
+		{
+			int key = atlas->glyphs[chars[i]] * FONT_HEIGHT + r;
+			if (scale == 1 && (!clip || (left >= 0 &&
+										 left + FONT_WIDTH <= target.width)))
+			{
+				draw_glyph_row(line + left * BITMAP_RGB_COLOR_SIZE,
+							   atlas->masks[key], pattern);
+				pixels += atlas->pixels[key];
+				continue;
+			}
+			for (int k = atlas->first[key]; k < atlas->first[key + 1]; k++)
+			{
+				const DrawGlyphRun *run = &atlas->runs[k];
+				pixels += draw_run(&target, row, left + run->x1 * scale,
+								   left + run->x2 * scale, clip);
+			}
+		}
+	}
+	return pixels;
+}
+
+/* clipping and not clipping instance of a kernel */
+#define DRAW_KERNEL_VARIANTS(kernel, type) \
+	static uint64_t kernel##_clip(PixelBuffer *pix_buffer, const void *obj) \
+	{ \
+		return kernel(pix_buffer, (const type *)obj, 1); \
+	} \
+	static uint64_t kernel##_noclip(PixelBuffer *pix_buffer, const void *obj) \
+	{ \
+		return kernel(pix_buffer, (const type *)obj, 0); \
+	}
+
+DRAW_KERNEL_VARIANTS(draw_rectangle, Rectangle)
+DRAW_KERNEL_VARIANTS(draw_circle, Circle)
+DRAW_KERNEL_VARIANTS(draw_triangle, Triangle)
+DRAW_KERNEL_VARIANTS(draw_line, Line)
+DRAW_KERNEL_VARIANTS(draw_polyline, Polyline)
+DRAW_KERNEL_VARIANTS(draw_polygon, Polygon)
+DRAW_KERNEL_VARIANTS(draw_ellipse, Ellipse)
+DRAW_KERNEL_VARIANTS(draw_ring, Ring)
+DRAW_KERNEL_VARIANTS(draw_roundrect, RoundRect)
+DRAW_KERNEL_VARIANTS(draw_use, Use)
+DRAW_KERNEL_VARIANTS(draw_points, Points)
+DRAW_KERNEL_VARIANTS(draw_grid, Grid)
+DRAW_KERNEL_VARIANTS(draw_image, Image)
+DRAW_KERNEL_VARIANTS(draw_text, Text)
+
+/* kernels by shape, [shape][0] clips, [shape][1] for shapes inside */
+static const DrawKernel draw_kernels[SH_COUNT][2] = {
+	[SH_RECTANGLE] = {draw_rectangle_clip, draw_rectangle_noclip},
+	[SH_CIRCLE] = {draw_circle_clip, draw_circle_noclip},
+	[SH_TRIANGLE] = {draw_triangle_clip, draw_triangle_noclip},
+	[SH_LINE] = {draw_line_clip, draw_line_noclip},
+	[SH_POLYLINE] = {draw_polyline_clip, draw_polyline_noclip},
+	[SH_POLYGON] = {draw_polygon_clip, draw_polygon_noclip},
+	[SH_ELLIPSE] = {draw_ellipse_clip, draw_ellipse_noclip},
+	[SH_RING] = {draw_ring_clip, draw_ring_noclip},
+	[SH_ROUNDRECT] = {draw_roundrect_clip, draw_roundrect_noclip},
+	[SH_USE] = {draw_use_clip, draw_use_noclip},
+	[SH_POINTS] = {draw_points_clip, draw_points_noclip},
+	[SH_GRID] = {draw_grid_clip, draw_grid_noclip},
+	[SH_IMAGE] = {draw_image_clip, draw_image_noclip},
+	[SH_TEXT] = {draw_text_clip, draw_text_noclip}
+	/* SH_SYMBOL and SH_GRADIENT have an empty box and are never drawn */
+};
+
+//-----------------------------------------------------------------------------
+///
+/// Calculates the bounding box of a command, with 64 bit values so that
+/// coordinates near the int limits don't overflow. Rows are counted from top
+/// like for bitmap_write_pixel, the box can be outside of the picture and is
+/// empty (right < left or bottom < top) for shapes without pixels.
+///
+/// @param comm    command with a valid shape
+/// @param left    pointer to leftmost column
+/// @param top     pointer to top row
+/// @param right   pointer to rightmost column
+/// @param bottom  pointer to bottom row
+//
+void draw_bounding_box(Command *comm, int64_t *left, int64_t *top,
+					   int64_t *right, int64_t *bottom)
+{
+	if (comm->shape == SH_RECTANGLE)
+	{
+		Rectangle *rect = comm->obj;
+		*left = rect->x;
+		*top = rect->y;
+		*right = (int64_t)rect->x + rect->width - 1;
+		*bottom = (int64_t)rect->y + rect->height - 1;
+	}
+	else if (comm->shape == SH_CIRCLE)
+	{
+		Circle *circle = comm->obj;
+		*left = (int64_t)circle->x - circle->radius;
+		*top = (int64_t)circle->y - circle->radius;
+		*right = (int64_t)circle->x + circle->radius;
+		*bottom = (int64_t)circle->y + circle->radius;
+	}
+	else if (comm->shape == SH_ELLIPSE)
+	{
+		/* columns and rows less than the radii away from the center */
+		Ellipse *ellipse = comm->obj;
+		*left = (int64_t)ellipse->x - ellipse->rx + 1;
+		*top = (int64_t)ellipse->y - ellipse->ry + 1;
+		*right = (int64_t)ellipse->x + ellipse->rx - 1;
+		*bottom = (int64_t)ellipse->y + ellipse->ry - 1;
+	}
+	else if (comm->shape == SH_RING)
+	{
+		/* like the circle with the outer radius */
+		Ring *ring = comm->obj;
+		*left = (int64_t)ring->x - ring->outer;
+		*top = (int64_t)ring->y - ring->outer;
+		*right = (int64_t)ring->x + ring->outer;
+		*bottom = (int64_t)ring->y + ring->outer;
+	}
+	else if (comm->shape == SH_ROUNDRECT)
+	{
+		RoundRect *rect = comm->obj;
+		*left = rect->x;
+		*top = rect->y;
+		*right = (int64_t)rect->x + rect->width - 1;
+		*bottom = (int64_t)rect->y + rect->height - 1;
+	}
+	else if (comm->shape == SH_USE)
+	{
+		/* the picture of the symbol at the origin of the use */
+		Use *use = comm->obj;
+		*left = use->x;
+		*top = use->y;
+		*right = (use->def != NULL) ? (int64_t)use->x + use->def->width - 1 :
+			*left - 1;
+		*bottom = (use->def != NULL) ? (int64_t)use->y + use->def->height - 1 :
+			*top - 1;
+	}
+	else if (comm->shape == SH_POINTS)
+	{
+		/* calculated by the parser when it mapped the file, if it did */
+		Points *points = comm->obj;
+		*left = points->left;
+		*top = points->top;
+		*right = (points->count > 0) ? points->right : *left - 1;
+		*bottom = points->bottom;
+	}
+	else if (comm->shape == SH_GRID)
+	{
+		/* empty if the file isn't mapped */
+		Grid *grid = comm->obj;
+		*left = grid->x;
+		*top = grid->y;
+		*right = (grid->cells != NULL) ?
+			grid->x + (int64_t)grid->columns * grid->cell_width - 1 :
+			*left - 1;
+		*bottom = grid->y + (int64_t)grid->rows * grid->cell_height - 1;
+	}
+	else if (comm->shape == SH_IMAGE)
+	{
+		/* empty if the file isn't mapped */
+		Image *image = comm->obj;
+		*left = image->x;
+		*top = image->y;
+		*right = (image->bitmap.map != NULL) ?
+			image->x + (int64_t)image->width - 1 : *left - 1;
+		*bottom = image->y + (int64_t)image->height - 1;
+	}
+	else if (comm->shape == SH_TEXT)
+	{
+		/* the cells of the glyphs, without the empty columns of the last */
+		Text *text = comm->obj;
+		int64_t length = strlen(text->text);
+		*left = text->x;
+		*top = text->y;
+		*right = (length > 0 && text->scale > 0) ? text->x +
+			((length - 1) * FONT_ADVANCE + FONT_WIDTH) * (int64_t)text->scale -
+			1 : *left - 1;
+		*bottom = text->y + (int64_t)FONT_HEIGHT * text->scale - 1;
+	}
+	else if (comm->shape == SH_SYMBOL || comm->shape == SH_GRADIENT)
+	{
+		/* drawn by its uses, by the shapes it fills */
+		*left = 0;
+		*top = 0;
+		*right = -1;
+		*bottom = -1;
+	}
+	else if (comm->shape == SH_LINE)
+	{
+		Line *line = comm->obj;
+		DrawLine spans;
+		if (!draw_line_setup(&spans, line->x1, line->y1, line->x2, line->y2,
+							 line->width))
+		{
+			spans.left = 0;
+			spans.top = 0;
+			spans.right = -1;
+			spans.bottom = -1;
+		}
+		*left = spans.left;
+		*top = spans.top;
+		*right = spans.right;
+		*bottom = spans.bottom;
+	}
+	else if (comm->shape == SH_POLYLINE)
+	{
+		/* the points, wide lines and joins reach half the width further */
+		Polyline *polyline = comm->obj;
+		const int *xy = polyline->points.xy;
+		int64_t margin = (polyline->width > 1) ? polyline->width / 2 + 1 : 0;
+		*left = xy[0];
+		*right = xy[0];
+		*top = xy[1];
+		*bottom = xy[1];
+		for (int i = 1; i < polyline->points.count; i++)
+		{
+			*left = (xy[2 * i] < *left) ? xy[2 * i] : *left;
+			*right = (xy[2 * i] > *right) ? xy[2 * i] : *right;
+			*top = (xy[2 * i + 1] < *top) ? xy[2 * i + 1] : *top;
+			*bottom = (xy[2 * i + 1] > *bottom) ? xy[2 * i + 1] : *bottom;
+		}
+		*left -= margin;
+		*top -= margin;
+		*right += margin;
+		*bottom += margin;
+		if (polyline->width < 1)
+		{
+			*right = *left - 1;
+		}
+	}
+	else if (comm->shape == SH_POLYGON)
+	{
+		/* the pixels are left of and above the rightmost and lowest point */
+		Polygon *polygon = comm->obj;
+		const int *xy = polygon->points.xy;
+		*left = xy[0];
+		*right = xy[0];
+		*top = xy[1];
+		*bottom = xy[1];
+		for (int i = 1; i < polygon->points.count; i++)
+		{
+			*left = (xy[2 * i] < *left) ? xy[2 * i] : *left;
+			*right = (xy[2 * i] > *right) ? xy[2 * i] : *right;
+			*top = (xy[2 * i + 1] < *top) ? xy[2 * i + 1] : *top;
+			*bottom = (xy[2 * i + 1] > *bottom) ? xy[2 * i + 1] : *bottom;
+		}
+		(*right)--;
+		(*bottom)--;
+	}
 	else
+	{
+		/* one pixel more for the rounding of the edge steps */
+		Triangle *tri = comm->obj;
+		int64_t x = tri->ax < tri->bx ? tri->ax : tri->bx;
+		*left = (tri->cx < x ? tri->cx : x) - 1;
+		x = tri->ax > tri->bx ? tri->ax : tri->bx;
+		*right = (tri->cx > x ? tri->cx : x) + 1;
+		int64_t y = tri->ay < tri->by ? tri->ay : tri->by;
+		*top = (tri->cy < y ? tri->cy : y) - 1;
+		y = tri->ay > tri->by ? tri->ay : tri->by;
+		*bottom = (tri->cy > y ? tri->cy : y) + 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Number of pieces a shape is drawn in. A polyline is drawn as its lines and
+/// its joins, points as their discs, the other shapes are one piece. The
+/// scanline renderer walks each piece on its own.
+///
+/// @param comm  command with a valid shape
+///
+/// @return number of pieces
+//
+int draw_pieces(Command *comm)
+{
+	if (comm->shape == SH_POINTS)
+	{
+		return ((Points *)comm->obj)->count;
+	}
+	if (comm->shape != SH_POLYLINE)
+	{
+		return 1;
+	}
+	Polyline *polyline = comm->obj;
+	int segments = polyline->points.count - 1;
+	return (polyline->width >= DRAW_JOIN_WIDTH) ? 2 * segments - 1 : segments;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Calculates the bounding box of a piece of a command (see draw_pieces and
+/// draw_bounding_box)
+///
+/// @param comm    command with a valid shape
+/// @param piece   piece of the shape
+/// @param left    pointer to leftmost column
+/// @param top     pointer to top row
+/// @param right   pointer to rightmost column
+/// @param bottom  pointer to bottom row
+//
+void draw_piece_bounding_box(Command *comm, int piece, int64_t *left,
+							 int64_t *top, int64_t *right, int64_t *bottom)
+{
+	if (comm->shape == SH_POINTS)
+	{
+		/* the box of a circle at the point */
+		Points *points = comm->obj;
+		*left = (int64_t)points->x[piece] - points->radius;
+		*top = (int64_t)points->y[piece] - points->radius;
+		*right = (int64_t)points->x[piece] + points->radius;
+		*bottom = (int64_t)points->y[piece] + points->radius;
+		return;
+	}
+	if (comm->shape != SH_POLYLINE)
+	{
+		draw_bounding_box(comm, left, top, right, bottom);
+		return;
+	}
+
+	Polyline *polyline = comm->obj;
+	const int *xy = polyline->points.xy;
+	int segments = polyline->points.count - 1;
+	if (piece < segments)
+	{
+		xy += 2 * piece;
+		Line line = {polyline->id, polyline->color, xy[0], xy[1], xy[2], xy[3],
+					 polyline->width};
+		Command line_comm = {.shape = SH_LINE, .id = polyline->id,
+							 .obj = &line};
+		draw_bounding_box(&line_comm, left, top, right, bottom);
+		return;
+	}
+	xy += 2 * (piece - segments + 1);
+	int64_t radius = draw_join_radius(polyline->width);
+	*left = xy[0] - radius;
+	*top = xy[1] - radius;
+	*right = xy[0] + radius;
+	*bottom = xy[1] + radius;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Clamps a bounding box (see draw_bounding_box) to the picture, so that
+/// what is done with the box scales with the visible part of the shape
+///
+/// @param width   width of the picture
+/// @param height  height of the picture
+/// @param left    pointer to leftmost column
+/// @param top     pointer to top row
+/// @param right   pointer to rightmost column
+/// @param bottom  pointer to bottom row
+///
+/// @return 1 if the box has pixels in the picture, 0 if the shape can be
+///         skipped (the box is left unchanged then)
+//
+int draw_clip_box(uint32_t width, uint32_t height, int64_t *left,
+				  int64_t *top, int64_t *right, int64_t *bottom)
+{
+	if (*right < *left || *bottom < *top || *right < 0 || *bottom < 0 ||
+		*left >= width || *top >= height)
+	{
+		return 0;
+	}
+	*left = (*left < 0) ? 0 : *left;
+	*top = (*top < 0) ? 0 : *top;
+	*right = (*right >= width) ? (int64_t)width - 1 : *right;
+	*bottom = (*bottom >= height) ? (int64_t)height - 1 : *bottom;
+	return 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws a command with a fill: its pieces are walked by their row
+/// iterators, which give the pixels the kernel would write, and the
+/// gradient is written into the spans in the picture
+///
+/// @param pix_buffer  pixel buffer the command will be drawn into
+/// @param comm        command with a valid shape and a fill
+///
+/// @return number of pixels written, DRAW_KERNEL_OUT_OF_MEM if out of
+///         memory
+//
+static uint64_t draw_filled(PixelBuffer *pix_buffer, Command *comm)
+{
+	if (draw_gradient_prepare(comm->fill) != DRAW_SUCCESS)
+	{
+		return DRAW_KERNEL_OUT_OF_MEM;
+	}
+
+	/* the spans of the shape, the gradient is written here */
+	Command shape = *comm;
+	shape.fill = NULL;
+	size_t row_size = bitmap_pixel_array_row_size(pix_buffer->width);
+	uint64_t pixels = 0;
+	for (int piece = 0; piece < draw_pieces(&shape); piece++)
+	{
+		DrawRows rows;
+		int more = draw_rows_begin(&rows, &shape, piece, pix_buffer->width,
+								   pix_buffer->height, 0);
+		if (more < 0)
+		{
+			return DRAW_KERNEL_OUT_OF_MEM;
+		}
+		while (more)
+		{
+			if (rows.x1 < rows.x2)
+			{
+				/* bitmap is upside down, therefore swap row */
+				uint8_t *pixel = (uint8_t *)pix_buffer->data +
+					(size_t)(pix_buffer->height - 1 - rows.row) * row_size +
+					(size_t)rows.x1 * BITMAP_RGB_COLOR_SIZE;
+				draw_gradient_span(comm->fill, rows.row, rows.x1, rows.x2,
+								   pixel);
+				pixels += rows.x2 - rows.x1;
+			}
+			more = draw_rows_next(&rows);
+		}
+		draw_rows_end(&rows);
+	}
+	return pixels;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Executes the drawing command and writes the shape to the pixel buffer.
+/// Shapes whose bounding box is outside of the picture are skipped, those
+/// inside are drawn by the kernel without clipping, shapes with a fill by
+/// draw_filled.
+///
+/// @param pix_buffer  pixel buffer struct where the command will be drawn into
+/// @param comm        command which will be executed
+///
+/// @return DRAW_SUCCESS on success, DRAW_ERR_NULL_POINTER_PASSED,
+///         DRAW_ERR_COMMAND_INVALID or DRAW_ERR_OUT_OF_MEM otherwise
+//
+int draw_command(PixelBuffer *pix_buffer, Command *comm)
+{
+	if (pix_buffer == NULL)
+	{
+		return DRAW_ERR_NULL_POINTER_PASSED;
+	}
+	if (comm == NULL)
+	{
+		return DRAW_ERR_NULL_POINTER_PASSED;
+	}
+	if (comm->obj == NULL || comm->shape < 0 || comm->shape >= SH_COUNT ||
+		(comm->shape == SH_USE && ((Use *)comm->obj)->def == NULL))
 	{
 		return DRAW_ERR_COMMAND_INVALID;
 	}
 
+	int64_t left, top, right, bottom;
+	draw_bounding_box(comm, &left, &top, &right, &bottom);
+	int inside = left >= 0 && top >= 0 && right < pix_buffer->width &&
+		bottom < pix_buffer->height;
+	if (!draw_clip_box(pix_buffer->width, pix_buffer->height, &left, &top,
+					   &right, &bottom))
+	{
+		/* no pixels in the picture */
+		return DRAW_SUCCESS;
+	}
+
+	/* a symbol is rasterized when its first use is drawn */
+	if (comm->shape == SH_USE &&
+		draw_symbol_prepare(((Use *)comm->obj)->def) != DRAW_SUCCESS)
+	{
+		return DRAW_ERR_OUT_OF_MEM;
+	}
+
+	/* clear the tiles below the shape before it is drawn */
+	if (pix_buffer->lazy)
+	{
+		bitmap_pixel_buffer_touch(pix_buffer, left, top, right, bottom);
+	}
+
+	uint64_t pixels = (comm->fill != NULL) ? draw_filled(pix_buffer, comm) :
+		draw_kernels[comm->shape][inside](pix_buffer, comm->obj);
+	if (pixels == DRAW_KERNEL_OUT_OF_MEM)
+	{
+		return DRAW_ERR_OUT_OF_MEM;
+	}
+	STATS_ADD(pixels[comm->shape], pixels);
+
 	return DRAW_SUCCESS;
 }
 
+//-----------------------------------------------------------------------------
+///
+/// Draws a command with the clipping or the not clipping kernel, for
+/// benchmarking the kernels (bench_draw), the not clipping kernel must only
+/// get shapes inside the picture
+///
+/// @param pix_buffer  pixel buffer the command will be drawn into
+/// @param comm        command with a valid shape
+/// @param clip        1 for the clipping kernel, 0 otherwise
+///
+/// @return number of pixels written, UINT64_MAX if out of memory
+//
+uint64_t draw_command_kernel(PixelBuffer *pix_buffer, Command *comm, int clip)
+{
+	return draw_kernels[comm->shape][!clip](pix_buffer, comm->obj);
+}
@@ -21,13 +21,208 @@
 #ifndef DRAW_H
 #define DRAW_H
 
+#include <stdint.h>
+
 #include "parse.h"
 #include "bitmap.h"
 
 #define DRAW_SUCCESS 0
 #define DRAW_ERR_NULL_POINTER_PASSED 1
 #define DRAW_ERR_COMMAND_INVALID 2
+#define DRAW_ERR_OUT_OF_MEM 3
+
+/* edges of a triangle, walked a row at a time from the top vertex */
+typedef struct _DrawTriangleEdges_ {
+	double sx;          /* start and end column of the first row */
+	double ex;
+	double sy;          /* first row */
+	double step_sx[2];  /* change of sx and ex per row above and below b */
+	double step_ex[2];
+	int bx;             /* middle vertex */
+	int by;
+	int cy;             /* last row */
+	int restart;        /* 1 if the lower part starts again at row by with
+	                     * sx = bx, 0 if it continues with ex = bx */
+} DrawTriangleEdges;
+
+/* a line as one span per row, see draw_line_setup */
+typedef struct _DrawLine_ {
+	int64_t left;       /* bounding box */
+	int64_t top;
+	int64_t right;
+	int64_t bottom;
+	int64_t x;          /* width 1: column of row top in 16.16 fixed point, */
+	int64_t step;       /* its change per row (rounded down, the remainder */
+	uint64_t rest;      /* rest of rows rows adds up), half the length of a */
+	uint64_t rows;      /* run without its middle pixel */
+	int64_t half;
+	double center[2];   /* wider: the quad around the line is the overlap */
+	double slope[2];    /* of two slabs, across and along the line, row y */
+	double reach[2];    /* crosses each from center + slope * y - reach to */
+	                    /* center + slope * y + reach */
+	int thick;          /* 1 if drawn as quad */
+} DrawLine;
+
+/*
+ * edge of a polygon from row top to the row before bottom, where it crosses
+ * the current row at x + fraction / dy (0 <= fraction < dy), 32 bit values
+ * are enough for points with int coordinates and keep the edges of a row
+ * in cache
+ */
+typedef struct _DrawPolygonEdge_ {
+	int64_t step;            /* change of the crossing per row: */
+	uint32_t step_fraction;  /* step + step_fraction / dy */
+	uint32_t dy;
+	uint32_t fraction;
+	int32_t x;
+	int32_t column;          /* first column right of the crossing */
+	int32_t top;
+	int32_t bottom;
+	int32_t winding;         /* 1 if the edge goes down, -1 if up */
+} DrawPolygonEdge;
+
+/* a polygon as the spans of a row at a time, see draw_polygon_setup */
+typedef struct _DrawPolygon_ {
+	DrawPolygonEdge *edges;   /* edges sorted by top, one allocation with */
+	int count;                /* active and spans */
+	int next;                 /* first edge not reached yet */
+	DrawPolygonEdge *active;  /* edges crossing the current row */
+	int active_length;
+	int64_t *spans;           /* first column and the column after the last */
+	int span_count;           /* one of each span of the row */
+	int span;                 /* iterator: current span */
+	int64_t row;
+	int nonzero;              /* 1 for FILL_NONZERO */
+} DrawPolygon;
+
+/*
+ * columns of each row of an ellipse (see draw_round_columns) by the distance
+ * of the row from the center, shared by the span cache and the kernels and
+ * row iterators using it, freed when the last of them releases it
+ */
+typedef struct _DrawEllipseSpans_ {
+	int refs;
+	int64_t rx;
+	int64_t ry;
+	int32_t columns[];
+} DrawEllipseSpans;
+
+/* columns x1 to x2 (exclusive) of a row of a symbol in one color */
+typedef struct _DrawSymbolRun_ {
+	int32_t x1;
+	int32_t x2;
+	int32_t color;
+} DrawSymbolRun;
+
+/*
+ * columns x1 to x2 (exclusive) of a row of a symbol covered by touching runs,
+ * their pixels start at pixel offset of the pixel data of the mask
+ */
+typedef struct _DrawSymbolSegment_ {
+	int32_t x1;
+	int32_t x2;
+	uint32_t offset;
+} DrawSymbolSegment;
+
+/*
+ * the pixels the shapes of a symbol write (see draw_symbol_prepare) as runs
+ * of one color, sorted by row and column and not overlapping: the runs of
+ * row top + r are runs[first[r]] to runs[first[r + 1] - 1]. The same pixels
+ * as segments for copying them: the segments of row top + r are
+ * segments[first_segment[r]] to segments[first_segment[r + 1] - 1]. The mask
+ * is one allocation.
+ */
+typedef struct _DrawSymbolMask_ {
+	int64_t top;                  /* first row with runs */
+	int64_t rows;                 /* rows from top on */
+	uint64_t pixels;              /* pixels of all runs */
+	uint32_t *first;
+	DrawSymbolRun *runs;
+	uint32_t *first_segment;
+	DrawSymbolSegment *segments;
+	uint8_t *pixel_data;          /* the pixels of the runs one after the */
+	                              /* other, blue, green, red like in the */
+	                              /* pixel buffer */
+} DrawSymbolMask;
+
+/*
+ * Walks the spans of a shape row by row, see draw_rows_begin. Only the
+ * fields of the shape walked are used, a polyline is walked as its lines
+ * and joins.
+ */
+typedef struct _DrawRows_ {
+	Shape shape;
+	Shape walk;
+	int color;
+	int64_t width;            /* picture */
+	int64_t height;
+	int64_t row;              /* current span from x1 to x2 (exclusive) */
+	int64_t x1;
+	int64_t x2;
+	int64_t end;              /* rectangle and round shapes: row after the */
+	int64_t x;                /* last, circle: center, radius and the */
+	int64_t y;                /* columns (from the center) of the current */
+	int64_t radius;           /* row */
+	int64_t columns;
+	int64_t radius_y;         /* ellipse: vertical radius (radius: rx) and */
+	DrawEllipseSpans *spans;  /* the columns of all rows if the span cache */
+	                          /* has them, else NULL */
+	int64_t inner;            /* ring: inner radius, its columns and the */
+	int64_t inner_columns;    /* span right of it, the next one if part */
+	int64_t next_x1;          /* is 1 */
+	int64_t next_x2;
+	int64_t right;            /* roundrect: column after the last, rows of */
+	int64_t bottom;           /* the lower (y: upper) corner centers and */
+	                          /* the corner radius (radius), x: left */
+	DrawTriangleEdges edges;  /* triangle: edges, the next row and the part */
+	double sx;                /* of the triangle (0 above b, 1 below) */
+	double sy;
+	double ex;
+	int part;
+	DrawLine line;            /* line: its spans */
+	DrawPolygon polygon;      /* polygon: its edges, freed by draw_rows_end */
+	const DrawSymbolMask *mask; /* use: the mask of the symbol, the row of */
+	int64_t mask_row;         /* the mask and the current run, x and y: */
+	int64_t run;              /* where the origin of the symbol is */
+	const Grid *grid;         /* grid: the grid, the cell column of the */
+	int64_t column;           /* next span, the visible cell columns, x */
+	int64_t first_column;     /* and y: the left upper corner, end: the */
+	int64_t last_column;      /* row after the last */
+	const Image *image;       /* image: the image, the row of the file the */
+	int64_t source_row;       /* pixels of the span are from, the columns */
+	uint32_t *source_columns; /* of the file of the visible columns and */
+	uint8_t *image_row;       /* their pixels (both NULL if the pixels are */
+	                          /* read from the file), one allocation freed */
+	                          /* by draw_rows_end, x and y: the left upper */
+	                          /* corner, end: the row after the last */
+	const Text *text;         /* text: the text, the glyph of the current */
+	int64_t glyph;            /* span (run: its run in the glyph atlas), */
+	                          /* first_column to last_column: the visible */
+	                          /* glyphs, x and y: the left upper corner, */
+	                          /* end: the row after the last */
+	const uint8_t *pixels;    /* pixels of the current span (x1 to x2) if */
+	                          /* they are copied (image, fill), NULL if the */
+	                          /* span has color */
+	const Gradient *fill;     /* gradient the shape is filled with, else */
+	uint8_t *fill_row;        /* NULL, and the pixels of the current span, */
+	                          /* freed by draw_rows_end */
+} DrawRows;
 
 int draw_command(PixelBuffer *pix_buffer, Command *comm);
+uint64_t draw_command_kernel(PixelBuffer *pix_buffer, Command *comm, int clip);
+int draw_pieces(Command *comm);
+int draw_rows_begin(DrawRows *rows, Command *comm, int piece, uint32_t width,
+					uint32_t height, int64_t first_row);
+int draw_rows_next(DrawRows *rows);
+void draw_rows_end(DrawRows *rows);
+int draw_symbol_prepare(Symbol *symbol);
+void draw_cache_clear(void);
+void draw_set_threads(int threads);
+void draw_bounding_box(Command *comm, int64_t *left, int64_t *top,
+					   int64_t *right, int64_t *bottom);
+void draw_piece_bounding_box(Command *comm, int piece, int64_t *left,
+							 int64_t *top, int64_t *right, int64_t *bottom);
+int draw_clip_box(uint32_t width, uint32_t height, int64_t *left,
+				  int64_t *top, int64_t *right, int64_t *bottom);
 
 #endif
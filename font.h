@@ -0,0 +1,46 @@
+/*
+ *  font.h - Definitions of the embedded bitmap font
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FONT_H
+#define FONT_H
+
+#include <stdint.h>
+
+/* glyphs of the printable ASCII characters, FONT_FIRST is the first one */
+#define FONT_FIRST 32
+#define FONT_GLYPHS 95
+
+/* pixels of a glyph and columns from one glyph to the next */
+#define FONT_WIDTH 5
+#define FONT_HEIGHT 7
+#define FONT_ADVANCE 6
+
+/* characters without a glyph are drawn with the glyph of this one */
+#define FONT_UNKNOWN '?'
+
+/*
+ * rows of each glyph from top to bottom, bit FONT_WIDTH - 1 of a row is its
+ * leftmost column
+ */
+extern const uint8_t font_glyphs[FONT_GLYPHS][FONT_HEIGHT];
+
+int font_glyph(unsigned char c);
+
+#endif
@@ -171,15 +171,23 @@ int list_insert(List *list, int index, void *element)
 	/* check if there is enough memory left */
 	if (list->mem_size < (list->length + 1) * element_size)
 	{
-		/* reallocate more memory for list */
-		void *mem_tmp = realloc(
-			list->mem,
-			(list->length + LIST_STANDARD_REALLOC_LENGTH) * element_size);
+		/*
+		 * reallocate more memory for list, growing by the current length so
+		 * that appending n elements only copies O(n) elements in total
+		 */
+		int grow = list->length;
+		if (grow < LIST_STANDARD_REALLOC_LENGTH)
+		{
+			grow = LIST_STANDARD_REALLOC_LENGTH;
+		}
+		int mem_size = (list->length + grow) * element_size;
+		void *mem_tmp = realloc(list->mem, mem_size);
 		if (mem_tmp == NULL)
 		{
 			return LIST_ERR_OUT_OF_MEMORY;
 		}
 		list->mem = mem_tmp;
+		list->mem_size = mem_size;
 	}
 
 	/* move up the elements to make space for element to insert */
@@ -18,19 +18,26 @@
  *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <stdint.h>
 
-#include "list.h"
-#include "linked_list.h"
-#include "parse.h"
 #include "bitmap.h"
-#include "main.h"
 #include "draw.h"
+#include "main.h"
+#include "render.h"
+#include "span.h"
+#include "stats.h"
 
 const char *err_msg_usage =
-	"Usage: ./bitmap <input> <output> <width> <height>\n";
+	"Usage: ./bitmap [--compress] [--fast] [--mmap] [--scanline] "
+	"[--stats[=json]] "
+	"[--format=bmp|png|qoi] [--kernel=auto|scalar|sse2|avx2|avx512] "
+	"[--threads=N] <input|-> <output|-> <width> <height>\n";
 const char *err_msg_read_input =
 	"Error: could not read input file \"%s\".\n";
 const char *err_msg_invalid_input =
@@ -43,152 +50,281 @@ const char *err_msg_out_of_mem =
 	"Error: out of memory.\n";
 const char *err_msg_unrecognised =
 	"Error: Unrecognised error.\n";
+const char *err_msg_too_large =
+	"Error: image too large for a bitmap file (4 GB), use png or qoi.\n";
+const char *err_msg_kernel =
+	"Error: kernel \"%s\" is not supported on this CPU.\n";
+
+//-----------------------------------------------------------------------------
+///
+/// Print the error message for an error of the render library and translate
+/// it to the exit code of the program
+///
+/// @param ret          RENDER_* code
+/// @param context      render context that returned the error
+/// @param input_path   path of input file (for error messages)
+/// @param output_path  path of output file (for error messages)
+///
+/// @return SUCCESS or the matching ERR_* exit code
+//
+static int report_error(int ret, RenderContext *context, char *input_path,
+						char *output_path)
+{
+	switch (ret)
+	{
+	case RENDER_SUCCESS:
+		return SUCCESS;
+	case RENDER_ERR_READ_INPUT:
+		fprintf(stderr, err_msg_read_input, input_path);
+		return ERR_READ_INPUT;
+	case RENDER_ERR_INVALID_INPUT:
+		fprintf(stderr, err_msg_invalid_input, context->error_line);
+		return ERR_INVALID_INPUT;
+	case RENDER_ERR_DUPLICATE_ID:
+		fprintf(stderr, err_msg_duplicate_id, (int)context->error_id);
+		return ERR_DUPLICATE_ID;
+	case RENDER_ERR_WRITE:
+		fprintf(stderr, err_msg_write_file, output_path);
+		return ERR_WRITE_FILE;
+	case RENDER_ERR_OUT_OF_MEM:
+		fprintf(stderr, err_msg_out_of_mem);
+		return ERR_OUT_OF_MEM;
+	case RENDER_ERR_TOO_LARGE:
+		fprintf(stderr, err_msg_too_large);
+		return ERR_TOO_LARGE;
+	default:
+		fprintf(stderr, err_msg_unrecognised);
+		return ERR_UNRECOGNISED;
+	}
+}
 
 int main(int argc, char *argv[])
 {
 	int ret;
 
+	/* parsing options */
+	int flags = 0;
+	int map_output = FALSE;
+	int scanline = FALSE;
+	int print_stats = FALSE;
+	int format = -1; /* chosen by the extension of the output path */
+	int stats_format = STATS_FORMAT_TEXT;
+	int arg_index = 1;
+	while (arg_index < argc && argv[arg_index][0] == '-' &&
+		   argv[arg_index][1] != 0)
+	{
+		if (strcmp(argv[arg_index], "--compress") == 0)
+		{
+			flags |= RENDER_FLAG_COMPRESS;
+		}
+		else if (strcmp(argv[arg_index], "--fast") == 0)
+		{
+			flags |= RENDER_FLAG_FAST;
+		}
+		else if (strcmp(argv[arg_index], "--mmap") == 0)
+		{
+			map_output = TRUE;
+		}
+		else if (strcmp(argv[arg_index], "--scanline") == 0)
+		{
+			scanline = TRUE;
+		}
+		else if (strcmp(argv[arg_index], "--stats") == 0)
+		{
+			print_stats = TRUE;
+		}
+		else if (strcmp(argv[arg_index], "--stats=json") == 0)
+		{
+			print_stats = TRUE;
+			stats_format = STATS_FORMAT_JSON;
+		}
+		else if (strcmp(argv[arg_index], "--format=bmp") == 0)
+		{
+			format = RENDER_FORMAT_BMP;
+		}
+		else if (strcmp(argv[arg_index], "--format=png") == 0)
+		{
+			format = RENDER_FORMAT_PNG;
+		}
+		else if (strcmp(argv[arg_index], "--format=qoi") == 0)
+		{
+			format = RENDER_FORMAT_QOI;
+		}
+		else if (strncmp(argv[arg_index], "--kernel=", 9) == 0)
+		{
+			/* overrides the kernel chosen by cpuid, for benchmarks */
+			const char *kernel = argv[arg_index] + 9;
+			ret = span_select(kernel);
+			if (ret == SPAN_ERR_UNSUPPORTED)
+			{
+				fprintf(stderr, err_msg_kernel, kernel);
+				exit(ERR_USAGE);
+			}
+			if (ret != SPAN_SUCCESS)
+			{
+				fprintf(stderr, err_msg_usage);
+				exit(ERR_USAGE);
+			}
+		}
+		else if (strncmp(argv[arg_index], "--threads=", 10) == 0)
+		{
+			/* threads drawing points, 0 for one per processor */
+			char *end;
+			long threads = strtol(argv[arg_index] + 10, &end, 10);
+			if (end == argv[arg_index] + 10 || *end != 0 || threads < 0 ||
+				threads > INT32_MAX)
+			{
+				fprintf(stderr, err_msg_usage);
+				exit(ERR_USAGE);
+			}
+			draw_set_threads(threads);
+		}
+		else
+		{
+			fprintf(stderr, err_msg_usage);
+			exit(ERR_USAGE);
+		}
+		arg_index++;
+	}
+
 	/* check whether there is a correct number of arguments */
-	if (argc != 5) {
-		printf(err_msg_usage);
+	if (argc - arg_index != 4) {
+		fprintf(stderr, err_msg_usage);
 		exit(ERR_USAGE);
 	}
 
 	/* parsing arguments */
-	char *input_path = argv[1];
-	char *output_path = argv[2];
+	char *input_path = argv[arg_index];
+	char *output_path = argv[arg_index + 1];
+	int to_stdout = strcmp(output_path, "-") == 0;
 
 	char *endptr;
-	int width = strtol(argv[3], &endptr, 10);
-	if (*endptr != 0 || width < 0)
+	long width = strtol(argv[arg_index + 2], &endptr, 10);
+	if (*endptr != 0 || width < 0 || width > INT32_MAX)
 	{
-		/* the image width is not a number */
-		printf(err_msg_usage);
+		/* the image width is not a number (or can't be stored in files) */
+		fprintf(stderr, err_msg_usage);
 		exit(ERR_USAGE);
 	}
-	int height = strtol(argv[4], &endptr, 10);
-	if (*endptr != 0 || height < 0)
+	long height = strtol(argv[arg_index + 3], &endptr, 10);
+	if (*endptr != 0 || height < 0 || height > INT32_MAX)
 	{
-		/* the image width is not a number */
-		printf(err_msg_usage);
+		/* the image width is not a number (or can't be stored in files) */
+		fprintf(stderr, err_msg_usage);
 		exit(ERR_USAGE);
 	}
 
-	/* parse input file */
-	LinkedList *command_list;
-	ret = parse_file(input_path, &command_list);
-	if (ret != SUCCESS)
+	/*
+	 * Fail before drawing if the picture can't be written as bitmap, with
+	 * --compress the 8 bit bitmap might still fit
+	 */
+	if (format < 0)
+	{
+		format = render_format_from_path(output_path);
+	}
+	int compress = (flags & RENDER_FLAG_COMPRESS) != 0;
+	if (format == RENDER_FORMAT_BMP && !compress &&
+		bitmap_file_size(width, height) > BITMAP_MAX_FILE_SIZE)
 	{
-		exit(ret);
+		fprintf(stderr, err_msg_too_large);
+		exit(ERR_TOO_LARGE);
 	}
 
-	/* create pixel buffer */
-	PixelBuffer *pix_buffer;
-	pix_buffer = bitmap_pixel_buffer_new(width, height);
-	if (pix_buffer == NULL)
+	if (print_stats)
 	{
-		printf(err_msg_out_of_mem);
-		ret = ERR_OUT_OF_MEM;
-		goto main_cleanup1;
+		stats_enable();
 	}
 
-	/* set pixel buffer white */
-	Command comm_white;
-	Rectangle rect_white;
-	comm_white.shape = SH_RECTANGLE;
-	comm_white.obj = &rect_white;
-	rect_white.x = 0;
-	rect_white.y = 0;
-	rect_white.width = width;
-	rect_white.height = height;
-	rect_white.color = 0xffffff;
-	if (draw_command(pix_buffer, &comm_white) != DRAW_SUCCESS)
-	{
-		printf(err_msg_unrecognised);
-		ret = ERR_UNRECOGNISED;
-		goto main_cleanup2;
+	RenderContext *context = render_context_new();
+	if (context == NULL)
+	{
+		fprintf(stderr, err_msg_out_of_mem);
+		exit(ERR_OUT_OF_MEM);
 	}
+	context->scanline = scanline;
 
-	/* draw commands */
-	int index_command = 0;
-	int data_size;
-	Command *comm = linked_list_get(command_list, index_command, &data_size);
+	/* parse input file ("-" is stdin) */
+	ret = render_load_file(context, input_path);
+	if (ret != RENDER_SUCCESS)
+	{
+		ret = report_error(ret, context, input_path, output_path);
+		goto main_cleanup1;
+	}
 
-	while (comm != NULL)
+	/*
+	 * Create pixel buffer, for uncompressed bitmaps it can be the mapped
+	 * output file itself
+	 */
+	PixelBuffer *pix_buffer;
+	if (map_output && format == RENDER_FORMAT_BMP && !compress &&
+		!to_stdout)
 	{
-		if (data_size != sizeof(Command))
+		pix_buffer = bitmap_pixel_buffer_map_file(output_path, width, height);
+		if (pix_buffer == NULL)
 		{
-			printf(err_msg_unrecognised);
-			ret = ERR_UNRECOGNISED;
-			goto main_cleanup2;
+			fprintf(stderr, err_msg_write_file, output_path);
+			ret = ERR_WRITE_FILE;
+			goto main_cleanup1;
 		}
-		if (draw_command(pix_buffer, comm) != DRAW_SUCCESS)
+	}
+	else
+	{
+		pix_buffer = render_pixel_buffer_get(context, width, height);
+		if (pix_buffer == NULL)
 		{
-			printf(err_msg_unrecognised);
-			ret = ERR_UNRECOGNISED;
-			goto  main_cleanup2;
+			fprintf(stderr, err_msg_out_of_mem);
+			ret = ERR_OUT_OF_MEM;
+			goto main_cleanup1;
 		}
-
-		index_command++;
-		comm = linked_list_get(command_list, index_command, &data_size);
 	}
 
-	/* write output file */
-	FILE *of = fopen(output_path, "w");
-	if (of == NULL)
+	/* draw commands */
+	ret = render_draw(context, pix_buffer);
+	if (ret != RENDER_SUCCESS)
 	{
-		printf(err_msg_write_file, output_path);
-		ret = ERR_WRITE_FILE;
+		ret = report_error(ret, context, input_path, output_path);
 		goto main_cleanup2;
 	}
 
-	/* write file header */
-	int header_size = 0;
-	char *file_header = bitmap_file_header_new(width, height, &header_size);
-	if (file_header == NULL)
+	/* a mapped pixel buffer already is the output file */
+	if (pix_buffer->map_is_file)
 	{
-		printf(err_msg_out_of_mem);
-		ret = ERR_OUT_OF_MEM;
-		goto main_cleanup3;
+		ret = SUCCESS;
+		goto main_cleanup2;
 	}
-	ret = fwrite(file_header, 1, header_size, of);
-	if (ret != header_size)
+
+	/* write output file, "-" is stdout (bitmaps go out with a single write) */
+	FILE *of = to_stdout ? stdout : fopen(output_path, "w");
+	if (of == NULL)
 	{
-		printf(err_msg_write_file, output_path);
+		fprintf(stderr, err_msg_write_file, output_path);
 		ret = ERR_WRITE_FILE;
-		goto main_cleanup4;
+		goto main_cleanup2;
 	}
+	ret = render_write_file(context, pix_buffer, format, flags, of);
 
-	/* write pixel array from pixel buffer to bitmap file */
-	int pixel_array_size;
-	char *pixel_array = bitmap_get_pixel_array(pix_buffer, &pixel_array_size);
-	if (pixel_array == NULL)
+	/* close output file, buffered data is written now and can still fail */
+	if (fclose(of) != 0 && ret == RENDER_SUCCESS)
 	{
-		printf(err_msg_out_of_mem);
-		ret = ERR_OUT_OF_MEM;
-		goto main_cleanup4;
+		ret = RENDER_ERR_WRITE;
 	}
-	ret = fwrite(pixel_array, 1, pixel_array_size, of);
-	if (ret != pixel_array_size)
+	ret = report_error(ret, context, input_path, output_path);
+main_cleanup2:
+	/* a mapped output file is incomplete if drawing failed */
+	if (pix_buffer->map_is_file && ret != SUCCESS)
 	{
-		printf(err_msg_write_file, output_path);
-		ret = ERR_WRITE_FILE;
-		goto main_cleanup4;
+		unlink(output_path);
 	}
-
-	ret = SUCCESS;
-
-main_cleanup4:
-	/* delete file header */
-	bitmap_file_header_delete(file_header);
-main_cleanup3:
-	/* close output file */
-	fclose(of);
-main_cleanup2:
-	/* delete pixel buffer */
-	bitmap_pixel_buffer_delete(pix_buffer);
+	/* give pixel buffer back, it is deleted with the context */
+	render_pixel_buffer_release(context, pix_buffer);
 main_cleanup1:
-	/* delete command list */
-	parse_delete_command_list(command_list);
+	/* delete scene and buffers, the span cache is shared by all contexts */
+	render_context_delete(context);
+	draw_cache_clear();
+
+	if (print_stats)
+	{
+		stats_print(stderr, stats_format);
+	}
 	return ret;
 }
@@ -32,6 +32,7 @@
 #define ERR_WRITE_FILE 5
 #define ERR_OUT_OF_MEM 6
 #define ERR_UNRECOGNISED 7
+#define ERR_TOO_LARGE 9
 
 extern const char *err_msg_usage;
 extern const char *err_msg_read_input;
@@ -40,6 +41,8 @@ extern const char *err_msg_duplicate_id;
 extern const char *err_msg_write_file;
 extern const char *err_msg_out_of_mem;
 extern const char *err_msg_unrecognised;
+extern const char *err_msg_too_large;
+extern const char *err_msg_kernel;
 
 
 #endif
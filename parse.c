@@ -18,760 +18,860 @@
  *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "parse.h"
-#include "linked_list.h"
 #include "list.h"
-#include "main.h"
+#include "stats.h"
+
+/* bytes read from an input at once, lines longer than this grow the buffer */
+#define PARSE_CHUNK_SIZE 65536
+
+/* base of a property whose value is a point list "x,y x,y ..." (PointList) */
+#define PARSE_BASE_POINTS 0
+
+/* base of a property whose value is a FillRule "evenodd" or "nonzero" */
+#define PARSE_BASE_RULE 1
 
-#define LINE_INCREMENT 4000000
+/* base of a property whose value is a path (char *) */
+#define PARSE_BASE_PATH 2
 
+/* base of a property whose value is a PointsLayout "xy" or "xyc" */
+#define PARSE_BASE_LAYOUT 3
+
+/* base of a property whose value is a GradientKind "linear" or "radial" */
+#define PARSE_BASE_KIND 4
+
+/*
+ * base of a property whose value is a stop list "offset:color ..."
+ * (GradientStops)
+ */
+#define PARSE_BASE_STOPS 5
 
-typedef struct _Property_ {
-	char name[PARSE_MAX_PROPERTY_NAME_LENGTH];
-	int64_t value;
-} Property;
+/* base of a property whose value is a text (char *), it can be empty */
+#define PARSE_BASE_TEXT 6
 
-char *prop_rectangle[] = {
-	"id",
-	"color",
-	"x",
-	"y",
-	"width",
-	"height",
-	""
+/*
+ * A property of a shape: where its value is stored in the shape structure and
+ * the base its value is written in
+ */
+typedef struct _PropertyDef_ {
+	const char *name;
+	size_t offset;
+	int base;
+} PropertyDef;
+
+/* a shape with its properties, all of them have to be given */
+typedef struct _ShapeDef_ {
+	const char *name;
+	Shape shape;
+	size_t size;
+	const PropertyDef *properties;
+	int property_count;
+} ShapeDef;
+
+static const PropertyDef prop_rectangle[] = {
+	{"id", offsetof(Rectangle, id), 10},
+	{"color", offsetof(Rectangle, color), 16},
+	{"x", offsetof(Rectangle, x), 10},
+	{"y", offsetof(Rectangle, y), 10},
+	{"width", offsetof(Rectangle, width), 10},
+	{"height", offsetof(Rectangle, height), 10}
 };
 
-char *prop_circle[] = {
-	"id",
-	"color",
-	"x",
-	"y",
-	"radius",
-	""
+static const PropertyDef prop_circle[] = {
+	{"id", offsetof(Circle, id), 10},
+	{"color", offsetof(Circle, color), 16},
+	{"x", offsetof(Circle, x), 10},
+	{"y", offsetof(Circle, y), 10},
+	{"radius", offsetof(Circle, radius), 10}
 };
 
-char *prop_triangle[] = {
-	"id",
-	"color",
-	"ax",
-	"ay",
-	"bx",
-	"by",
-	"cx",
-	"cy",
-	""
+static const PropertyDef prop_triangle[] = {
+	{"id", offsetof(Triangle, id), 10},
+	{"color", offsetof(Triangle, color), 16},
+	{"ax", offsetof(Triangle, ax), 10},
+	{"ay", offsetof(Triangle, ay), 10},
+	{"bx", offsetof(Triangle, bx), 10},
+	{"by", offsetof(Triangle, by), 10},
+	{"cx", offsetof(Triangle, cx), 10},
+	{"cy", offsetof(Triangle, cy), 10}
 };
 
-//-----------------------------------------------------------------------------
-///
-/// Read a line from file, reading stops after newline or EOF, if newline
-/// is read, then it's included in the buffer, buffer of sufficient size will
-/// be allocated (and has to be freed later on if function returns
-/// PARSE_SUCCESS)
-///
-/// @param line_buffer pointer to a char pointer, this char pointer will point
-///                    to a char array containing the read line if
-///                    function returns PARSE_SUCCESS
-/// @param n           pointer to an integer that will store size of the data
-///                    data array if function returns PARSE_SUCCESS
-/// @param file        file structure to read from
-///
-/// @return PARSE_SUCCESS on success, PARSE_ERR_OUT_OF_MEM or PARSE_ERR_EOF
-///         (if end of file is reached)
-//
-static int readline(char **line_buffer, int *n, FILE *file)
-{
-	int ret;
+static const PropertyDef prop_line[] = {
+	{"id", offsetof(Line, id), 10},
+	{"color", offsetof(Line, color), 16},
+	{"x1", offsetof(Line, x1), 10},
+	{"y1", offsetof(Line, y1), 10},
+	{"x2", offsetof(Line, x2), 10},
+	{"y2", offsetof(Line, y2), 10},
+	{"width", offsetof(Line, width), 10}
+};
 
-	/* allocate buffer */
-	int buffer_size = LINE_INCREMENT;
-	char *buffer = malloc(buffer_size);
-	int index = 0;
-	if (buffer == NULL)
-	{
-		return PARSE_ERR_OUT_OF_MEM;
-	}
+static const PropertyDef prop_polyline[] = {
+	{"id", offsetof(Polyline, id), 10},
+	{"color", offsetof(Polyline, color), 16},
+	{"width", offsetof(Polyline, width), 10},
+	{"points", offsetof(Polyline, points), PARSE_BASE_POINTS}
+};
 
-	buffer[index] = fgetc(file);
-	while (buffer[index] != EOF && buffer[index] != '\n')
-	{
-		index++;
+static const PropertyDef prop_polygon[] = {
+	{"id", offsetof(Polygon, id), 10},
+	{"color", offsetof(Polygon, color), 16},
+	{"rule", offsetof(Polygon, rule), PARSE_BASE_RULE},
+	{"points", offsetof(Polygon, points), PARSE_BASE_POINTS}
+};
 
-		/* if necessary realloc memory */
-		if (index >= (buffer_size - 1)) /* (buffer_size - 1) is necessary so
-										 * that always a byte for terminating
-										 * zero is available
-										 */
-		{
-			buffer_size += LINE_INCREMENT;
-			char *buffer_new = realloc(buffer, buffer_size);
-			if (buffer_new == NULL)
-			{
-				ret = PARSE_ERR_OUT_OF_MEM;
-				goto readline_cleanup;
-			}
-			buffer = buffer_new;
-		}
+static const PropertyDef prop_ellipse[] = {
+	{"id", offsetof(Ellipse, id), 10},
+	{"color", offsetof(Ellipse, color), 16},
+	{"x", offsetof(Ellipse, x), 10},
+	{"y", offsetof(Ellipse, y), 10},
+	{"rx", offsetof(Ellipse, rx), 10},
+	{"ry", offsetof(Ellipse, ry), 10}
+};
 
-		buffer[index] = fgetc(file);
-	}
+static const PropertyDef prop_ring[] = {
+	{"id", offsetof(Ring, id), 10},
+	{"color", offsetof(Ring, color), 16},
+	{"x", offsetof(Ring, x), 10},
+	{"y", offsetof(Ring, y), 10},
+	{"inner", offsetof(Ring, inner), 10},
+	{"outer", offsetof(Ring, outer), 10}
+};
 
-	if (index == 0 && buffer[index] == EOF)
-	{
-		ret = PARSE_ERR_EOF;
-		goto readline_cleanup;
-	}
+static const PropertyDef prop_roundrect[] = {
+	{"id", offsetof(RoundRect, id), 10},
+	{"color", offsetof(RoundRect, color), 16},
+	{"x", offsetof(RoundRect, x), 10},
+	{"y", offsetof(RoundRect, y), 10},
+	{"width", offsetof(RoundRect, width), 10},
+	{"height", offsetof(RoundRect, height), 10},
+	{"radius", offsetof(RoundRect, radius), 10}
+};
+
+static const PropertyDef prop_symbol[] = {
+	{"id", offsetof(Symbol, id), 10},
+	{"width", offsetof(Symbol, width), 10},
+	{"height", offsetof(Symbol, height), 10}
+};
 
-	buffer[index + 1] = 0; /* terminate the string */
-	*n = buffer_size;
-	*line_buffer = buffer;
+static const PropertyDef prop_use[] = {
+	{"id", offsetof(Use, id), 10},
+	{"symbol", offsetof(Use, symbol), 10},
+	{"x", offsetof(Use, x), 10},
+	{"y", offsetof(Use, y), 10}
+};
 
-	return PARSE_SUCCESS;
+static const PropertyDef prop_points[] = {
+	{"id", offsetof(Points, id), 10},
+	{"color", offsetof(Points, color), 16},
+	{"radius", offsetof(Points, radius), 10},
+	{"file", offsetof(Points, file), PARSE_BASE_PATH},
+	{"layout", offsetof(Points, layout), PARSE_BASE_LAYOUT}
+};
 
-readline_cleanup:
-	free(buffer);
-	return ret;
-}
+static const PropertyDef prop_grid[] = {
+	{"id", offsetof(Grid, id), 10},
+	{"x", offsetof(Grid, x), 10},
+	{"y", offsetof(Grid, y), 10},
+	{"cell_width", offsetof(Grid, cell_width), 10},
+	{"cell_height", offsetof(Grid, cell_height), 10},
+	{"columns", offsetof(Grid, columns), 10},
+	{"rows", offsetof(Grid, rows), 10},
+	{"file", offsetof(Grid, file), PARSE_BASE_PATH}
+};
+
+static const PropertyDef prop_image[] = {
+	{"id", offsetof(Image, id), 10},
+	{"x", offsetof(Image, x), 10},
+	{"y", offsetof(Image, y), 10},
+	{"width", offsetof(Image, width), 10},
+	{"height", offsetof(Image, height), 10},
+	{"file", offsetof(Image, file), PARSE_BASE_PATH}
+};
+
+static const PropertyDef prop_gradient[] = {
+	{"id", offsetof(Gradient, id), 10},
+	{"kind", offsetof(Gradient, kind), PARSE_BASE_KIND},
+	{"x1", offsetof(Gradient, x1), 10},
+	{"y1", offsetof(Gradient, y1), 10},
+	{"x2", offsetof(Gradient, x2), 10},
+	{"y2", offsetof(Gradient, y2), 10},
+	{"stops", offsetof(Gradient, stops), PARSE_BASE_STOPS}
+};
+
+static const PropertyDef prop_text[] = {
+	{"id", offsetof(Text, id), 10},
+	{"color", offsetof(Text, color), 16},
+	{"x", offsetof(Text, x), 10},
+	{"y", offsetof(Text, y), 10},
+	{"scale", offsetof(Text, scale), 10},
+	{"text", offsetof(Text, text), PARSE_BASE_TEXT}
+};
+
+#define PROPERTIES(table) table, (int)(sizeof(table) / sizeof(table[0]))
+
+static const ShapeDef shape_defs[] = {
+	{"rectangle", SH_RECTANGLE, sizeof(Rectangle), PROPERTIES(prop_rectangle)},
+	{"circle", SH_CIRCLE, sizeof(Circle), PROPERTIES(prop_circle)},
+	{"triangle", SH_TRIANGLE, sizeof(Triangle), PROPERTIES(prop_triangle)},
+	{"line", SH_LINE, sizeof(Line), PROPERTIES(prop_line)},
+	{"polyline", SH_POLYLINE, sizeof(Polyline), PROPERTIES(prop_polyline)},
+	{"polygon", SH_POLYGON, sizeof(Polygon), PROPERTIES(prop_polygon)},
+	{"ellipse", SH_ELLIPSE, sizeof(Ellipse), PROPERTIES(prop_ellipse)},
+	{"ring", SH_RING, sizeof(Ring), PROPERTIES(prop_ring)},
+	{"roundrect", SH_ROUNDRECT, sizeof(RoundRect),
+	 PROPERTIES(prop_roundrect)},
+	{"define", SH_SYMBOL, sizeof(Symbol), PROPERTIES(prop_symbol)},
+	{"use", SH_USE, sizeof(Use), PROPERTIES(prop_use)},
+	{"points", SH_POINTS, sizeof(Points), PROPERTIES(prop_points)},
+	{"grid", SH_GRID, sizeof(Grid), PROPERTIES(prop_grid)},
+	{"image", SH_IMAGE, sizeof(Image), PROPERTIES(prop_image)},
+	{"gradient", SH_GRADIENT, sizeof(Gradient), PROPERTIES(prop_gradient)},
+	{"text", SH_TEXT, sizeof(Text), PROPERTIES(prop_text)}
+};
+
+#define SHAPE_DEF_COUNT (int)(sizeof(shape_defs) / sizeof(shape_defs[0]))
+
+/* what parse_lines keeps from one part of the input to the next */
+typedef struct _ParseState_ {
+	Symbol *open;    /* symbol whose shapes are read (after its define line
+	                  * up to the end line), NULL outside of symbols */
+	List *symbols;   /* pointers to the symbols defined so far */
+	List *gradients; /* pointers to the gradients defined so far */
+} ParseState;
 
 //-----------------------------------------------------------------------------
 ///
-/// Helper function for adding a part of a string to a linked list
+/// Compares a token (not terminated by zero) with a string
 ///
-/// @param list        list where the part of the string will be appended
-/// @param line        pointer to a char array containing a string
-/// @param index_start index of the first char which will be appended to list
-/// @param index_end   index of the first char that won't be appended any more
+/// @param token   first char of the token
+/// @param length  length of the token
+/// @param name    zero terminated string
 ///
-/// @return PARSE_SUCCESS on success, PARSE_ERR_OUT_OF_MEM or PARSE_ERR_LIST
-///         (for errors given back from linked_list library)
+/// @return 1 if the token equals the string, 0 otherwise
 //
-static int insert_split_to_list(LinkedList *list,
-								char *line, int index_start, int index_end)
+static int token_equals(const char *token, size_t length, const char *name)
 {
-	/* check index bounds */
-	if (index_end > index_start)
-	{
-		/* calculate size of string that will be appended to list */
-		int size = index_end - index_start + 1;
-
-		/* allocate temporary buffer for string that will be appended to list */
-		char *buffer = malloc(size);
-		if (buffer == NULL)
-		{
-			return PARSE_ERR_OUT_OF_MEM;
-		}
-
-		/* copy string to the temporary buffer */
-		strncpy(buffer, line + index_start, size - 1);
-		buffer[size - 1] = 0; /* to ensure that there is terminating zero at end */
-
-		/* append string to list */
-		int ret = linked_list_append(list, buffer, size);
-		int error_success = PARSE_SUCCESS;
-		if (ret != LINKED_LIST_SUCCESS)
-		{
-			if (ret == LINKED_LIST_ERR_OUT_OF_MEMORY)
-			{
-				error_success = PARSE_ERR_OUT_OF_MEM;
-			}
-			else
-			{
-				error_success = PARSE_ERR_LIST;
-			}
-		}
-
-		/* free temporary buffer */
-		free(buffer);
-		return error_success;
-	}
-	return PARSE_ERR_INDEX_OUT_OF_BOUND;
+	return strncmp(token, name, length) == 0 && name[length] == 0;
 }
 
 //-----------------------------------------------------------------------------
 ///
-/// Split a char array into a list of smaller char arrays.
-/// String will be split at spaces (removing the spaces from the result)
-/// and at every equal sign (including the equal sign as a separate split part
-/// in the result)
+/// Converts the value of a property to an integer like strtol would (leading
+/// white space, sign and for hexadecimal values a "0x" are allowed), but on
+/// a string that is not terminated by zero. The whole value has to be a
+/// number.
 ///
-/// @param line     pointer to char array containing the string to be split
+/// @param value   first char of the value (after the opening double quote)
+/// @param length  length of the value (without the double quotes)
+/// @param base    10 or 16
+/// @param result  pointer to an integer in which the converted value will
+///                be written
 ///
-/// @return pointer to a LinkedList that contains the split string parts or
-///         return NULL if memory allocation failed or NULL if list has grown
-///         too long
+/// @return PARSE_SUCCESS on success, PARSE_ERR_INVALID_INPUT otherwise
 //
-static LinkedList *split_line(char *line)
+static int convert_to_value(const char *value, size_t length, int base,
+							int *result)
 {
-	/* create new linked list for splitted strings */
-	LinkedList *split = linked_list_new();
-	if (split == NULL)
+	size_t index = 0;
+	while (index < length && (value[index] == ' ' || value[index] == '\t' ||
+							  value[index] == '\f' || value[index] == '\v'))
 	{
-		return NULL;
+		index++;
 	}
 
-	/* search line for spaces and equal signs */
-	int index_end = 0, index_start = 0;
-	int ret;
-	/* iterate through string until end of string */
-	while (line[index_end] != 0 && line[index_end] != '\n')
-	{
-		/* split at space */
-		if (line[index_end] == ' ')
-		{
-			/*
-			 * Check whether the immediate next character after space or '='
-			 * is also an equal sign because then the "last part" oft the string
-			 * is empty and hence should not be copied to the list
-			 */
-			if (index_start != index_end) {
-				/* insert the last part of the string to the list */
-				ret = insert_split_to_list(split, line, index_start, index_end);
-				if (ret != PARSE_SUCCESS)
-				{
-					return NULL;
-				}
-			}
+	int negative = 0;
+	if (index < length && (value[index] == '+' || value[index] == '-'))
+	{
+		negative = value[index] == '-';
+		index++;
+	}
 
-			/* jump over remaining spaces */
-			while (line[index_end] == ' ')
-			{
-				index_end++;
-			}
-			index_start = index_end;
-		}
-		else if (line[index_end] == '=')
-		{
-			/*
-			 * Check whether the immediate next character after space or '='
-			 * is also an equal sign because then the "last part" oft the string
-			 * is empty and hence should not be copied to the list
-			 */
-			if (index_start != index_end) {
-				/* insert the last part of the string to the list */
-				ret = insert_split_to_list(split, line, index_start, index_end);
-				if (ret != PARSE_SUCCESS)
-				{
-					return NULL;
-				}
-			}
+	if (base == 16 && index + 2 < length && value[index] == '0' &&
+		(value[index + 1] == 'x' || value[index + 1] == 'X'))
+	{
+		index += 2;
+	}
 
-			/* insert the equal sign to the string */
-			index_start = index_end;
-			index_end++;
-			ret = insert_split_to_list(split, line, index_start, index_end);
-			if (ret != PARSE_SUCCESS)
-			{
-				return NULL;
-			}
+	if (index == length)
+	{
+		return PARSE_ERR_INVALID_INPUT;
+	}
 
-			/* update index_start to character after '=' */
-			index_start = index_end;
+	/* saturate like strtol, the conversion to int truncates like before */
+	int64_t num = 0;
+	for (; index < length; index++)
+	{
+		char c = value[index];
+		int digit;
+		if (c >= '0' && c <= '9')
+		{
+			digit = c - '0';
+		}
+		else if (base == 16 && c >= 'a' && c <= 'f')
+		{
+			digit = c - 'a' + 10;
+		}
+		else if (base == 16 && c >= 'A' && c <= 'F')
+		{
+			digit = c - 'A' + 10;
 		}
 		else
 		{
-			index_end++;
+			return PARSE_ERR_INVALID_INPUT;
 		}
-	}
 
-	/*
-	 * If there is remaining part in the string which was not appended to list,
-     * then append it
-	 */
-	if (index_start != index_end)
-	{
-		ret = insert_split_to_list(split, line, index_start, index_end);
-		if (ret != PARSE_SUCCESS)
+		if (num <= (INT64_MAX - digit) / base)
+		{
+			num = num * base + digit;
+		}
+		else
 		{
-			return NULL;
+			num = INT64_MAX;
 		}
 	}
 
-	return split;
+	if (negative)
+	{
+		num = (num == INT64_MAX) ? INT64_MIN : -num;
+	}
+	*result = (int)num;
+	return PARSE_SUCCESS;
 }
 
 //-----------------------------------------------------------------------------
 ///
-/// Converts the string containing a property value to an integer value
+/// Converts the value of a fill rule property ("evenodd" or "nonzero") to a
+/// FillRule
 ///
-/// @param value_string  string containing the value, starting and ending with "
-///                      (double quote)
-/// @param value         Pointer to an integer in which the converted value will
-///                      be written
-/// @param base          the base of the represented string (hexadecimal,
-///                      decimal...)
+/// @param value   first char of the value (after the opening double quote)
+/// @param length  length of the value (without the double quotes)
+/// @param result  pointer to an integer in which the FillRule will be written
 ///
 /// @return PARSE_SUCCESS on success, PARSE_ERR_INVALID_INPUT otherwise
 //
-static int convert_to_value(char *value_string, int64_t *value, int base)
+static int convert_to_rule(const char *value, size_t length, int *result)
 {
-	/* check double quote at beginning of string */
-	if (value_string[0] != '"')
-	{
-		return PARSE_ERR_INVALID_INPUT;
-	}
-
-	/* search for end of string */
-	int index = 0;
-	int secure_counter = PARSE_MAX_VALUE_STRING_LENGTH;
-	while (value_string[index] != 0 || secure_counter < 0)
-	{
-		index++;
-		secure_counter--;
-	}
-	if (index <= 2)
+	if (token_equals(value, length, "evenodd"))
 	{
-		return PARSE_ERR_INVALID_INPUT;
-	}
-
-	/* check double quote at end of string */
-	if (value_string[index - 1] != '"')
-	{
-		return PARSE_ERR_INVALID_INPUT;
+		*result = FILL_EVENODD;
+		return PARSE_SUCCESS;
 	}
-	value_string[index - 1] = 0; /* temporarily remove the '"' by a \0 */
-
-	/* convert to integer */
-	char *endptr;
-	int num = strtol(value_string + 1, &endptr, base);
-	if (*endptr != 0)
+	if (token_equals(value, length, "nonzero"))
 	{
-		return PARSE_ERR_INVALID_INPUT;
+		*result = FILL_NONZERO;
+		return PARSE_SUCCESS;
 	}
-
-	value_string[index - 1] = '"'; /* restore the '"' instead of the \0 */
-
-	*value = num;
-	return PARSE_SUCCESS;
+	return PARSE_ERR_INVALID_INPUT;
 }
 
 //-----------------------------------------------------------------------------
 ///
-/// Takes a list coming from split_line function and translates it to a list
-/// of Property structures
+/// Converts the value of a layout property to a PointsLayout
 ///
-/// @param split_list   List as outputted by split_line function
-/// @param prop_list    Pointer to a pointer to a list that later will be set
-///                     pointing to the list with properties
+/// @param value   first char of the value (after the opening double quote)
+/// @param length  length of the value (without the double quotes)
+/// @param result  pointer to an integer in which the PointsLayout will be
+///                written
 ///
-/// @return PARSE_SUCCESS on success, PARSE_ERR_PASSED_NULL_POINTER,
-///         PARSE_ERR_OUT_OF_MEM, PARSE_ERR_INVALID_INPUT or
-///         PARSE_ERR_PROPERTY_NAME_TOO_LONG otherwise
+/// @return PARSE_SUCCESS on success, PARSE_ERR_INVALID_INPUT otherwise
 //
-static int split_to_properties(LinkedList *split_list, List **prop_list)
+static int convert_to_layout(const char *value, size_t length, int *result)
 {
-	/* check whether parameters were passed correctly */
-	if (prop_list == NULL)
-	{
-		return PARSE_ERR_PASSED_NULL_POINTER;
-	}
-
-	if (split_list == NULL)
+	if (token_equals(value, length, "xy"))
 	{
-		return PARSE_ERR_PASSED_NULL_POINTER;
+		*result = POINTS_XY;
+		return PARSE_SUCCESS;
 	}
-
-	/* create property list */
-	List *list = list_new(sizeof(Property));
-	if (list == NULL)
+	if (token_equals(value, length, "xyc"))
 	{
-		return PARSE_ERR_OUT_OF_MEM;
+		*result = POINTS_XYC;
+		return PARSE_SUCCESS;
 	}
+	return PARSE_ERR_INVALID_INPUT;
+}
 
-	Property prop;
-	int ret;
-
-	/* get first property which doesn't have a value */
-	int data_size;
-	char *command = linked_list_get(split_list, 0, &data_size);
-	if (command == NULL)
+//-----------------------------------------------------------------------------
+///
+/// Converts the value of a kind property to a GradientKind
+///
+/// @param value   first char of the value (after the opening double quote)
+/// @param length  length of the value (without the double quotes)
+/// @param result  pointer to an integer in which the GradientKind will be
+///                written
+///
+/// @return PARSE_SUCCESS on success, PARSE_ERR_INVALID_INPUT otherwise
+//
+static int convert_to_kind(const char *value, size_t length, int *result)
+{
+	if (token_equals(value, length, "linear"))
 	{
-		return PARSE_ERR_INVALID_INPUT;
+		*result = GRADIENT_LINEAR;
+		return PARSE_SUCCESS;
 	}
-	if (data_size >= PARSE_MAX_PROPERTY_NAME_LENGTH)
+	if (token_equals(value, length, "radial"))
 	{
-		return PARSE_ERR_PROPERTY_NAME_TOO_LONG;
+		*result = GRADIENT_RADIAL;
+		return PARSE_SUCCESS;
 	}
+	return PARSE_ERR_INVALID_INPUT;
+}
 
-	strncpy(prop.name, command, data_size);
-	prop.name[PARSE_MAX_PROPERTY_NAME_LENGTH - 1] = 0;
-	prop.value = 0;
-
-	/* append the command to list */
-	ret = list_append(list, &prop);
-	if (ret != LIST_SUCCESS)
+//-----------------------------------------------------------------------------
+///
+/// Converts a point list "x,y x,y ..." (points separated by spaces, the
+/// coordinates of a point by a comma) to numbers, or only counts the points
+///
+/// @param value   first char of the value (after the opening double quote)
+/// @param length  length of the value (without the double quotes)
+/// @param xy      receives x and y of each point, NULL to only count them
+/// @param count   pointer to the number of points
+///
+/// @return PARSE_SUCCESS on success, PARSE_ERR_INVALID_INPUT if the list is
+///         malformed or has less than two points
+//
+static int convert_to_points(const char *value, size_t length, int *xy,
+							 int *count)
+{
+	size_t pos = 0;
+	int n = 0;
+	for (;;)
 	{
-		if (ret == LIST_ERR_OUT_OF_MEMORY)
-		{
-			return PARSE_ERR_OUT_OF_MEM;
-		}
-		else
+		while (pos < length && value[pos] == ' ')
 		{
-			return PARSE_ERR_LIST;
+			pos++;
 		}
-	}
-
-	/* get all other properties */
-	int index = 1;
-	command = linked_list_get(split_list, index, &data_size);
-	while (command != NULL)
-	{
-		/* get property name */
-		if (data_size >= PARSE_MAX_PROPERTY_NAME_LENGTH)
+		if (pos == length)
 		{
-			return PARSE_ERR_PROPERTY_NAME_TOO_LONG;
+			break;
 		}
-		strncpy(prop.name, command, data_size);
-		prop.name[PARSE_MAX_PROPERTY_NAME_LENGTH - 1] = 0;
-
-		index++;
 
-		/* next command must be equal sign */
-		command = linked_list_get(split_list, index, &data_size);
-		if (command == NULL)
+		/* x up to the comma, y up to the next space */
+		const char *comma = memchr(value + pos, ',', length - pos);
+		if (comma == NULL)
 		{
 			return PARSE_ERR_INVALID_INPUT;
 		}
-		if (strncmp(command, "=", data_size) != 0)
+		size_t y_start = comma - value + 1;
+		size_t end = y_start;
+		while (end < length && value[end] != ' ')
 		{
-			return PARSE_ERR_INVALID_INPUT;
+			end++;
 		}
 
-		index++;
-
-		/* next command is the value */
-		command = linked_list_get(split_list, index, &data_size);
-		if (command == NULL)
+		int x, y;
+		if (convert_to_value(value + pos, y_start - 1 - pos, 10, &x) !=
+			PARSE_SUCCESS ||
+			convert_to_value(value + y_start, end - y_start, 10, &y) !=
+			PARSE_SUCCESS)
 		{
 			return PARSE_ERR_INVALID_INPUT;
 		}
-
-		/* convert value */
-		int base = 10;
-		if (strcmp(prop.name, "color") == 0)
-		{
-			base = 16;
-		}
-		ret = convert_to_value(command, &prop.value, base);
-		if (ret != PARSE_SUCCESS)
-		{
-			return ret;
-		}
-
-		/* append the command to list */
-		ret = list_append(list, &prop);
-		if (ret != LIST_SUCCESS)
+		if (xy != NULL)
 		{
-			if (ret == LIST_ERR_OUT_OF_MEMORY)
-			{
-				return PARSE_ERR_OUT_OF_MEM;
-			}
-			else
-			{
-				return PARSE_ERR_LIST;
-			}
+			xy[2 * n] = x;
+			xy[2 * n + 1] = y;
 		}
+		n++;
+		pos = end;
+	}
 
-		/* next command for next property */
-		index++;
-		command = linked_list_get(split_list, index, &data_size);
+	if (n < 2)
+	{
+		return PARSE_ERR_INVALID_INPUT;
 	}
-	*prop_list = list;
+	*count = n;
 	return PARSE_SUCCESS;
 }
 
 //-----------------------------------------------------------------------------
 ///
-/// Find a specific property in a property list
+/// Converts a stop list "offset:color offset:color ..." (stops separated by
+/// spaces, offset in percent and the hexadecimal color by a colon) to stops,
+/// or only counts the stops
 ///
-/// @param list    pointer to the list as returned by split_to_properties
-/// @param name    name of the property that is searched for
-/// @param value   pointer to an integer in which the value of the property will
-///                be stored
+/// @param value   first char of the value (after the opening double quote)
+/// @param length  length of the value (without the double quotes)
+/// @param stops   receives the stops, NULL to only count them
+/// @param count   pointer to the number of stops
 ///
-/// @return PARSE_SUCCESS on success or PARSE_ERR_PASSED_NULL_POINTER,
-/// PARSE_ERR_INVALID_INPUT (if property isn't found) otherwise
+/// @return PARSE_SUCCESS on success, PARSE_ERR_INVALID_INPUT if the list is
+///         malformed, has less than two stops or an offset is not from 0 to
+///         100 or less than the one before
 //
-static int find_property(List *list, char *name, int *value)
+static int convert_to_stops(const char *value, size_t length,
+							GradientStop *stops, int *count)
 {
-	/* check whether list is NULL */
-	if (list == NULL)
-	{
-		return PARSE_ERR_PASSED_NULL_POINTER;
-	}
-
-	/* search list for correct command */
-	int index_command = 0;
-	Property *prop_command = list_get(list, index_command);
-	while (prop_command != NULL)
+	size_t pos = 0;
+	int n = 0;
+	int last = 0;
+	for (;;)
 	{
-		if (strcmp(prop_command->name, name) == 0)
+		while (pos < length && value[pos] == ' ')
+		{
+			pos++;
+		}
+		if (pos == length)
 		{
-			*value = prop_command->value;
 			break;
 		}
 
-		index_command++;
-		prop_command = list_get(list, index_command);
+		/* offset up to the colon, color up to the next space */
+		const char *colon = memchr(value + pos, ':', length - pos);
+		if (colon == NULL)
+		{
+			return PARSE_ERR_INVALID_INPUT;
+		}
+		size_t color_start = colon - value + 1;
+		size_t end = color_start;
+		while (end < length && value[end] != ' ')
+		{
+			end++;
+		}
+
+		int offset, color;
+		if (convert_to_value(value + pos, color_start - 1 - pos, 10,
+							 &offset) != PARSE_SUCCESS ||
+			convert_to_value(value + color_start, end - color_start, 16,
+							 &color) != PARSE_SUCCESS ||
+			offset < last || offset > 100)
+		{
+			return PARSE_ERR_INVALID_INPUT;
+		}
+		if (stops != NULL)
+		{
+			stops[n].offset = offset;
+			stops[n].color = color;
+		}
+		last = offset;
+		n++;
+		pos = end;
 	}
 
-	/* if prop_command after while is NULL, then property wasn't found */
-	if (prop_command == NULL)
+	if (n < 2)
 	{
 		return PARSE_ERR_INVALID_INPUT;
 	}
-
+	*count = n;
 	return PARSE_SUCCESS;
 }
 
 //-----------------------------------------------------------------------------
 ///
-/// Converts a list containing the properties to an command structure of the
-/// given shape
-/// If (and only if) function returns PARSE_SUCCESS, then caller is responsible
-/// to properly free the Command pointed to by command pointer (for Command the
-/// command->obj and command itself have to be freed!)
+/// Parses one line of the input into a command. The line is read in place,
+/// it does not have to be terminated by zero and is not modified.
+/// A line is the shape name followed by properties name="value", separated
+/// by spaces (spaces around the equal sign are allowed). Properties the
+/// shape doesn't have are ignored, if a property is given twice the first
+/// value is used. Shapes with a color can have a fill property, the id of a
+/// gradient they are filled with (see parse_fill).
+/// If and only if the function returns PARSE_SUCCESS, the caller is
+/// responsible to free command->obj.
 ///
-/// @param list    pointer to the list as returned by split_to_properties
-/// @param command pointer to an pointer to an command structure. After
-///                calling the function this pointer will point to the newly
-///                created command
+/// @param line     first char of the line
+/// @param length   length of the line without the newline
+/// @param command  pointer to the command that will be filled
+/// @param fill     receives the id of the fill property, -1 without it
 ///
-/// @return PARSE_SUCCESS on success, PARSE_ERR_PASSED_NULL_POINTER,
-///         PARSE_ERR_OUT_OF_MEM or PARSE_ERR_INVALID_INPUT otherwise
+/// @return PARSE_SUCCESS on success, PARSE_ERR_OUT_OF_MEM,
+///         PARSE_ERR_PROPERTY_NAME_TOO_LONG or PARSE_ERR_INVALID_INPUT
+///         otherwise
 //
-static int properties_to_command(List *list, Command **command)
+static int parse_span(const char *line, size_t length, Command *command,
+					  int64_t *fill)
 {
 	int ret;
+	size_t pos = 0;
+	*fill = -1;
 
-	/* check whether list is NULL */
-	if (list == NULL)
+	/* a carriage return of a windows line ending is no part of the line */
+	if (length > 0 && line[length - 1] == '\r')
 	{
-		return PARSE_ERR_PASSED_NULL_POINTER;
+		length--;
 	}
 
-	/* get properties */
-	Property *prop_command = list_get(list, 0);
-	int value;
-	if (prop_command == NULL)
+	/* shape name */
+	while (pos < length && line[pos] == ' ')
+	{
+		pos++;
+	}
+	size_t start = pos;
+	while (pos < length && line[pos] != ' ' && line[pos] != '=')
+	{
+		pos++;
+	}
+	if (pos == start)
 	{
 		return PARSE_ERR_INVALID_INPUT;
 	}
-
-	Command *comm = malloc(sizeof(Command));
-	if (comm == NULL)
+	if (pos - start >= PARSE_MAX_PROPERTY_NAME_LENGTH)
 	{
-		return PARSE_ERR_OUT_OF_MEM;
+		return PARSE_ERR_PROPERTY_NAME_TOO_LONG;
 	}
-	memset(comm, 0, sizeof(Command));
 
-	/* check shape of the command */
-	if (strcmp(prop_command->name, "rectangle") == 0)
+	const ShapeDef *def = NULL;
+	for (int i = 0; i < SHAPE_DEF_COUNT; i++)
 	{
-		/* rectangle */
-
-		/* allocate memory for rectangle */
-		Rectangle *rect = malloc(sizeof(Rectangle));
-		if (rect == NULL)
+		if (token_equals(line + start, pos - start, shape_defs[i].name))
 		{
-			ret = PARSE_ERR_OUT_OF_MEM;
-			goto properties_to_command_cleanup1;
+			def = &shape_defs[i];
+			break;
 		}
-		memset(rect, 0, sizeof(Rectangle));
+	}
+	if (def == NULL)
+	{
+		return PARSE_ERR_INVALID_INPUT;
+	}
 
-		comm->shape = SH_RECTANGLE;
-		comm->obj = rect;
+	char *obj = malloc(def->size);
+	if (obj == NULL)
+	{
+		return PARSE_ERR_OUT_OF_MEM;
+	}
+	memset(obj, 0, def->size);
+	int colored = 0;
+	for (int i = 0; i < def->property_count; i++)
+	{
+		colored |= strcmp(def->properties[i].name, "color") == 0;
+	}
 
-		/* read and set property values */
-		ret = find_property(list, "id", &value);
-		rect->id = value;
-		comm->id = value;
-		if (ret != PARSE_SUCCESS)
+	/* properties */
+	uint32_t found = 0;
+	for (;;)
+	{
+		while (pos < length && line[pos] == ' ')
 		{
-			goto properties_to_command_cleanup2;
+			pos++;
 		}
-
-		ret = find_property(list, "color", &value);
-		rect->color = value;
-		if (ret != PARSE_SUCCESS)
+		if (pos == length)
 		{
-			goto properties_to_command_cleanup2;
+			break;
 		}
 
-		ret = find_property(list, "x", &value);
-		rect->x = value;
-		if (ret != PARSE_SUCCESS)
+		/* name */
+		start = pos;
+		while (pos < length && line[pos] != ' ' && line[pos] != '=')
 		{
-			goto properties_to_command_cleanup2;
+			pos++;
 		}
-
-		ret = find_property(list, "y", &value);
-		rect->y = value;
-		if (ret != PARSE_SUCCESS)
+		size_t name_length = pos - start;
+		if (name_length == 0)
 		{
-			goto properties_to_command_cleanup2;
+			ret = PARSE_ERR_INVALID_INPUT;
+			goto parse_span_cleanup1;
 		}
-
-		ret = find_property(list, "width", &value);
-		rect->width = value;
-		if (ret != PARSE_SUCCESS)
+		if (name_length >= PARSE_MAX_PROPERTY_NAME_LENGTH)
 		{
-			goto properties_to_command_cleanup2;
+			ret = PARSE_ERR_PROPERTY_NAME_TOO_LONG;
+			goto parse_span_cleanup1;
 		}
+		const char *name = line + start;
 
-		ret = find_property(list, "height", &value);
-		rect->height = value;
-		if (ret != PARSE_SUCCESS)
+		/* equal sign */
+		while (pos < length && line[pos] == ' ')
 		{
-			goto properties_to_command_cleanup2;
+			pos++;
 		}
-	}
-	else if (strcmp(prop_command->name, "triangle") == 0)
-	{
-		/* triangle */
-
-		/* allocate memory for triangle */
-		Triangle *triangle = malloc(sizeof(Triangle));
-		if (triangle == NULL)
+		if (pos == length || line[pos] != '=')
 		{
-			ret = PARSE_ERR_OUT_OF_MEM;
-			goto properties_to_command_cleanup1;
+			ret = PARSE_ERR_INVALID_INPUT;
+			goto parse_span_cleanup1;
 		}
-		memset(triangle, 0, sizeof(Triangle));
-
-		comm->shape = SH_TRIANGLE;
-		comm->obj = triangle;
-
-		/* read and set properties */
-		ret = find_property(list, "id", &value);
-		triangle->id = value;
-		comm->id = value;
-		if (ret != PARSE_SUCCESS)
+		pos++;
+		while (pos < length && line[pos] == ' ')
 		{
-			goto properties_to_command_cleanup2;
+			pos++;
 		}
 
-		ret = find_property(list, "color", &value);
-		triangle->color = value;
-		if (ret != PARSE_SUCCESS)
+		/* value in double quotes, followed by a space or the end of line */
+		if (pos == length || line[pos] != '"')
 		{
-			goto properties_to_command_cleanup2;
+			ret = PARSE_ERR_INVALID_INPUT;
+			goto parse_span_cleanup1;
 		}
-
-		ret = find_property(list, "ax", &value);
-		triangle->ax = value;
-		if (ret != PARSE_SUCCESS)
+		pos++;
+		start = pos;
+		const char *quote = memchr(line + pos, '"', length - pos);
+		if (quote == NULL)
 		{
-			goto properties_to_command_cleanup2;
+			ret = PARSE_ERR_INVALID_INPUT;
+			goto parse_span_cleanup1;
 		}
-
-		ret = find_property(list, "ay", &value);
-		triangle->ay = value;
-		if (ret != PARSE_SUCCESS)
+		pos = quote - line + 1;
+		if (pos < length && line[pos] != ' ')
 		{
-			goto properties_to_command_cleanup2;
+			ret = PARSE_ERR_INVALID_INPUT;
+			goto parse_span_cleanup1;
 		}
 
-		ret = find_property(list, "bx", &value);
-		triangle->bx = value;
-		if (ret != PARSE_SUCCESS)
+		/* index of the property, -1 if the shape doesn't have it */
+		int index = -1;
+		for (int i = 0; i < def->property_count; i++)
 		{
-			goto properties_to_command_cleanup2;
-		}
-
-		ret = find_property(list, "by", &value);
-		triangle->by = value;
-		if (ret != PARSE_SUCCESS)
-		{
-			goto properties_to_command_cleanup2;
+			if (token_equals(name, name_length, def->properties[i].name))
+			{
+				index = i;
+				break;
+			}
 		}
 
-		ret = find_property(list, "cx", &value);
-		triangle->cx = value;
-		if (ret != PARSE_SUCCESS)
+		/* point lists are stored behind the shape, in the same allocation */
+		if (index >= 0 && def->properties[index].base == PARSE_BASE_POINTS)
 		{
-			goto properties_to_command_cleanup2;
+			int count;
+			ret = convert_to_points(line + start, quote - line - start, NULL,
+									&count);
+			if (ret != PARSE_SUCCESS)
+			{
+				goto parse_span_cleanup1;
+			}
+			if (!(found & (1u << index)))
+			{
+				char *tmp = realloc(obj, def->size + 2 * count * sizeof(int));
+				if (tmp == NULL)
+				{
+					ret = PARSE_ERR_OUT_OF_MEM;
+					goto parse_span_cleanup1;
+				}
+				obj = tmp;
+				PointList *points = (PointList *)(obj +
+												  def->properties[index].offset);
+				points->xy = (int *)(obj + def->size);
+				convert_to_points(line + start, quote - line - start,
+								  points->xy, &points->count);
+				found |= 1u << index;
+			}
+			continue;
 		}
 
-		ret = find_property(list, "cy", &value);
-		triangle->cy = value;
-		if (ret != PARSE_SUCCESS)
+		/* stop lists too */
+		if (index >= 0 && def->properties[index].base == PARSE_BASE_STOPS)
 		{
-			goto properties_to_command_cleanup2;
+			int count;
+			ret = convert_to_stops(line + start, quote - line - start, NULL,
+								   &count);
+			if (ret != PARSE_SUCCESS)
+			{
+				goto parse_span_cleanup1;
+			}
+			if (!(found & (1u << index)))
+			{
+				char *tmp = realloc(obj, def->size +
+									count * sizeof(GradientStop));
+				if (tmp == NULL)
+				{
+					ret = PARSE_ERR_OUT_OF_MEM;
+					goto parse_span_cleanup1;
+				}
+				obj = tmp;
+				GradientStops *stops = (GradientStops *)(obj +
+					def->properties[index].offset);
+				stops->stops = (GradientStop *)(obj + def->size);
+				convert_to_stops(line + start, quote - line - start,
+								 stops->stops, &stops->count);
+				found |= 1u << index;
+			}
+			continue;
 		}
-	}
-	else if (strcmp(prop_command->name, "circle") == 0)
-	{
-		/* circle */
 
-		/* allocate memory for circle */
-		Circle *circle = malloc(sizeof(Circle));
-		if (circle == NULL)
+		/* paths and texts too, without the terminating zero in the line */
+		if (index >= 0 && (def->properties[index].base == PARSE_BASE_PATH ||
+						   def->properties[index].base == PARSE_BASE_TEXT))
 		{
-			ret = PARSE_ERR_OUT_OF_MEM;
-			goto properties_to_command_cleanup1;
+			size_t path_length = quote - line - start;
+			if ((path_length == 0 &&
+				 def->properties[index].base == PARSE_BASE_PATH) ||
+				memchr(line + start, 0, path_length))
+			{
+				ret = PARSE_ERR_INVALID_INPUT;
+				goto parse_span_cleanup1;
+			}
+			if (!(found & (1u << index)))
+			{
+				char *tmp = realloc(obj, def->size + path_length + 1);
+				if (tmp == NULL)
+				{
+					ret = PARSE_ERR_OUT_OF_MEM;
+					goto parse_span_cleanup1;
+				}
+				obj = tmp;
+				char *path = obj + def->size;
+				memcpy(path, line + start, path_length);
+				path[path_length] = 0;
+				memcpy(obj + def->properties[index].offset, &path,
+					   sizeof(char *));
+				found |= 1u << index;
+			}
+			continue;
 		}
-		memset(circle, 0, sizeof(Circle));
 
-		comm->shape = SH_CIRCLE;
-		comm->obj = circle;
-
-		/* read and set properties */
-		ret = find_property(list, "id", &value);
-		circle->id = value;
-		comm->id = value;
-		if (ret != PARSE_SUCCESS)
+		/* colors are hexadecimal, also for properties the shape doesn't have */
+		int base = token_equals(name, name_length, "color") ? 16 : 10;
+		int value;
+		if (index >= 0 && def->properties[index].base == PARSE_BASE_RULE)
 		{
-			goto properties_to_command_cleanup2;
+			ret = convert_to_rule(line + start, quote - line - start, &value);
 		}
-
-		ret = find_property(list, "color", &value);
-		circle->color = value;
-		if (ret != PARSE_SUCCESS)
+		else if (index >= 0 &&
+				 def->properties[index].base == PARSE_BASE_LAYOUT)
 		{
-			goto properties_to_command_cleanup2;
+			ret = convert_to_layout(line + start, quote - line - start,
+									&value);
 		}
-
-		ret = find_property(list, "x", &value);
-		circle->x = value;
-		if (ret != PARSE_SUCCESS)
+		else if (index >= 0 &&
+				 def->properties[index].base == PARSE_BASE_KIND)
 		{
-			goto properties_to_command_cleanup2;
+			ret = convert_to_kind(line + start, quote - line - start, &value);
+		}
+		else
+		{
+			ret = convert_to_value(line + start, quote - line - start, base,
+								   &value);
 		}
-
-		ret = find_property(list, "y", &value);
-		circle->y = value;
 		if (ret != PARSE_SUCCESS)
 		{
-			goto properties_to_command_cleanup2;
+			goto parse_span_cleanup1;
 		}
 
-		ret = find_property(list, "radius", &value);
-		circle->radius = value;
-		if (ret != PARSE_SUCCESS)
+		if (index >= 0 && !(found & (1u << index)))
+		{
+			memcpy(obj + def->properties[index].offset, &value, sizeof(int));
+			found |= 1u << index;
+		}
+		if (colored && *fill < 0 && token_equals(name, name_length, "fill"))
 		{
-			goto properties_to_command_cleanup2;
+			*fill = (id_t)value;
 		}
 	}
-	else
+
+	/* all properties of the shape are required */
+	if (found != (1u << def->property_count) - 1)
 	{
-		/* no shape recognised */
 		ret = PARSE_ERR_INVALID_INPUT;
-		goto properties_to_command_cleanup1;
+		goto parse_span_cleanup1;
 	}
 
-	/* return command via pointer */
-	*command = comm;
-
+	/* the id is the first member of every shape */
+	command->shape = def->shape;
+	memcpy(&command->id, obj, sizeof(id_t));
+	command->obj = obj;
 	return PARSE_SUCCESS;
 
-properties_to_command_cleanup2:
-	free(comm->obj);
-properties_to_command_cleanup1:
-	free(comm);
+parse_span_cleanup1:
+	free(obj);
 	return ret;
 }
 
@@ -780,6 +880,10 @@ properties_to_command_cleanup1:
 /// Parses command given as a string to the Command structure
 /// If and only if the function returns PARSE_SUCCESS, the caller is responsible
 /// to free the Command (comm->obj and comm) properly!
+/// A single line has no symbols: a define gets no shapes (shapes is NULL) and
+/// a use no symbol (def is NULL, draw_command rejects it). The files of
+/// points, grids and images are not mapped either, they draw nothing, and
+/// the fill property finds no gradient (the shape has its color).
 ///
 /// @param line    The command line read from input file, given as char array
 /// @param comm    Pointer to a pointer to a command structure. After calling
@@ -791,217 +895,775 @@ properties_to_command_cleanup1:
 //
 int parse_line(char *line, Command **comm)
 {
-	int ret;
-
-	LinkedList *split = split_line(line);
+	if (line == NULL || comm == NULL)
+	{
+		return PARSE_ERR_PASSED_NULL_POINTER;
+	}
 
-	if (split == NULL) {
-		ret = PARSE_ERR_OUT_OF_MEM;
-		goto parse_line_cleanup1;
+	Command *command = malloc(sizeof(Command));
+	if (command == NULL)
+	{
+		return PARSE_ERR_OUT_OF_MEM;
 	}
+	memset(command, 0, sizeof(Command));
 
-	List *property;
-	ret = split_to_properties(split, &property);
+	int64_t fill;
+	int ret = parse_span(line, strcspn(line, "\n"), command, &fill);
 	if (ret != PARSE_SUCCESS)
 	{
-		goto parse_line_cleanup1;
+		free(command);
+		return ret;
 	}
 
-	ret = properties_to_command(property, comm);
-	if (ret != PARSE_SUCCESS)
+	*comm = command;
+	return PARSE_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Checks whether a line is an end line (closing a symbol)
+///
+/// @param line    first char of the line
+/// @param length  length of the line without the newline
+///
+/// @return 1 if the line is "end" (spaces around it are allowed), 0 otherwise
+//
+static int parse_is_end(const char *line, size_t length)
+{
+	while (length > 0 && (line[length - 1] == ' ' || line[length - 1] == '\r'))
+	{
+		length--;
+	}
+	size_t start = 0;
+	while (start < length && line[start] == ' ')
+	{
+		start++;
+	}
+	return token_equals(line + start, length - start, "end");
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Frees a command of a list and what its obj owns (the shapes and the mask
+/// of a symbol, the mapped file of points, grids and images, the ramp of a
+/// gradient)
+///
+/// @param comm  command
+//
+static void parse_delete_command(Command *comm)
+{
+	if (comm->shape == SH_SYMBOL)
+	{
+		Symbol *symbol = comm->obj;
+		parse_delete_command_list(symbol->shapes);
+		free(symbol->mask);
+	}
+	if (comm->shape == SH_POINTS && ((Points *)comm->obj)->map != NULL)
+	{
+		munmap(((Points *)comm->obj)->map, ((Points *)comm->obj)->map_size);
+	}
+	if (comm->shape == SH_GRID && ((Grid *)comm->obj)->map != NULL)
+	{
+		munmap(((Grid *)comm->obj)->map, ((Grid *)comm->obj)->map_size);
+	}
+	if (comm->shape == SH_IMAGE)
 	{
-		goto parse_line_cleanup2;
+		bitmap_image_unmap(&((Image *)comm->obj)->bitmap);
 	}
+	if (comm->shape == SH_GRADIENT)
+	{
+		free(((Gradient *)comm->obj)->ramp);
+	}
+	free(comm->obj);
+}
 
+//-----------------------------------------------------------------------------
+///
+/// Connects a parsed command with the symbols: a define opens a symbol, which
+/// gets the shapes up to the end line, a use gets its symbol. Symbols have to
+/// be defined before they are used and contain neither defines nor uses.
+///
+/// @param state    symbols defined so far and the open one
+/// @param command  parsed command
+///
+/// @return PARSE_SUCCESS on success, PARSE_ERR_INVALID_INPUT or
+///         PARSE_ERR_OUT_OF_MEM otherwise
+//
+static int parse_symbol(ParseState *state, Command *command)
+{
+	if (command->shape == SH_USE)
+	{
+		/* the symbols are few compared to the uses, they are searched */
+		Use *use = command->obj;
+		if (state->open != NULL)
+		{
+			return PARSE_ERR_INVALID_INPUT;
+		}
+		for (int i = state->symbols->length - 1; i >= 0; i--)
+		{
+			Symbol *symbol = *(Symbol **)list_get(state->symbols, i);
+			if (symbol->id == use->symbol)
+			{
+				use->def = symbol;
+				return PARSE_SUCCESS;
+			}
+		}
+		return PARSE_ERR_INVALID_INPUT;
+	}
+
+	if (command->shape == SH_SYMBOL)
+	{
+		Symbol *symbol = command->obj;
+		if (state->open != NULL)
+		{
+			return PARSE_ERR_INVALID_INPUT;
+		}
+		symbol->shapes = list_new(sizeof(Command));
+		if (symbol->shapes == NULL ||
+			list_append(state->symbols, &symbol) != LIST_SUCCESS)
+		{
+			return PARSE_ERR_OUT_OF_MEM;
+		}
+		state->open = symbol;
+	}
+	return PARSE_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Connects a parsed command with the gradients: a gradient is added to the
+/// gradients, a shape with a fill property gets its gradient. Gradients have
+/// to be defined before they fill a shape and outside of symbols.
+///
+/// @param state    gradients defined so far and the open symbol
+/// @param command  parsed command
+/// @param fill     id of the fill property of the command, -1 without it
+///
+/// @return PARSE_SUCCESS on success, PARSE_ERR_INVALID_INPUT or
+///         PARSE_ERR_OUT_OF_MEM otherwise
+//
+static int parse_fill(ParseState *state, Command *command, int64_t fill)
+{
+	if (command->shape == SH_GRADIENT)
+	{
+		Gradient *gradient = command->obj;
+		if (state->open != NULL)
+		{
+			return PARSE_ERR_INVALID_INPUT;
+		}
+		if (list_append(state->gradients, &gradient) != LIST_SUCCESS)
+		{
+			return PARSE_ERR_OUT_OF_MEM;
+		}
+		return PARSE_SUCCESS;
+	}
+
+	if (fill < 0)
+	{
+		return PARSE_SUCCESS;
+	}
+	/* like symbols searched, the last one first */
+	for (int i = state->gradients->length - 1; i >= 0; i--)
+	{
+		Gradient *gradient = *(Gradient **)list_get(state->gradients, i);
+		if (gradient->id == fill)
+		{
+			command->fill = gradient;
+			return PARSE_SUCCESS;
+		}
+	}
+	return PARSE_ERR_INVALID_INPUT;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Maps a file read only, the pages are shared with the page cache, so
+/// the data of a big file is not copied
+///
+/// @param path  path of the file
+/// @param map   receives the mapping, NULL for an empty file
+/// @param size  receives the size of the file
+///
+/// @return PARSE_SUCCESS on success, PARSE_ERR_INVALID_INPUT if the file is
+///         no regular file or can't be mapped
+//
+static int parse_map_file(const char *path, void **map, size_t *size)
+{
+	int ret = PARSE_ERR_INVALID_INPUT;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return PARSE_ERR_INVALID_INPUT;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+		(uint64_t)st.st_size > SIZE_MAX)
+	{
+		goto parse_map_file_cleanup1;
+	}
+	*map = NULL;
+	*size = st.st_size;
+	if (*size > 0)
+	{
+		*map = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (*map == MAP_FAILED)
+		{
+			*map = NULL;
+			goto parse_map_file_cleanup1;
+		}
+	}
+	STATS_ADD(bytes_read, *size);
 	ret = PARSE_SUCCESS;
-parse_line_cleanup2:
-	list_delete(property);
-parse_line_cleanup1:
-	linked_list_delete(split);
+
+parse_map_file_cleanup1:
+	close(fd);
 	return ret;
 }
 
 //-----------------------------------------------------------------------------
 ///
-/// Parses an input file and returns a list containing all commands from file
-/// If and only if the function returns SUCCESS, the caller is responsible
-/// to free the list pointed to by list (the function
+/// Maps the file of a points command and finds its points in it (see
+/// Points), the points are not copied: a file of millions of points is
+/// drawn straight from the page cache. The box around all discs is
+/// calculated once here, so drawing doesn't walk the points for it.
+///
+/// @param points  points with the file and layout parsed
+///
+/// @return PARSE_SUCCESS on success, PARSE_ERR_INVALID_INPUT if the file
+///         can't be read or its size is no whole number of points
+//
+static int parse_points_map(Points *points)
+{
+	void *map;
+	size_t size;
+	if (parse_map_file(points->file, &map, &size) != PARSE_SUCCESS)
+	{
+		return PARSE_ERR_INVALID_INPUT;
+	}
+	points->map = map;
+	points->map_size = size;
+	points->left = 0;
+	points->top = 0;
+	points->right = -1;
+	points->bottom = -1;
+
+	size_t columns = (points->layout == POINTS_XYC) ? 3 : 2;
+	size_t point_size = columns * sizeof(int32_t);
+	if (size % point_size != 0 || size / point_size > INT_MAX)
+	{
+		return PARSE_ERR_INVALID_INPUT;
+	}
+	points->count = size / point_size;
+	if (points->count == 0)
+	{
+		return PARSE_SUCCESS;
+	}
+	points->x = map;
+	points->y = points->x + points->count;
+	points->colors = (columns == 3) ? points->y + points->count : NULL;
+
+	/* the discs reach radius from their centers, like circles */
+	int64_t min_x = points->x[0];
+	int64_t max_x = min_x;
+	int64_t min_y = points->y[0];
+	int64_t max_y = min_y;
+	for (int i = 1; i < points->count; i++)
+	{
+		min_x = (points->x[i] < min_x) ? points->x[i] : min_x;
+		max_x = (points->x[i] > max_x) ? points->x[i] : max_x;
+		min_y = (points->y[i] < min_y) ? points->y[i] : min_y;
+		max_y = (points->y[i] > max_y) ? points->y[i] : max_y;
+	}
+	if (points->radius > 0)
+	{
+		points->left = min_x - points->radius;
+		points->top = min_y - points->radius;
+		points->right = max_x + points->radius;
+		points->bottom = max_y + points->radius;
+	}
+	return PARSE_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Maps the file of a grid command, the colors of the cells are drawn
+/// straight from the mapping
+///
+/// @param grid  grid with the file and its size parsed
+///
+/// @return PARSE_SUCCESS on success, PARSE_ERR_INVALID_INPUT if a size of
+///         the grid is negative, the file can't be read or doesn't have a
+///         color for every cell
+//
+static int parse_grid_map(Grid *grid)
+{
+	if (grid->cell_width < 0 || grid->cell_height < 0 || grid->columns < 0 ||
+		grid->rows < 0)
+	{
+		return PARSE_ERR_INVALID_INPUT;
+	}
+	void *map;
+	size_t size;
+	if (parse_map_file(grid->file, &map, &size) != PARSE_SUCCESS)
+	{
+		return PARSE_ERR_INVALID_INPUT;
+	}
+	grid->map = map;
+	grid->map_size = size;
+	if ((uint64_t)grid->columns * grid->rows * sizeof(uint32_t) != size)
+	{
+		return PARSE_ERR_INVALID_INPUT;
+	}
+	grid->cells = map;
+	return PARSE_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Maps the bitmap file of an image command, its pixels are drawn straight
+/// from the mapping. A width or height of 0 becomes the one of the file.
+///
+/// @param image  image with the file and its size parsed
+///
+/// @return PARSE_SUCCESS on success, PARSE_ERR_INVALID_INPUT if the size of
+///         the image is negative or the file can't be read or is no 24 or
+///         32 bit bitmap file
+//
+static int parse_image_map(Image *image)
+{
+	if (image->width < 0 || image->height < 0)
+	{
+		return PARSE_ERR_INVALID_INPUT;
+	}
+	if (bitmap_image_map(image->file, &image->bitmap) != BITMAP_SUCCESS)
+	{
+		return PARSE_ERR_INVALID_INPUT;
+	}
+	STATS_ADD(bytes_read, image->bitmap.map_size);
+	image->width = (image->width == 0) ? (int)image->bitmap.width :
+		image->width;
+	image->height = (image->height == 0) ? (int)image->bitmap.height :
+		image->height;
+	return PARSE_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Parses the lines of a part of the input and appends the commands to a
+/// list, the shapes of a symbol to the symbol. Only complete lines are
+/// parsed, unless the part is the end of the input, then the last line
+/// doesn't need a newline.
+///
+/// @param data         first char of the part
+/// @param size         size of the part in bytes
+/// @param last         1 if the part is the end of the input, 0 otherwise
+/// @param list         command list the commands are appended to
+/// @param state        symbols and gradients, kept for the next part
+/// @param line_number  pointer to the number of the line data starts with,
+///                     counted up for every parsed line, on error it is the
+///                     line that failed
+///
+/// @return number of bytes of the parsed lines on success (the rest is an
+///         incomplete line), -1 - PARSE_ERR_* code otherwise
+//
+static int64_t parse_lines(const char *data, size_t size, int last,
+						   List *list, ParseState *state, int *line_number)
+{
+	size_t pos = 0;
+	while (pos < size)
+	{
+		const char *newline = memchr(data + pos, '\n', size - pos);
+		if (newline == NULL && !last)
+		{
+			break;
+		}
+		size_t end = (newline == NULL) ? size : (size_t)(newline - data);
+
+		if (parse_is_end(data + pos, end - pos))
+		{
+			if (state->open == NULL)
+			{
+				return -1 - PARSE_ERR_INVALID_INPUT;
+			}
+			state->open = NULL;
+			STATS_ADD(lines_parsed, 1);
+			(*line_number)++;
+			pos = (newline == NULL) ? size : end + 1;
+			continue;
+		}
+
+		Command command = {0};
+		int64_t fill;
+		int ret = parse_span(data + pos, end - pos, &command, &fill);
+		if (ret != PARSE_SUCCESS)
+		{
+			return -1 - ret;
+		}
+		STATS_ADD(lines_parsed, 1);
+		STATS_ADD(commands[command.shape], 1);
+
+		/* the list copies the command, the obj belongs to the list now */
+		List *target = (state->open != NULL) ? state->open->shapes : list;
+		ret = parse_symbol(state, &command);
+		if (ret == PARSE_SUCCESS)
+		{
+			ret = parse_fill(state, &command, fill);
+		}
+		if (ret == PARSE_SUCCESS && command.shape == SH_POINTS)
+		{
+			ret = parse_points_map(command.obj);
+		}
+		if (ret == PARSE_SUCCESS && command.shape == SH_GRID)
+		{
+			ret = parse_grid_map(command.obj);
+		}
+		if (ret == PARSE_SUCCESS && command.shape == SH_IMAGE)
+		{
+			ret = parse_image_map(command.obj);
+		}
+		if (ret != PARSE_SUCCESS)
+		{
+			parse_delete_command(&command);
+			return -1 - ret;
+		}
+		ret = list_append(target, &command);
+		if (ret != LIST_SUCCESS)
+		{
+			if (state->open == command.obj)
+			{
+				state->open = NULL;
+			}
+			parse_delete_command(&command);
+			return -1 - ((ret == LIST_ERR_OUT_OF_MEMORY) ? PARSE_ERR_OUT_OF_MEM :
+						 PARSE_ERR_LIST);
+		}
+
+		(*line_number)++;
+		pos = (newline == NULL) ? size : end + 1;
+	}
+
+	/* a symbol without end line */
+	if (last && state->open != NULL)
+	{
+		return -1 - PARSE_ERR_INVALID_INPUT;
+	}
+	return pos;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Parses all lines read from a file descriptor and returns a list containing
+/// all commands in the order of the input. The input is read in chunks and
+/// parsed in place in the read buffer, so a piped input is not kept in memory
+/// as a whole, only a line longer than the buffer makes it grow.
+/// If and only if the function returns PARSE_SUCCESS, the caller is
+/// responsible to free the list pointed to by list (the function
 /// parse_delete_command_list should be used)
-/// Function also outputs error messages if there is a problem with file
 ///
-/// @param input_path  path to input file
+/// @param fd          file descriptor opened for reading, e.g. STDIN_FILENO,
+///                    it is read until end of file and not closed
 /// @param list        pointer to pointer to list, the pointer will point
 ///                    to created list with commands if functions returns
-///                    successfully, caller responsible for freeing the list and
-///                    the commands contained in the list!
+///                    successfully
+/// @param error_line  pointer to an integer receiving the number of the line
+///                    that could not be parsed (may be NULL)
 ///
-/// @return SUCCESS on success, ERR_READ_INPUT, ERR_OUT_OF_MEM, ERR_UNRECOGNISED
-///         or ERR_DUPLICATE_ID or ERR_INVALID_INPUT otherwise
+/// @return PARSE_SUCCESS on success, PARSE_ERR_READ_INPUT,
+///         PARSE_ERR_OUT_OF_MEM, PARSE_ERR_INVALID_INPUT or another
+///         PARSE_ERR_* code otherwise
 //
-int parse_file(char *input_path, LinkedList **list)
+int parse_fd(int fd, List **list, int *error_line)
 {
 	int ret;
 
-	/* try to open input file */
-	FILE *input = fopen(input_path, "r");
-	if (input == NULL) {
-		printf(err_msg_read_input, input_path);
-		return(ERR_READ_INPUT);
+	if (list == NULL)
+	{
+		return PARSE_ERR_PASSED_NULL_POINTER;
 	}
 
 	/* create list for commands */
-	LinkedList *command_list = linked_list_new();
+	List *command_list = list_new(sizeof(Command));
 	if (command_list == NULL)
 	{
-		printf(err_msg_out_of_mem);
-		ret = ERR_OUT_OF_MEM;
-		goto parse_file_cleanup1;
+		return PARSE_ERR_OUT_OF_MEM;
 	}
 
-	/* read input file and parse to command list */
-	char *line_buffer = NULL;
-	int line_buffer_size = 0;
+	ParseState state = {NULL, list_new(sizeof(Symbol *)),
+		list_new(sizeof(Gradient *))};
+	size_t buffer_size = PARSE_CHUNK_SIZE;
+	char *buffer = malloc(buffer_size);
+	if (buffer == NULL || state.symbols == NULL || state.gradients == NULL)
+	{
+		ret = PARSE_ERR_OUT_OF_MEM;
+		goto parse_fd_cleanup2;
+	}
+
+	/* buffer holds the incomplete line of the last chunk and the new chunk */
+	size_t filled = 0;
 	int line_number = 1;
-	Command *command = NULL; /*
-							  * set to NULL to ensure that it will only be freed
-							  * if it points to actual Command!
-							  */
-	Command *search_id_command = NULL;
-
-	/* read each line */
-	ret = readline(&line_buffer, &line_buffer_size, input);
-	while (ret == PARSE_SUCCESS) /* break if EOF is reached or if out of mem */
-	{
-		/* parse line and get command structure */
-		ret = parse_line(line_buffer, &command);
-		if (ret != PARSE_SUCCESS)
+	for (;;)
+	{
+		/* a line as long as the buffer, make room for the rest of it */
+		if (filled == buffer_size)
 		{
-			if (ret == PARSE_ERR_OUT_OF_MEM)
-			{
-				printf(err_msg_out_of_mem);
-				ret = ERR_OUT_OF_MEM;
-				goto parse_file_cleanup1;
-			}
-			else if (ret == PARSE_ERR_INVALID_INPUT)
-			{
-				printf(err_msg_invalid_input, line_number);
-				ret = ERR_INVALID_INPUT;
-				goto parse_file_cleanup1;
-			}
-			else
+			char *buffer_new = realloc(buffer, buffer_size * 2);
+			if (buffer_new == NULL)
 			{
-				printf(err_msg_unrecognised);
-				ret = ERR_UNRECOGNISED;
-				goto parse_file_cleanup1;
+				ret = PARSE_ERR_OUT_OF_MEM;
+				goto parse_fd_cleanup2;
 			}
+			buffer = buffer_new;
+			buffer_size *= 2;
 		}
 
-		/* get id of command element */
-		int id = command->id;
-
-		/* search right place for id in the list */
-		int index_search_list = 0, data_size;
-		search_id_command = linked_list_get(command_list,
-											index_search_list, &data_size);
-		while (search_id_command != NULL)
+		ssize_t n = read(fd, buffer + filled, buffer_size - filled);
+		if (n < 0)
 		{
-			if (data_size != sizeof(Command))
-			{
-				printf(err_msg_unrecognised);
-				ret = ERR_UNRECOGNISED;
-				goto parse_file_cleanup2;
-			}
-			if (id < search_id_command->id)
-			{
-				/*
-				 * search_id_command is index of position where element
-				 * should be inserted
-				 */
-				break;
-			}
-			else if (id == search_id_command->id)
+			if (errno == EINTR)
 			{
-				/* this id is already in the list -> duplicate */
-				printf(err_msg_duplicate_id, id);
-				ret = ERR_DUPLICATE_ID;
-				goto parse_file_cleanup2;
+				continue;
 			}
-
-			/* increment index and get next command of list */
-			index_search_list++;
-			search_id_command = linked_list_get(command_list,
-												index_search_list, &data_size);
+			ret = PARSE_ERR_READ_INPUT;
+			goto parse_fd_cleanup2;
 		}
+		STATS_ADD(bytes_read, n);
+		filled += n;
 
-		/* insert command to correct index in list */
-		ret = linked_list_insert(command_list, index_search_list,
-								 command, sizeof(Command));
-		if (ret != LINKED_LIST_SUCCESS)
+		int64_t parsed = parse_lines(buffer, filled, n == 0, command_list,
+									 &state, &line_number);
+		if (parsed < 0)
 		{
-			if (ret == LINKED_LIST_ERR_OUT_OF_MEMORY)
-			{
-				printf(err_msg_out_of_mem);
-				ret = ERR_OUT_OF_MEM;
-				goto parse_file_cleanup2;
-			}
-			else
+			ret = -1 - parsed;
+			if (error_line != NULL)
 			{
-				printf(err_msg_unrecognised);
-				ret = ERR_UNRECOGNISED;
-				goto parse_file_cleanup2;
+				*error_line = line_number;
 			}
+			goto parse_fd_cleanup2;
+		}
+		if (n == 0)
+		{
+			break;
 		}
 
-		/* increase line_number (line number only needed for error output */
-		line_number++;
-		/* setting line_buffer and line_buffer_size to empty */
-		free(line_buffer);
-		line_buffer = NULL;
-		line_buffer_size = 0;
-		/*
-		 * free current comm element, before a new one will be created next
-		 * iteration, since comm element is copied into list, the obj part must
-		 * not be freed!
-		 */
-		free(command);
-		command = NULL; /* set to NULL to ensure that it won't be freed twice */
+		/* keep the incomplete line for the next chunk */
+		memmove(buffer, buffer + parsed, filled - parsed);
+		filled -= parsed;
+	}
 
-		/* read next line */
-		ret = readline(&line_buffer, &line_buffer_size, input);
+	free(buffer);
+	list_delete(state.symbols);
+	list_delete(state.gradients);
+	*list = command_list;
+	return PARSE_SUCCESS;
+
+parse_fd_cleanup2:
+	free(buffer);
+	list_delete(state.symbols);
+	list_delete(state.gradients);
+	parse_delete_command_list(command_list);
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Parses an input file and returns a list containing all commands from file
+/// in the order of the file, parse_sort_command_list brings them into drawing
+/// order
+/// If and only if the function returns PARSE_SUCCESS, the caller is
+/// responsible to free the list pointed to by list (the function
+/// parse_delete_command_list should be used)
+///
+/// @param input_path  path to input file, "-" reads from stdin
+/// @param list        pointer to pointer to list, the pointer will point
+///                    to created list with commands if functions returns
+///                    successfully, caller responsible for freeing the list and
+///                    the commands contained in the list!
+/// @param error_line  pointer to an integer receiving the number of the line
+///                    that could not be parsed (may be NULL)
+///
+/// @return PARSE_SUCCESS on success, PARSE_ERR_READ_INPUT,
+///         PARSE_ERR_OUT_OF_MEM, PARSE_ERR_INVALID_INPUT or another
+///         PARSE_ERR_* code otherwise
+//
+int parse_file(const char *input_path, List **list, int *error_line)
+{
+	if (input_path == NULL)
+	{
+		return PARSE_ERR_PASSED_NULL_POINTER;
+	}
+	if (strcmp(input_path, "-") == 0)
+	{
+		return parse_fd(STDIN_FILENO, list, error_line);
+	}
+
+	/* try to open input file */
+	int fd = open(input_path, O_RDONLY);
+	if (fd < 0) {
+		return PARSE_ERR_READ_INPUT;
+	}
+
+	int ret = parse_fd(fd, list, error_line);
+
+	/* close input file */
+	close(fd);
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Parses commands from a buffer in memory, the buffer has the same format as
+/// an input file, otherwise like parse_file. The lines are parsed in place,
+/// the buffer is neither copied nor modified.
+///
+/// @param data        buffer containing the commands
+/// @param size        size of the buffer in bytes
+/// @param list        pointer to pointer to list, the pointer will point
+///                    to created list with commands if functions returns
+///                    successfully
+/// @param error_line  pointer to an integer receiving the number of the line
+///                    that could not be parsed (may be NULL)
+///
+/// @return PARSE_SUCCESS on success, PARSE_ERR_PASSED_NULL_POINTER,
+///         PARSE_ERR_OUT_OF_MEM, PARSE_ERR_INVALID_INPUT or another
+///         PARSE_ERR_* code otherwise
+//
+int parse_memory(const char *data, size_t size, List **list, int *error_line)
+{
+	if (list == NULL || (data == NULL && size > 0))
+	{
+		return PARSE_ERR_PASSED_NULL_POINTER;
 	}
-	if (ret == PARSE_ERR_OUT_OF_MEM)
+
+	List *command_list = list_new(sizeof(Command));
+	if (command_list == NULL)
 	{
-		goto parse_file_cleanup1;
+		return PARSE_ERR_OUT_OF_MEM;
+	}
+
+	ParseState state = {NULL, list_new(sizeof(Symbol *)),
+		list_new(sizeof(Gradient *))};
+	if (state.symbols == NULL || state.gradients == NULL)
+	{
+		list_delete(state.symbols);
+		list_delete(state.gradients);
+		parse_delete_command_list(command_list);
+		return PARSE_ERR_OUT_OF_MEM;
+	}
+
+	STATS_ADD(bytes_read, size);
+	int line_number = 1;
+	int64_t parsed = parse_lines(data, size, 1, command_list, &state,
+								 &line_number);
+	list_delete(state.symbols);
+	list_delete(state.gradients);
+	if (parsed < 0)
+	{
+		if (error_line != NULL)
+		{
+			*error_line = line_number;
+		}
+		parse_delete_command_list(command_list);
+		return -1 - parsed;
 	}
 
-	ret = SUCCESS;
 	*list = command_list;
-	goto parse_file_end;
+	return PARSE_SUCCESS;
+}
 
-parse_file_cleanup2:
-	/* delete comm element */
-	if (command != NULL)
+//-----------------------------------------------------------------------------
+///
+/// Namespace of the id of a command: symbols and gradients are only referred
+/// to by their ids and never drawn, so their ids are apart from the ids of
+/// the shapes (a symbol may have the id of a shape or of a gradient)
+///
+/// @param shape  shape of the command
+///
+/// @return 0 for shapes, 1 for symbols, 2 for gradients
+//
+static int command_id_namespace(Shape shape)
+{
+	if (shape == SH_SYMBOL)
 	{
-		if (command->obj != NULL)
+		return 1;
+	}
+	return (shape == SH_GRADIENT) ? 2 : 0;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Compare function for qsort, orders commands by the namespace of their id
+/// (the shapes first) and then by ascending id
+///
+/// @param a  pointer to first command
+/// @param b  pointer to second command
+///
+/// @return negative, zero or positive like strcmp
+//
+static int compare_command_id(const void *a, const void *b)
+{
+	int space_a = command_id_namespace(((const Command *)a)->shape);
+	int space_b = command_id_namespace(((const Command *)b)->shape);
+	if (space_a != space_b)
+	{
+		return space_a - space_b;
+	}
+	id_t id_a = ((const Command *)a)->id;
+	id_t id_b = ((const Command *)b)->id;
+	return (id_a > id_b) - (id_a < id_b);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Sorts the command list created by parse_file into drawing order (ascending
+/// ids) and checks that no id is used twice, the same for the shapes of each
+/// symbol. Symbols and gradients come after the shapes and are checked
+/// among themselves (see command_id_namespace).
+///
+/// @param command_list  command list created by parse_file
+/// @param duplicate_id  pointer to an id receiving the id that is used twice
+///                      (may be NULL)
+///
+/// @return PARSE_SUCCESS on success, PARSE_ERR_DUPLICATE_ID or
+///         PARSE_ERR_PASSED_NULL_POINTER otherwise
+//
+int parse_sort_command_list(List *command_list, id_t *duplicate_id)
+{
+	if (command_list == NULL)
+	{
+		return PARSE_ERR_PASSED_NULL_POINTER;
+	}
+
+	Command *commands = command_list->mem;
+	qsort(commands, command_list->length, sizeof(Command), compare_command_id);
+
+	/* the shapes of a symbol have ids of their own */
+	for (int i = 0; i < command_list->length; i++)
+	{
+		if (commands[i].shape == SH_SYMBOL)
 		{
-			free(command->obj);
+			Symbol *symbol = commands[i].obj;
+			int ret = parse_sort_command_list(symbol->shapes, duplicate_id);
+			if (ret == PARSE_ERR_DUPLICATE_ID)
+			{
+				return ret;
+			}
 		}
-		free(command);
-		command = NULL;
 	}
-parse_file_cleanup1:
-	/* delete command list */
-	parse_delete_command_list(command_list);
-	/* delete line buffer */
-	if (line_buffer != NULL)
+
+	/* after sorting duplicates are neighbours */
+	for (int i = 1; i < command_list->length; i++)
 	{
-		free(line_buffer);
-		line_buffer = NULL;
+		if (compare_command_id(&commands[i], &commands[i - 1]) == 0)
+		{
+			if (duplicate_id != NULL)
+			{
+				*duplicate_id = commands[i].id;
+			}
+			return PARSE_ERR_DUPLICATE_ID;
+		}
 	}
-parse_file_end:
-	/* close input file */
-	fclose(input);
-	return ret;
+
+	return PARSE_SUCCESS;
 }
 
 //-----------------------------------------------------------------------------
@@ -1010,7 +1672,7 @@ parse_file_end:
 ///
 /// @param command_list  command list created by parse_file
 //
-void parse_delete_command_list(LinkedList *command_list)
+void parse_delete_command_list(List *command_list)
 {
 	if (command_list == NULL)
 	{
@@ -1018,25 +1680,15 @@ void parse_delete_command_list(LinkedList *command_list)
 	}
 
 	/*
-	 * free the obj of the commands (because linked_list_delete will
+	 * free the obj of the commands (because list_delete will
 	 * only delete the commands, but not the objects the commands point to!
 	 */
-	int index = 0;
-	int data_size;
-	Command *comm = linked_list_get(command_list, index, &data_size);
-	while (comm != NULL)
+	for (int index = 0; index < command_list->length; index++)
 	{
-		if (data_size == sizeof(Command))
-		{
-			if (comm->obj != NULL)
-			{
-				free(comm->obj);
-			}
-		}
-		index++;
-		comm = linked_list_get(command_list, index, &data_size);
+		Command *comm = list_get(command_list, index);
+		parse_delete_command(comm);
 	}
 
 	/* free the list */
-	linked_list_delete(command_list);
+	list_delete(command_list);
 }
@@ -22,8 +22,10 @@
 #define PARSE_H
 
 #include <stdint.h>
+#include <stddef.h>
 
-#include "linked_list.h"
+#include "list.h"
+#include "bitmap.h"
 
 #define PARSE_SUCCESS 0
 #define PARSE_ERR_OUT_OF_MEM 1
@@ -33,13 +35,26 @@
 #define PARSE_ERR_PROPERTY_NAME_TOO_LONG 5
 #define PARSE_ERR_INVALID_INPUT 6
 #define PARSE_ERR_EOF 7
+#define PARSE_ERR_READ_INPUT 8
+#define PARSE_ERR_DUPLICATE_ID 9
 
 #define PARSE_MAX_PROPERTY_NAME_LENGTH 20
-#define PARSE_MAX_VALUE_STRING_LENGTH 400
 
 typedef uint32_t id_t;
 
-typedef enum _Shape_ {SH_RECTANGLE, SH_CIRCLE, SH_TRIANGLE} Shape;
+/* SH_COUNT is no shape, it is the number of shapes */
+typedef enum _Shape_ {SH_RECTANGLE, SH_CIRCLE, SH_TRIANGLE, SH_LINE,
+	SH_POLYLINE, SH_POLYGON, SH_ELLIPSE, SH_RING, SH_ROUNDRECT, SH_SYMBOL,
+	SH_USE, SH_POINTS, SH_GRID, SH_IMAGE, SH_GRADIENT, SH_TEXT, SH_COUNT} Shape;
+
+/* which pixels a polygon fills, see Polygon */
+typedef enum _FillRule_ {FILL_EVENODD, FILL_NONZERO} FillRule;
+
+/* columns of a points file, see Points */
+typedef enum _PointsLayout_ {POINTS_XY, POINTS_XYC} PointsLayout;
+
+/* how the colors of a gradient change, see Gradient */
+typedef enum _GradientKind_ {GRADIENT_LINEAR, GRADIENT_RADIAL} GradientKind;
 
 typedef struct _Rectangle_ {
 	id_t id;
@@ -69,6 +84,211 @@ typedef struct _Triangle_ {
 	int cy;
 } Triangle;
 
+typedef struct _Line_ {
+	id_t id;
+	int color;
+	int x1;
+	int y1;
+	int x2;
+	int y2;
+	int width;
+} Line;
+
+/*
+ * points of a polyline, x and y of each point one after the other, xy points
+ * into the allocation of the shape itself (freeing the shape frees them)
+ */
+typedef struct _PointList_ {
+	int count;
+	int *xy;
+} PointList;
+
+typedef struct _Polyline_ {
+	id_t id;
+	int color;
+	int width;
+	PointList points;
+} Polyline;
+
+/*
+ * polygon through the points (closed from the last point back to the first),
+ * rule is a FillRule: with FILL_EVENODD a pixel is filled if a ray from it
+ * crosses the edges an odd number of times, with FILL_NONZERO if the edges
+ * wind around it
+ */
+typedef struct _Polygon_ {
+	id_t id;
+	int color;
+	int rule;
+	PointList points;
+} Polygon;
+
+typedef struct _Ellipse_ {
+	id_t id;
+	int color;
+	int x;
+	int y;
+	int rx;
+	int ry;
+} Ellipse;
+
+typedef struct _Ring_ {
+	id_t id;
+	int color;
+	int x;
+	int y;
+	int inner;
+	int outer;
+} Ring;
+
+typedef struct _RoundRect_ {
+	id_t id;
+	int color;
+	int x;
+	int y;
+	int width;
+	int height;
+	int radius;
+} RoundRect;
+
+/*
+ * symbol of the shapes between a define line and the next end line, in the
+ * coordinates of a picture of width x height (the shapes are clipped to
+ * it), a symbol draws nothing itself, use commands draw it
+ */
+typedef struct _Symbol_ {
+	id_t id;
+	int width;
+	int height;
+	List *shapes;                   /* commands of the shapes, sorted by
+	                                 * parse_sort_command_list */
+	struct _DrawSymbolMask_ *mask;  /* the shapes rasterized by the first
+	                                 * use drawn (see draw.h), else NULL */
+} Symbol;
+
+/* the symbol of the define with the id symbol, its origin at x, y */
+typedef struct _Use_ {
+	id_t id;
+	id_t symbol;
+	int x;
+	int y;
+	Symbol *def;  /* the symbol, found by the parser */
+} Use;
+
+/*
+ * discs of one radius (drawn like circles) at the points of a binary file
+ * of int32 columns in the byte order of the machine, without header: all x,
+ * then all y, with layout POINTS_XYC then all colors (24 bit, the upper 8
+ * bits are ignored), else the points have color. The file is mapped by the
+ * parser, x, y and colors point into the mapping, the box around all discs
+ * is calculated when the file is mapped. Later points are drawn on top.
+ */
+typedef struct _Points_ {
+	id_t id;
+	int color;
+	int radius;
+	int layout;
+	char *file;              /* path, stored behind the shape */
+	int count;
+	const int32_t *x;
+	const int32_t *y;
+	const int32_t *colors;   /* NULL for POINTS_XY */
+	void *map;               /* mapping of the file, NULL if not mapped */
+	size_t map_size;
+	int64_t left;            /* bounding box of all discs */
+	int64_t top;
+	int64_t right;
+	int64_t bottom;
+} Points;
+
+/*
+ * columns x rows cells of cell_width x cell_height pixels, the left upper
+ * one at x, y, colored by a binary file of uint32 colors (24 bit, the upper
+ * 8 bits are ignored) in the byte order of the machine, without header: the
+ * colors of the top row of cells from left to right, then of the next row
+ * and so on. The file is mapped by the parser like the file of points.
+ */
+typedef struct _Grid_ {
+	id_t id;
+	int x;
+	int y;
+	int cell_width;
+	int cell_height;
+	int columns;
+	int rows;
+	char *file;              /* path, stored behind the shape */
+	const uint32_t *cells;   /* colors in the mapping, NULL if not mapped */
+	void *map;               /* mapping of the file, NULL if not mapped */
+	size_t map_size;
+} Grid;
+
+/*
+ * the picture of a 24 or 32 bit bitmap file (see BitmapImage) with its left
+ * upper corner at x, y, scaled to width x height pixels (nearest neighbour),
+ * a width or height of 0 is the one of the file. The file is mapped by the
+ * parser like the file of points, which also sets the size of the file for
+ * a size of 0.
+ */
+typedef struct _Image_ {
+	id_t id;
+	int x;
+	int y;
+	int width;
+	int height;
+	char *file;              /* path, stored behind the shape */
+	BitmapImage bitmap;      /* the mapped file, its map is NULL if not
+	                          * mapped */
+} Image;
+
+/* a color of a gradient at offset percent of its way (0 to 100) */
+typedef struct _GradientStop_ {
+	int offset;
+	int color;
+} GradientStop;
+
+/*
+ * stops of a gradient by ascending offset, stops points into the allocation
+ * of the shape itself like the points of a PointList
+ */
+typedef struct _GradientStops_ {
+	int count;
+	GradientStop *stops;
+} GradientStops;
+
+/*
+ * colors that change along the way from x1, y1 (offset 0) to x2, y2
+ * (offset 100): with GRADIENT_LINEAR along that line, the same on lines
+ * across it, with GRADIENT_RADIAL with the distance from x1, y1, the same
+ * on circles around it. Between two stops the color is interpolated, before
+ * the first and after the last stop it is the color of the stop. A gradient
+ * draws nothing itself, shapes are filled with it (see Command).
+ */
+typedef struct _Gradient_ {
+	id_t id;
+	int kind;
+	int x1;
+	int y1;
+	int x2;
+	int y2;
+	GradientStops stops;
+	uint32_t *ramp;      /* radial: colors by distance, calculated when the
+	                      * gradient is first drawn (see draw.c), else NULL */
+} Gradient;
+
+/*
+ * a line of text in the embedded font (see font.h), the left upper corner of
+ * its first glyph at x, y, each pixel of the font drawn as scale x scale
+ * pixels
+ */
+typedef struct _Text_ {
+	id_t id;
+	int color;
+	int x;
+	int y;
+	int scale;
+	char *text;   /* zero terminated, stored behind the shape */
+} Text;
+
 /*
  * element contains information about which object it is and the union
  * with the data itself
@@ -77,11 +297,17 @@ typedef struct _Command_ {
 	Shape shape;
 	id_t id;
 	void *obj;
+	Gradient *fill;  /* gradient the shape is filled with instead of its
+	                  * color (fill property), found by the parser, else
+	                  * NULL */
 } Command;
 
 int parse_line(char *line, Command **com);
-int parse_file(char *input_path, LinkedList **list);
-void parse_delete_command_list(LinkedList *command_list);
+int parse_fd(int fd, List **list, int *error_line);
+int parse_file(const char *input_path, List **list, int *error_line);
+int parse_memory(const char *data, size_t size, List **list, int *error_line);
+int parse_sort_command_list(List *command_list, id_t *duplicate_id);
+void parse_delete_command_list(List *command_list);
 
 
 #endif
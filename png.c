@@ -0,0 +1,374 @@
+/*
+ *  png.c - Code for writing PNG files
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "png.h"
+#include "deflate.h"
+#include "span.h"
+
+static int crc_table_initialised = 0;
+static uint32_t crc_table[256];
+
+typedef struct _PngEncoder_ {
+	Stream *stream;   /* stream the png file is written to */
+	Stream idat;      /* stream for the deflate data, wraps it in IDAT chunks */
+} PngEncoder;
+
+//-----------------------------------------------------------------------------
+///
+/// Fill the lookup table for the crc32 calculation
+//
+static void png_init_crc_table(void)
+{
+	if (crc_table_initialised)
+	{
+		return;
+	}
+
+	uint32_t n;
+	for (n = 0; n < 256; n++)
+	{
+		uint32_t c = n;
+		int k;
+		for (k = 0; k < 8; k++)
+		{
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		}
+		crc_table[n] = c;
+	}
+	crc_table_initialised = 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Update a crc32 checksum (without the final inversion)
+///
+/// @param crc   current value of the checksum
+/// @param data  data to add to checksum
+/// @param size  size of data in bytes
+///
+/// @return updated checksum
+//
+static uint32_t png_crc(uint32_t crc, const unsigned char *data, size_t size)
+{
+	while (size-- > 0)
+	{
+		crc = crc_table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write a 32 bit value in big endian byte order
+///
+/// @param out    output buffer
+/// @param value  value to write
+//
+static void png_put_u32(unsigned char *out, uint32_t value)
+{
+	out[0] = (value & 0xff000000) >> 24;
+	out[1] = (value & 0x00ff0000) >> 16;
+	out[2] = (value & 0x0000ff00) >> 8;
+	out[3] = (value & 0x000000ff) >> 0;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write a chunk (length, type, data and crc) to the stream
+///
+/// @param stream  stream the png file is written to
+/// @param type    four character chunk type
+/// @param data    chunk data
+/// @param size    size of chunk data in bytes
+///
+/// @return PNG_SUCCESS on success, PNG_ERR_WRITE otherwise
+//
+static int png_write_chunk(Stream *stream, const char *type,
+						   const void *data, size_t size)
+{
+	unsigned char head[8];
+	unsigned char tail[4];
+
+	png_put_u32(head, size);
+	memcpy(head + 4, type, 4);
+
+	uint32_t crc = png_crc(0xffffffff, head + 4, 4);
+	crc = png_crc(crc, data, size);
+	png_put_u32(tail, crc ^ 0xffffffff);
+
+	if (stream_write(stream, head, sizeof(head)) != STREAM_SUCCESS ||
+		stream_write(stream, data, size) != STREAM_SUCCESS ||
+		stream_write(stream, tail, sizeof(tail)) != STREAM_SUCCESS)
+	{
+		return PNG_ERR_WRITE;
+	}
+	return PNG_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write function of the IDAT stream, every buffer flushed by the compressor
+/// becomes one IDAT chunk
+///
+/// @param handle  png encoder
+/// @param data    compressed data
+/// @param size    size of data in bytes
+///
+/// @return STREAM_SUCCESS on success, STREAM_ERR_WRITE otherwise
+//
+static int png_idat_write(void *handle, const void *data, size_t size)
+{
+	PngEncoder *enc = handle;
+	if (png_write_chunk(enc->stream, "IDAT", data, size) != PNG_SUCCESS)
+	{
+		return STREAM_ERR_WRITE;
+	}
+	return STREAM_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Predictor of the paeth filter
+///
+/// @param a  left byte
+/// @param b  upper byte
+/// @param c  upper left byte
+///
+/// @return the one of a, b or c closest to a + b - c
+//
+static inline int png_paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+	if (pa <= pb && pa <= pc)
+	{
+		return a;
+	}
+	if (pb <= pc)
+	{
+		return b;
+	}
+	return c;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Apply a filter to a row
+///
+/// @param filter  one of PNG_FILTER_*
+/// @param row     unfiltered row (RGB)
+/// @param prev    unfiltered previous row (all zero for the first row)
+/// @param size    size of a row in bytes
+/// @param out     output buffer of size + 1 bytes (filter type byte first)
+///
+/// @return sum of the absolute values of the filtered bytes (as signed bytes)
+///         as estimation how well the row compresses
+//
+static uint32_t png_filter_row(int filter, const unsigned char *row,
+							   const unsigned char *prev, size_t size,
+							   unsigned char *out)
+{
+	const size_t bpp = BITMAP_RGB_COLOR_SIZE;
+	uint32_t sum = 0;
+	size_t i;
+
+	out[0] = filter;
+	out++;
+
+	/* the bytes left of the first pixel are treated as zero */
+	switch (filter)
+	{
+	case PNG_FILTER_SUB:
+		memcpy(out, row, bpp);
+		for (i = bpp; i < size; i++)
+		{
+			out[i] = row[i] - row[i - bpp];
+		}
+		break;
+	case PNG_FILTER_UP:
+		for (i = 0; i < size; i++)
+		{
+			out[i] = row[i] - prev[i];
+		}
+		break;
+	case PNG_FILTER_AVERAGE:
+		for (i = 0; i < bpp; i++)
+		{
+			out[i] = row[i] - (prev[i] >> 1);
+		}
+		for (i = bpp; i < size; i++)
+		{
+			out[i] = row[i] - ((row[i - bpp] + prev[i]) >> 1);
+		}
+		break;
+	case PNG_FILTER_PAETH:
+		for (i = 0; i < bpp; i++)
+		{
+			out[i] = row[i] - prev[i];
+		}
+		for (i = bpp; i < size; i++)
+		{
+			out[i] = row[i] - png_paeth(row[i - bpp], prev[i], prev[i - bpp]);
+		}
+		break;
+	default:
+		memcpy(out, row, size);
+		break;
+	}
+
+	for (i = 0; i < size; i++)
+	{
+		sum += abs((signed char)out[i]);
+	}
+
+	return sum;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Encode the pixel buffer as PNG image (8 bit RGB). Rows are converted and
+/// filtered one at a time and fed to the compressor, so apart from a few rows
+/// no memory proportional to the picture is needed.
+///
+/// @param stream      stream the image is written to
+/// @param pix_buffer  pixel buffer containing the picture
+/// @param fast        if not 0, all rows use the sub filter and the compressor
+///                    only checks one match candidate, otherwise the filter
+///                    is chosen per row and more candidates are checked
+///
+/// @return PNG_SUCCESS on success, PNG_ERR_NULL_POINTER_PASSED,
+///         PNG_ERR_OUT_OF_MEM or PNG_ERR_WRITE otherwise
+//
+int png_write(Stream *stream, PixelBuffer *pix_buffer, int fast)
+{
+	int ret;
+
+	if (stream == NULL || pix_buffer == NULL || pix_buffer->data == NULL)
+	{
+		return PNG_ERR_NULL_POINTER_PASSED;
+	}
+	png_init_crc_table();
+
+	PngEncoder enc;
+	enc.stream = stream;
+	enc.idat.write = png_idat_write;
+	enc.idat.handle = &enc;
+
+	/* row buffers: current and previous row, one per filter type */
+	size_t row_size = (size_t)pix_buffer->width * BITMAP_RGB_COLOR_SIZE;
+	unsigned char *rows = calloc(2 * row_size +
+								 PNG_FILTER_COUNT * (row_size + 1), 1);
+	if (rows == NULL)
+	{
+		return PNG_ERR_OUT_OF_MEM;
+	}
+	unsigned char *row = rows;
+	unsigned char *prev = rows + row_size;
+	unsigned char *filtered = rows + 2 * row_size;
+
+	Deflate *deflate = deflate_new(&enc.idat, fast);
+	if (deflate == NULL)
+	{
+		ret = PNG_ERR_OUT_OF_MEM;
+		goto png_write_cleanup1;
+	}
+
+	/* signature and header */
+	static const unsigned char signature[8] = {
+		0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+	};
+	unsigned char ihdr[13];
+	png_put_u32(ihdr, pix_buffer->width);
+	png_put_u32(ihdr + 4, pix_buffer->height);
+	ihdr[8] = 8;  /* bit depth */
+	ihdr[9] = 2;  /* color type: RGB */
+	ihdr[10] = 0; /* compression: deflate */
+	ihdr[11] = 0; /* filter method: adaptive */
+	ihdr[12] = 0; /* no interlace */
+	if (stream_write(stream, signature, sizeof(signature)) != STREAM_SUCCESS ||
+		png_write_chunk(stream, "IHDR", ihdr, sizeof(ihdr)) != PNG_SUCCESS)
+	{
+		ret = PNG_ERR_WRITE;
+		goto png_write_cleanup2;
+	}
+
+	/* image data */
+	uint32_t y;
+	for (y = 0; y < pix_buffer->height; y++)
+	{
+		/* convert row from blue, green, red to red, green, blue */
+		const unsigned char *pixel =
+			(unsigned char *)bitmap_get_row(pix_buffer, y);
+		span_pack_rgb(row, pixel, pix_buffer->width);
+
+		unsigned char *best = filtered;
+		if (fast)
+		{
+			png_filter_row(PNG_FILTER_SUB, row, prev, row_size, best);
+		}
+		else
+		{
+			/* choose filter with the smallest sum of absolute differences */
+			uint32_t best_sum = 0xffffffff;
+			int filter;
+			for (filter = 0; filter < PNG_FILTER_COUNT; filter++)
+			{
+				unsigned char *out = filtered + filter * (row_size + 1);
+				uint32_t sum = png_filter_row(filter, row, prev, row_size, out);
+				if (sum < best_sum)
+				{
+					best_sum = sum;
+					best = out;
+				}
+			}
+		}
+
+		if (deflate_write(deflate, best, row_size + 1) != DEFLATE_SUCCESS)
+		{
+			ret = PNG_ERR_WRITE;
+			goto png_write_cleanup2;
+		}
+
+		unsigned char *tmp = prev;
+		prev = row;
+		row = tmp;
+	}
+
+	if (deflate_finish(deflate) != DEFLATE_SUCCESS ||
+		png_write_chunk(stream, "IEND", NULL, 0) != PNG_SUCCESS)
+	{
+		ret = PNG_ERR_WRITE;
+		goto png_write_cleanup2;
+	}
+
+	ret = PNG_SUCCESS;
+
+png_write_cleanup2:
+	deflate_delete(deflate);
+png_write_cleanup1:
+	free(rows);
+	return ret;
+}
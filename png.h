@@ -0,0 +1,43 @@
+/*
+ *  png.h - Definitions for writing PNG files
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PNG_H
+#define PNG_H
+
+#include <stdint.h>
+
+#include "bitmap.h"
+#include "stream.h"
+
+#define PNG_SUCCESS 0
+#define PNG_ERR_NULL_POINTER_PASSED 1
+#define PNG_ERR_OUT_OF_MEM 2
+#define PNG_ERR_WRITE 3
+
+#define PNG_FILTER_NONE 0
+#define PNG_FILTER_SUB 1
+#define PNG_FILTER_UP 2
+#define PNG_FILTER_AVERAGE 3
+#define PNG_FILTER_PAETH 4
+#define PNG_FILTER_COUNT 5
+
+int png_write(Stream *stream, PixelBuffer *pix_buffer, int fast);
+
+#endif
@@ -0,0 +1,223 @@
+/*
+ *  qoi.c - Code for writing QOI (Quite OK Image) files
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "qoi.h"
+
+typedef struct _QoiEncoder_ {
+	Stream *stream;
+	unsigned char buffer[QOI_BUFFER_SIZE];
+	int length;
+} QoiEncoder;
+
+//-----------------------------------------------------------------------------
+///
+/// Write the buffered output of the encoder to the stream
+///
+/// @param enc  encoder
+///
+/// @return QOI_SUCCESS on success, QOI_ERR_WRITE otherwise
+//
+static int qoi_flush(QoiEncoder *enc)
+{
+	if (stream_write(enc->stream, enc->buffer, enc->length) != STREAM_SUCCESS)
+	{
+		return QOI_ERR_WRITE;
+	}
+	enc->length = 0;
+	return QOI_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write a 32 bit value in big endian byte order to the output buffer
+///
+/// @param out    output buffer
+/// @param value  value to write
+//
+static void qoi_put_u32(unsigned char *out, uint32_t value)
+{
+	out[0] = (value & 0xff000000) >> 24;
+	out[1] = (value & 0x00ff0000) >> 16;
+	out[2] = (value & 0x0000ff00) >> 8;
+	out[3] = (value & 0x000000ff) >> 0;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Encode the pixel buffer as QOI image (3 channels, sRGB) in a single pass
+/// over the rows of the pixel buffer
+///
+/// @param stream      stream the image is written to
+/// @param pix_buffer  pixel buffer containing the picture
+///
+/// @return QOI_SUCCESS on success, QOI_ERR_NULL_POINTER_PASSED,
+///         QOI_ERR_OUT_OF_MEM or QOI_ERR_WRITE otherwise
+//
+int qoi_write(Stream *stream, PixelBuffer *pix_buffer)
+{
+	if (stream == NULL || pix_buffer == NULL || pix_buffer->data == NULL)
+	{
+		return QOI_ERR_NULL_POINTER_PASSED;
+	}
+
+	QoiEncoder *enc = malloc(sizeof(QoiEncoder));
+	if (enc == NULL)
+	{
+		return QOI_ERR_OUT_OF_MEM;
+	}
+	enc->stream = stream;
+	enc->length = 0;
+
+	/* header */
+	unsigned char *out = enc->buffer;
+	memcpy(out, "qoif", 4);
+	qoi_put_u32(out + 4, pix_buffer->width);
+	qoi_put_u32(out + 8, pix_buffer->height);
+	out[12] = 3; /* channels: RGB */
+	out[13] = 0; /* colorspace: sRGB with linear alpha */
+	enc->length = QOI_HEADER_SIZE;
+
+	/* previously seen pixels, alpha is always 255 */
+	uint32_t index[QOI_INDEX_SIZE];
+	memset(index, 0, sizeof(index));
+	int pr = 0, pg = 0, pb = 0;
+	uint32_t prev = 0xff000000; /* 0xaarrggbb */
+	int run = 0;
+	int ret = QOI_SUCCESS;
+
+	uint32_t row, column;
+	for (row = 0; row < pix_buffer->height; row++)
+	{
+		const unsigned char *pixel =
+			(unsigned char *)bitmap_get_row(pix_buffer, row);
+
+		for (column = 0; column < pix_buffer->width; column++)
+		{
+			/* make sure the longest op (4 bytes) fits into the buffer */
+			if (enc->length > QOI_BUFFER_SIZE - 8)
+			{
+				ret = qoi_flush(enc);
+				if (ret != QOI_SUCCESS)
+				{
+					goto qoi_write_cleanup;
+				}
+			}
+			out = enc->buffer + enc->length;
+
+			int b = pixel[0];
+			int g = pixel[1];
+			int r = pixel[2];
+			pixel += BITMAP_RGB_COLOR_SIZE;
+			uint32_t px = 0xff000000 | (r << 16) | (g << 8) | b;
+
+			if (px == prev)
+			{
+				run++;
+				if (run == 62)
+				{
+					*out = QOI_OP_RUN | (run - 1);
+					enc->length++;
+					run = 0;
+				}
+				continue;
+			}
+
+			int length = 0;
+			if (run > 0)
+			{
+				out[length++] = QOI_OP_RUN | (run - 1);
+				run = 0;
+			}
+
+			int hash = (r * 3 + g * 5 + b * 7 + 255 * 11) % QOI_INDEX_SIZE;
+			if (index[hash] == px)
+			{
+				out[length++] = QOI_OP_INDEX | hash;
+			}
+			else
+			{
+				index[hash] = px;
+
+				int dr = r - pr;
+				int dg = g - pg;
+				int db = b - pb;
+				/* differences wrap around like the 8 bit channels */
+				dr = (signed char)dr;
+				dg = (signed char)dg;
+				db = (signed char)db;
+				int dr_dg = dr - dg;
+				int db_dg = db - dg;
+
+				if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2)
+				{
+					out[length++] = QOI_OP_DIFF | (dr + 2) << 4 |
+						(dg + 2) << 2 | (db + 2);
+				}
+				else if (dg > -33 && dg < 32 && dr_dg > -9 && dr_dg < 8 &&
+						 db_dg > -9 && db_dg < 8)
+				{
+					out[length++] = QOI_OP_LUMA | (dg + 32);
+					out[length++] = (dr_dg + 8) << 4 | (db_dg + 8);
+				}
+				else
+				{
+					out[length++] = QOI_OP_RGB;
+					out[length++] = r;
+					out[length++] = g;
+					out[length++] = b;
+				}
+			}
+
+			enc->length += length;
+			prev = px;
+			pr = r;
+			pg = g;
+			pb = b;
+		}
+	}
+
+	/* remaining run and end marker (seven 0x00 followed by 0x01) */
+	if (enc->length > QOI_BUFFER_SIZE - 9)
+	{
+		ret = qoi_flush(enc);
+		if (ret != QOI_SUCCESS)
+		{
+			goto qoi_write_cleanup;
+		}
+	}
+	out = enc->buffer + enc->length;
+	if (run > 0)
+	{
+		*out++ = QOI_OP_RUN | (run - 1);
+		enc->length++;
+	}
+	memset(out, 0, 7);
+	out[7] = 1;
+	enc->length += 8;
+	ret = qoi_flush(enc);
+
+qoi_write_cleanup:
+	free(enc);
+	return ret;
+}
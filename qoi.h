@@ -0,0 +1,44 @@
+/*
+ *  qoi.h - Definitions for writing QOI (Quite OK Image) files
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QOI_H
+#define QOI_H
+
+#include "bitmap.h"
+#include "stream.h"
+
+#define QOI_SUCCESS 0
+#define QOI_ERR_NULL_POINTER_PASSED 1
+#define QOI_ERR_OUT_OF_MEM 2
+#define QOI_ERR_WRITE 3
+
+#define QOI_HEADER_SIZE 14
+#define QOI_INDEX_SIZE 64
+#define QOI_BUFFER_SIZE 65536
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+
+int qoi_write(Stream *stream, PixelBuffer *pix_buffer);
+
+#endif
@@ -0,0 +1,748 @@
+/*
+ *  render.c - Library interface for rendering scenes
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "render.h"
+#include "draw.h"
+#include "scanline.h"
+#include "qoi.h"
+#include "png.h"
+#include "stats.h"
+
+/* internal, picture can't be written as 8 bit bitmap, nothing was written */
+#define RENDER_TOO_MANY_COLORS (-1)
+
+//-----------------------------------------------------------------------------
+///
+/// Create a new render context without a scene
+///
+/// @return pointer to the new context, NULL if out of memory
+//
+RenderContext *render_context_new(void)
+{
+	RenderContext *context = malloc(sizeof(RenderContext));
+	if (context == NULL)
+	{
+		return NULL;
+	}
+	memset(context, 0, sizeof(RenderContext));
+	return context;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Delete a render context with its scene and buffers, and empty the span
+/// cache of the drawing kernels
+///
+/// @param context  context to delete
+//
+void render_context_delete(RenderContext *context)
+{
+	if (context == NULL)
+	{
+		return;
+	}
+	parse_delete_command_list(context->commands);
+	stream_memory_free(&context->output);
+	for (int i = 0; i < context->pool_length; i++)
+	{
+		bitmap_pixel_buffer_delete(context->pool[i]);
+	}
+	free(context);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Get a pixel buffer for a picture, a buffer of the same size released to
+/// the context before is reused (most recently released first), otherwise a
+/// new one is created. The content of the buffer is undefined, render_draw
+/// fills it with the background.
+///
+/// @param context  render context
+/// @param width    width of the picture in pixel
+/// @param height   height of the picture in pixel
+///
+/// @return pointer to pixel buffer, NULL if context is NULL or out of memory
+//
+PixelBuffer *render_pixel_buffer_get(RenderContext *context, uint32_t width,
+									 uint32_t height)
+{
+	if (context == NULL)
+	{
+		return NULL;
+	}
+
+	for (int i = context->pool_length - 1; i >= 0; i--)
+	{
+		PixelBuffer *pix_buffer = context->pool[i];
+		if (pix_buffer->width == width && pix_buffer->height == height)
+		{
+			/* close the gap */
+			memmove(context->pool + i, context->pool + i + 1,
+					(context->pool_length - i - 1) * sizeof(PixelBuffer *));
+			context->pool_length--;
+			return pix_buffer;
+		}
+	}
+
+	return bitmap_pixel_buffer_new(width, height);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Give a pixel buffer back to the context for the next picture of the same
+/// size, if the pool is full the buffer released longest ago is deleted.
+/// Buffers that are mapped files are deleted right away (which completes the
+/// file).
+///
+/// @param context     render context the buffer is kept by
+/// @param pix_buffer  pixel buffer from render_pixel_buffer_get or
+///                    bitmap_pixel_buffer_new
+//
+void render_pixel_buffer_release(RenderContext *context,
+								 PixelBuffer *pix_buffer)
+{
+	if (pix_buffer == NULL)
+	{
+		return;
+	}
+	if (context == NULL || pix_buffer->map_is_file)
+	{
+		bitmap_pixel_buffer_delete(pix_buffer);
+		return;
+	}
+
+	if (context->pool_length == RENDER_POOL_SIZE)
+	{
+		bitmap_pixel_buffer_delete(context->pool[0]);
+		memmove(context->pool, context->pool + 1,
+				(RENDER_POOL_SIZE - 1) * sizeof(PixelBuffer *));
+		context->pool_length--;
+	}
+	context->pool[context->pool_length++] = pix_buffer;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Translate the error codes of the parser
+///
+/// @param ret  PARSE_* code
+///
+/// @return matching RENDER_* code
+//
+static int render_parse_error(int ret)
+{
+	switch (ret)
+	{
+	case PARSE_SUCCESS:
+		return RENDER_SUCCESS;
+	case PARSE_ERR_READ_INPUT:
+		return RENDER_ERR_READ_INPUT;
+	case PARSE_ERR_OUT_OF_MEM:
+		return RENDER_ERR_OUT_OF_MEM;
+	case PARSE_ERR_INVALID_INPUT:
+		return RENDER_ERR_INVALID_INPUT;
+	case PARSE_ERR_DUPLICATE_ID:
+		return RENDER_ERR_DUPLICATE_ID;
+	default:
+		return RENDER_ERR_UNRECOGNISED;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Sort a freshly parsed command list and make it the scene of the context
+///
+/// @param context   render context
+/// @param commands  parsed command list, owned by the context afterwards
+///
+/// @return RENDER_SUCCESS on success, RENDER_ERR_DUPLICATE_ID otherwise
+//
+static int render_set_scene(RenderContext *context, List *commands)
+{
+	stats_stage_begin(STATS_STAGE_SORT);
+	int ret = parse_sort_command_list(commands, &context->error_id);
+	stats_stage_end(STATS_STAGE_SORT);
+	if (ret != PARSE_SUCCESS)
+	{
+		parse_delete_command_list(commands);
+		return render_parse_error(ret);
+	}
+
+	context->commands = commands;
+	return RENDER_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Load the scene from an input file, replacing the previous scene
+///
+/// @param context  render context
+/// @param path     path of the input file, "-" reads from stdin
+///
+/// @return RENDER_SUCCESS on success, RENDER_ERR_NULL_POINTER_PASSED,
+///         RENDER_ERR_READ_INPUT, RENDER_ERR_INVALID_INPUT (context->error_line
+///         is the line), RENDER_ERR_DUPLICATE_ID (context->error_id is the
+///         id), RENDER_ERR_OUT_OF_MEM or RENDER_ERR_UNRECOGNISED otherwise
+//
+int render_load_file(RenderContext *context, const char *path)
+{
+	if (context == NULL || path == NULL)
+	{
+		return RENDER_ERR_NULL_POINTER_PASSED;
+	}
+	parse_delete_command_list(context->commands);
+	context->commands = NULL;
+
+	List *commands;
+	stats_stage_begin(STATS_STAGE_PARSE);
+	int ret = parse_file(path, &commands, &context->error_line);
+	stats_stage_end(STATS_STAGE_PARSE);
+	if (ret != PARSE_SUCCESS)
+	{
+		return render_parse_error(ret);
+	}
+	return render_set_scene(context, commands);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Load the scene from a file descriptor (e.g. a pipe) until its end,
+/// replacing the previous scene, the file descriptor is not closed
+///
+/// @param context  render context
+/// @param fd       file descriptor opened for reading
+///
+/// @return like render_load_file
+//
+int render_load_fd(RenderContext *context, int fd)
+{
+	if (context == NULL)
+	{
+		return RENDER_ERR_NULL_POINTER_PASSED;
+	}
+	parse_delete_command_list(context->commands);
+	context->commands = NULL;
+
+	List *commands;
+	stats_stage_begin(STATS_STAGE_PARSE);
+	int ret = parse_fd(fd, &commands, &context->error_line);
+	stats_stage_end(STATS_STAGE_PARSE);
+	if (ret != PARSE_SUCCESS)
+	{
+		return render_parse_error(ret);
+	}
+	return render_set_scene(context, commands);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Load the scene from memory, replacing the previous scene
+///
+/// @param context  render context
+/// @param data     commands in the format of an input file
+/// @param size     size of data in bytes
+///
+/// @return like render_load_file
+//
+int render_load_memory(RenderContext *context, const char *data, size_t size)
+{
+	if (context == NULL || (data == NULL && size > 0))
+	{
+		return RENDER_ERR_NULL_POINTER_PASSED;
+	}
+	parse_delete_command_list(context->commands);
+	context->commands = NULL;
+
+	List *commands;
+	stats_stage_begin(STATS_STAGE_PARSE);
+	int ret = parse_memory(data, size, &commands, &context->error_line);
+	stats_stage_end(STATS_STAGE_PARSE);
+	if (ret != PARSE_SUCCESS)
+	{
+		return render_parse_error(ret);
+	}
+	return render_set_scene(context, commands);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Decide whether the background is cleared lazily per tile (if enabled in
+/// the context): drawing is faster when large parts of the picture are not
+/// drawn to, for scenes covering the picture the tiles are cleared in
+/// scattered order and a single fill is faster. Overlapping shapes are
+/// counted twice, which favours the fill.
+///
+/// @param context     render context with the scene
+/// @param pix_buffer  pixel buffer the scene will be drawn into
+///
+/// @return 1 if lazy clearing is enabled and the bounding boxes of the shapes
+///         cover less than RENDER_LAZY_COVERAGE of the picture, 0 otherwise
+//
+static int render_use_lazy_clear(RenderContext *context,
+								 PixelBuffer *pix_buffer)
+{
+	if (!context->lazy_clear)
+	{
+		return 0;
+	}
+
+	double canvas = (double)pix_buffer->width * pix_buffer->height;
+	double covered = 0;
+	int length = (context->commands != NULL) ? context->commands->length : 0;
+	for (int index = 0; index < length; index++)
+	{
+		int64_t left, top, right, bottom;
+		draw_bounding_box(list_get(context->commands, index), &left, &top,
+						  &right, &bottom);
+
+		/* clip to the picture */
+		left = (left < 0) ? 0 : left;
+		top = (top < 0) ? 0 : top;
+		right = (right >= pix_buffer->width) ? pix_buffer->width - 1 : right;
+		bottom = (bottom >= pix_buffer->height) ? pix_buffer->height - 1 :
+			bottom;
+		if (left <= right && top <= bottom)
+		{
+			covered += (double)(right - left + 1) * (bottom - top + 1);
+			if (covered >= canvas * RENDER_LAZY_COVERAGE)
+			{
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draw the loaded scene on white background into a pixel buffer, the pixel
+/// buffer can be created by bitmap_pixel_buffer_new or be memory of the
+/// caller set up by bitmap_pixel_buffer_init, nothing is allocated unless
+/// the context uses the scanline renderer
+///
+/// @param context     render context
+/// @param pix_buffer  pixel buffer to draw into, its size is the canvas size
+///
+/// @return RENDER_SUCCESS on success, RENDER_ERR_NULL_POINTER_PASSED,
+///         RENDER_ERR_OUT_OF_MEM or RENDER_ERR_UNRECOGNISED otherwise
+//
+int render_draw(RenderContext *context, PixelBuffer *pix_buffer)
+{
+	if (context == NULL || pix_buffer == NULL)
+	{
+		return RENDER_ERR_NULL_POINTER_PASSED;
+	}
+
+	int ret = RENDER_SUCCESS;
+	stats_stage_begin(STATS_STAGE_RASTERIZE);
+
+	if (context->scanline && context->commands != NULL)
+	{
+		/* background and shapes in one pass */
+		int scanline_ret = scanline_draw(pix_buffer, context->commands,
+										 RENDER_BACKGROUND_COLOR);
+		if (scanline_ret == SCANLINE_ERR_OUT_OF_MEM)
+		{
+			ret = RENDER_ERR_OUT_OF_MEM;
+		}
+		else if (scanline_ret != SCANLINE_SUCCESS)
+		{
+			ret = RENDER_ERR_UNRECOGNISED;
+		}
+		stats_stage_end(STATS_STAGE_RASTERIZE);
+		return ret;
+	}
+
+	/*
+	 * background, with lazy_clear tiles of sparse scenes are filled when they
+	 * are first drawn to and the rest when the picture is encoded
+	 */
+	int clear_ret;
+	if (render_use_lazy_clear(context, pix_buffer))
+	{
+		clear_ret = bitmap_pixel_buffer_clear_lazy(pix_buffer,
+												   RENDER_BACKGROUND_COLOR);
+	}
+	else
+	{
+		clear_ret = bitmap_pixel_buffer_fill(pix_buffer,
+											 RENDER_BACKGROUND_COLOR);
+	}
+	if (clear_ret != BITMAP_SUCCESS)
+	{
+		ret = RENDER_ERR_UNRECOGNISED;
+	}
+
+	/* draw commands */
+	int length = (context->commands != NULL) ? context->commands->length : 0;
+	for (int index = 0; index < length && ret == RENDER_SUCCESS; index++)
+	{
+		Command *comm = list_get(context->commands, index);
+		int draw_ret = draw_command(pix_buffer, comm);
+		if (draw_ret == DRAW_ERR_OUT_OF_MEM)
+		{
+			ret = RENDER_ERR_OUT_OF_MEM;
+		}
+		else if (draw_ret != DRAW_SUCCESS)
+		{
+			ret = RENDER_ERR_UNRECOGNISED;
+		}
+	}
+
+	stats_stage_end(STATS_STAGE_RASTERIZE);
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Determine the output format from the extension of a path
+///
+/// @param path  path of output file
+///
+/// @return RENDER_FORMAT_QOI for ".qoi", RENDER_FORMAT_PNG for ".png" and
+///         RENDER_FORMAT_BMP for everything else
+//
+int render_format_from_path(const char *path)
+{
+	const char *extension = strrchr(path, '.');
+	if (extension == NULL)
+	{
+		return RENDER_FORMAT_BMP;
+	}
+
+	char lower[5];
+	int i;
+	for (i = 0; i < 4 && extension[i] != 0; i++)
+	{
+		lower[i] = tolower((unsigned char)extension[i]);
+	}
+	lower[i] = 0;
+	if (extension[i] != 0)
+	{
+		return RENDER_FORMAT_BMP;
+	}
+
+	if (strcmp(lower, ".qoi") == 0)
+	{
+		return RENDER_FORMAT_QOI;
+	}
+	if (strcmp(lower, ".png") == 0)
+	{
+		return RENDER_FORMAT_PNG;
+	}
+	return RENDER_FORMAT_BMP;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write the pixel buffer as 8 bit palette bitmap (run length encoded if that
+/// is smaller)
+///
+/// @param context     render context
+/// @param pix_buffer  pixel buffer containing the drawn picture
+/// @param stream      stream to write to
+///
+/// @return RENDER_SUCCESS on success, RENDER_TOO_MANY_COLORS (nothing was
+///         written then, the picture needs a 24 bit bitmap because it has too
+///         many colors or the 8 bit bitmap is too large),
+///         RENDER_ERR_OUT_OF_MEM or RENDER_ERR_WRITE otherwise
+//
+static int render_write_indexed(RenderContext *context,
+								PixelBuffer *pix_buffer, Stream *stream)
+{
+	int ret;
+
+	/* collect colors of the picture */
+	BitmapPalette *palette = &context->palette;
+	if (bitmap_palette_from_pixel_buffer(pix_buffer, palette) != BITMAP_SUCCESS)
+	{
+		return RENDER_TOO_MANY_COLORS;
+	}
+
+	/* encode pixel array */
+	uint32_t compression;
+	size_t pixel_array_size;
+	char *pixel_array = bitmap_indexed_pixel_array_new(pix_buffer, palette,
+													   &compression,
+													   &pixel_array_size);
+	if (pixel_array == NULL)
+	{
+		return RENDER_ERR_OUT_OF_MEM;
+	}
+
+	/* even the 8 bit pixel array can exceed the size limit of bitmap files */
+	if (BITMAP_HEADER_SIZE + (uint64_t)pixel_array_size +
+		palette->size * BITMAP_PALETTE_ENTRY_SIZE > BITMAP_MAX_FILE_SIZE)
+	{
+		ret = RENDER_TOO_MANY_COLORS;
+		goto render_write_indexed_cleanup1;
+	}
+
+	/* write file header and color table */
+	int header_size;
+	char *file_header = bitmap_indexed_file_header_new(pix_buffer->width,
+													   pix_buffer->height,
+													   palette, compression,
+													   pixel_array_size,
+													   &header_size);
+	if (file_header == NULL)
+	{
+		ret = RENDER_ERR_OUT_OF_MEM;
+		goto render_write_indexed_cleanup1;
+	}
+	if (stream_write(stream, file_header, header_size) != STREAM_SUCCESS ||
+		stream_write(stream, pixel_array, pixel_array_size) != STREAM_SUCCESS)
+	{
+		ret = RENDER_ERR_WRITE;
+		goto render_write_indexed_cleanup2;
+	}
+
+	ret = RENDER_SUCCESS;
+
+render_write_indexed_cleanup2:
+	bitmap_file_header_delete(file_header);
+render_write_indexed_cleanup1:
+	bitmap_pixel_array_delete(pixel_array);
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write the pixel buffer as 24 bit bitmap
+///
+/// @param pix_buffer  pixel buffer containing the drawn picture
+/// @param stream      stream to write to
+/// @param fd          file descriptor the stream writes to or -1, a file
+///                    is written with a single system call
+///
+/// @return RENDER_SUCCESS on success, RENDER_ERR_TOO_LARGE or
+///         RENDER_ERR_WRITE otherwise
+//
+static int render_write_bitmap(PixelBuffer *pix_buffer, Stream *stream, int fd)
+{
+	if (fd >= 0)
+	{
+		/* nothing has been written with stdio yet, write directly */
+		int ret = bitmap_write_file(fd, pix_buffer);
+		if (ret == BITMAP_ERR_TOO_LARGE)
+		{
+			return RENDER_ERR_TOO_LARGE;
+		}
+		return (ret == BITMAP_SUCCESS) ? RENDER_SUCCESS : RENDER_ERR_WRITE;
+	}
+
+	char file_header[BITMAP_HEADER_SIZE];
+	if (bitmap_file_header_init(file_header, pix_buffer->width,
+								pix_buffer->height) != BITMAP_SUCCESS)
+	{
+		return RENDER_ERR_TOO_LARGE;
+	}
+
+	size_t array_size;
+	char *array = bitmap_get_pixel_array(pix_buffer, &array_size);
+	if (stream_write(stream, file_header, BITMAP_HEADER_SIZE)
+		!= STREAM_SUCCESS ||
+		stream_write(stream, array, array_size) != STREAM_SUCCESS)
+	{
+		return RENDER_ERR_WRITE;
+	}
+	return RENDER_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write the pixel buffer in the requested format
+///
+/// @param context     render context
+/// @param pix_buffer  pixel buffer containing the drawn picture
+/// @param format      RENDER_FORMAT_* value
+/// @param flags       RENDER_FLAG_* values
+/// @param stream      stream to write to
+/// @param fd          file descriptor the stream writes to or -1
+///
+/// @return RENDER_SUCCESS on success, RENDER_ERR_TOO_LARGE,
+///         RENDER_ERR_OUT_OF_MEM or RENDER_ERR_WRITE otherwise
+//
+static int render_write_stream(RenderContext *context,
+							   PixelBuffer *pix_buffer, int format, int flags,
+							   Stream *stream, int fd)
+{
+	int ret;
+	stats_stage_begin(STATS_STAGE_ENCODE);
+
+	if (format == RENDER_FORMAT_QOI)
+	{
+		ret = qoi_write(stream, pix_buffer);
+		ret = (ret == QOI_SUCCESS) ? RENDER_SUCCESS :
+			(ret == QOI_ERR_OUT_OF_MEM) ? RENDER_ERR_OUT_OF_MEM :
+			RENDER_ERR_WRITE;
+	}
+	else if (format == RENDER_FORMAT_PNG)
+	{
+		ret = png_write(stream, pix_buffer, (flags & RENDER_FLAG_FAST) != 0);
+		ret = (ret == PNG_SUCCESS) ? RENDER_SUCCESS :
+			(ret == PNG_ERR_OUT_OF_MEM) ? RENDER_ERR_OUT_OF_MEM :
+			RENDER_ERR_WRITE;
+	}
+	else
+	{
+		ret = RENDER_TOO_MANY_COLORS;
+		if (flags & RENDER_FLAG_COMPRESS)
+		{
+			ret = render_write_indexed(context, pix_buffer, stream);
+		}
+		if (ret == RENDER_TOO_MANY_COLORS)
+		{
+			/* no palette requested or possible, write 24 bit bitmap */
+			ret = render_write_bitmap(pix_buffer, stream, fd);
+		}
+	}
+
+	stats_stage_end(STATS_STAGE_ENCODE);
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write the pixel buffer to a stream
+///
+/// @param context     render context
+/// @param pix_buffer  pixel buffer containing the drawn picture
+/// @param format      RENDER_FORMAT_* value
+/// @param flags       RENDER_FLAG_* values
+/// @param stream      stream to write to
+///
+/// @return RENDER_SUCCESS on success, RENDER_ERR_NULL_POINTER_PASSED,
+///         RENDER_ERR_TOO_LARGE (bitmaps are limited to 4 GB),
+///         RENDER_ERR_OUT_OF_MEM or RENDER_ERR_WRITE otherwise
+//
+int render_write(RenderContext *context, PixelBuffer *pix_buffer, int format,
+				 int flags, Stream *stream)
+{
+	if (context == NULL || pix_buffer == NULL || stream == NULL)
+	{
+		return RENDER_ERR_NULL_POINTER_PASSED;
+	}
+	return render_write_stream(context, pix_buffer, format, flags, stream, -1);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write the pixel buffer to a file, nothing must have been written to the
+/// file with stdio before
+///
+/// @param context     render context
+/// @param pix_buffer  pixel buffer containing the drawn picture
+/// @param format      RENDER_FORMAT_* value
+/// @param flags       RENDER_FLAG_* values
+/// @param file        file opened for writing
+///
+/// @return like render_write
+//
+int render_write_file(RenderContext *context, PixelBuffer *pix_buffer,
+					  int format, int flags, FILE *file)
+{
+	if (context == NULL || pix_buffer == NULL || file == NULL)
+	{
+		return RENDER_ERR_NULL_POINTER_PASSED;
+	}
+	Stream stream;
+	stream_file_init(&stream, file);
+	return render_write_stream(context, pix_buffer, format, flags, &stream,
+							   fileno(file));
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Encode the pixel buffer into memory owned by the context, the memory is
+/// reused by the next call, so encoding pictures of the same size again
+/// allocates no output memory
+/// A 24 bit bitmap of a pixel buffer with headroom is not copied at all, the
+/// header is written in front of the pixel array and the result points into
+/// the pixel buffer
+///
+/// @param context     render context
+/// @param pix_buffer  pixel buffer containing the drawn picture
+/// @param format      RENDER_FORMAT_* value
+/// @param flags       RENDER_FLAG_* values
+/// @param data        pointer receiving the encoded picture, valid until the
+///                    next call, until the context is deleted or (24 bit
+///                    bitmap) until the pixel buffer is changed or deleted
+/// @param size        pointer receiving the size of the encoded picture
+///
+/// @return RENDER_SUCCESS on success, RENDER_ERR_NULL_POINTER_PASSED,
+///         RENDER_ERR_TOO_LARGE or RENDER_ERR_OUT_OF_MEM otherwise
+//
+int render_encode(RenderContext *context, PixelBuffer *pix_buffer, int format,
+				  int flags, const char **data, size_t *size)
+{
+	if (context == NULL || pix_buffer == NULL || data == NULL || size == NULL)
+	{
+		return RENDER_ERR_NULL_POINTER_PASSED;
+	}
+
+	/* the pixel buffer already is the bitmap file if it has headroom */
+	if (format == RENDER_FORMAT_BMP && !(flags & RENDER_FLAG_COMPRESS) &&
+		pix_buffer->header != NULL)
+	{
+		stats_stage_begin(STATS_STAGE_ENCODE);
+		*data = bitmap_get_file(pix_buffer, size);
+		stats_stage_end(STATS_STAGE_ENCODE);
+		return (*data != NULL) ? RENDER_SUCCESS : RENDER_ERR_TOO_LARGE;
+	}
+
+	Stream stream;
+	stream_memory_init(&stream, &context->output);
+
+	/* bitmaps have a known size, allocate it at once */
+	if (format == RENDER_FORMAT_BMP)
+	{
+		uint64_t file_size = bitmap_file_size(pix_buffer->width,
+											  pix_buffer->height);
+		if (file_size <= BITMAP_MAX_FILE_SIZE &&
+			stream_memory_reserve(&context->output, file_size)
+			!= STREAM_SUCCESS)
+		{
+			return RENDER_ERR_OUT_OF_MEM;
+		}
+	}
+
+	int ret = render_write_stream(context, pix_buffer, format, flags, &stream,
+								  -1);
+	if (ret == RENDER_ERR_WRITE)
+	{
+		/* writing to memory only fails if it can't grow */
+		ret = RENDER_ERR_OUT_OF_MEM;
+	}
+	if (ret != RENDER_SUCCESS)
+	{
+		return ret;
+	}
+
+	*data = context->output.data;
+	*size = context->output.size;
+	return RENDER_SUCCESS;
+}
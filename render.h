@@ -0,0 +1,104 @@
+/*
+ *  render.h - Definitions of the library interface for rendering scenes
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "list.h"
+#include "parse.h"
+#include "bitmap.h"
+#include "stream.h"
+
+#define RENDER_SUCCESS 0
+#define RENDER_ERR_NULL_POINTER_PASSED 1
+#define RENDER_ERR_READ_INPUT 2
+#define RENDER_ERR_INVALID_INPUT 3
+#define RENDER_ERR_DUPLICATE_ID 4
+#define RENDER_ERR_WRITE 5
+#define RENDER_ERR_OUT_OF_MEM 6
+#define RENDER_ERR_UNRECOGNISED 7
+#define RENDER_ERR_TOO_LARGE 8
+
+#define RENDER_FORMAT_BMP 0
+#define RENDER_FORMAT_QOI 1
+#define RENDER_FORMAT_PNG 2
+
+/* 8 bit palette bitmap (run length encoded if smaller) for <= 256 colors */
+#define RENDER_FLAG_COMPRESS 1
+/* faster but larger PNG output */
+#define RENDER_FLAG_FAST 2
+
+#define RENDER_BACKGROUND_COLOR 0xffffff
+
+/*
+ * with lazy_clear the background is cleared lazily if the shapes cover less
+ * of the picture
+ */
+#define RENDER_LAZY_COVERAGE 0.5
+
+/* pixel buffers kept by a context for the next picture of the same size */
+#define RENDER_POOL_SIZE 4
+
+/*
+ * Everything needed to render scenes repeatedly: the loaded scene, the
+ * buffers of the encoders and released pixel buffers, which are kept from
+ * one image to the next
+ */
+typedef struct _RenderContext_ {
+	List *commands;         /* loaded scene in drawing order */
+	int error_line;         /* line of the entry RENDER_ERR_INVALID_INPUT */
+	id_t error_id;          /* id RENDER_ERR_DUPLICATE_ID was returned for */
+	BitmapPalette palette;  /* colors of the picture for RENDER_FLAG_COMPRESS */
+	StreamMemory output;    /* encoded picture of render_encode */
+	PixelBuffer *pool[RENDER_POOL_SIZE]; /* released pixel buffers, the
+	                                      * most recently released last */
+	int pool_length;
+	int lazy_clear;         /* 1: render_draw clears the background of
+	                         * sparse scenes per tile on first touch */
+	int scanline;           /* 1: render_draw resolves the visible spans
+	                         * of each row and writes every pixel once */
+} RenderContext;
+
+RenderContext *render_context_new(void);
+void render_context_delete(RenderContext *context);
+
+PixelBuffer *render_pixel_buffer_get(RenderContext *context, uint32_t width,
+									 uint32_t height);
+void render_pixel_buffer_release(RenderContext *context,
+								 PixelBuffer *pix_buffer);
+
+int render_load_file(RenderContext *context, const char *path);
+int render_load_fd(RenderContext *context, int fd);
+int render_load_memory(RenderContext *context, const char *data, size_t size);
+
+int render_draw(RenderContext *context, PixelBuffer *pix_buffer);
+
+int render_format_from_path(const char *path);
+int render_write(RenderContext *context, PixelBuffer *pix_buffer, int format,
+				 int flags, Stream *stream);
+int render_write_file(RenderContext *context, PixelBuffer *pix_buffer,
+					  int format, int flags, FILE *file);
+int render_encode(RenderContext *context, PixelBuffer *pix_buffer, int format,
+				  int flags, const char **data, size_t *size);
+
+#endif
@@ -0,0 +1,510 @@
+/*
+ *  scanline.c - Scanline renderer writing every pixel once
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "scanline.h"
+#include "draw.h"
+#include "span.h"
+#include "stats.h"
+
+/* first number of row iterators, doubled when more shapes are active */
+#define SCANLINE_SLOTS 64
+
+/* longer runs are filled by span_fill, shorter ones right here */
+#define SCANLINE_SHORT_RUN 16
+
+/*
+ * Columns of a row written so far as intervals from start to end
+ * (exclusive), sorted and not touching each other
+ */
+typedef struct _ScanlineCovered_ {
+	uint32_t *start;
+	uint32_t *end;
+	int length;
+} ScanlineCovered;
+
+/*
+ * Shapes crossing the current row (active edge table): row iterators in
+ * slots that are reused, and the active ones in drawing order
+ */
+typedef struct _ScanlineActive_ {
+	DrawRows *rows;     /* row iterator of each slot */
+	int *index;         /* command index of each slot */
+	int *piece;         /* piece of the command of each slot */
+	int *free_slots;    /* stack of unused slots */
+	int free_length;
+	int capacity;       /* number of slots */
+	int *active;        /* active slots by ascending command index and
+	                     * piece */
+	int *merged;        /* room for merging new slots into active */
+	int length;
+} ScanlineActive;
+
+//-----------------------------------------------------------------------------
+///
+/// Gets an unused slot, the slots are doubled if all are used
+///
+/// @param set  active shapes
+///
+/// @return slot number, -1 if out of memory
+//
+static int scanline_slot_new(ScanlineActive *set)
+{
+	if (set->free_length == 0)
+	{
+		int capacity = (set->capacity == 0) ? SCANLINE_SLOTS :
+			2 * set->capacity;
+		DrawRows *rows = realloc(set->rows, sizeof(DrawRows) * capacity);
+		if (rows == NULL)
+		{
+			return -1;
+		}
+		set->rows = rows;
+		int **lists[5] = {&set->index, &set->piece, &set->free_slots,
+						  &set->active, &set->merged};
+		for (int i = 0; i < 5; i++)
+		{
+			int *list = realloc(*lists[i], sizeof(int) * capacity);
+			if (list == NULL)
+			{
+				return -1;
+			}
+			*lists[i] = list;
+		}
+		for (int slot = capacity - 1; slot >= set->capacity; slot--)
+		{
+			set->free_slots[set->free_length++] = slot;
+		}
+		set->capacity = capacity;
+	}
+	return set->free_slots[--set->free_length];
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Checks whether a slot is drawn before another one: pieces of the same
+/// command (the discs of points) are drawn in their order too
+///
+/// @param set  active shapes
+/// @param a    slot
+/// @param b    other slot
+///
+/// @return 1 if a is drawn before b, 0 otherwise
+//
+static inline int scanline_before(const ScanlineActive *set, int a, int b)
+{
+	return set->index[a] < set->index[b] ||
+		(set->index[a] == set->index[b] && set->piece[a] < set->piece[b]);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Frees the memory of the active shapes
+///
+/// @param set  active shapes
+//
+static void scanline_active_delete(ScanlineActive *set)
+{
+	free(set->rows);
+	free(set->index);
+	free(set->piece);
+	free(set->free_slots);
+	free(set->active);
+	free(set->merged);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Fills a run of pixels in a row
+///
+/// @param row    first pixel of the row
+/// @param x      first column
+/// @param n      number of pixels
+/// @param color  24 bit color
+//
+static inline void scanline_fill(uint8_t *row, uint32_t x, uint32_t n,
+								 int color)
+{
+	uint8_t *pixel = row + (size_t)x * BITMAP_RGB_COLOR_SIZE;
+	if (n >= SCANLINE_SHORT_RUN)
+	{
+		span_fill(pixel, color, n);
+		return;
+	}
+	for (; n > 0; n--)
+	{
+		pixel[0] = color & 0xff; /* blue */
+		pixel[1] = (color & 0xff00) >> 8; /* green */
+		pixel[2] = (color & 0xff0000) >> 16; /* red */
+		pixel += BITMAP_RGB_COLOR_SIZE;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes a run of pixels of a span in a row: copies the pixels of the span
+/// if it has some (an image), else fills the run with its color
+///
+/// @param row     first pixel of the row
+/// @param x       first column
+/// @param n       number of pixels
+/// @param color   24 bit color
+/// @param pixels  pixels of the run, NULL to fill it with color
+//
+static inline void scanline_write(uint8_t *row, uint32_t x, uint32_t n,
+								  int color, const uint8_t *pixels)
+{
+	if (pixels != NULL)
+	{
+		memcpy(row + (size_t)x * BITMAP_RGB_COLOR_SIZE, pixels,
+			   (size_t)n * BITMAP_RGB_COLOR_SIZE);
+		return;
+	}
+	scanline_fill(row, x, n, color);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes the columns of a span that are not written yet (that no shape
+/// with a higher id covers) and adds the span to the written intervals of
+/// the row
+///
+/// @param covered  written intervals of the row, sorted, with gaps between
+/// @param row      first pixel of the row
+/// @param x1       first column of the span
+/// @param x2       column after the last one
+/// @param color    24 bit color
+/// @param pixels   pixels of the span from x1 on, NULL if it has color
+///
+/// @return number of pixels written
+//
+static uint64_t scanline_cover(ScanlineCovered *covered, uint8_t *row,
+							   uint32_t x1, uint32_t x2, int color,
+							   const uint8_t *pixels)
+{
+	/* first interval ending at x1 or right of it (binary search) */
+	int low = 0;
+	int high = covered->length;
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (covered->end[middle] < x1)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	/* write the gaps between the intervals the span touches */
+	uint64_t written = 0;
+	uint32_t start = x1;
+	uint32_t end = x2;
+	uint32_t x = x1;
+	int last = low;
+	for (; last < covered->length && covered->start[last] <= x2; last++)
+	{
+		if (covered->start[last] > x)
+		{
+			const uint8_t *run = (pixels == NULL) ? NULL :
+				pixels + (size_t)(x - x1) * BITMAP_RGB_COLOR_SIZE;
+			scanline_write(row, x, covered->start[last] - x, color, run);
+			written += covered->start[last] - x;
+		}
+		if (covered->end[last] > x)
+		{
+			x = covered->end[last];
+		}
+		if (covered->start[last] < start)
+		{
+			start = covered->start[last];
+		}
+	}
+	if (x < x2)
+	{
+		const uint8_t *run = (pixels == NULL) ? NULL :
+			pixels + (size_t)(x - x1) * BITMAP_RGB_COLOR_SIZE;
+		scanline_write(row, x, x2 - x, color, run);
+		written += x2 - x;
+	}
+	else
+	{
+		end = x;
+	}
+
+	/* the touched intervals and the span become one interval */
+	int removed = last - low;
+	if (removed != 1)
+	{
+		memmove(covered->start + low + 1, covered->start + last,
+				sizeof(uint32_t) * (covered->length - last));
+		memmove(covered->end + low + 1, covered->end + last,
+				sizeof(uint32_t) * (covered->length - last));
+		covered->length += 1 - removed;
+	}
+	covered->start[low] = start;
+	covered->end[low] = end;
+	return written;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws all commands and the background with each pixel written once. The
+/// commands are converted to spans row by row: the shapes are sorted into
+/// the rows their bounding boxes start in (edge table), the shapes crossing
+/// the current row are kept with their row iterators in drawing order
+/// (active edge table), a polyline as its lines and joins (draw_pieces).
+/// Each row is resolved from the last command to the
+/// first, a span only writes the columns no later command wrote, the
+/// remaining columns get the background. The picture is the same as
+/// filling the background and drawing each command with draw_command.
+/// With statistics enabled the pixels the spans cover and the visible
+/// pixels are counted (overdraw).
+///
+/// @param pix_buffer  pixel buffer to draw into
+/// @param commands    commands in drawing order (ascending ids)
+/// @param background  24 bit background color
+///
+/// @return SCANLINE_SUCCESS on success, SCANLINE_ERR_NULL_POINTER_PASSED or
+///         SCANLINE_ERR_OUT_OF_MEM otherwise
+//
+int scanline_draw(PixelBuffer *pix_buffer, List *commands, uint32_t background)
+{
+	if (pix_buffer == NULL || commands == NULL)
+	{
+		return SCANLINE_ERR_NULL_POINTER_PASSED;
+	}
+
+	/* every pixel is written, tiles of a lazy clear don't matter */
+	pix_buffer->lazy = 0;
+	uint32_t width = pix_buffer->width;
+	uint32_t height = pix_buffer->height;
+	if (width == 0 || height == 0)
+	{
+		return SCANLINE_SUCCESS;
+	}
+	size_t line_width = (size_t)width * BITMAP_RGB_COLOR_SIZE;
+	size_t row_size = bitmap_pixel_array_row_size(width);
+
+	int ret = SCANLINE_ERR_OUT_OF_MEM;
+	int length = commands->length;
+	uint32_t *starts = calloc((size_t)height + 2, sizeof(uint32_t));
+	int *edges = NULL;
+	int *pieces = NULL;
+	/* intervals have gaps, so there are at most width / 2 + 1 */
+	ScanlineCovered covered;
+	covered.start = malloc(sizeof(uint32_t) * ((size_t)width / 2 + 2));
+	covered.end = malloc(sizeof(uint32_t) * ((size_t)width / 2 + 2));
+	ScanlineActive set;
+	memset(&set, 0, sizeof(set));
+	if (starts == NULL || covered.start == NULL ||
+		covered.end == NULL)
+	{
+		goto scanline_draw_cleanup1;
+	}
+
+	/*
+	 * edge table: the commands (and their pieces) starting in row y are
+	 * edges[starts[y]] to edges[starts[y + 1] - 1], in drawing order
+	 */
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (int i = 0; i < length; i++)
+		{
+			Command *comm = list_get(commands, i);
+			int count = draw_pieces(comm);
+			for (int piece = 0; piece < count; piece++)
+			{
+				int64_t left, top, right, bottom;
+				draw_piece_bounding_box(comm, piece, &left, &top, &right,
+										&bottom);
+				if (!draw_clip_box(width, height, &left, &top, &right,
+								   &bottom))
+				{
+					continue;
+				}
+				if (pass == 0)
+				{
+					starts[top + 2]++;
+				}
+				else
+				{
+					pieces[starts[top + 1]] = piece;
+					edges[starts[top + 1]++] = i;
+				}
+			}
+		}
+		if (pass == 0)
+		{
+			for (uint32_t y = 2; y < height + 2; y++)
+			{
+				starts[y] += starts[y - 1];
+			}
+			edges = malloc(sizeof(int) * ((size_t)starts[height + 1] + 1));
+			pieces = malloc(sizeof(int) * ((size_t)starts[height + 1] + 1));
+			if (edges == NULL || pieces == NULL)
+			{
+				goto scanline_draw_cleanup1;
+			}
+		}
+	}
+
+	uint64_t covered_pixels = 0;
+	uint64_t visible = 0;
+	for (uint32_t y = 0; y < height; y++)
+	{
+		/* start the shapes of this row and merge them into the active ones */
+		int old_length = set.length;
+		for (uint32_t e = starts[y]; e < starts[y + 1]; e++)
+		{
+			int slot = scanline_slot_new(&set);
+			if (slot < 0)
+			{
+				goto scanline_draw_cleanup1;
+			}
+			Command *comm = list_get(commands, edges[e]);
+			int begun = draw_rows_begin(&set.rows[slot], comm, pieces[e],
+										width, height, y);
+			if (begun > 0)
+			{
+				set.index[slot] = edges[e];
+				set.piece[slot] = pieces[e];
+				set.active[set.length++] = slot;
+			}
+			else
+			{
+				set.free_slots[set.free_length++] = slot;
+			}
+			if (begun < 0)
+			{
+				goto scanline_draw_cleanup1;
+			}
+		}
+		if (old_length > 0 && set.length > old_length)
+		{
+			int a = 0;
+			int b = old_length;
+			for (int m = 0; m < set.length; m++)
+			{
+				if (b == set.length || (a < old_length &&
+					scanline_before(&set, set.active[a], set.active[b])))
+				{
+					set.merged[m] = set.active[a++];
+				}
+				else
+				{
+					set.merged[m] = set.active[b++];
+				}
+			}
+			int *tmp = set.active;
+			set.active = set.merged;
+			set.merged = tmp;
+		}
+
+		/* bitmap is upside down, therefore swap row */
+		uint8_t *row = (uint8_t *)pix_buffer->data +
+			(size_t)(height - 1 - y) * row_size;
+		memset(row + line_width, 0, row_size - line_width);
+		if (set.length == 0)
+		{
+			span_fill(row, background, width);
+			continue;
+		}
+
+		/* spans from the last command to the first */
+		covered.length = 0;
+		uint64_t row_written = 0;
+		int alive = 0;
+		for (int a = set.length - 1; a >= 0; a--)
+		{
+			int slot = set.active[a];
+			DrawRows *rows = &set.rows[slot];
+			int more = 1;
+			while (more && rows->row == y)
+			{
+				if (rows->x1 < rows->x2)
+				{
+					covered_pixels += rows->x2 - rows->x1;
+				}
+				if (rows->x1 < rows->x2 && row_written < width)
+				{
+					uint64_t written = scanline_cover(&covered, row, rows->x1,
+													  rows->x2, rows->color,
+													  rows->pixels);
+					visible += written;
+					row_written += written;
+					STATS_ADD(pixels[rows->shape], written);
+				}
+				more = draw_rows_next(rows);
+			}
+			if (more)
+			{
+				alive++;
+			}
+			else
+			{
+				draw_rows_end(rows);
+				set.free_slots[set.free_length++] = slot;
+				set.active[a] = -1;
+			}
+		}
+		if (row_written < width)
+		{
+			scanline_cover(&covered, row, 0, width, background, NULL);
+		}
+
+		/* remove the finished shapes */
+		if (alive < set.length)
+		{
+			int kept = 0;
+			for (int a = 0; a < set.length; a++)
+			{
+				if (set.active[a] >= 0)
+				{
+					set.active[kept++] = set.active[a];
+				}
+			}
+			set.length = kept;
+		}
+	}
+
+	STATS_ADD(overdraw_picture, (uint64_t)width * height);
+	STATS_ADD(overdraw_covered, covered_pixels);
+	STATS_ADD(overdraw_visible, visible);
+	ret = SCANLINE_SUCCESS;
+
+scanline_draw_cleanup1:
+	for (int a = 0; a < set.length; a++)
+	{
+		draw_rows_end(&set.rows[set.active[a]]);
+	}
+	scanline_active_delete(&set);
+	free(starts);
+	free(edges);
+	free(pieces);
+	free(covered.start);
+	free(covered.end);
+	return ret;
+}
@@ -0,0 +1,36 @@
+/*
+ *  scanline.h - Definitions for the scanline renderer
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SCANLINE_H
+#define SCANLINE_H
+
+#include <stdint.h>
+
+#include "list.h"
+#include "bitmap.h"
+
+#define SCANLINE_SUCCESS 0
+#define SCANLINE_ERR_NULL_POINTER_PASSED 1
+#define SCANLINE_ERR_OUT_OF_MEM 2
+
+int scanline_draw(PixelBuffer *pix_buffer, List *commands, uint32_t background);
+
+#endif
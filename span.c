@@ -0,0 +1,875 @@
+/*
+ *  span.c - Pixel span kernels with runtime CPU dispatch
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "span.h"
+#include "bitmap.h"
+
+/*
+ * The vector kernels are compiled with target attributes, so the build
+ * needs no architecture flags and the binary still runs on every x86 CPU,
+ * a kernel is only used after cpuid reported its instruction set
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPAN_X86
+#include <immintrin.h>
+#define SPAN_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+/* pixels of the color pattern of the scalar fill (12 bytes) */
+#define SPAN_SCALAR_BLOCK 4
+
+/* lengths and offsets checked by span_self_test */
+#define SPAN_TEST_LENGTH 300
+#define SPAN_TEST_OFFSETS 4
+#define SPAN_TEST_GUARD 64
+
+typedef struct _SpanFunctions_ {
+	const char *name;
+	void (*fill)(uint8_t *dst, int color, size_t count);
+	void (*pack_rgb)(uint8_t *dst, const uint8_t *src, size_t count);
+	void (*lerp)(uint8_t *dst, const int32_t start[3], const int32_t step[3],
+				 size_t count);
+} SpanFunctions;
+
+static void span_fill_first(uint8_t *dst, int color, size_t count);
+static void span_pack_rgb_first(uint8_t *dst, const uint8_t *src,
+								size_t count);
+static void span_lerp_first(uint8_t *dst, const int32_t start[3],
+							const int32_t step[3], size_t count);
+
+/* until the first call the functions choose the kernel */
+static const SpanFunctions span_first = {
+	"auto", span_fill_first, span_pack_rgb_first, span_lerp_first
+};
+static const SpanFunctions *span_active = &span_first;
+static SpanKernel span_active_kernel = SPAN_KERNEL_SCALAR;
+
+//-----------------------------------------------------------------------------
+///
+/// Writes a pattern of n pixels with the color, blue, green, red like in
+/// the pixel buffer
+///
+/// @param pattern  receives n * BITMAP_RGB_COLOR_SIZE bytes
+/// @param color    24 bit color
+/// @param n        number of pixels
+//
+static inline void span_pattern(uint8_t *pattern, int color, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		pattern[i * 3] = color & 0xff; /* blue */
+		pattern[i * 3 + 1] = (color & 0xff00) >> 8; /* green */
+		pattern[i * 3 + 2] = (color & 0xff0000) >> 16; /* red */
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Fills pixels with a color, portable version
+///
+/// @param dst    first pixel
+/// @param color  24 bit color
+/// @param count  number of pixels
+//
+static void span_fill_scalar(uint8_t *dst, int color, size_t count)
+{
+	uint8_t pattern[SPAN_SCALAR_BLOCK * BITMAP_RGB_COLOR_SIZE];
+	span_pattern(pattern, color, SPAN_SCALAR_BLOCK);
+	for (; count >= SPAN_SCALAR_BLOCK; count -= SPAN_SCALAR_BLOCK)
+	{
+		memcpy(dst, pattern, sizeof(pattern));
+		dst += sizeof(pattern);
+	}
+	for (; count > 0; count--)
+	{
+		memcpy(dst, pattern, BITMAP_RGB_COLOR_SIZE);
+		dst += BITMAP_RGB_COLOR_SIZE;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Converts pixels from blue, green, red to red, green, blue, portable
+/// version
+///
+/// @param dst    receives count pixels, must not overlap src
+/// @param src    pixels of the pixel buffer
+/// @param count  number of pixels
+//
+static void span_pack_rgb_scalar(uint8_t *dst, const uint8_t *src,
+								 size_t count)
+{
+	for (size_t i = 0; i < count * BITMAP_RGB_COLOR_SIZE;
+		 i += BITMAP_RGB_COLOR_SIZE)
+	{
+		dst[i + 0] = src[i + 2];
+		dst[i + 1] = src[i + 1];
+		dst[i + 2] = src[i + 0];
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Values of the channels n pixels after start (see span_lerp), the sum
+/// wraps around like the adds of the kernels
+///
+/// @param value  receives the 3 values
+/// @param start  values of the first pixel
+/// @param step   change of the values from one pixel to the next
+/// @param n      number of pixels
+//
+static inline void span_lerp_advance(int32_t value[3], const int32_t start[3],
+									 const int32_t step[3], size_t n)
+{
+	for (int c = 0; c < 3; c++)
+	{
+		value[c] = (int32_t)((uint32_t)start[c] + (uint32_t)step[c] *
+							 (uint32_t)n);
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes pixels whose channels change by a fixed step (see span_lerp),
+/// portable version
+///
+/// @param dst    first pixel
+/// @param start  blue, green and red of the first pixel, 16.16 fixed point
+/// @param step   change of blue, green and red from one pixel to the next
+/// @param count  number of pixels
+//
+static void span_lerp_scalar(uint8_t *dst, const int32_t start[3],
+							 const int32_t step[3], size_t count)
+{
+	uint32_t value[3] = {start[0], start[1], start[2]};
+	for (; count > 0; count--)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			int32_t v = (int32_t)value[c] >> 16;
+			dst[c] = (v < 0) ? 0 : (v > 255) ? 255 : v;
+			value[c] += (uint32_t)step[c];
+		}
+		dst += BITMAP_RGB_COLOR_SIZE;
+	}
+}
+
+#ifdef SPAN_X86
+
+//-----------------------------------------------------------------------------
+///
+/// Fills pixels with a color, 16 pixels (3 vectors) at a time
+///
+/// @param dst    first pixel
+/// @param color  24 bit color
+/// @param count  number of pixels
+//
+SPAN_TARGET("sse2")
+static void span_fill_sse2(uint8_t *dst, int color, size_t count)
+{
+	if (count < 16)
+	{
+		span_fill_scalar(dst, color, count);
+		return;
+	}
+	uint8_t pattern[3 * sizeof(__m128i)];
+	span_pattern(pattern, color, sizeof(pattern) / BITMAP_RGB_COLOR_SIZE);
+	__m128i v0 = _mm_loadu_si128((const __m128i *)pattern);
+	__m128i v1 = _mm_loadu_si128((const __m128i *)(pattern + 16));
+	__m128i v2 = _mm_loadu_si128((const __m128i *)(pattern + 32));
+	for (; count >= 16; count -= 16)
+	{
+		_mm_storeu_si128((__m128i *)dst, v0);
+		_mm_storeu_si128((__m128i *)(dst + 16), v1);
+		_mm_storeu_si128((__m128i *)(dst + 32), v2);
+		dst += sizeof(pattern);
+	}
+	span_fill_scalar(dst, color, count);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Converts pixels from blue, green, red to red, green, blue. SSE2 has no
+/// byte shuffle, so red and blue are moved by shifting the vector two bytes
+/// left and right and merged with masks. A vector holds 5 whole pixels, the
+/// 16th byte is wrong and overwritten by the next step.
+///
+/// @param dst    receives count pixels, must not overlap src
+/// @param src    pixels of the pixel buffer
+/// @param count  number of pixels
+//
+SPAN_TARGET("sse2")
+static void span_pack_rgb_sse2(uint8_t *dst, const uint8_t *src, size_t count)
+{
+	const __m128i red = _mm_setr_epi8(-1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0,
+									  -1, 0, 0, 0);
+	const __m128i green = _mm_slli_si128(red, 1);
+	const __m128i blue = _mm_slli_si128(red, 2);
+	size_t size = count * BITMAP_RGB_COLOR_SIZE;
+	size_t i = 0;
+	for (; i + sizeof(__m128i) <= size; i += 5 * BITMAP_RGB_COLOR_SIZE)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i out = _mm_or_si128(
+			_mm_and_si128(_mm_srli_si128(v, 2), red),
+			_mm_or_si128(_mm_and_si128(v, green),
+						 _mm_and_si128(_mm_slli_si128(v, 2), blue)));
+		_mm_storeu_si128((__m128i *)(dst + i), out);
+	}
+	span_pack_rgb_scalar(dst + i, src + i, count - i / BITMAP_RGB_COLOR_SIZE);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes pixels whose channels change by a fixed step (see span_lerp), 4
+/// pixels at a time: a vector per channel, the saturating packs clamp the
+/// values to bytes, which are interleaved to 4 pixels of 4 bytes. Each 64
+/// bit half shifts its second pixel onto the unused byte of the first, the
+/// halves are put together to 12 bytes.
+///
+/// @param dst    first pixel
+/// @param start  blue, green and red of the first pixel, 16.16 fixed point
+/// @param step   change of blue, green and red from one pixel to the next
+/// @param count  number of pixels
+//
+SPAN_TARGET("sse2")
+static void span_lerp_sse2(uint8_t *dst, const int32_t start[3],
+						   const int32_t step[3], size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i first = _mm_set_epi32(0, 0xffffff, 0, 0xffffff);
+	const __m128i second = _mm_set_epi32(0xffff, (int)0xff000000, 0xffff,
+										 (int)0xff000000);
+	__m128i v[3];
+	__m128i step4[3];
+	for (int c = 0; c < 3; c++)
+	{
+		uint32_t s = start[c];
+		uint32_t d = step[c];
+		v[c] = _mm_setr_epi32(s, s + d, s + 2 * d, s + 3 * d);
+		step4[c] = _mm_set1_epi32((int32_t)((uint32_t)step[c] * 4));
+	}
+	size_t done = 0;
+	for (; done + 4 <= count; done += 4)
+	{
+		__m128i bg = _mm_packs_epi32(_mm_srai_epi32(v[0], 16),
+									 _mm_srai_epi32(v[1], 16));
+		__m128i r = _mm_srai_epi32(v[2], 16);
+		__m128i bytes = _mm_packus_epi16(bg, _mm_packs_epi32(r, r));
+		__m128i pixels = _mm_unpacklo_epi16(
+			_mm_unpacklo_epi8(bytes, _mm_srli_si128(bytes, 4)),
+			_mm_unpacklo_epi8(_mm_srli_si128(bytes, 8), zero));
+		pixels = _mm_or_si128(_mm_and_si128(pixels, first),
+							  _mm_and_si128(_mm_srli_epi64(pixels, 8), second));
+		pixels = _mm_or_si128(_mm_move_epi64(pixels),
+							  _mm_slli_si128(_mm_srli_si128(pixels, 8), 6));
+		_mm_storel_epi64((__m128i *)dst, pixels);
+		int32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(pixels, 8));
+		memcpy(dst + 8, &tail, sizeof(tail));
+		dst += 4 * BITMAP_RGB_COLOR_SIZE;
+		for (int c = 0; c < 3; c++)
+		{
+			v[c] = _mm_add_epi32(v[c], step4[c]);
+		}
+	}
+	int32_t rest[3];
+	span_lerp_advance(rest, start, step, done);
+	span_lerp_scalar(dst, rest, step, count - done);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Fills pixels with a color, 32 pixels (3 vectors) at a time
+///
+/// @param dst    first pixel
+/// @param color  24 bit color
+/// @param count  number of pixels
+//
+SPAN_TARGET("avx2")
+static void span_fill_avx2(uint8_t *dst, int color, size_t count)
+{
+	if (count < 16)
+	{
+		span_fill_scalar(dst, color, count);
+		return;
+	}
+	uint8_t pattern[3 * sizeof(__m256i)];
+	span_pattern(pattern, color, sizeof(pattern) / BITMAP_RGB_COLOR_SIZE);
+	__m256i v0 = _mm256_loadu_si256((const __m256i *)pattern);
+	__m256i v1 = _mm256_loadu_si256((const __m256i *)(pattern + 32));
+	__m256i v2 = _mm256_loadu_si256((const __m256i *)(pattern + 64));
+	for (; count >= 32; count -= 32)
+	{
+		_mm256_storeu_si256((__m256i *)dst, v0);
+		_mm256_storeu_si256((__m256i *)(dst + 32), v1);
+		_mm256_storeu_si256((__m256i *)(dst + 64), v2);
+		dst += sizeof(pattern);
+	}
+	/*
+	 * The rest 5 pixels at a time with the first 16 bytes of the pattern,
+	 * the 16th byte is the blue of the next pixel, so 6 pixels must be left
+	 */
+	__m128i head = _mm256_castsi256_si128(v0);
+	for (; count >= 6; count -= 5)
+	{
+		_mm_storeu_si128((__m128i *)dst, head);
+		dst += 5 * BITMAP_RGB_COLOR_SIZE;
+	}
+
+	/*
+	 * gcc leaves out the vzeroupper before the tail call, the dirty upper
+	 * halves would slow down all following SSE code
+	 */
+	_mm256_zeroupper();
+	span_fill_scalar(dst, color, count);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Converts pixels from blue, green, red to red, green, blue. The 8 pixels
+/// of 24 bytes are spread to 12 bytes in each 128 bit lane, swapped with a
+/// byte shuffle and put together again.
+///
+/// @param dst    receives count pixels, must not overlap src
+/// @param src    pixels of the pixel buffer
+/// @param count  number of pixels
+//
+SPAN_TARGET("avx2")
+static void span_pack_rgb_avx2(uint8_t *dst, const uint8_t *src, size_t count)
+{
+	const __m256i spread = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+	const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+	const __m256i swap = _mm256_setr_epi8(
+		2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1,
+		2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1);
+	size_t size = count * BITMAP_RGB_COLOR_SIZE;
+	size_t i = 0;
+	for (; i + sizeof(__m256i) <= size; i += 8 * BITMAP_RGB_COLOR_SIZE)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+		v = _mm256_permutevar8x32_epi32(v, spread);
+		v = _mm256_shuffle_epi8(v, swap);
+		v = _mm256_permutevar8x32_epi32(v, join);
+		_mm256_storeu_si256((__m256i *)(dst + i), v);
+	}
+	span_pack_rgb_scalar(dst + i, src + i, count - i / BITMAP_RGB_COLOR_SIZE);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes pixels whose channels change by a fixed step (see span_lerp), 8
+/// pixels at a time: the channels are clamped in a vector each and joined to
+/// pixels of 4 bytes, a byte shuffle drops the unused bytes in each 128 bit
+/// lane and a permutation puts the 24 bytes together
+///
+/// @param dst    first pixel
+/// @param start  blue, green and red of the first pixel, 16.16 fixed point
+/// @param step   change of blue, green and red from one pixel to the next
+/// @param count  number of pixels
+//
+SPAN_TARGET("avx2")
+static void span_lerp_avx2(uint8_t *dst, const int32_t start[3],
+						   const int32_t step[3], size_t count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i max = _mm256_set1_epi32(255);
+	const __m256i compact = _mm256_setr_epi8(
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+	__m256i v[3];
+	__m256i step8[3];
+	for (int c = 0; c < 3; c++)
+	{
+		uint32_t s = start[c];
+		uint32_t d = step[c];
+		v[c] = _mm256_setr_epi32(s, s + d, s + 2 * d, s + 3 * d, s + 4 * d,
+								 s + 5 * d, s + 6 * d, s + 7 * d);
+		step8[c] = _mm256_set1_epi32((int32_t)(d * 8));
+	}
+	size_t done = 0;
+	for (; done + 8 <= count; done += 8)
+	{
+		__m256i channel[3];
+		for (int c = 0; c < 3; c++)
+		{
+			channel[c] = _mm256_min_epi32(_mm256_max_epi32(
+				_mm256_srai_epi32(v[c], 16), zero), max);
+			v[c] = _mm256_add_epi32(v[c], step8[c]);
+		}
+		__m256i pixels = _mm256_or_si256(channel[0], _mm256_or_si256(
+			_mm256_slli_epi32(channel[1], 8),
+			_mm256_slli_epi32(channel[2], 16)));
+		pixels = _mm256_shuffle_epi8(pixels, compact);
+		pixels = _mm256_permutevar8x32_epi32(pixels, join);
+		_mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(pixels));
+		_mm_storel_epi64((__m128i *)(dst + 16),
+						 _mm256_extracti128_si256(pixels, 1));
+		dst += 8 * BITMAP_RGB_COLOR_SIZE;
+	}
+	int32_t rest[3];
+	span_lerp_advance(rest, start, step, done);
+
+	/* no dirty upper halves for the following SSE code, see span_fill_avx2 */
+	_mm256_zeroupper();
+	span_lerp_scalar(dst, rest, step, count - done);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Fills pixels with a color, 64 pixels (3 vectors) at a time, the rest
+/// with masked stores
+///
+/// @param dst    first pixel
+/// @param color  24 bit color
+/// @param count  number of pixels
+//
+SPAN_TARGET("avx512f,avx512bw")
+static void span_fill_avx512(uint8_t *dst, int color, size_t count)
+{
+	if (count < 16)
+	{
+		span_fill_scalar(dst, color, count);
+		return;
+	}
+	uint8_t pattern[3 * sizeof(__m512i)];
+	span_pattern(pattern, color, sizeof(pattern) / BITMAP_RGB_COLOR_SIZE);
+	__m512i v[3];
+	v[0] = _mm512_loadu_si512(pattern);
+	v[1] = _mm512_loadu_si512(pattern + 64);
+	v[2] = _mm512_loadu_si512(pattern + 128);
+	for (; count >= 64; count -= 64)
+	{
+		_mm512_storeu_si512(dst, v[0]);
+		_mm512_storeu_si512(dst + 64, v[1]);
+		_mm512_storeu_si512(dst + 128, v[2]);
+		dst += sizeof(pattern);
+	}
+	size_t rest = count * BITMAP_RGB_COLOR_SIZE;
+	for (int k = 0; rest > 0; k++)
+	{
+		size_t n = (rest < 64) ? rest : 64;
+		__mmask64 mask = (n == 64) ? ~(__mmask64)0 :
+			((__mmask64)1 << n) - 1;
+		_mm512_mask_storeu_epi8(dst, mask, v[k]);
+		dst += n;
+		rest -= n;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Converts pixels from blue, green, red to red, green, blue. 16 pixels of
+/// 48 bytes are spread to 12 bytes in each 128 bit lane, swapped with a byte
+/// shuffle and put together again, the last pixels with masked loads and
+/// stores.
+///
+/// @param dst    receives count pixels, must not overlap src
+/// @param src    pixels of the pixel buffer
+/// @param count  number of pixels
+//
+SPAN_TARGET("avx512f,avx512bw")
+static void span_pack_rgb_avx512(uint8_t *dst, const uint8_t *src,
+								 size_t count)
+{
+	const __m512i spread = _mm512_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6,
+											 6, 7, 8, 9, 9, 10, 11, 12);
+	const __m512i join = _mm512_setr_epi32(0, 1, 2, 4, 5, 6, 8, 9,
+										   10, 12, 13, 14, 15, 15, 15, 15);
+	const __m512i swap = _mm512_broadcast_i32x4(_mm_setr_epi8(
+		2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1));
+	while (count > 0)
+	{
+		size_t n = (count < 16) ? count : 16;
+		__mmask64 mask = ((__mmask64)1 << (n * BITMAP_RGB_COLOR_SIZE)) - 1;
+		__m512i v = _mm512_maskz_loadu_epi8(mask, src);
+		v = _mm512_permutexvar_epi32(spread, v);
+		v = _mm512_shuffle_epi8(v, swap);
+		v = _mm512_permutexvar_epi32(join, v);
+		_mm512_mask_storeu_epi8(dst, mask, v);
+		src += n * BITMAP_RGB_COLOR_SIZE;
+		dst += n * BITMAP_RGB_COLOR_SIZE;
+		count -= n;
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes pixels whose channels change by a fixed step (see span_lerp), 16
+/// pixels at a time like the AVX2 kernel, the last pixels with a masked store
+///
+/// @param dst    first pixel
+/// @param start  blue, green and red of the first pixel, 16.16 fixed point
+/// @param step   change of blue, green and red from one pixel to the next
+/// @param count  number of pixels
+//
+SPAN_TARGET("avx512f,avx512bw")
+static void span_lerp_avx512(uint8_t *dst, const int32_t start[3],
+							 const int32_t step[3], size_t count)
+{
+	const __m512i zero = _mm512_setzero_si512();
+	const __m512i max = _mm512_set1_epi32(255);
+	const __m512i index = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+											11, 12, 13, 14, 15);
+	const __m512i compact = _mm512_broadcast_i32x4(_mm_setr_epi8(
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+	const __m512i join = _mm512_setr_epi32(0, 1, 2, 4, 5, 6, 8, 9,
+										   10, 12, 13, 14, 15, 15, 15, 15);
+	__m512i v[3];
+	__m512i step16[3];
+	for (int c = 0; c < 3; c++)
+	{
+		__m512i d = _mm512_set1_epi32(step[c]);
+		v[c] = _mm512_add_epi32(_mm512_set1_epi32(start[c]),
+								_mm512_mullo_epi32(index, d));
+		step16[c] = _mm512_slli_epi32(d, 4);
+	}
+	while (count > 0)
+	{
+		size_t n = (count < 16) ? count : 16;
+		__m512i channel[3];
+		for (int c = 0; c < 3; c++)
+		{
+			channel[c] = _mm512_min_epi32(_mm512_max_epi32(
+				_mm512_srai_epi32(v[c], 16), zero), max);
+			v[c] = _mm512_add_epi32(v[c], step16[c]);
+		}
+		__m512i pixels = _mm512_or_si512(channel[0], _mm512_or_si512(
+			_mm512_slli_epi32(channel[1], 8),
+			_mm512_slli_epi32(channel[2], 16)));
+		pixels = _mm512_shuffle_epi8(pixels, compact);
+		pixels = _mm512_permutexvar_epi32(join, pixels);
+		__mmask64 mask = ((__mmask64)1 << (n * BITMAP_RGB_COLOR_SIZE)) - 1;
+		_mm512_mask_storeu_epi8(dst, mask, pixels);
+		dst += n * BITMAP_RGB_COLOR_SIZE;
+		count -= n;
+	}
+}
+
+#endif
+
+/* kernels by SpanKernel, NULL functions if not compiled in */
+static const SpanFunctions span_kernels[SPAN_KERNEL_COUNT] = {
+	[SPAN_KERNEL_SCALAR] = {"scalar", span_fill_scalar, span_pack_rgb_scalar,
+							span_lerp_scalar},
+#ifdef SPAN_X86
+	[SPAN_KERNEL_SSE2] = {"sse2", span_fill_sse2, span_pack_rgb_sse2,
+						  span_lerp_sse2},
+	[SPAN_KERNEL_AVX2] = {"avx2", span_fill_avx2, span_pack_rgb_avx2,
+						  span_lerp_avx2},
+	[SPAN_KERNEL_AVX512] = {"avx512", span_fill_avx512, span_pack_rgb_avx512,
+							span_lerp_avx512}
+#else
+	[SPAN_KERNEL_SSE2] = {"sse2", NULL, NULL, NULL},
+	[SPAN_KERNEL_AVX2] = {"avx2", NULL, NULL, NULL},
+	[SPAN_KERNEL_AVX512] = {"avx512", NULL, NULL, NULL}
+#endif
+};
+
+//-----------------------------------------------------------------------------
+///
+/// Checks whether a kernel is compiled in and the CPU (and the operating
+/// system) supports its instructions
+///
+/// @param kernel  kernel to check
+///
+/// @return 1 if the kernel can be used, 0 otherwise
+//
+int span_kernel_supported(SpanKernel kernel)
+{
+	if (kernel < 0 || kernel >= SPAN_KERNEL_COUNT ||
+		span_kernels[kernel].fill == NULL)
+	{
+		return 0;
+	}
+#ifdef SPAN_X86
+	__builtin_cpu_init();
+	if (kernel == SPAN_KERNEL_SSE2)
+	{
+		return __builtin_cpu_supports("sse2");
+	}
+	if (kernel == SPAN_KERNEL_AVX2)
+	{
+		return __builtin_cpu_supports("avx2");
+	}
+	if (kernel == SPAN_KERNEL_AVX512)
+	{
+		return __builtin_cpu_supports("avx512f") &&
+			__builtin_cpu_supports("avx512bw");
+	}
+#endif
+	return 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Name of a kernel as accepted by span_select
+///
+/// @param kernel  kernel
+///
+/// @return name of the kernel, "unknown" for invalid values
+//
+const char *span_kernel_name(SpanKernel kernel)
+{
+	if (kernel < 0 || kernel >= SPAN_KERNEL_COUNT)
+	{
+		return "unknown";
+	}
+	return span_kernels[kernel].name;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Uses a kernel for all following span functions
+///
+/// @param kernel  kernel to use
+///
+/// @return SPAN_SUCCESS on success, SPAN_ERR_UNSUPPORTED if the CPU does not
+///         support the kernel
+//
+int span_use(SpanKernel kernel)
+{
+	if (!span_kernel_supported(kernel))
+	{
+		return SPAN_ERR_UNSUPPORTED;
+	}
+	span_active_kernel = kernel;
+	span_active = &span_kernels[kernel];
+	return SPAN_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Selects the kernel by name, "auto" takes the fastest kernel the CPU
+/// supports. Without a call the span functions select "auto" on their first
+/// call.
+///
+/// @param name  "auto", "scalar", "sse2", "avx2" or "avx512"
+///
+/// @return SPAN_SUCCESS on success, SPAN_ERR_UNKNOWN_KERNEL or
+///         SPAN_ERR_UNSUPPORTED otherwise
+//
+int span_select(const char *name)
+{
+	if (name == NULL || strcmp(name, "auto") == 0)
+	{
+		SpanKernel kernel = SPAN_KERNEL_COUNT - 1;
+		while (!span_kernel_supported(kernel))
+		{
+			kernel--;
+		}
+		return span_use(kernel);
+	}
+	for (int kernel = 0; kernel < SPAN_KERNEL_COUNT; kernel++)
+	{
+		if (strcmp(name, span_kernels[kernel].name) == 0)
+		{
+			return span_use(kernel);
+		}
+	}
+	return SPAN_ERR_UNKNOWN_KERNEL;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Kernel used by the span functions, selects "auto" if none is selected
+///
+/// @return the kernel
+//
+SpanKernel span_selected(void)
+{
+	if (span_active == &span_first)
+	{
+		span_select("auto");
+	}
+	return span_active_kernel;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// First call of span_fill, selects the kernel and forwards the call
+//
+static void span_fill_first(uint8_t *dst, int color, size_t count)
+{
+	span_select("auto");
+	span_active->fill(dst, color, count);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// First call of span_pack_rgb, selects the kernel and forwards the call
+//
+static void span_pack_rgb_first(uint8_t *dst, const uint8_t *src,
+								size_t count)
+{
+	span_select("auto");
+	span_active->pack_rgb(dst, src, count);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// First call of span_lerp, selects the kernel and forwards the call
+//
+static void span_lerp_first(uint8_t *dst, const int32_t start[3],
+							const int32_t step[3], size_t count)
+{
+	span_select("auto");
+	span_active->lerp(dst, start, step, count);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Fills pixels of a row with a color
+///
+/// @param dst    first pixel (blue, green, red)
+/// @param color  24 bit color
+/// @param count  number of pixels
+//
+void span_fill(uint8_t *dst, int color, size_t count)
+{
+	span_active->fill(dst, color, count);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Converts pixels of a row from blue, green, red (pixel buffer) to red,
+/// green, blue (png)
+///
+/// @param dst    receives count pixels, must not overlap src
+/// @param src    pixels of the pixel buffer
+/// @param count  number of pixels
+//
+void span_pack_rgb(uint8_t *dst, const uint8_t *src, size_t count)
+{
+	span_active->pack_rgb(dst, src, count);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes pixels of a row whose channels change by a fixed step, as for a
+/// color gradient: channel c of pixel i is (start[c] + i * step[c]) >> 16
+/// clamped to 0 to 255, the sum wraps around at 32 bits
+///
+/// @param dst    first pixel (blue, green, red)
+/// @param start  blue, green and red of the first pixel, 16.16 fixed point
+/// @param step   change of blue, green and red from one pixel to the next
+/// @param count  number of pixels
+//
+void span_lerp(uint8_t *dst, const int32_t start[3], const int32_t step[3],
+			   size_t count)
+{
+	span_active->lerp(dst, start, step, count);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Compares the output of a kernel with the scalar kernel for all lengths up
+/// to SPAN_TEST_LENGTH pixels at different offsets, bytes next to the span
+/// must not change
+///
+/// @param kernel  kernel to check
+///
+/// @return SPAN_SUCCESS if the output is identical, SPAN_ERR_MISMATCH if not,
+///         SPAN_ERR_UNSUPPORTED or SPAN_ERR_OUT_OF_MEM otherwise
+//
+int span_self_test(SpanKernel kernel)
+{
+	if (!span_kernel_supported(kernel))
+	{
+		return SPAN_ERR_UNSUPPORTED;
+	}
+	const SpanFunctions *test = &span_kernels[kernel];
+	const SpanFunctions *scalar = &span_kernels[SPAN_KERNEL_SCALAR];
+	static const int colors[] = {0x000000, 0xffffff, 0x123456, 0xfe01a7};
+
+	/* gradients, clamped at both ends and wrapping around */
+	static const int32_t lerps[][2][3] = {
+		{{0, 0, 0}, {0, 0, 0}},
+		{{10 << 16, 200 << 16, 128 << 16}, {3000, -5000, 0}},
+		{{-5 * 65536, 250 << 16, 0x7fff0000}, {40000, 40000, -70000}},
+		{{0x7ff00000, INT32_MIN, 0x8000}, {0x01000000, 0x00800000, 65536}}
+	};
+
+	size_t size = SPAN_TEST_LENGTH * BITMAP_RGB_COLOR_SIZE +
+		SPAN_TEST_OFFSETS + 2 * SPAN_TEST_GUARD;
+	uint8_t *src = malloc(size);
+	uint8_t *expected = malloc(size);
+	uint8_t *actual = malloc(size);
+	int ret = SPAN_ERR_OUT_OF_MEM;
+	if (src == NULL || expected == NULL || actual == NULL)
+	{
+		goto span_self_test_cleanup1;
+	}
+	for (size_t i = 0; i < size; i++)
+	{
+		src[i] = (uint8_t)(i * 167 + (i >> 3) * 13);
+	}
+
+	ret = SPAN_ERR_MISMATCH;
+	for (size_t count = 0; count <= SPAN_TEST_LENGTH; count++)
+	{
+		for (size_t offset = 0; offset < SPAN_TEST_OFFSETS; offset++)
+		{
+			uint8_t *dst_expected = expected + SPAN_TEST_GUARD + offset;
+			uint8_t *dst_actual = actual + SPAN_TEST_GUARD + offset;
+			for (size_t c = 0; c < sizeof(colors) / sizeof(colors[0]); c++)
+			{
+				memset(expected, 0xa5, size);
+				memset(actual, 0xa5, size);
+				scalar->fill(dst_expected, colors[c], count);
+				test->fill(dst_actual, colors[c], count);
+				if (memcmp(expected, actual, size) != 0)
+				{
+					goto span_self_test_cleanup1;
+				}
+			}
+			memset(expected, 0xa5, size);
+			memset(actual, 0xa5, size);
+			scalar->pack_rgb(dst_expected, src + offset, count);
+			test->pack_rgb(dst_actual, src + offset, count);
+			if (memcmp(expected, actual, size) != 0)
+			{
+				goto span_self_test_cleanup1;
+			}
+			for (size_t l = 0; l < sizeof(lerps) / sizeof(lerps[0]); l++)
+			{
+				memset(expected, 0xa5, size);
+				memset(actual, 0xa5, size);
+				scalar->lerp(dst_expected, lerps[l][0], lerps[l][1], count);
+				test->lerp(dst_actual, lerps[l][0], lerps[l][1], count);
+				if (memcmp(expected, actual, size) != 0)
+				{
+					goto span_self_test_cleanup1;
+				}
+			}
+		}
+	}
+	ret = SPAN_SUCCESS;
+
+span_self_test_cleanup1:
+	free(src);
+	free(expected);
+	free(actual);
+	return ret;
+}
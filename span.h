@@ -0,0 +1,55 @@
+/*
+ *  span.h - Definitions for the pixel span kernels
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SPAN_SUCCESS 0
+#define SPAN_ERR_UNKNOWN_KERNEL 1
+#define SPAN_ERR_UNSUPPORTED 2
+#define SPAN_ERR_MISMATCH 3
+#define SPAN_ERR_OUT_OF_MEM 4
+
+/* SPAN_KERNEL_COUNT is no kernel, it is the number of kernels */
+typedef enum _SpanKernel_ {
+	SPAN_KERNEL_SCALAR,
+	SPAN_KERNEL_SSE2,
+	SPAN_KERNEL_AVX2,
+	SPAN_KERNEL_AVX512,
+	SPAN_KERNEL_COUNT
+} SpanKernel;
+
+int span_kernel_supported(SpanKernel kernel);
+const char *span_kernel_name(SpanKernel kernel);
+int span_select(const char *name);
+SpanKernel span_selected(void);
+int span_use(SpanKernel kernel);
+int span_self_test(SpanKernel kernel);
+
+void span_fill(uint8_t *dst, int color, size_t count);
+void span_pack_rgb(uint8_t *dst, const uint8_t *src, size_t count);
+void span_lerp(uint8_t *dst, const int32_t start[3], const int32_t step[3],
+			   size_t count);
+
+#endif
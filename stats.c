@@ -0,0 +1,265 @@
+/*
+ *  stats.c - Code for collecting and printing run time statistics
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "stats.h"
+
+Stats stats;
+
+static const char *stage_names[STATS_STAGE_COUNT] = {
+	"parse",
+	"sort",
+	"rasterize",
+	"encode"
+};
+
+static const char *shape_names[SH_COUNT] = {
+	"rectangle",
+	"circle",
+	"triangle",
+	"line",
+	"polyline",
+	"polygon",
+	"ellipse",
+	"ring",
+	"roundrect",
+	"define",
+	"use",
+	"points",
+	"grid",
+	"image",
+	"gradient",
+	"text"
+};
+
+//-----------------------------------------------------------------------------
+///
+/// Read the monotonic clock
+///
+/// @return current time in seconds
+//
+static double stats_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Read the peak resident set size of the process
+///
+/// @return peak resident set size in kB
+//
+static long stats_peak_rss(void)
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+	return usage.ru_maxrss;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Overdraw the scanline renderer avoided: writes per pixel if the
+/// background is filled and every shape is drawn completely
+///
+/// @return writes per pixel
+//
+static double stats_overdraw_factor(void)
+{
+	return (double)(stats.overdraw_picture + stats.overdraw_covered) /
+		stats.overdraw_picture;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Share of the ellipses drawn whose spans the span cache had
+///
+/// @return hit rate from 0 to 1
+//
+static double stats_span_cache_hit_rate(void)
+{
+	return (double)stats.span_cache_hits /
+		(stats.span_cache_hits + stats.span_cache_misses);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Enable collecting statistics, all counters start at zero
+//
+void stats_enable(void)
+{
+	stats.enabled = 1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Start timing a stage, does nothing if statistics are disabled
+///
+/// @param stage  one of the STATS_STAGE_* values
+//
+void stats_stage_begin(int stage)
+{
+	if (!stats.enabled || stage < 0 || stage >= STATS_STAGE_COUNT)
+	{
+		return;
+	}
+	stats.stage_allocations = stats.allocations;
+	stats.stage_start = stats_now();
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Stop timing a stage and record its wall time, allocations and the peak
+/// resident set size reached so far, does nothing if statistics are disabled
+///
+/// @param stage  stage passed to stats_stage_begin before
+//
+void stats_stage_end(int stage)
+{
+	if (!stats.enabled || stage < 0 || stage >= STATS_STAGE_COUNT)
+	{
+		return;
+	}
+	StatsStage *s = &stats.stage[stage];
+	s->wall_time += stats_now() - stats.stage_start;
+	s->allocations += stats.allocations - stats.stage_allocations;
+	s->peak_rss = stats_peak_rss();
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Print the collected statistics
+///
+/// @param file    file to print to
+/// @param format  STATS_FORMAT_TEXT for a table or STATS_FORMAT_JSON
+//
+void stats_print(FILE *file, int format)
+{
+	double wall_time = 0;
+	for (int i = 0; i < STATS_STAGE_COUNT; i++)
+	{
+		wall_time += stats.stage[i].wall_time;
+	}
+	long peak_rss = stats_peak_rss();
+
+	if (format == STATS_FORMAT_JSON)
+	{
+		fprintf(file, "{\n  \"stages\": {\n");
+		for (int i = 0; i < STATS_STAGE_COUNT; i++)
+		{
+			StatsStage *s = &stats.stage[i];
+			fprintf(file, "    \"%s\": {\"wall_ms\": %.3f, \"allocations\": "
+					"%llu, \"peak_rss_kb\": %ld}%s\n", stage_names[i],
+					s->wall_time * 1e3, (unsigned long long)s->allocations,
+					s->peak_rss, i + 1 < STATS_STAGE_COUNT ? "," : "");
+		}
+		fprintf(file, "  },\n  \"wall_ms\": %.3f,\n", wall_time * 1e3);
+		fprintf(file, "  \"bytes_read\": %llu,\n",
+				(unsigned long long)stats.bytes_read);
+		fprintf(file, "  \"lines_parsed\": %llu,\n",
+				(unsigned long long)stats.lines_parsed);
+		fprintf(file, "  \"commands\": {");
+		for (int i = 0; i < SH_COUNT; i++)
+		{
+			fprintf(file, "%s\"%s\": %llu", i > 0 ? ", " : "",
+					shape_names[i],
+					(unsigned long long)stats.commands[i]);
+		}
+		fprintf(file, "},\n  \"pixels\": {");
+		for (int i = 0; i < SH_COUNT; i++)
+		{
+			fprintf(file, "%s\"%s\": %llu", i > 0 ? ", " : "",
+					shape_names[i], (unsigned long long)stats.pixels[i]);
+		}
+		fprintf(file, "},\n");
+		if (stats.overdraw_picture > 0)
+		{
+			fprintf(file, "  \"overdraw\": {\"picture\": %llu, \"covered\": "
+					"%llu, \"visible\": %llu, \"factor\": %.3f},\n",
+					(unsigned long long)stats.overdraw_picture,
+					(unsigned long long)stats.overdraw_covered,
+					(unsigned long long)stats.overdraw_visible,
+					stats_overdraw_factor());
+		}
+		if (stats.span_cache_hits + stats.span_cache_misses > 0)
+		{
+			fprintf(file, "  \"span_cache\": {\"hits\": %llu, \"misses\": "
+					"%llu, \"hit_rate\": %.3f},\n",
+					(unsigned long long)stats.span_cache_hits,
+					(unsigned long long)stats.span_cache_misses,
+					stats_span_cache_hit_rate());
+		}
+		fprintf(file, "  \"allocations\": %llu,\n",
+				(unsigned long long)stats.allocations);
+		fprintf(file, "  \"peak_rss_kb\": %ld\n}\n", peak_rss);
+		return;
+	}
+
+	fprintf(file, "%-12s %12s %12s %12s\n",
+			"stage", "wall ms", "allocations", "peak rss kB");
+	for (int i = 0; i < STATS_STAGE_COUNT; i++)
+	{
+		StatsStage *s = &stats.stage[i];
+		fprintf(file, "%-12s %12.3f %12llu %12ld\n", stage_names[i],
+				s->wall_time * 1e3, (unsigned long long)s->allocations,
+				s->peak_rss);
+	}
+	fprintf(file, "%-12s %12.3f %12llu %12ld\n", "total", wall_time * 1e3,
+			(unsigned long long)stats.allocations, peak_rss);
+
+	fprintf(file, "\nbytes read:   %llu\nlines parsed: %llu\n\n",
+			(unsigned long long)stats.bytes_read,
+			(unsigned long long)stats.lines_parsed);
+
+	fprintf(file, "%-12s %12s %16s\n", "shape", "commands", "pixels");
+	for (int i = 0; i < SH_COUNT; i++)
+	{
+		fprintf(file, "%-12s %12llu %16llu\n", shape_names[i],
+				(unsigned long long)stats.commands[i],
+				(unsigned long long)stats.pixels[i]);
+	}
+
+	if (stats.overdraw_picture > 0)
+	{
+		fprintf(file, "\nscanline: %llu pixels covered by shapes, %llu "
+				"visible\noverdraw: %.2f writes per pixel without scanline "
+				"rendering, 1.00 with\n",
+				(unsigned long long)stats.overdraw_covered,
+				(unsigned long long)stats.overdraw_visible,
+				stats_overdraw_factor());
+	}
+
+	if (stats.span_cache_hits + stats.span_cache_misses > 0)
+	{
+		fprintf(file, "\nellipse span cache: %llu hits, %llu misses, hit "
+				"rate %.1f%%\n", (unsigned long long)stats.span_cache_hits,
+				(unsigned long long)stats.span_cache_misses,
+				stats_span_cache_hit_rate() * 100);
+	}
+}
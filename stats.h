@@ -0,0 +1,81 @@
+/*
+ *  stats.h - Definitions for collecting run time statistics
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "parse.h"
+
+#define STATS_STAGE_PARSE 0
+#define STATS_STAGE_SORT 1
+#define STATS_STAGE_RASTERIZE 2
+#define STATS_STAGE_ENCODE 3
+#define STATS_STAGE_COUNT 4
+
+#define STATS_FORMAT_TEXT 0
+#define STATS_FORMAT_JSON 1
+
+typedef struct _StatsStage_ {
+	double wall_time;      /* seconds */
+	uint64_t allocations;  /* malloc, calloc and realloc calls */
+	long peak_rss;         /* high water mark of the resident set in kB */
+} StatsStage;
+
+typedef struct _Stats_ {
+	int enabled;
+	StatsStage stage[STATS_STAGE_COUNT];
+	double stage_start;
+	uint64_t stage_allocations;
+	uint64_t bytes_read;
+	uint64_t lines_parsed;
+	uint64_t commands[SH_COUNT];
+	uint64_t pixels[SH_COUNT];
+	uint64_t overdraw_picture;  /* scanline renderer: pixels of the picture, */
+	uint64_t overdraw_covered;  /* pixels covered by the spans of the shapes */
+	uint64_t overdraw_visible;  /* and the visible ones */
+	uint64_t span_cache_hits;    /* ellipses whose spans were cached and */
+	uint64_t span_cache_misses;  /* ellipses whose spans were calculated */
+	uint64_t allocations;  /* counted even if disabled, see stats_alloc.c */
+} Stats;
+
+extern Stats stats;
+
+/*
+ * Counters are only touched if statistics are enabled, so the disabled case
+ * costs a single well predicted branch
+ */
+#define STATS_ADD(field, value) \
+	do \
+	{ \
+		if (stats.enabled) \
+		{ \
+			stats.field += (value); \
+		} \
+	} while (0)
+
+void stats_enable(void);
+void stats_stage_begin(int stage);
+void stats_stage_end(int stage);
+void stats_print(FILE *file, int format);
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ *  stream.c - Code for output streams of the encoders
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stream.h"
+
+//-----------------------------------------------------------------------------
+///
+/// Write function for streams writing to a file
+///
+/// @param handle  FILE pointer
+/// @param data    data to write
+/// @param size    size of data in bytes
+///
+/// @return STREAM_SUCCESS on success, STREAM_ERR_WRITE otherwise
+//
+static int stream_file_write(void *handle, const void *data, size_t size)
+{
+	if (fwrite(data, 1, size, (FILE *)handle) != size)
+	{
+		return STREAM_ERR_WRITE;
+	}
+	return STREAM_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Initialise a stream writing to a file
+///
+/// @param stream  stream structure to initialise
+/// @param file    file opened for writing
+//
+void stream_file_init(Stream *stream, FILE *file)
+{
+	stream->write = stream_file_write;
+	stream->handle = file;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Make sure a memory buffer can hold at least capacity bytes
+///
+/// @param memory    memory buffer
+/// @param capacity  number of bytes the buffer must be able to hold
+///
+/// @return STREAM_SUCCESS on success, STREAM_ERR_OUT_OF_MEM otherwise
+//
+int stream_memory_reserve(StreamMemory *memory, size_t capacity)
+{
+	if (capacity <= memory->capacity)
+	{
+		return STREAM_SUCCESS;
+	}
+	char *data = realloc(memory->data, capacity);
+	if (data == NULL)
+	{
+		return STREAM_ERR_OUT_OF_MEM;
+	}
+	memory->data = data;
+	memory->capacity = capacity;
+	return STREAM_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write function for streams writing to memory, the buffer grows by
+/// doubling
+///
+/// @param handle  StreamMemory pointer
+/// @param data    data to write
+/// @param size    size of data in bytes
+///
+/// @return STREAM_SUCCESS on success, STREAM_ERR_OUT_OF_MEM otherwise
+//
+static int stream_memory_write(void *handle, const void *data, size_t size)
+{
+	StreamMemory *memory = handle;
+	if (size > memory->capacity - memory->size)
+	{
+		size_t capacity = 2 * memory->capacity;
+		if (capacity < memory->size + size)
+		{
+			capacity = memory->size + size;
+		}
+		if (stream_memory_reserve(memory, capacity) != STREAM_SUCCESS)
+		{
+			return STREAM_ERR_OUT_OF_MEM;
+		}
+	}
+	memcpy(memory->data + memory->size, data, size);
+	memory->size += size;
+	return STREAM_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Initialise a stream writing to memory, writing starts at the beginning of
+/// the buffer, memory allocated before is reused
+///
+/// @param stream  stream structure to initialise
+/// @param memory  memory buffer, zero initialised before first use
+//
+void stream_memory_init(Stream *stream, StreamMemory *memory)
+{
+	memory->size = 0;
+	stream->write = stream_memory_write;
+	stream->handle = memory;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Free the memory of a memory buffer, it can be used again afterwards
+///
+/// @param memory  memory buffer
+//
+void stream_memory_free(StreamMemory *memory)
+{
+	free(memory->data);
+	memory->data = NULL;
+	memory->size = 0;
+	memory->capacity = 0;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write data to a stream
+///
+/// @param stream  stream to write to
+/// @param data    data to write
+/// @param size    size of data in bytes
+///
+/// @return STREAM_SUCCESS on success, STREAM_ERR_WRITE otherwise
+//
+int stream_write(Stream *stream, const void *data, size_t size)
+{
+	if (size == 0)
+	{
+		return STREAM_SUCCESS;
+	}
+	return stream->write(stream->handle, data, size);
+}
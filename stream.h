@@ -0,0 +1,56 @@
+/*
+ *  stream.h - Definitions for output streams of the encoders
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define STREAM_SUCCESS 0
+#define STREAM_ERR_WRITE 1
+#define STREAM_ERR_OUT_OF_MEM 2
+
+/*
+ * Destination of encoded data, the encoders only call write and do not know
+ * whether they write to a file or somewhere else
+ */
+typedef struct _Stream_ {
+	int (*write)(void *handle, const void *data, size_t size);
+	void *handle;
+} Stream;
+
+/*
+ * Growing buffer in memory as destination, the buffer is kept when the
+ * stream is initialised again, so it can be reused for many images
+ */
+typedef struct _StreamMemory_ {
+	char *data;
+	size_t size;      /* bytes written */
+	size_t capacity;  /* bytes allocated */
+} StreamMemory;
+
+void stream_file_init(Stream *stream, FILE *file);
+void stream_memory_init(Stream *stream, StreamMemory *memory);
+int stream_memory_reserve(StreamMemory *memory, size_t capacity);
+void stream_memory_free(StreamMemory *memory);
+int stream_write(Stream *stream, const void *data, size_t size);
+
+#endif
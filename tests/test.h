@@ -0,0 +1,74 @@
+/*
+ *  test.h - Checks shared by the tests
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+/* checks that failed in the test program */
+static int test_failures = 0;
+
+/* a check that prints the condition and counts the failure if it is false */
+#define TEST_CHECK(condition) \
+	test_check((condition) != 0, #condition, __FILE__, __LINE__)
+
+//-----------------------------------------------------------------------------
+///
+/// Count and print a failed check
+///
+/// @param passed     1 if the condition was true
+/// @param condition  text of the condition
+/// @param file       source file of the check
+/// @param line       line of the check
+///
+/// @return passed
+//
+static int test_check(int passed, const char *condition, const char *file,
+					  int line)
+{
+	if (!passed)
+	{
+		fprintf(stderr, "%s:%d: check failed: %s\n", file, line, condition);
+		test_failures++;
+	}
+	return passed;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Print the result of a test program
+///
+/// @param name  name of the test program
+///
+/// @return exit code of the test program, 0 if every check passed
+//
+static int test_summary(const char *name)
+{
+	if (test_failures > 0)
+	{
+		fprintf(stderr, "%s: %d checks failed\n", name, test_failures);
+		return 1;
+	}
+	printf("%s: passed\n", name);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,813 @@
+/*
+ *  test_draw.c - Tests of the pixels the shapes draw
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../bitmap.h"
+#include "../draw.h"
+#include "../render.h"
+#include "test.h"
+
+/* canvas of the tests */
+#define TEST_WIDTH 64
+#define TEST_HEIGHT 48
+
+#define TEST_WHITE 0xffffff
+
+/*
+ * threads rendering the same scene at once and the pictures each renders,
+ * the ellipses of the scene have more sizes than the span cache keeps
+ */
+#define TEST_THREADS 4
+#define TEST_THREAD_RUNS 8
+#define TEST_THREAD_ELLIPSES 300
+
+/* binary file of the points drawn by the tests */
+#define TEST_POINTS_FILE "/tmp/bitmap_test_draw.bin"
+
+/* the picture a scene has to give, row by row from the top row on */
+static uint32_t expected[TEST_HEIGHT][TEST_WIDTH];
+
+//-----------------------------------------------------------------------------
+///
+/// Clear the expected picture to the background
+//
+static void test_expect_clear(void)
+{
+	for (int y = 0; y < TEST_HEIGHT; y++)
+	{
+		for (int x = 0; x < TEST_WIDTH; x++)
+		{
+			expected[y][x] = TEST_WHITE;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Put a picture drawn with characters into the expected picture, '#' is a
+/// pixel of the color, every other character leaves the pixel as it is
+///
+/// @param art    rows of the picture
+/// @param rows   number of rows
+/// @param x      column of the left upper corner
+/// @param y      row of the left upper corner
+/// @param color  color of the '#' pixels
+//
+static void test_expect_art(const char *const *art, int rows, int x, int y,
+							uint32_t color)
+{
+	for (int r = 0; r < rows; r++)
+	{
+		for (int c = 0; art[r][c] != 0; c++)
+		{
+			if (art[r][c] == '#' && x + c >= 0 && x + c < TEST_WIDTH &&
+				y + r >= 0 && y + r < TEST_HEIGHT)
+			{
+				expected[y + r][x + c] = color;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Reference of a circle: the bar of column i is higher than the distance j
+/// of the row if i^2 + (j + 1)^2 <= radius^2, checked without square roots
+///
+/// @param radius  radius of the circle
+/// @param i       column counted from the center column
+/// @param j       row counted from the center row
+///
+/// @return 1 if the pixel is in the circle
+//
+static int test_in_circle(int64_t radius, int64_t i, int64_t j)
+{
+	i = (i < 0) ? -i : i;
+	j = (j < 0) ? -j : j;
+	return i < radius && j < radius &&
+		i * i + (j + 1) * (j + 1) <= radius * radius;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Reference of an ellipse: (i ry)^2 + (j rx)^2 < (rx ry)^2, rx ry has to be
+/// below 2^31 for 64 bits
+///
+/// @param rx  horizontal radius
+/// @param ry  vertical radius
+/// @param i   column counted from the center column
+/// @param j   row counted from the center row
+///
+/// @return 1 if the pixel is in the ellipse
+//
+static int test_in_ellipse(int64_t rx, int64_t ry, int64_t i, int64_t j)
+{
+	return rx > 0 && ry > 0 && i * ry * i * ry + j * rx * j * rx <
+		rx * ry * rx * ry;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Reference of a rounded rectangle: the corner radius is limited to half
+/// the size and at least 1, a pixel outside the rows and columns of the
+/// corner centers has to be in the circle of the nearest corner center
+///
+/// @param width   width of the rectangle
+/// @param height  height of the rectangle
+/// @param radius  corner radius of the command
+/// @param i       column counted from the left column
+/// @param j       row counted from the top row
+///
+/// @return 1 if the pixel is in the rounded rectangle
+//
+static int test_in_roundrect(int64_t width, int64_t height, int64_t radius,
+							 int64_t i, int64_t j)
+{
+	int64_t max = ((width < height ? width : height) + 1) / 2;
+	radius = (radius > max) ? max : radius;
+	radius = (radius < 1) ? 1 : radius;
+	if (i < 0 || i >= width || j < 0 || j >= height)
+	{
+		return 0;
+	}
+	int64_t dx = (i < radius - 1) ? radius - 1 - i :
+		(i > width - radius) ? i - (width - radius) : 0;
+	int64_t dy = (j < radius - 1) ? radius - 1 - j :
+		(j > height - radius) ? j - (height - radius) : 0;
+	return test_in_circle(radius, dx, dy);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Put the reference pixels of an ellipse into the expected picture
+///
+/// @param x      center column
+/// @param y      center row
+/// @param rx     horizontal radius
+/// @param ry     vertical radius
+/// @param color  color of the ellipse
+//
+static void test_expect_ellipse(int64_t x, int64_t y, int64_t rx, int64_t ry,
+								uint32_t color)
+{
+	for (int py = 0; py < TEST_HEIGHT; py++)
+	{
+		for (int px = 0; px < TEST_WIDTH; px++)
+		{
+			if (test_in_ellipse(rx, ry, px - x, py - y))
+			{
+				expected[py][px] = color;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Put the reference pixels of a ring into the expected picture, like circles
+/// it leaves out column 0 if it is left of the center
+///
+/// @param x      center column
+/// @param y      center row
+/// @param inner  radius of the hole
+/// @param outer  radius of the ring
+/// @param color  color of the ring
+//
+static void test_expect_ring(int64_t x, int64_t y, int64_t inner,
+							 int64_t outer, uint32_t color)
+{
+	for (int py = 0; py < TEST_HEIGHT; py++)
+	{
+		for (int px = 0; px < TEST_WIDTH; px++)
+		{
+			if (test_in_circle(outer, px - x, py - y) &&
+				!test_in_circle(inner, px - x, py - y) && (px > 0 || x <= 0))
+			{
+				expected[py][px] = color;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Put the reference pixels of a rounded rectangle into the expected picture
+///
+/// @param x       left column
+/// @param y       top row
+/// @param width   width
+/// @param height  height
+/// @param radius  corner radius
+/// @param color   color of the rectangle
+//
+static void test_expect_roundrect(int64_t x, int64_t y, int64_t width,
+								  int64_t height, int64_t radius,
+								  uint32_t color)
+{
+	for (int py = 0; py < TEST_HEIGHT; py++)
+	{
+		for (int px = 0; px < TEST_WIDTH; px++)
+		{
+			if (test_in_roundrect(width, height, radius, px - x, py - y))
+			{
+				expected[py][px] = color;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Render a scene on the test canvas
+///
+/// @param scene     lines of the scene
+/// @param scanline  1 to draw with the scanline renderer
+/// @param pixels    receives the colors of the pixels, row by row from the
+///                  top row on
+///
+/// @return RENDER_* code of loading or drawing the scene, -1 if out of
+///         memory
+//
+static int test_render(const char *scene, int scanline,
+					   uint32_t pixels[TEST_HEIGHT][TEST_WIDTH])
+{
+	RenderContext *context = render_context_new();
+	if (context == NULL)
+	{
+		return -1;
+	}
+	context->scanline = scanline;
+	int ret = render_load_memory(context, scene, strlen(scene));
+	if (ret != RENDER_SUCCESS)
+	{
+		goto test_render_cleanup1;
+	}
+	PixelBuffer *pix_buffer = render_pixel_buffer_get(context, TEST_WIDTH,
+													  TEST_HEIGHT);
+	if (pix_buffer == NULL)
+	{
+		ret = -1;
+		goto test_render_cleanup1;
+	}
+	ret = render_draw(context, pix_buffer);
+	for (int y = 0; y < TEST_HEIGHT; y++)
+	{
+		const uint8_t *row = (const uint8_t *)bitmap_get_row(pix_buffer, y);
+		for (int x = 0; x < TEST_WIDTH; x++)
+		{
+			const uint8_t *pixel = row + x * BITMAP_RGB_COLOR_SIZE;
+			pixels[y][x] = pixel[0] | (pixel[1] << 8) | (pixel[2] << 16);
+		}
+	}
+	render_pixel_buffer_release(context, pix_buffer);
+
+test_render_cleanup1:
+	render_context_delete(context);
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Render a scene with both renderers (see --scanline), which have to give
+/// the same picture, and compare it to the expected picture
+///
+/// @param scene  lines of the scene
+//
+static void test_scene(const char *scene)
+{
+	static uint32_t pixels[TEST_HEIGHT][TEST_WIDTH];
+	static uint32_t scanline[TEST_HEIGHT][TEST_WIDTH];
+	if (!TEST_CHECK(test_render(scene, 0, pixels) == RENDER_SUCCESS) ||
+		!TEST_CHECK(test_render(scene, 1, scanline) == RENDER_SUCCESS) ||
+		!TEST_CHECK(memcmp(pixels, scanline, sizeof(pixels)) == 0))
+	{
+		fprintf(stderr, "  scene: %s", scene);
+		return;
+	}
+	for (int y = 0; y < TEST_HEIGHT; y++)
+	{
+		for (int x = 0; x < TEST_WIDTH; x++)
+		{
+			if (!TEST_CHECK(pixels[y][x] == expected[y][x]))
+			{
+				fprintf(stderr, "  pixel %d, %d is %06x instead of %06x\n"
+						"  scene: %s", x, y, pixels[y][x], expected[y][x],
+						scene);
+				return;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Triangles with vertices at the ends of the int range: the edge from
+/// (INT32_MIN, INT32_MIN) to (INT32_MAX, INT32_MAX) crosses the canvas on
+/// its diagonal, every row y is filled left of column y
+//
+static void test_triangle_extreme(void)
+{
+	test_expect_clear();
+	for (int y = 0; y < TEST_HEIGHT; y++)
+	{
+		for (int x = 0; x < y && x < TEST_WIDTH; x++)
+		{
+			expected[y][x] = 0xff0000;
+		}
+	}
+	test_scene("triangle id=\"1\" color=\"ff0000\" ax=\"-2147483648\" "
+			   "ay=\"-2147483648\" bx=\"2147483647\" by=\"2147483647\" "
+			   "cx=\"-2147483648\" cy=\"2147483647\"\n");
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Polygon with vertices in the top row of the int range: the corners of a
+/// rectangle from row INT32_MIN to row 20 get the pixels of the rectangle,
+/// columns 10 to 29 of the rows above row 20
+//
+static void test_polygon_extreme(void)
+{
+	test_expect_clear();
+	for (int y = 0; y < 20; y++)
+	{
+		for (int x = 10; x < 30; x++)
+		{
+			expected[y][x] = 0x00ff00;
+		}
+	}
+	test_scene("polygon id=\"1\" color=\"00ff00\" rule=\"evenodd\" "
+			   "points=\"10,-2147483648 30,-2147483648 30,20 10,20\"\n");
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Ellipses: a small one pixel by pixel, clipped ones, one far bigger than
+/// the canvas and the degenerate radii
+//
+static void test_ellipse(void)
+{
+	/* rx = 7, ry = 4: 13 columns and 7 rows */
+	static const char *const art[] = {
+		"..#########..",
+		"#############",
+		"#############",
+		"#############",
+		"#############",
+		"#############",
+		"..#########..",
+	};
+	test_expect_clear();
+	test_expect_art(art, 7, 4, 7, 0x0000ff);
+	test_scene("ellipse id=\"1\" color=\"0000ff\" x=\"10\" y=\"10\" rx=\"7\" "
+			   "ry=\"4\"\n");
+
+	/* clipped at the left and the bottom, at the top and the right */
+	test_expect_clear();
+	test_expect_ellipse(2, 45, 30, 12, 0x0000ff);
+	test_expect_ellipse(60, 3, 9, 20, 0xff00ff);
+	test_scene("ellipse id=\"1\" color=\"0000ff\" x=\"2\" y=\"45\" rx=\"30\" "
+			   "ry=\"12\"\n"
+			   "ellipse id=\"2\" color=\"ff00ff\" x=\"60\" y=\"3\" rx=\"9\" "
+			   "ry=\"20\"\n");
+
+	/* pixels on the ellipse, like (6, 4) for rx = 10 and ry = 5, are outside */
+	test_expect_clear();
+	test_expect_ellipse(15, 15, 10, 5, 0x0000ff);
+	test_expect_ellipse(45, 20, 5, 5, 0xff00ff);
+	test_scene("ellipse id=\"1\" color=\"0000ff\" x=\"15\" y=\"15\" rx=\"10\" "
+			   "ry=\"5\"\n"
+			   "ellipse id=\"2\" color=\"ff00ff\" x=\"45\" y=\"20\" rx=\"5\" "
+			   "ry=\"5\"\n");
+
+	/* only the right end of an ellipse of two million columns is visible */
+	test_expect_clear();
+	test_expect_ellipse(-1000000, 24, 1000030, 1000, 0x0000ff);
+	test_scene("ellipse id=\"1\" color=\"0000ff\" x=\"-1000000\" y=\"24\" "
+			   "rx=\"1000030\" ry=\"1000\"\n");
+
+	/* radius 0 draws nothing, radius 1 one column or row */
+	test_expect_clear();
+	for (int y = 6; y <= 14; y++)
+	{
+		expected[y][20] = 0x0000ff;
+	}
+	for (int x = 36; x <= 44; x++)
+	{
+		expected[10][x] = 0x0000ff;
+	}
+	expected[30][30] = 0x0000ff;
+	test_scene("ellipse id=\"1\" color=\"0000ff\" x=\"5\" y=\"5\" rx=\"0\" "
+			   "ry=\"4\"\n"
+			   "ellipse id=\"2\" color=\"0000ff\" x=\"5\" y=\"20\" rx=\"4\" "
+			   "ry=\"0\"\n"
+			   "ellipse id=\"3\" color=\"0000ff\" x=\"20\" y=\"10\" rx=\"1\" "
+			   "ry=\"5\"\n"
+			   "ellipse id=\"4\" color=\"0000ff\" x=\"40\" y=\"10\" rx=\"5\" "
+			   "ry=\"1\"\n"
+			   "ellipse id=\"5\" color=\"0000ff\" x=\"30\" y=\"30\" rx=\"1\" "
+			   "ry=\"1\"\n"
+			   "ellipse id=\"6\" color=\"0000ff\" x=\"50\" y=\"30\" rx=\"-3\" "
+			   "ry=\"3\"\n");
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Render a scene again and again, alternating the renderers, each time with
+/// a new context
+///
+/// @param arg  scene
+///
+/// @return NULL if every picture was the expected one, else the scene
+//
+static void *test_thread(void *arg)
+{
+	uint32_t (*pixels)[TEST_WIDTH] = malloc(sizeof(expected));
+	if (pixels == NULL)
+	{
+		return arg;
+	}
+	void *ret = NULL;
+	for (int run = 0; run < TEST_THREAD_RUNS && ret == NULL; run++)
+	{
+		if (test_render(arg, run % 2, pixels) != RENDER_SUCCESS ||
+			memcmp(pixels, expected, sizeof(expected)) != 0)
+		{
+			ret = arg;
+		}
+	}
+	free(pixels);
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Ellipses drawn by threads at once: they share the span cache, evict the
+/// tables of each other and delete their contexts while the others draw,
+/// and the cache is cleared meanwhile
+//
+static void test_ellipse_threads(void)
+{
+	static char scene[TEST_THREAD_ELLIPSES * 96];
+	size_t length = 0;
+	test_expect_clear();
+	for (int i = 0; i < TEST_THREAD_ELLIPSES; i++)
+	{
+		int rx = TEST_THREAD_ELLIPSES - i;
+		int ry = 1 + (i * 13) % 50;
+		int x = 28 + i % 9;
+		int color = (i * 0x050b13) & 0xffffff;
+		test_expect_ellipse(x, 24, rx, ry, color);
+		length += snprintf(scene + length, sizeof(scene) - length,
+						   "ellipse id=\"%d\" color=\"%06x\" x=\"%d\" "
+						   "y=\"24\" rx=\"%d\" ry=\"%d\"\n", i + 1, color,
+						   x, rx, ry);
+	}
+
+	pthread_t threads[TEST_THREADS];
+	int started = 0;
+	while (started < TEST_THREADS &&
+		   pthread_create(&threads[started], NULL, test_thread, scene) == 0)
+	{
+		started++;
+	}
+	TEST_CHECK(started == TEST_THREADS);
+	for (int i = 0; i < 1000; i++)
+	{
+		draw_cache_clear();
+	}
+	for (int i = 0; i < started; i++)
+	{
+		void *failed;
+		pthread_join(threads[i], &failed);
+		TEST_CHECK(failed == NULL);
+	}
+	draw_cache_clear();
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Rings: a small one pixel by pixel, clipped ones and the degenerate radii
+//
+static void test_ring(void)
+{
+	/* inner = 3, outer = 6: 11 columns and 11 rows */
+	static const char *const art[] = {
+		".....#.....",
+		"..#######..",
+		".#########.",
+		"#####.#####",
+		"###.....###",
+		"###.....###",
+		"###.....###",
+		"#####.#####",
+		".#########.",
+		"..#######..",
+		".....#.....",
+	};
+	test_expect_clear();
+	test_expect_art(art, 11, 15, 5, 0x00ffff);
+	test_scene("ring id=\"1\" color=\"00ffff\" x=\"20\" y=\"10\" inner=\"3\" "
+			   "outer=\"6\"\n");
+
+	/* clipped around the left upper corner and at the right border */
+	test_expect_clear();
+	test_expect_ring(0, 0, 10, 20, 0x00ffff);
+	test_expect_ring(62, 30, 5, 15, 0x808000);
+	test_scene("ring id=\"1\" color=\"00ffff\" x=\"0\" y=\"0\" inner=\"10\" "
+			   "outer=\"20\"\n"
+			   "ring id=\"2\" color=\"808000\" x=\"62\" y=\"30\" inner=\"5\" "
+			   "outer=\"15\"\n");
+
+	/* a ring wider than the canvas leaves its hole */
+	test_expect_clear();
+	test_expect_ring(32, 100020, 100000, 100030, 0x00ffff);
+	test_scene("ring id=\"1\" color=\"00ffff\" x=\"32\" y=\"100020\" "
+			   "inner=\"100000\" outer=\"100030\"\n");
+
+	/*
+	 * inner >= outer draws nothing, inner 0 or below the whole circle,
+	 * outer 0 nothing
+	 */
+	test_expect_clear();
+	test_expect_ring(40, 30, 0, 5, 0x00ffff);
+	test_expect_ring(55, 30, -4, 5, 0x00ffff);
+	test_scene("ring id=\"1\" color=\"00ffff\" x=\"10\" y=\"10\" inner=\"8\" "
+			   "outer=\"8\"\n"
+			   "ring id=\"2\" color=\"00ffff\" x=\"30\" y=\"10\" inner=\"9\" "
+			   "outer=\"6\"\n"
+			   "ring id=\"3\" color=\"00ffff\" x=\"10\" y=\"30\" inner=\"0\" "
+			   "outer=\"0\"\n"
+			   "ring id=\"4\" color=\"00ffff\" x=\"40\" y=\"30\" inner=\"0\" "
+			   "outer=\"5\"\n"
+			   "ring id=\"5\" color=\"00ffff\" x=\"55\" y=\"30\" inner=\"-4\" "
+			   "outer=\"5\"\n");
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Rounded rectangles: a small one pixel by pixel, clipped ones, corner
+/// radii larger than half the size, square corners and empty rectangles
+//
+static void test_roundrect(void)
+{
+	/* 12 x 9 pixels, corner radius 4 */
+	static const char *const art[] = {
+		"...######...",
+		".##########.",
+		"############",
+		"############",
+		"############",
+		"############",
+		"############",
+		".##########.",
+		"...######...",
+	};
+	test_expect_clear();
+	test_expect_art(art, 9, 3, 4, 0xff8000);
+	test_scene("roundrect id=\"1\" color=\"ff8000\" x=\"3\" y=\"4\" "
+			   "width=\"12\" height=\"9\" radius=\"4\"\n");
+
+	/* clipped at the left and the bottom, at the top and the right */
+	test_expect_clear();
+	test_expect_roundrect(-5, 40, 30, 20, 8, 0xff8000);
+	test_expect_roundrect(50, -10, 30, 25, 12, 0x008000);
+	test_scene("roundrect id=\"1\" color=\"ff8000\" x=\"-5\" y=\"40\" "
+			   "width=\"30\" height=\"20\" radius=\"8\"\n"
+			   "roundrect id=\"2\" color=\"008000\" x=\"50\" y=\"-10\" "
+			   "width=\"30\" height=\"25\" radius=\"12\"\n");
+
+	/*
+	 * a radius larger than half the size is limited to it, 2 radius - 1
+	 * pixels are the circle of the radius
+	 */
+	test_expect_clear();
+	test_expect_roundrect(2, 2, 10, 6, 3, 0xff8000);
+	test_expect_roundrect(20, 2, 9, 20, 5, 0xff8000);
+	for (int y = 30; y < 39; y++)
+	{
+		for (int x = 40; x < 49; x++)
+		{
+			if (test_in_circle(5, x - 44, y - 34))
+			{
+				expected[y][x] = 0xff8000;
+			}
+		}
+	}
+	test_scene("roundrect id=\"1\" color=\"ff8000\" x=\"2\" y=\"2\" "
+			   "width=\"10\" height=\"6\" radius=\"100\"\n"
+			   "roundrect id=\"2\" color=\"ff8000\" x=\"20\" y=\"2\" "
+			   "width=\"9\" height=\"20\" radius=\"2147483647\"\n"
+			   "roundrect id=\"3\" color=\"ff8000\" x=\"40\" y=\"30\" "
+			   "width=\"9\" height=\"9\" radius=\"5\"\n");
+
+	/* radius 1, 0 or below gives square corners, no width or height nothing */
+	test_expect_clear();
+	for (int y = 5; y < 12; y++)
+	{
+		for (int x = 5; x < 15; x++)
+		{
+			expected[y][x] = 0xff8000;
+			expected[y + 20][x] = 0xff8000;
+			expected[y][x + 20] = 0xff8000;
+		}
+	}
+	test_scene("roundrect id=\"1\" color=\"ff8000\" x=\"5\" y=\"5\" "
+			   "width=\"10\" height=\"7\" radius=\"1\"\n"
+			   "roundrect id=\"2\" color=\"ff8000\" x=\"5\" y=\"25\" "
+			   "width=\"10\" height=\"7\" radius=\"0\"\n"
+			   "roundrect id=\"3\" color=\"ff8000\" x=\"25\" y=\"5\" "
+			   "width=\"10\" height=\"7\" radius=\"-6\"\n"
+			   "roundrect id=\"4\" color=\"ff8000\" x=\"45\" y=\"5\" "
+			   "width=\"0\" height=\"7\" radius=\"2\"\n"
+			   "roundrect id=\"5\" color=\"ff8000\" x=\"45\" y=\"25\" "
+			   "width=\"8\" height=\"-3\" radius=\"2\"\n");
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draw points of one radius from a points file, each disc has to be the
+/// circle of the radius at its point
+///
+/// @param x       columns of the points
+/// @param y       rows of the points
+/// @param colors  colors of the points (layout "xyc"), NULL for layout "xy"
+///                with all points red
+/// @param count   number of points
+/// @param radius  radius of the discs
+//
+static void test_points(const int32_t *x, const int32_t *y,
+						const uint32_t *colors, int count, int64_t radius)
+{
+	test_expect_clear();
+	for (int i = 0; i < count; i++)
+	{
+		/* the upper 8 bits of a color are ignored */
+		test_expect_ring(x[i], y[i], 0, radius,
+						 (colors != NULL) ? colors[i] & 0xffffff : 0xff0000);
+	}
+	FILE *file = fopen(TEST_POINTS_FILE, "wb");
+	if (!TEST_CHECK(file != NULL))
+	{
+		return;
+	}
+	int written = fwrite(x, sizeof(int32_t), count, file) == (size_t)count &&
+		fwrite(y, sizeof(int32_t), count, file) == (size_t)count &&
+		(colors == NULL ||
+		 fwrite(colors, sizeof(uint32_t), count, file) == (size_t)count);
+	if (!TEST_CHECK(fclose(file) == 0 && written))
+	{
+		return;
+	}
+	char scene[256];
+	snprintf(scene, sizeof(scene), "points id=\"1\" color=\"ff0000\" "
+			 "radius=\"%lld\" file=\"%s\" layout=\"%s\"\n",
+			 (long long)radius, TEST_POINTS_FILE,
+			 (colors != NULL) ? "xyc" : "xy");
+	test_scene(scene);
+	unlink(TEST_POINTS_FILE);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Points whose discs reach the picture from far away: the rows of the
+/// discs are only calculated as far as the picture, a point two billion
+/// rows away costs no table of two billion rows
+//
+static void test_points_far(void)
+{
+	/* one disc covers the picture, the other one ends above it */
+	const int32_t far_x[] = {10, 10};
+	const int32_t far_y[] = {20, -2000000000};
+	test_points(far_x, far_y, NULL, 2, 2000000000);
+
+	/* discs centered above and below, their rows in the table and beyond */
+	const int32_t edge_x[] = {32, 5};
+	const int32_t edge_y[] = {-40, 90};
+	test_points(edge_x, edge_y, NULL, 2, 60);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Points with a color each (layout "xyc") whose upper 8 bits are set: both
+/// renderers ignore them and draw the 24 bit colors
+//
+static void test_points_colors(void)
+{
+	const int32_t x[] = {6, 16, 26};
+	const int32_t y[] = {8, 4, 11};
+	const uint32_t colors[] = {0xff00ff00, 0x800000ff, 0x01ff8000};
+	test_points(x, y, colors, 3, 4);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Reference of a steep line of width 1 (more rows than columns): row y has
+/// the pixel x1 + (x2 - x1) (y - y1) / (y2 - y1) rounded, halves up
+///
+/// @param x1     column of the first point
+/// @param y1     row of the first point
+/// @param x2     column of the second point
+/// @param y2     row of the second point (y2 > y1)
+/// @param color  color of the line
+//
+static void test_expect_steep_line(int64_t x1, int64_t y1, int64_t x2,
+								   int64_t y2, uint32_t color)
+{
+	int64_t dy = y2 - y1;
+	for (int64_t y = (y1 > 0) ? y1 : 0; y <= y2 && y < TEST_HEIGHT; y++)
+	{
+		/* floor((2 x1 dy + 2 dx k + dy) / 2 dy) */
+		int64_t n = 2 * x1 * dy + 2 * (x2 - x1) * (y - y1) + dy;
+		int64_t x = (n >= 0) ? n / (2 * dy) : -((-n + 2 * dy - 1) / (2 * dy));
+		if (x >= 0 && x < TEST_WIDTH)
+		{
+			expected[y][x] = color;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Long steep lines ending in the picture: the column of each row is exact,
+/// a line of 40000 rows over 3 columns ends at its end point instead of a
+/// column before it
+//
+static void test_line_long(void)
+{
+	test_expect_clear();
+	test_expect_steep_line(0, -39952, 3, 47, 0xff0000);
+	test_expect_steep_line(60, -39952, 57, 47, 0x0000ff);
+	test_expect_steep_line(20, -99999, 30, 40, 0x00ff00);
+	TEST_CHECK(expected[47][3] == 0xff0000 && expected[47][57] == 0x0000ff);
+	test_scene("line id=\"1\" color=\"ff0000\" x1=\"0\" y1=\"-39952\" "
+			   "x2=\"3\" y2=\"47\" width=\"1\"\n"
+			   "line id=\"2\" color=\"0000ff\" x1=\"57\" y1=\"47\" "
+			   "x2=\"60\" y2=\"-39952\" width=\"1\"\n"
+			   "line id=\"3\" color=\"00ff00\" x1=\"20\" y1=\"-99999\" "
+			   "x2=\"30\" y2=\"40\" width=\"1\"\n");
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Symbols without pixels: a symbol without shapes and one whose shapes are
+/// all outside its picture are used and draw nothing
+//
+static void test_symbol_empty(void)
+{
+	test_expect_clear();
+	expected[20][30] = 0x00ff00;
+	test_scene("define id=\"1\" width=\"8\" height=\"8\"\n"
+			   "end\n"
+			   "define id=\"2\" width=\"8\" height=\"8\"\n"
+			   "rectangle id=\"1\" color=\"ff0000\" x=\"20\" y=\"0\" "
+			   "width=\"4\" height=\"4\"\n"
+			   "circle id=\"2\" color=\"ff0000\" x=\"-10\" y=\"-10\" "
+			   "radius=\"3\"\n"
+			   "end\n"
+			   "use id=\"1\" symbol=\"1\" x=\"10\" y=\"10\"\n"
+			   "use id=\"2\" symbol=\"2\" x=\"30\" y=\"10\"\n"
+			   "rectangle id=\"3\" color=\"00ff00\" x=\"30\" y=\"20\" "
+			   "width=\"1\" height=\"1\"\n");
+}
+
+int main(void)
+{
+	test_triangle_extreme();
+	test_polygon_extreme();
+	test_ellipse();
+	test_ellipse_threads();
+	test_ring();
+	test_roundrect();
+	test_points_far();
+	test_points_colors();
+	test_line_long();
+	test_symbol_empty();
+
+	return test_summary("test_draw");
+}
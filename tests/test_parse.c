@@ -0,0 +1,195 @@
+/*
+ *  test_parse.c - Tests of the input file parser
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../bitmap.h"
+#include "../render.h"
+#include "test.h"
+
+/* size of the pictures the scenes are drawn into */
+#define TEST_WIDTH 32
+#define TEST_HEIGHT 16
+
+//-----------------------------------------------------------------------------
+///
+/// Load a scene and draw it
+///
+/// @param scene     lines of the scene
+/// @param error_id  receives the id of RENDER_ERR_DUPLICATE_ID (may be NULL)
+/// @param x         column of a pixel to read (when the scene is drawn)
+/// @param y         row of the pixel
+/// @param color     receives the color of the pixel (may be NULL)
+///
+/// @return RENDER_* code of loading or drawing, -1 if the test could not
+///         set it up
+//
+static int test_load(const char *scene, id_t *error_id, int x, int y,
+					 uint32_t *color)
+{
+	RenderContext *context = render_context_new();
+	if (context == NULL)
+	{
+		return -1;
+	}
+	int ret = render_load_memory(context, scene, strlen(scene));
+	if (error_id != NULL)
+	{
+		*error_id = context->error_id;
+	}
+	if (ret != RENDER_SUCCESS)
+	{
+		goto test_load_cleanup1;
+	}
+	PixelBuffer *pix_buffer = render_pixel_buffer_get(context, TEST_WIDTH,
+													  TEST_HEIGHT);
+	if (pix_buffer == NULL)
+	{
+		ret = -1;
+		goto test_load_cleanup1;
+	}
+	ret = render_draw(context, pix_buffer);
+	if (color != NULL)
+	{
+		const uint8_t *pixel = (const uint8_t *)bitmap_get_row(pix_buffer, y) +
+			x * BITMAP_RGB_COLOR_SIZE;
+		*color = pixel[0] | (pixel[1] << 8) | (pixel[2] << 16);
+	}
+	render_pixel_buffer_release(context, pix_buffer);
+
+test_load_cleanup1:
+	render_context_delete(context);
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Ids of shapes, symbols and gradients: each kind has its own ids, an id
+/// used twice in one kind is an error
+//
+static void test_ids(void)
+{
+	id_t error_id = 0;
+	uint32_t color = 0;
+
+	/* a symbol with the id of a shape, the use draws it in front */
+	TEST_CHECK(test_load("define id=\"1\" width=\"4\" height=\"4\"\n"
+						 "rectangle id=\"1\" color=\"ff0000\" x=\"0\" y=\"0\" "
+						 "width=\"4\" height=\"4\"\n"
+						 "end\n"
+						 "rectangle id=\"1\" color=\"0000ff\" x=\"0\" y=\"0\" "
+						 "width=\"32\" height=\"16\"\n"
+						 "use id=\"2\" symbol=\"1\" x=\"10\" y=\"5\"\n",
+						 NULL, 11, 6, &color) == RENDER_SUCCESS);
+	TEST_CHECK(color == 0xff0000);
+	TEST_CHECK(test_load("define id=\"1\" width=\"4\" height=\"4\"\n"
+						 "end\n"
+						 "rectangle id=\"1\" color=\"0000ff\" x=\"0\" y=\"0\" "
+						 "width=\"32\" height=\"16\"\n",
+						 NULL, 20, 10, &color) == RENDER_SUCCESS);
+	TEST_CHECK(color == 0x0000ff);
+
+	/* a gradient with the id of a shape and of a symbol */
+	TEST_CHECK(test_load("gradient id=\"1\" kind=\"linear\" x1=\"0\" y1=\"0\" "
+						 "x2=\"31\" y2=\"0\" stops=\"0:00ff00 100:00ff00\"\n"
+						 "define id=\"1\" width=\"4\" height=\"4\"\n"
+						 "end\n"
+						 "rectangle id=\"1\" color=\"0000ff\" x=\"0\" y=\"0\" "
+						 "width=\"32\" height=\"16\" fill=\"1\"\n",
+						 NULL, 5, 5, &color) == RENDER_SUCCESS);
+	TEST_CHECK(color == 0x00ff00);
+
+	/* ids used twice by shapes, by symbols or by gradients */
+	TEST_CHECK(test_load("rectangle id=\"3\" color=\"0000ff\" x=\"0\" y=\"0\" "
+						 "width=\"1\" height=\"1\"\n"
+						 "circle id=\"3\" color=\"0000ff\" x=\"5\" y=\"5\" "
+						 "radius=\"2\"\n",
+						 &error_id, 0, 0, NULL) == RENDER_ERR_DUPLICATE_ID);
+	TEST_CHECK(error_id == 3);
+	TEST_CHECK(test_load("define id=\"5\" width=\"4\" height=\"4\"\n"
+						 "end\n"
+						 "define id=\"5\" width=\"4\" height=\"4\"\n"
+						 "end\n",
+						 &error_id, 0, 0, NULL) == RENDER_ERR_DUPLICATE_ID);
+	TEST_CHECK(error_id == 5);
+	TEST_CHECK(test_load("gradient id=\"6\" kind=\"linear\" x1=\"0\" y1=\"0\" "
+						 "x2=\"9\" y2=\"0\" stops=\"0:000000 100:ffffff\"\n"
+						 "gradient id=\"6\" kind=\"radial\" x1=\"0\" y1=\"0\" "
+						 "x2=\"9\" y2=\"0\" stops=\"0:000000 100:ffffff\"\n",
+						 &error_id, 0, 0, NULL) == RENDER_ERR_DUPLICATE_ID);
+	TEST_CHECK(error_id == 6);
+
+	/* the shapes of a symbol have ids of their own too */
+	TEST_CHECK(test_load("define id=\"7\" width=\"4\" height=\"4\"\n"
+						 "rectangle id=\"7\" color=\"ff0000\" x=\"0\" y=\"0\" "
+						 "width=\"4\" height=\"4\"\n"
+						 "end\n"
+						 "use id=\"7\" symbol=\"7\" x=\"0\" y=\"0\"\n",
+						 NULL, 1, 1, &color) == RENDER_SUCCESS);
+	TEST_CHECK(color == 0xff0000);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Stops of gradients in the documented form: offset:color pairs separated
+/// by spaces, like the gradient of the example in the README
+//
+static void test_gradient_stops(void)
+{
+	uint32_t color = 0;
+
+	/* the gradient line of the README example, fill of the whole picture */
+	const char *example = "gradient id=\"15\" kind=\"radial\" x1=\"120\" "
+		"y1=\"100\" x2=\"200\" y2=\"100\" stops=\"0:ffffff 100:0000ff\"\n"
+		"rectangle id=\"16\" color=\"000000\" x=\"0\" y=\"0\" "
+		"width=\"32\" height=\"16\" fill=\"15\"\n";
+	TEST_CHECK(test_load(example, NULL, 0, 0, &color) == RENDER_SUCCESS);
+	TEST_CHECK(color == 0x0000ff);
+
+	/* first and last stop at the ends, the middle one half way */
+	const char *stops = "gradient id=\"1\" kind=\"linear\" x1=\"0\" "
+		"y1=\"0\" x2=\"30\" y2=\"0\" "
+		"stops=\"0:ff0000 50:ffffff 100:0000ff\"\n"
+		"rectangle id=\"1\" color=\"000000\" x=\"0\" y=\"0\" "
+		"width=\"32\" height=\"16\" fill=\"1\"\n";
+	TEST_CHECK(test_load(stops, NULL, 0, 5, &color) == RENDER_SUCCESS);
+	TEST_CHECK(color == 0xff0000);
+	TEST_CHECK(test_load(stops, NULL, 15, 5, &color) == RENDER_SUCCESS);
+	TEST_CHECK(color == 0xffffff);
+	TEST_CHECK(test_load(stops, NULL, 31, 5, &color) == RENDER_SUCCESS);
+	TEST_CHECK(color == 0x0000ff);
+
+	/* stops separated by commas are not the documented form */
+	TEST_CHECK(test_load("gradient id=\"1\" kind=\"linear\" x1=\"0\" "
+						 "y1=\"0\" x2=\"30\" y2=\"0\" "
+						 "stops=\"0:ffffff,100:0000ff\"\n",
+						 NULL, 0, 0, NULL) == RENDER_ERR_INVALID_INPUT);
+}
+
+int main(void)
+{
+	test_ids();
+	test_gradient_stops();
+
+	return test_summary("test_parse");
+}
@@ -0,0 +1,238 @@
+/*
+ *  test_size.c - Tests of the size limit of bitmap files
+ *  Copyright (C) 2017  Simon Kaufmann, HeKa
+ *
+ *  This file is part of Bitmap Drawing.
+ *
+ *  Bitmap Drawing is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Bitmap Drawing is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "../bitmap.h"
+#include "../render.h"
+#include "../main.h"
+#include "test.h"
+
+/*
+ * Sizes at the limit of bitmap files (BITMAP_MAX_FILE_SIZE): the largest
+ * picture of a row that fits (file of 0xfffffffe bytes, the size of a file
+ * is a multiple of 4 plus the header, it can't be 0xffffffff), the largest
+ * square that fits and the smallest ones that don't
+ */
+#define TEST_ROW_FITS 1431655746
+#define TEST_ROW_TOO_LARGE 1431655747
+#define TEST_SQUARE_FITS 37837
+#define TEST_SQUARE_TOO_LARGE 37838
+
+/* output of the bitmap program run by the tests */
+#define TEST_OUTPUT "/tmp/bitmap_test_size.bmp"
+
+//-----------------------------------------------------------------------------
+///
+/// Read the file size a bitmap file header stores
+///
+/// @param header  file header
+///
+/// @return bf_size of the header
+//
+static uint32_t test_header_size(const char *header)
+{
+	const uint8_t *h = (const uint8_t *)header;
+	return h[2] | (h[3] << 8) | (h[4] << 16) | ((uint32_t)h[5] << 24);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Write a pixel buffer of width x height pixels as bitmap file to
+/// /dev/null, the pixels are a reserved mapping that is never touched, so
+/// pictures of 4 GB cost no memory
+///
+/// @param width   width of the picture
+/// @param height  height of the picture
+/// @param render  1 to write with render_write_file, 0 with
+///                bitmap_write_file
+///
+/// @return BITMAP_* or RENDER_* code of the write, -1 if the test could
+///         not set it up
+//
+static int test_write(uint32_t width, uint32_t height, int render)
+{
+	size_t size = bitmap_pixel_array_size(width, height);
+	char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS |
+					  MAP_NORESERVE, -1, 0);
+	if (data == MAP_FAILED)
+	{
+		return -1;
+	}
+	int ret = -1;
+	FILE *file = fopen("/dev/null", "w");
+	if (file == NULL)
+	{
+		goto test_write_cleanup1;
+	}
+	PixelBuffer pix_buffer;
+	bitmap_pixel_buffer_init(&pix_buffer, data, size, width, height);
+	if (render)
+	{
+		RenderContext *context = render_context_new();
+		if (context == NULL)
+		{
+			goto test_write_cleanup2;
+		}
+		ret = render_write_file(context, &pix_buffer, RENDER_FORMAT_BMP, 0,
+								file);
+		render_context_delete(context);
+	}
+	else
+	{
+		ret = bitmap_write_file(fileno(file), &pix_buffer);
+	}
+
+test_write_cleanup2:
+	fclose(file);
+test_write_cleanup1:
+	munmap(data, size);
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Encode a pixel buffer of width x height pixels as bitmap into memory,
+/// like test_write the pixels are never touched
+///
+/// @param width   width of the picture
+/// @param height  height of the picture
+///
+/// @return RENDER_* code of render_encode, -1 if the test could not set it
+///         up
+//
+static int test_encode(uint32_t width, uint32_t height)
+{
+	size_t size = bitmap_pixel_array_size(width, height);
+	char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS |
+					  MAP_NORESERVE, -1, 0);
+	if (data == MAP_FAILED)
+	{
+		return -1;
+	}
+	int ret = -1;
+	RenderContext *context = render_context_new();
+	if (context != NULL)
+	{
+		PixelBuffer pix_buffer;
+		bitmap_pixel_buffer_init(&pix_buffer, data, size, width, height);
+		const char *encoded;
+		size_t encoded_size;
+		ret = render_encode(context, &pix_buffer, RENDER_FORMAT_BMP, 0,
+							&encoded, &encoded_size);
+		render_context_delete(context);
+	}
+	munmap(data, size);
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Run the bitmap program with an empty scene
+///
+/// @param width   width argument
+/// @param height  height argument
+///
+/// @return exit code of the program, -1 if it could not be run
+//
+static int test_run(const char *width, const char *height)
+{
+	char command[256];
+	snprintf(command, sizeof(command), "./bitmap /dev/null %s %s %s "
+			 "2> /dev/null", TEST_OUTPUT, width, height);
+	int status = system(command);
+	if (status == -1 || !WIFEXITED(status))
+	{
+		return -1;
+	}
+	return WEXITSTATUS(status);
+}
+
+int main(void)
+{
+	/* file sizes are calculated in 64 bits */
+	TEST_CHECK(bitmap_pixel_array_row_size(UINT32_MAX) ==
+			   3 * (uint64_t)UINT32_MAX + 3);
+	TEST_CHECK(bitmap_file_size(UINT32_MAX, UINT32_MAX) ==
+			   BITMAP_HEADER_SIZE +
+			   (3 * (uint64_t)UINT32_MAX + 3) * UINT32_MAX);
+	TEST_CHECK(bitmap_file_size(TEST_ROW_FITS, 1) ==
+			   BITMAP_MAX_FILE_SIZE - 1);
+	TEST_CHECK(bitmap_file_size(TEST_ROW_TOO_LARGE, 1) >
+			   BITMAP_MAX_FILE_SIZE);
+	TEST_CHECK(bitmap_file_size(TEST_SQUARE_FITS, TEST_SQUARE_FITS) ==
+			   4294953598ULL);
+	TEST_CHECK(bitmap_file_size(TEST_SQUARE_TOO_LARGE, TEST_SQUARE_TOO_LARGE)
+			   > BITMAP_MAX_FILE_SIZE);
+
+	/* headers are written up to the limit and store the size of the file */
+	char header[BITMAP_HEADER_SIZE];
+	TEST_CHECK(bitmap_file_header_init(header, TEST_ROW_FITS, 1) ==
+			   BITMAP_SUCCESS);
+	TEST_CHECK(test_header_size(header) == BITMAP_MAX_FILE_SIZE - 1);
+	TEST_CHECK(bitmap_file_header_init(header, TEST_SQUARE_FITS,
+									   TEST_SQUARE_FITS) == BITMAP_SUCCESS);
+	TEST_CHECK(test_header_size(header) == 4294953598U);
+	TEST_CHECK(bitmap_file_header_init(header, TEST_ROW_TOO_LARGE, 1) ==
+			   BITMAP_ERR_TOO_LARGE);
+	TEST_CHECK(bitmap_file_header_init(header, TEST_SQUARE_TOO_LARGE,
+									   TEST_SQUARE_TOO_LARGE) ==
+			   BITMAP_ERR_TOO_LARGE);
+	int header_size;
+	char *header_new = bitmap_file_header_new(TEST_ROW_FITS, 1, &header_size);
+	TEST_CHECK(header_new != NULL && header_size == BITMAP_HEADER_SIZE);
+	bitmap_file_header_delete(header_new);
+	TEST_CHECK(bitmap_file_header_new(TEST_ROW_TOO_LARGE, 1, &header_size) ==
+			   NULL);
+
+	/* output files are not created for pictures above the limit */
+	unlink(TEST_OUTPUT);
+	TEST_CHECK(bitmap_pixel_buffer_map_file(TEST_OUTPUT, TEST_SQUARE_TOO_LARGE,
+											TEST_SQUARE_TOO_LARGE) == NULL);
+	TEST_CHECK(access(TEST_OUTPUT, F_OK) != 0);
+
+	/* pictures of almost 4 GB are written completely, larger ones fail */
+	TEST_CHECK(test_write(TEST_SQUARE_FITS, TEST_SQUARE_FITS, 0) ==
+			   BITMAP_SUCCESS);
+	TEST_CHECK(test_write(TEST_SQUARE_TOO_LARGE, TEST_SQUARE_TOO_LARGE, 0) ==
+			   BITMAP_ERR_TOO_LARGE);
+	TEST_CHECK(test_write(TEST_SQUARE_FITS, TEST_SQUARE_FITS, 1) ==
+			   RENDER_SUCCESS);
+	TEST_CHECK(test_write(TEST_ROW_TOO_LARGE, 1, 1) == RENDER_ERR_TOO_LARGE);
+	TEST_CHECK(test_encode(TEST_SQUARE_TOO_LARGE, TEST_SQUARE_TOO_LARGE) ==
+			   RENDER_ERR_TOO_LARGE);
+
+	/* the program fails before drawing with ERR_TOO_LARGE */
+	TEST_CHECK(test_run("37838", "37838") == ERR_TOO_LARGE);
+	TEST_CHECK(test_run("1431655747", "1") == ERR_TOO_LARGE);
+	TEST_CHECK(test_run("2147483648", "1") == ERR_USAGE);
+	TEST_CHECK(test_run("64", "48") == SUCCESS);
+	unlink(TEST_OUTPUT);
+
+	return test_summary("test_size");
+}